@@ -0,0 +1,75 @@
+/// Very simple benchmark setup for LinuxCNC-Ethercat.
+///
+/// To define benchmarks, create a function with
+/// `BENCHFUNC(bench_foo) { ... }`.  Inside, call
+/// `BENCH("description", iterations, code);` for each variant being
+/// measured.  `code` is run `iterations` times after a short warm-up,
+/// and the average time per iteration is printed.  Like the tests in
+/// `tests/`, benchmark functions are constructors and run before
+/// `main()`, so the file just needs to end with `BENCHMAIN`.
+///
+/// Numbers from these benchmarks are only meaningful relative to each
+/// other on the same machine; they aren't running on a realtime
+/// thread and won't show worst-case latency.
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static inline uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// @brief Open a counter of the instructions this thread runs in userspace.
+///
+/// Returns a file descriptor for `bench_instructions()`, or -1 if the
+/// kernel doesn't allow it, as in most containers and with
+/// `kernel.perf_event_paranoid` above 2.
+static inline int bench_instructions_open(void) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/// @brief Read an instruction counter from `bench_instructions_open()`, or 0 if it isn't open.
+static inline uint64_t bench_instructions(int fd) {
+  uint64_t count = 0;
+
+  if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) {
+    return 0;
+  }
+  return count;
+}
+
+#define BENCH(label, iterations, code)                                                      \
+  do {                                                                                      \
+    uint64_t bench_i, bench_start, bench_end;                                               \
+    for (bench_i = 0; bench_i < (iterations) / 10 + 1; bench_i++) {                         \
+      code;                                                                                 \
+    }                                                                                       \
+    bench_start = bench_now_ns();                                                           \
+    for (bench_i = 0; bench_i < (iterations); bench_i++) {                                  \
+      code;                                                                                 \
+    }                                                                                       \
+    bench_end = bench_now_ns();                                                             \
+    printf("%-56s %12.1f ns/op\n", label, (double)(bench_end - bench_start) / (iterations)); \
+  } while (0)
+
+#define BENCHFUNC(name)                         \
+  void name(void) __attribute__((constructor)); \
+  void name(void)
+
+#define BENCHMAIN \
+  int main(int argc, char **argv) { return 0; }
@@ -0,0 +1,388 @@
+/// @file
+/// @brief Benchmark for every driver's `proc_read` and `proc_write`.
+///
+/// For each type registered with `ADD_TYPES()`, this loads a config
+/// with a single slave of that type, with its default modParams, on
+/// the simulator in `sim/`, and runs it for a few cycles so that the
+/// slave is operational.  It then calls the driver's `proc_read`
+/// with a different process image every cycle, and its `proc_write`
+/// with different values on the slave's input pins every cycle, and
+/// prints the time and the number of instructions per call.  The
+/// cost of changing the data is measured separately and subtracted.
+///
+/// The data comes from a fixed seed, so runs on different commits
+/// see the same inputs.  Instruction counts are close to exact from
+/// run to run, and are what `-c` compares when they are available;
+/// the kernel only provides them where `perf_event_open()` is
+/// allowed.
+///
+/// Types that don't load without more configuration, such as
+/// `generic`, are skipped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../lcec.h"
+#include "../sim/sim.h"
+#include "bench.h"
+
+#define DEFAULT_CYCLES  1000000
+#define DEFAULT_PERIOD  1000000
+#define WARMUP_CYCLES   100
+#define ROUNDS          10
+#define VARIANTS        64  ///< Number of different inputs that are cycled through.
+#define MAX_PINS        1024
+#define MAX_RESULTS     4096
+
+extern lcec_typelinkedlist_t *typeslist;
+
+/// @brief Cost of one operation of one type.
+typedef struct {
+  char type[LCEC_CONF_STR_MAXLEN];
+  char op[8];
+  double ns;            ///< Time per call, in ns.
+  double instructions;  ///< Instructions per call, or -1 if they weren't counted.
+} result_t;
+
+static const char *modname = "bench_drivers";
+static int instructions_fd = -1;
+static uint64_t rng_state;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return (uint32_t)rng_state;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [options] [type...]\n", modname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Times each driver's read and write functions, for all types or the\n");
+  fprintf(stderr, "ones given, and prints the results as CSV.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -n <cycles>   calls to time per function (default %d)\n", DEFAULT_CYCLES);
+  fprintf(stderr, "  -o <file>     write the CSV to <file> instead of stdout\n");
+  fprintf(stderr, "  -c <file>     compare with the CSV of an earlier run, and fail if\n");
+  fprintf(stderr, "                anything got slower\n");
+  fprintf(stderr, "  -t <percent>  how much slower counts with -c (default 5)\n");
+  fprintf(stderr, "  -v            print lcec's messages\n");
+}
+
+/// @brief Write a config with one slave of a type, with its default modParams.
+static int write_config(const char *path, const lcec_typelist_t *type) {
+  const lcec_modparam_desc_t *m;
+  FILE *f;
+
+  if ((f = fopen(path, "w")) == NULL) {
+    return -1;
+  }
+  fprintf(f, "<masters>\n  <master idx=\"0\" appTimePeriod=\"%d\" refClockSyncCycles=\"1000\">\n", DEFAULT_PERIOD);
+  fprintf(f, "    <slave idx=\"0\" type=\"%s\" name=\"d\">\n", type->name);
+  for (m = type->modparams; m != NULL && m->name != NULL; m++) {
+    if (m->config_value != NULL) {
+      fprintf(f, "      <modParam name=\"%s\" value=\"%s\"/>\n", m->name, m->config_value);
+    }
+  }
+  fprintf(f, "    </slave>\n  </master>\n</masters>\n");
+  return fclose(f);
+}
+
+/// @brief Time `cycles` calls of `step`, and return the time and instructions per call.
+///
+/// After one round to warm up caches and the CPU clock, the calls are
+/// split into `ROUNDS` rounds, and the fastest round counts, which
+/// keeps other processes on the machine out of the results.
+#define MEASURE(cycles, step, ns, insns)                                                       \
+  do {                                                                                         \
+    uint64_t start_ns, start_insns;                                                            \
+    long i, round, per_round = (cycles) / ROUNDS + 1;                                          \
+    double round_ns, round_insns;                                                              \
+    ns = insns = -1;                                                                           \
+    for (i = 0; i < per_round; i++) {                                                          \
+      step;                                                                                    \
+    }                                                                                          \
+    for (round = 0; round < ROUNDS; round++) {                                                 \
+      start_insns = bench_instructions(instructions_fd);                                       \
+      start_ns = bench_now_ns();                                                               \
+      for (i = 0; i < per_round; i++) {                                                        \
+        step;                                                                                  \
+        __asm__ volatile("" ::: "memory");                                                     \
+      }                                                                                        \
+      round_ns = (double)(bench_now_ns() - start_ns) / per_round;                              \
+      round_insns = (double)(bench_instructions(instructions_fd) - start_insns) / per_round;   \
+      if (ns < 0 || round_ns < ns) {                                                           \
+        ns = round_ns;                                                                         \
+      }                                                                                        \
+      if (insns < 0 || round_insns < insns) {                                                  \
+        insns = round_insns;                                                                   \
+      }                                                                                        \
+    }                                                                                          \
+  } while (0)
+
+static void add_result(result_t *results, int *count, const char *type, const char *op, double ns, double base_ns, double insns,
+    double base_insns) {
+  result_t *r;
+
+  if (*count >= MAX_RESULTS) {
+    return;
+  }
+  r = &results[(*count)++];
+  snprintf(r->type, sizeof(r->type), "%s", type);
+  snprintf(r->op, sizeof(r->op), "%s", op);
+  r->ns = ns > base_ns ? ns - base_ns : 0;
+  r->instructions = instructions_fd < 0 ? -1 : insns > base_insns ? insns - base_insns : 0;
+}
+
+/// @brief Load one type and time its read and write functions.
+static int bench_type(const char *config, const lcec_typelist_t *type, long cycles, result_t *results, int *count) {
+  static uint64_t values[VARIANTS * MAX_PINS];
+  static sim_pin_t *pins[MAX_PINS];
+  char prefix[LCEC_CONF_STR_MAXLEN * 2 + 16];
+  lcec_master_t *master;
+  lcec_slave_t *slave;
+  uint8_t *data, *images;
+  size_t size;
+  double ns, base_ns, insns, base_insns;
+  int i, j, pin_count;
+  sim_pin_t *pin;
+
+  if (write_config(config, type) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to write %s\n", modname, config);
+    return -1;
+  }
+  if (sim_start(config) != 0) {
+    return -1;
+  }
+  if ((master = sim_funct_arg(LCEC_MODULE_NAME ".0.read")) == NULL || (slave = master->first_slave) == NULL ||
+      (data = sim_master_data(0, &size)) == NULL) {
+    sim_stop();
+    return -1;
+  }
+
+  // let the slave come up
+  for (i = 0; i < WARMUP_CYCLES; i++) {
+    sim_set_time((long long)i * DEFAULT_PERIOD);
+    sim_call(LCEC_MODULE_NAME ".read-all", DEFAULT_PERIOD);
+    sim_call(LCEC_MODULE_NAME ".write-all", DEFAULT_PERIOD);
+  }
+
+  rng_state = 0x9e3779b97f4a7c15ULL;
+  if (slave->proc_read != NULL && size > 0) {
+    if ((images = malloc(VARIANTS * size)) == NULL) {
+      sim_stop();
+      return -1;
+    }
+    for (i = 0; i < (int)(VARIANTS * size); i++) {
+      images[i] = (uint8_t)rng_next();
+    }
+    MEASURE(cycles, memcpy(data, images + (i % VARIANTS) * size, size), base_ns, base_insns);
+    MEASURE(cycles, memcpy(data, images + (i % VARIANTS) * size, size); slave->proc_read(slave, DEFAULT_PERIOD), ns, insns);
+    add_result(results, count, type->name, "read", ns, base_ns, insns, base_insns);
+    free(images);
+  }
+
+  if (slave->proc_write != NULL) {
+    snprintf(prefix, sizeof(prefix), "%s.%s.%s.", LCEC_MODULE_NAME, master->name, slave->name);
+    pin_count = 0;
+    for (i = 0; i < sim_pin_count() && pin_count < MAX_PINS; i++) {
+      pin = sim_pin(i);
+      if (!pin->is_param && pin->dir != HAL_OUT && strncmp(pin->name, prefix, strlen(prefix)) == 0) {
+        pins[pin_count++] = pin;
+      }
+    }
+    for (i = 0; i < VARIANTS; i++) {
+      for (j = 0; j < pin_count; j++) {
+        pin = pins[j];
+        switch (pin->type) {
+          case HAL_BIT:
+            sim_pin_set(pin, rng_next() & 1);
+            break;
+          case HAL_U32:
+            sim_pin_set(pin, rng_next() % 2001);
+            break;
+          default:
+            sim_pin_set(pin, (double)(rng_next() % 2001) - 1000);
+            break;
+        }
+        memcpy(&values[i * MAX_PINS + j], (const void *)pin->data, sizeof(uint64_t));
+      }
+    }
+
+#define SET_PINS                                                                                       \
+  for (j = 0; j < pin_count; j++) {                                                                   \
+    memcpy((void *)pins[j]->data, &values[(i % VARIANTS) * MAX_PINS + j], sizeof(uint64_t));          \
+  }
+    MEASURE(cycles, SET_PINS, base_ns, base_insns);
+    MEASURE(cycles, SET_PINS; slave->proc_write(slave, DEFAULT_PERIOD), ns, insns);
+#undef SET_PINS
+    add_result(results, count, type->name, "write", ns, base_ns, insns, base_insns);
+  }
+
+  sim_stop();
+  return 0;
+}
+
+static void print_results(FILE *out, const result_t *results, int count) {
+  int i;
+
+  fprintf(out, "type,op,ns,instructions\n");
+  for (i = 0; i < count; i++) {
+    if (results[i].instructions < 0) {
+      fprintf(out, "%s,%s,%.2f,\n", results[i].type, results[i].op, results[i].ns);
+    } else {
+      fprintf(out, "%s,%s,%.2f,%.1f\n", results[i].type, results[i].op, results[i].ns, results[i].instructions);
+    }
+  }
+}
+
+/// @brief Read the CSV of an earlier run.  Returns the number of results, or -1 on error.
+static int read_results(const char *path, result_t *results) {
+  char line[256], *type, *op, *ns, *insns, *save;
+  int count = 0;
+  FILE *f;
+
+  if ((f = fopen(path, "r")) == NULL) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL && count < MAX_RESULTS) {
+    line[strcspn(line, "\r\n")] = 0;
+    if ((type = strtok_r(line, ",", &save)) == NULL || (op = strtok_r(NULL, ",", &save)) == NULL ||
+        (ns = strtok_r(NULL, ",", &save)) == NULL || strcmp(type, "type") == 0) {
+      continue;
+    }
+    insns = strtok_r(NULL, ",", &save);
+    snprintf(results[count].type, sizeof(results[count].type), "%s", type);
+    snprintf(results[count].op, sizeof(results[count].op), "%s", op);
+    results[count].ns = atof(ns);
+    results[count].instructions = insns != NULL && *insns != 0 ? atof(insns) : -1;
+    count++;
+  }
+  fclose(f);
+  return count;
+}
+
+/// @brief Print what changed since an earlier run.  Returns the number of regressions.
+static int compare_results(const result_t *old, int old_count, const result_t *results, int count, double threshold) {
+  const result_t *o, *n;
+  double was, now;
+  const char *unit;
+  int i, j, regressions = 0;
+
+  for (i = 0; i < count; i++) {
+    n = &results[i];
+    for (j = 0, o = NULL; j < old_count; j++) {
+      if (strcmp(old[j].type, n->type) == 0 && strcmp(old[j].op, n->op) == 0) {
+        o = &old[j];
+        break;
+      }
+    }
+    if (o == NULL) {
+      continue;
+    }
+
+    if (o->instructions >= 0 && n->instructions >= 0) {
+      was = o->instructions;
+      now = n->instructions;
+      unit = "instructions";
+    } else {
+      was = o->ns;
+      now = n->ns;
+      unit = "ns";
+    }
+    // ignore changes of less than one instruction or ns
+    if (now > was * (1 + threshold / 100) && now - was >= 1) {
+      fprintf(stderr, "%s: %s %s: %.1f -> %.1f %s (+%.0f%%)\n", modname, n->type, n->op, was, now, unit,
+          was > 0 ? (now - was) * 100 / was : 100);
+      regressions++;
+    }
+  }
+  return regressions;
+}
+
+int main(int argc, char **argv) {
+  static result_t results[MAX_RESULTS], old[MAX_RESULTS];
+  const char *output = NULL, *compare = NULL;
+  char config[] = "/tmp/lcec-bench-XXXXXX";
+  const lcec_typelinkedlist_t *t;
+  long cycles = DEFAULT_CYCLES;
+  double threshold = 5;
+  int i, fd, opt, count = 0, old_count = 0, verbose = 0, wanted, skipped = 0;
+  FILE *out = stdout;
+
+  while ((opt = getopt(argc, argv, "n:o:c:t:vh")) != -1) {
+    switch (opt) {
+      case 'n':
+        cycles = atol(optarg);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'c':
+        compare = optarg;
+        break;
+      case 't':
+        threshold = atof(optarg);
+        break;
+      case 'v':
+        verbose = 1;
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+  if (cycles < 1) {
+    usage();
+    return 1;
+  }
+  if (compare != NULL && (old_count = read_results(compare, old)) < 0) {
+    fprintf(stderr, "%s: ERROR: unable to read %s\n", modname, compare);
+    return 1;
+  }
+  if ((fd = mkstemp(config)) < 0) {
+    fprintf(stderr, "%s: ERROR: unable to create a config file\n", modname);
+    return 1;
+  }
+  close(fd);
+
+  sim_set_msg_level(verbose ? RTAPI_MSG_ALL : RTAPI_MSG_NONE);
+  instructions_fd = bench_instructions_open();
+  if (instructions_fd < 0) {
+    fprintf(stderr, "%s: instruction counts are not available, comparing times\n", modname);
+  }
+
+  for (t = typeslist; t != NULL; t = t->next) {
+    wanted = (optind == argc);
+    for (i = optind; i < argc && !wanted; i++) {
+      wanted = (strcmp(argv[i], t->type->name) == 0);
+    }
+    if (wanted && bench_type(config, t->type, cycles, results, &count) != 0) {
+      if (verbose || optind < argc) {
+        fprintf(stderr, "%s: skipped %s, which doesn't load on its own\n", modname, t->type->name);
+      }
+      skipped++;
+    }
+  }
+  unlink(config);
+
+  if (output != NULL && (out = fopen(output, "w")) == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, output);
+    return 1;
+  }
+  print_results(out, results, count);
+  if (out != stdout) {
+    fclose(out);
+  }
+  if (skipped > 0) {
+    fprintf(stderr, "%s: skipped %d types that don't load on their own\n", modname, skipped);
+  }
+
+  if (compare != NULL && compare_results(old, old_count, results, count, threshold) > 0) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+/// @file
+/// @brief Benchmark for per-cycle master locking.
+///
+/// Compares the cost of the locking patterns that
+/// `lcec_read_master()` has used: one lock/unlock per slave, one
+/// critical section per cycle (kernel builds), and no locking at all
+/// (userspace builds).  The EtherCAT calls are replaced with an
+/// out-of-line no-op so that only the locking overhead is measured.
+
+#include <stdio.h>
+
+#include "../lcec.h"
+#include "bench.h"
+
+#define ITERATIONS 200000
+
+static volatile int state_reads;
+
+static void __attribute__((noinline)) fake_slave_config_state(void) { state_reads++; }
+
+static void per_slave_lock(lcec_master_t *master, int slaves) {
+  int i;
+
+  for (i = 0; i < slaves; i++) {
+    rtapi_mutex_get(&master->mutex);
+    fake_slave_config_state();
+    rtapi_mutex_give(&master->mutex);
+  }
+}
+
+static void per_cycle_lock(lcec_master_t *master, int slaves) {
+  int i;
+
+  rtapi_mutex_get(&master->mutex);
+  for (i = 0; i < slaves; i++) {
+    fake_slave_config_state();
+  }
+  rtapi_mutex_give(&master->mutex);
+}
+
+static void current_build(lcec_master_t *master, int slaves) {
+  int i;
+
+  lcec_master_lock(master);
+  for (i = 0; i < slaves; i++) {
+    fake_slave_config_state();
+  }
+  lcec_master_unlock(master);
+}
+
+BENCHFUNC(bench_locking) {
+  static lcec_master_t master;
+  static const int slave_counts[] = {10, 80, 200};
+  char label[80];
+  unsigned int i;
+
+  for (i = 0; i < sizeof(slave_counts) / sizeof(slave_counts[0]); i++) {
+    int slaves = slave_counts[i];
+
+    snprintf(label, sizeof(label), "%d slaves, lock per slave", slaves);
+    BENCH(label, ITERATIONS, per_slave_lock(&master, slaves));
+    snprintf(label, sizeof(label), "%d slaves, lock per cycle", slaves);
+    BENCH(label, ITERATIONS, per_cycle_lock(&master, slaves));
+    snprintf(label, sizeof(label), "%d slaves, lcec_master_lock() (this build)", slaves);
+    BENCH(label, ITERATIONS, current_build(&master, slaves));
+  }
+}
+
+BENCHMAIN
@@ -0,0 +1,293 @@
+/// @file
+/// @brief Benchmark for how startup and the cycle scale with the number of slaves.
+///
+/// This generates configs with a number of masters and a growing
+/// number of slaves on each, of a mix of common types, and loads each
+/// one on the simulator in `sim/`.  For each size it measures how long
+/// `lcec_conf` takes to parse the config, how long `lcec` takes to
+/// load it, how many pins and how much HAL memory it uses, and how
+/// long `lcec.read-all` and `lcec.write-all` take per cycle.
+///
+/// Each measurement is compared with the one for the previous size as
+/// a growth exponent: 1 means it grew in proportion to the number of
+/// slaves, and 2 means it grew with its square.  Exponents above the
+/// threshold are marked.
+///
+/// `-g` only prints the config for the largest size, which can be
+/// used to try the same topology elsewhere.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../lcec.h"
+#include "../sim/sim.h"
+#include "bench.h"
+
+#define DEFAULT_MASTERS 2
+#define DEFAULT_SLAVES  256
+#define MIN_SLAVES      8
+#define DEFAULT_CYCLES  10000
+#define DEFAULT_REPEATS 3
+#define DEFAULT_PERIOD  1000000
+#define WARMUP_CYCLES   100
+#define ROUNDS          10
+#define MAX_SIZES       32
+
+/// @brief Types that slaves are chosen from, in turn, after an `EK1100` coupler at position 0.
+static const char *slave_types[] = {
+    "EL1008", "EL2008", "EL1008", "EL2008", "EL3068", "EL4034", "EL5101", "EL7041", "EL1809", "EL2809",
+};
+
+/// @brief What was measured for one size.
+typedef struct {
+  int masters;
+  int slaves;            ///< Slaves per master.
+  int pins;              ///< Pins and params.
+  size_t hal_bytes;      ///< Bytes from `hal_malloc()`.
+  double conf_ns;        ///< Time for `lcec_conf` to parse the config.
+  double load_ns;        ///< Time for `rtapi_app_main()`.
+  double read_ns;        ///< Time per `lcec.read-all`.
+  double write_ns;       ///< Time per `lcec.write-all`.
+} result_t;
+
+static const char *modname = "bench_scale";
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [options]\n", modname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Loads configs with more and more slaves on the simulator, and prints\n");
+  fprintf(stderr, "how startup time, memory, and cycle time grow.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -m <masters>  number of masters (default %d)\n", DEFAULT_MASTERS);
+  fprintf(stderr, "  -s <slaves>   largest number of slaves per master; sizes double from\n");
+  fprintf(stderr, "                %d up to it (default %d)\n", MIN_SLAVES, DEFAULT_SLAVES);
+  fprintf(stderr, "  -n <cycles>   cycles to time per size (default %d)\n", DEFAULT_CYCLES);
+  fprintf(stderr, "  -r <count>    times to load each size; the fastest counts (default %d)\n", DEFAULT_REPEATS);
+  fprintf(stderr, "  -t <exponent> mark growth faster than this (default 1.2)\n");
+  fprintf(stderr, "  -o <file>     also write the results as CSV to <file>\n");
+  fprintf(stderr, "  -g            print the config for the largest size and exit\n");
+  fprintf(stderr, "  -v            print lcec's messages\n");
+}
+
+/// @brief Write a config with `masters` masters of `slaves` slaves each.
+static void write_config(FILE *f, int masters, int slaves) {
+  int m, s;
+
+  fprintf(f, "<masters>\n");
+  for (m = 0; m < masters; m++) {
+    fprintf(f, "  <master idx=\"%d\" appTimePeriod=\"%d\" refClockSyncCycles=\"1000\">\n", m, DEFAULT_PERIOD);
+    fprintf(f, "    <slave idx=\"0\" type=\"EK1100\" name=\"s0\"/>\n");
+    for (s = 1; s < slaves; s++) {
+      fprintf(f, "    <slave idx=\"%d\" type=\"%s\" name=\"s%d\"/>\n", s,
+          slave_types[(s - 1) % (sizeof(slave_types) / sizeof(slave_types[0]))], s);
+    }
+    fprintf(f, "  </master>\n");
+  }
+  fprintf(f, "</masters>\n");
+}
+
+/// @brief Time `cycles` calls of `funct`, split into `ROUNDS` rounds, and return the fastest round's ns per call.
+static double time_funct(const char *funct, long cycles, long long *clock) {
+  long i, round, per_round = cycles / ROUNDS + 1;
+  uint64_t start;
+  double ns, best = -1;
+
+  for (round = 0; round < ROUNDS; round++) {
+    start = bench_now_ns();
+    for (i = 0; i < per_round; i++) {
+      *clock += DEFAULT_PERIOD;
+      sim_set_time(*clock);
+      sim_call(funct, DEFAULT_PERIOD);
+    }
+    ns = (double)(bench_now_ns() - start) / per_round;
+    if (best < 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+/// @brief Load one size `repeats` times, and keep the fastest of each measurement.
+static int bench_size(const char *config, int masters, int slaves, long cycles, int repeats, result_t *r) {
+  long long conf_ns, load_ns, clock = 0;
+  FILE *f;
+  int i, n;
+
+  if ((f = fopen(config, "w")) == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to write %s\n", modname, config);
+    return -1;
+  }
+  write_config(f, masters, slaves);
+  fclose(f);
+
+  memset(r, 0, sizeof(*r));
+  r->masters = masters;
+  r->slaves = slaves;
+  for (n = 0; n < repeats; n++) {
+    if (sim_start(config) != 0) {
+      return -1;
+    }
+    sim_start_times(&conf_ns, &load_ns);
+    if (n == 0 || conf_ns < r->conf_ns) {
+      r->conf_ns = conf_ns;
+    }
+    if (n == 0 || load_ns < r->load_ns) {
+      r->load_ns = load_ns;
+    }
+    r->pins = sim_pin_count();
+    r->hal_bytes = sim_hal_malloc_bytes();
+
+    // let the slaves come up; the cycle is only timed the first time
+    if (n == 0) {
+      for (i = 0; i < WARMUP_CYCLES; i++) {
+        clock += DEFAULT_PERIOD;
+        sim_set_time(clock);
+        sim_call(LCEC_MODULE_NAME ".read-all", DEFAULT_PERIOD);
+        sim_call(LCEC_MODULE_NAME ".write-all", DEFAULT_PERIOD);
+      }
+      r->read_ns = time_funct(LCEC_MODULE_NAME ".read-all", cycles, &clock);
+      r->write_ns = time_funct(LCEC_MODULE_NAME ".write-all", cycles, &clock);
+    }
+    sim_stop();
+  }
+  return 0;
+}
+
+/// @brief Growth exponent of `now` over `was`, as `slaves` grew from `was_slaves`.
+static double exponent(double was, double now, int was_slaves, int slaves) {
+  if (was <= 0 || now <= 0) {
+    return 0;
+  }
+  return log(now / was) / log((double)slaves / was_slaves);
+}
+
+static void print_value(double value, double exp, int first, double threshold) {
+  if (first) {
+    printf(" %10.0f       ", value);
+  } else {
+    printf(" %10.0f %5.2f%c", value, exp, exp > threshold ? '*' : ' ');
+  }
+}
+
+static void print_results(const result_t *results, int count, double threshold) {
+  const result_t *r, *p;
+  int i;
+
+  printf("%7s %7s %17s %17s %17s %17s %17s %17s\n", "masters", "slaves", "pins", "hal-bytes", "conf-ns", "load-ns",
+      "read-all-ns", "write-all-ns");
+  for (i = 0; i < count; i++) {
+    r = &results[i];
+    p = (i > 0) ? &results[i - 1] : r;
+    printf("%7d %7d", r->masters, r->masters * r->slaves);
+    print_value(r->pins, exponent(p->pins, r->pins, p->slaves, r->slaves), i == 0, threshold);
+    print_value(r->hal_bytes, exponent(p->hal_bytes, r->hal_bytes, p->slaves, r->slaves), i == 0, threshold);
+    print_value(r->conf_ns, exponent(p->conf_ns, r->conf_ns, p->slaves, r->slaves), i == 0, threshold);
+    print_value(r->load_ns, exponent(p->load_ns, r->load_ns, p->slaves, r->slaves), i == 0, threshold);
+    print_value(r->read_ns, exponent(p->read_ns, r->read_ns, p->slaves, r->slaves), i == 0, threshold);
+    print_value(r->write_ns, exponent(p->write_ns, r->write_ns, p->slaves, r->slaves), i == 0, threshold);
+    printf("\n");
+  }
+  printf("\nEach value is followed by its growth exponent since the previous size; 1 is\n");
+  printf("linear.  Exponents above %.2f are marked with '*'.\n", threshold);
+}
+
+static void write_csv(FILE *out, const result_t *results, int count) {
+  int i;
+
+  fprintf(out, "masters,slaves,pins,hal_bytes,conf_ns,load_ns,read_all_ns,write_all_ns\n");
+  for (i = 0; i < count; i++) {
+    fprintf(out, "%d,%d,%d,%zu,%.0f,%.0f,%.1f,%.1f\n", results[i].masters, results[i].masters * results[i].slaves,
+        results[i].pins, results[i].hal_bytes, results[i].conf_ns, results[i].load_ns, results[i].read_ns,
+        results[i].write_ns);
+  }
+}
+
+int main(int argc, char **argv) {
+  static result_t results[MAX_SIZES];
+  const char *output = NULL;
+  char config[] = "/tmp/lcec-bench-XXXXXX";
+  int masters = DEFAULT_MASTERS, max_slaves = DEFAULT_SLAVES, repeats = DEFAULT_REPEATS;
+  int slaves, fd, opt, count = 0, generate = 0, verbose = 0;
+  long cycles = DEFAULT_CYCLES;
+  double threshold = 1.2;
+  FILE *out;
+
+  while ((opt = getopt(argc, argv, "m:s:n:r:t:o:gvh")) != -1) {
+    switch (opt) {
+      case 'm':
+        masters = atoi(optarg);
+        break;
+      case 's':
+        max_slaves = atoi(optarg);
+        break;
+      case 'n':
+        cycles = atol(optarg);
+        break;
+      case 'r':
+        repeats = atoi(optarg);
+        break;
+      case 't':
+        threshold = atof(optarg);
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'g':
+        generate = 1;
+        break;
+      case 'v':
+        verbose = 1;
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+  if (masters < 1 || max_slaves < 1 || cycles < 1 || repeats < 1 || optind < argc) {
+    usage();
+    return 1;
+  }
+
+  if (generate) {
+    write_config(stdout, masters, max_slaves);
+    return 0;
+  }
+
+  if ((fd = mkstemp(config)) < 0) {
+    fprintf(stderr, "%s: ERROR: unable to create a config file\n", modname);
+    return 1;
+  }
+  close(fd);
+  sim_set_msg_level(verbose ? RTAPI_MSG_ALL : RTAPI_MSG_NONE);
+
+  for (slaves = (max_slaves < MIN_SLAVES) ? max_slaves : MIN_SLAVES; count < MAX_SIZES; slaves *= 2) {
+    if (slaves > max_slaves) {
+      slaves = max_slaves;
+    }
+    if (bench_size(config, masters, slaves, cycles, repeats, &results[count]) != 0) {
+      fprintf(stderr, "%s: ERROR: unable to load %d masters with %d slaves each\n", modname, masters, slaves);
+      unlink(config);
+      return 1;
+    }
+    count++;
+    if (slaves == max_slaves) {
+      break;
+    }
+  }
+  unlink(config);
+
+  print_results(results, count, threshold);
+  if (output != NULL) {
+    if ((out = fopen(output, "w")) == NULL) {
+      fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, output);
+      return 1;
+    }
+    write_csv(out, results, count);
+    fclose(out);
+  }
+  return 0;
+}
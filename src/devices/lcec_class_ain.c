@@ -47,10 +47,10 @@ static const lcec_pindesc_t slave_pins_sync[] = {
 
 /// @brief List of HAL pins for pressure sensors.
 static const lcec_pindesc_t slave_pins_basic_pressure[] = {
-    {HAL_S32, HAL_OUT, offsetof(lcec_class_ain_channel_t, raw_val), "%s.%s.%s.press-%d-raw"},
-    {HAL_FLOAT, HAL_OUT, offsetof(lcec_class_ain_channel_t, val), "%s.%s.%s.press-%d-pressure"},
-    {HAL_FLOAT, HAL_IO, offsetof(lcec_class_ain_channel_t, scale), "%s.%s.%s.press-%d-scale"},
-    {HAL_FLOAT, HAL_IO, offsetof(lcec_class_ain_channel_t, bias), "%s.%s.%s.press-%d-bias"},
+    {HAL_S32, HAL_OUT, offsetof(lcec_class_ain_channel_t, raw_val), "%s.%s.%s.%s-%d-raw"},
+    {HAL_FLOAT, HAL_OUT, offsetof(lcec_class_ain_channel_t, val), "%s.%s.%s.%s-%d-pressure"},
+    {HAL_FLOAT, HAL_IO, offsetof(lcec_class_ain_channel_t, scale), "%s.%s.%s.%s-%d-scale"},
+    {HAL_FLOAT, HAL_IO, offsetof(lcec_class_ain_channel_t, bias), "%s.%s.%s.%s-%d-bias"},
     {HAL_TYPE_UNSPECIFIED, HAL_DIR_UNSPECIFIED, -1, NULL},
 };
 
@@ -133,7 +133,7 @@ lcec_class_ain_channel_t *lcec_ain_register_channel(lcec_slave_t *slave, int id,
   // The default name depends on the port type.
   const char *name_prefix = "ain";
   if (is_temperature) name_prefix = "temp";
-  if (is_pressure) name_prefix = "pressure";
+  if (is_pressure) name_prefix = "press";
   if (opt && opt->name_prefix) name_prefix = opt->name_prefix;
 
   // If we were passed a NULL opt, then create a new
@@ -228,11 +228,18 @@ lcec_class_ain_channel_t *lcec_ain_register_channel(lcec_slave_t *slave, int id,
 ///
 /// Call this once per channel registered, from inside of your device's
 /// read function.  Use `lcec_ain_read_all` to read all pins.
+///
+/// While the slave's process data is stale, all pins keep their last
+/// values.
 void lcec_ain_read(lcec_slave_t *slave, lcec_class_ain_channel_t *data) {
   uint8_t *pd = slave->master->process_data;
   int value;  // Needs to be large enough to hold either a uint16_t or an sint16_t without loss.
   int max_value = data->options->max_value;
 
+  if (lcec_slave_input_state(slave) != LCEC_INPUT_VALID) {
+    return;
+  }
+
   // Update status bits, if enabled
   if (!data->options->valueonly) {
     *(data->overrange) = EC_READ_BIT(&pd[data->ovr_pdo_os], data->ovr_pdo_bp);
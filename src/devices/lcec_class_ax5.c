@@ -194,6 +194,7 @@ void lcec_class_ax5_read(lcec_slave_t *slave, lcec_class_ax5_chan_t *chan) {
   lcec_master_t *master = slave->master;
   uint8_t *pd = master->process_data;
   uint32_t pos_cnt;
+  lcec_input_state_t input;
 
   // wait for slave to be operational
   if (!slave->state.operational) {
@@ -208,6 +209,16 @@ void lcec_class_ax5_read(lcec_slave_t *slave, lcec_class_ax5_chan_t *chan) {
   // check inputs
   lcec_class_ax5_check_scales(chan);
 
+  // hold or extrapolate the position while the process data is stale
+  input = lcec_slave_input_state(slave);
+  if (input != LCEC_INPUT_VALID) {
+    class_enc_stale(&chan->enc, chan->pos_resolution, chan->scale_rcpt, input);
+    if (chan->fb2_enabled) {
+      class_enc_stale(&chan->enc_fb2, 1, chan->scale_fb2_rcpt, input);
+    }
+    return;
+  }
+
   *(chan->status) = EC_READ_U16(&pd[chan->status_pdo_os]);
 
   // check fault
@@ -478,8 +478,22 @@ lcec_class_cia402_channel_t *lcec_cia402_register_channel(
 ///
 /// Call this once per channel registered, from inside of your device's
 /// read function.  Use `lcec_cia402_read_all` to read all channels.
+///
+/// While the slave's process data is stale, all pins keep their last
+/// values, except `actual-position`, which is extrapolated for up to
+/// the master's `extrapolateCycles`.
 void lcec_cia402_read(lcec_slave_t *slave, lcec_class_cia402_channel_t *data) {
   uint8_t *pd = slave->master->process_data;
+  lcec_input_state_t input = lcec_slave_input_state(slave);
+  int32_t last_position;
+
+  if (input != LCEC_INPUT_VALID) {
+    if (data->enabled->enable_actual_position && data->position_read) {
+      *(data->actual_position) += lcec_extrap_stale(&data->extrap, input);
+    }
+    return;
+  }
+  last_position = data->enabled->enable_actual_position ? *(data->actual_position) : 0;
 
 #define READ_OPT(pin_name)              \
   if (data->enabled->enable_##pin_name) \
@@ -490,6 +504,13 @@ void lcec_cia402_read(lcec_slave_t *slave, lcec_class_cia402_channel_t *data) {
   // Read from all readable PDOs.
   FOR_ALL_READ_PDOS_DO(READ_OPT);
 
+  if (data->enabled->enable_actual_position) {
+    if (data->position_read) {
+      lcec_extrap_update(&data->extrap, (int32_t)((uint32_t)*(data->actual_position) - (uint32_t)last_position));
+    }
+    data->position_read = 1;
+  }
+
   if (data->enabled->enable_digital_input) {
     lcec_din_read_all(slave, data->din);
   }
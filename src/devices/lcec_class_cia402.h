@@ -286,6 +286,9 @@ typedef struct {
 
   lcec_class_cia402_channel_options_t *options;  ///< The options used to create this device.
   lcec_class_cia402_enabled_t *enabled;
+
+  int position_read;     ///< Set once `actual_position` has been read at least once.
+  lcec_extrap_t extrap;  ///< Extrapolates `actual_position` while the process data is stale.
 } lcec_class_cia402_channel_t;
 
 typedef struct {
@@ -46,6 +46,8 @@ static const lcec_paramdesc_t slave_params[] = {
     {HAL_TYPE_UNSPECIFIED},
 };
 
+static void enc_update(
+    lcec_class_enc_data_t *hal_data, uint64_t pprev, double scale, uint32_t raw, uint32_t ext_latch_raw, int ext_latch_ena);
 static int32_t raw_diff(int shift, uint32_t raw_a, uint32_t raw_b);
 static void set_ref(lcec_class_enc_data_t *hal_data, long long ref);
 static long long signed_mod_64(long long val, unsigned long div);
@@ -79,6 +81,32 @@ int class_enc_init(lcec_slave_t *slave, lcec_class_enc_data_t *hal_data, int raw
 
 void class_enc_update(
     lcec_class_enc_data_t *hal_data, uint64_t pprev, double scale, uint32_t raw, uint32_t ext_latch_raw, int ext_latch_ena) {
+  if (!hal_data->do_init) {
+    lcec_extrap_update(&hal_data->extrap, raw_diff(hal_data->raw_shift, raw, *(hal_data->raw)));
+  }
+  enc_update(hal_data, pprev, scale, raw, ext_latch_raw, ext_latch_ena);
+}
+
+/// @brief Update the position while the slave's inputs are not valid.
+///
+/// Call this instead of `class_enc_update()` when
+/// `lcec_slave_input_state()` isn't `LCEC_INPUT_VALID`.  The raw
+/// count is moved on at the speed of the last valid cycles, or held,
+/// depending on `input`.  Index and latch inputs are ignored until
+/// the data is valid again.
+void class_enc_stale(lcec_class_enc_data_t *hal_data, uint64_t pprev, double scale, lcec_input_state_t input) {
+  uint32_t raw;
+
+  if (hal_data->do_init) {
+    return;
+  }
+
+  raw = (*(hal_data->raw) + lcec_extrap_stale(&hal_data->extrap, input)) & hal_data->raw_mask;
+  enc_update(hal_data, pprev, scale, raw, 0, 0);
+}
+
+static void enc_update(
+    lcec_class_enc_data_t *hal_data, uint64_t pprev, double scale, uint32_t raw, uint32_t ext_latch_raw, int ext_latch_ena) {
   long long pos, mod;
   uint32_t ovfl_win;
   int sign;
@@ -54,10 +54,13 @@ typedef struct {
 
   int index_sign;
 
+  lcec_extrap_t extrap;
+
 } lcec_class_enc_data_t;
 
 int class_enc_init(struct lcec_slave *slave, lcec_class_enc_data_t *hal_data, int raw_bits, const char *pfx);
 void class_enc_update(
     lcec_class_enc_data_t *hal_data, uint64_t pprev, double scale, uint32_t raw, uint32_t ext_latch_raw, int ext_latch_ena);
+void class_enc_stale(lcec_class_enc_data_t *hal_data, uint64_t pprev, double scale, lcec_input_state_t input);
 
 #endif
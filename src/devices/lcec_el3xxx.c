@@ -252,6 +252,9 @@ static int lcec_el3xxx_init(int comp_id, lcec_slave_t *slave) {
     options->is_pressure = flags & F_PRESSURE;
 
     hal_data->channels[i] = lcec_ain_register_channel(slave, i, 0x6000 + (i << 4), options);
+    if (hal_data->channels[i] == NULL) {
+      return -EIO;
+    }
   }
 
   slave->proc_read = lcec_el3xxx_read;
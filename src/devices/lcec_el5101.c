@@ -80,6 +80,7 @@ typedef struct {
   int16_t last_count;
   double old_scale;
   double scale;
+  lcec_extrap_t extrap;
 
   int last_operational;
 } lcec_el5101_data_t;
@@ -205,6 +206,7 @@ static void lcec_el5101_read(lcec_slave_t *slave, long period) {
   int16_t raw_count, raw_latch, raw_delta;
   uint16_t raw_period, raw_window;
   uint32_t raw_frequency;
+  lcec_input_state_t input;
 
   // wait for slave to be operational
   if (!slave->state.operational) {
@@ -225,6 +227,18 @@ static void lcec_el5101_read(lcec_slave_t *slave, long period) {
     hal_data->scale = 1.0 / *(hal_data->pos_scale);
   }
 
+  // hold or extrapolate the count while the process data is stale
+  input = lcec_slave_input_state(slave);
+  if (input != LCEC_INPUT_VALID) {
+    if (hal_data->last_operational && !hal_data->do_init) {
+      raw_delta = lcec_extrap_stale(&hal_data->extrap, input);
+      hal_data->last_count += raw_delta;
+      *(hal_data->count) += raw_delta;
+      *(hal_data->pos) = *(hal_data->count) * hal_data->scale;
+    }
+    return;
+  }
+
   // get bit states
   raw_status = EC_READ_U8(&pd[hal_data->status_pdo_os]);
   *(hal_data->inext) = raw_status & LCEC_EL5101_STATUS_INPUT;
@@ -244,6 +258,7 @@ static void lcec_el5101_read(lcec_slave_t *slave, long period) {
   if (!hal_data->last_operational) {
     hal_data->last_count = raw_count;
   }
+  lcec_extrap_update(&hal_data->extrap, (int16_t)(raw_count - hal_data->last_count));
 
   // check for counter set done
   if (raw_status & LCEC_EL5101_STATUS_CNTSET_ACC) {
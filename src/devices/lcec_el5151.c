@@ -92,6 +92,7 @@ typedef struct {
   int32_t last_count;
   double old_scale;
   double scale;
+  lcec_extrap_t extrap;
 
   int last_operational;
 } lcec_el5151_data_t;
@@ -235,6 +236,7 @@ static void lcec_el5151_read(lcec_slave_t *slave, long period) {
   lcec_el5151_data_t *hal_data = (lcec_el5151_data_t *)slave->hal_data;
   uint8_t *pd = master->process_data;
   int32_t raw_count, raw_latch, raw_delta;
+  lcec_input_state_t input;
   uint32_t raw_period;
 
   // wait for slave to be operational
@@ -256,6 +258,18 @@ static void lcec_el5151_read(lcec_slave_t *slave, long period) {
     hal_data->scale = 1.0 / *(hal_data->pos_scale);
   }
 
+  // hold or extrapolate the count while the process data is stale
+  input = lcec_slave_input_state(slave);
+  if (input != LCEC_INPUT_VALID) {
+    if (hal_data->last_operational && !hal_data->do_init) {
+      raw_delta = lcec_extrap_stale(&hal_data->extrap, input);
+      hal_data->last_count += raw_delta;
+      *(hal_data->count) += raw_delta;
+      *(hal_data->pos) = *(hal_data->count) * hal_data->scale;
+    }
+    return;
+  }
+
   // get bit states
   *(hal_data->ina) = EC_READ_BIT(&pd[hal_data->ina_pdo_os], hal_data->ina_pdo_bp);
   *(hal_data->inb) = EC_READ_BIT(&pd[hal_data->inb_pdo_os], hal_data->inb_pdo_bp);
@@ -276,6 +290,7 @@ static void lcec_el5151_read(lcec_slave_t *slave, long period) {
   if (!hal_data->last_operational) {
     hal_data->last_count = raw_count;
   }
+  lcec_extrap_update(&hal_data->extrap, (raw_count - hal_data->last_count));
 
   // check for counter set done
   if (EC_READ_BIT(&pd[hal_data->set_count_done_pdo_os], hal_data->set_count_done_pdo_bp)) {
@@ -69,6 +69,7 @@ typedef struct {
   int last_index;
   double old_scale;
   double scale;
+  lcec_extrap_t extrap;
 } lcec_el5152_chan_t;
 
 typedef struct {
@@ -225,6 +226,7 @@ static void lcec_el5152_read(lcec_slave_t *slave, long period) {
   lcec_el5152_chan_t *chan;
   int32_t idx_count, raw_count, raw_delta;
   uint32_t raw_period;
+  lcec_input_state_t input;
 
   // wait for slave to be operational
   if (!slave->state.operational) {
@@ -232,6 +234,23 @@ static void lcec_el5152_read(lcec_slave_t *slave, long period) {
     return;
   }
 
+  // hold or extrapolate the counts while the process data is stale
+  input = lcec_slave_input_state(slave);
+  if (input != LCEC_INPUT_VALID) {
+    if (hal_data->last_operational) {
+      for (i = 0; i < LCEC_EL5152_CHANS; i++) {
+        chan = &hal_data->chans[i];
+        if (!chan->do_init) {
+          raw_delta = lcec_extrap_stale(&chan->extrap, input);
+          chan->last_count += raw_delta;
+          *(chan->count) += raw_delta;
+          *(chan->pos) = *(chan->count) * chan->scale;
+        }
+      }
+    }
+    return;
+  }
+
   // check inputs
   for (i = 0; i < LCEC_EL5152_CHANS; i++) {
     chan = &hal_data->chans[i];
@@ -263,6 +282,7 @@ static void lcec_el5152_read(lcec_slave_t *slave, long period) {
     if (!hal_data->last_operational) {
       chan->last_count = raw_count;
     }
+    lcec_extrap_update(&chan->extrap, raw_count - chan->last_count);
 
     // check for counter set done
     if (EC_READ_BIT(&pd[chan->set_count_done_pdo_os], chan->set_count_done_pdo_bp)) {
@@ -372,6 +372,7 @@ static void lcec_el7211_read(lcec_slave_t *slave, long period) {
   int32_t vel_raw;
   double vel;
   uint32_t pos_cnt;
+  lcec_input_state_t input;
 
   // wait for slave to be operational
   if (!slave->state.operational) {
@@ -389,6 +390,13 @@ static void lcec_el7211_read(lcec_slave_t *slave, long period) {
   // check for change in scale value
   lcec_el7211_check_scales(hal_data);
 
+  // hold or extrapolate the position while the process data is stale
+  input = lcec_slave_input_state(slave);
+  if (input != LCEC_INPUT_VALID) {
+    class_enc_stale(&hal_data->enc, hal_data->pos_resolution, hal_data->scale_rcpt, input);
+    return;
+  }
+
   // read status word
   status = EC_READ_U16(&pd[hal_data->status_pdo_os]);
   *(hal_data->status_ready) = (status >> 0) & 0x01;
@@ -437,6 +445,11 @@ static void lcec_el7201_9014_read(lcec_slave_t *slave, long period) {
 
   lcec_el7211_read(slave, period);
 
+  // keep the inputs while the process data is stale
+  if (lcec_slave_input_state(slave) != LCEC_INPUT_VALID) {
+    return;
+  }
+
   // read info1
   info1 = EC_READ_U16(&pd[hal_data->info1_pdo_os]);
   *(hal_data->input_0) = (info1 >> 0) & 0x01;
@@ -466,7 +479,7 @@ static void lcec_el7211_write(lcec_slave_t *slave, long period) {
   if (*(hal_data->enable)) {
     velo_cmd = clamp(*(hal_data->vel_cmd), hal_data->min_vel, hal_data->max_vel);
   }
-  velo_maxdelta = hal_data->max_accel * (double)period * 1e-9;
+  velo_maxdelta = hal_data->max_accel * (double)lcec_slave_time(slave)->delta * 1e-9;
   *(hal_data->vel_cmd_out) = clamp(velo_cmd, *(hal_data->vel_cmd_out) - velo_maxdelta, *(hal_data->vel_cmd_out) + velo_maxdelta);
 
   control = 0;
@@ -54,7 +54,7 @@ int lcec_generic_init(int comp_id, lcec_slave_t *slave) {
   // initialize pins
   for (i = 0; i < slave->generic_pdo_entry_count; i++, hal_data++) {
     // PDO mapping
-    lcec_pdo_init(slave, hal_data->pdo_idx, hal_data->pdo_sidx, &hal_data->pdo_os, &hal_data->pdo_bp);
+    lcec_pdo_init_domain(slave, hal_data->domain, hal_data->pdo_idx, hal_data->pdo_sidx, &hal_data->pdo_os, &hal_data->pdo_bp);
 
     switch (hal_data->type) {
       case HAL_BIT:
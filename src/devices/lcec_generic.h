@@ -39,6 +39,7 @@ typedef struct {
   uint8_t pdo_sidx;
   unsigned int pdo_os;
   unsigned int pdo_bp;
+  lcec_domain_t *domain;
 } lcec_generic_pin_t;
 
 int lcec_generic_init(int comp_id, struct lcec_slave *slave);
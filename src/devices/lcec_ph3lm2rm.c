@@ -275,6 +275,19 @@ static void lcec_ph3lm2rm_read(lcec_slave_t *slave, long period) {
   int i;
   lcec_ph3lm2rm_rm_data_t *rm;
   lcec_ph3lm2rm_lm_data_t *lm;
+  lcec_input_state_t input;
+
+  // hold or extrapolate the positions while the process data is stale
+  input = lcec_slave_input_state(slave);
+  if (input != LCEC_INPUT_VALID) {
+    for (i = 0, lm = hal_data->lms; i < LCEC_PH3LM2RM_LM_COUNT; i++, lm++) {
+      class_enc_stale(&lm->ch.enc, 0, lm->ch.scale, input);
+    }
+    for (i = 0, rm = hal_data->rms; i < LCEC_PH3LM2RM_RM_COUNT; i++, rm++) {
+      class_enc_stale(&rm->ch.enc, 0, rm->ch.scale, input);
+    }
+    return;
+  }
 
   *(hal_data->sync_locked) = EC_READ_BIT(&pd[hal_data->sync_locked_os], hal_data->sync_locked_bp);
 
@@ -421,6 +421,7 @@ static void lcec_stmds5k_read(lcec_slave_t *slave, long period) {
   int16_t speed_raw, torque_raw;
   double rpm, torque;
   uint32_t pos_cnt;
+  lcec_input_state_t input;
 
   // wait for slave to be operational
   if (!slave->state.operational) {
@@ -437,6 +438,16 @@ static void lcec_stmds5k_read(lcec_slave_t *slave, long period) {
   // check for change in scale value
   lcec_stmds5k_check_scales(hal_data);
 
+  // hold or extrapolate the position while the process data is stale
+  input = lcec_slave_input_state(slave);
+  if (input != LCEC_INPUT_VALID) {
+    class_enc_stale(&hal_data->enc, STMDS5K_PPREV, hal_data->pos_scale_rcpt, input);
+    if (hal_data->extenc_conf != NULL) {
+      class_enc_stale(&hal_data->extenc, hal_data->extenc_conf->pprev, hal_data->extenc_scale_rcpt, input);
+    }
+    return;
+  }
+
   // read device state
   dev_state = EC_READ_U8(&pd[hal_data->dev_state_pdo_os]);
   *(hal_data->ready) = (dev_state >> 0) & 0x01;
@@ -29,7 +29,13 @@ extern "C" {
 #include "ecrt.h"
 #include "hal.h"
 #include "lcec_conf.h"
+#include "lcec_image.h"
+#include "lcec_recorder.h"
+#include "lcec_log.h"
+#include "lcec_pll.h"
+#include "lcec_profile.h"
 #include "lcec_rtapi.h"
+#include "lcec_timing.h"
 #include "rtapi_ctype.h"
 #include "rtapi_math.h"
 #include "rtapi_string.h"
@@ -69,9 +75,21 @@ extern "C" {
 #define LCEC_MODUSOFT_VID   0x00000907
 #define LCEC_RTELLIGENT_VID 0x00000a88
 
-// State update period (ns)
+// Default state update period (ns), overridden by `stateUpdatePeriod`
 #define LCEC_STATE_UPDATE_PERIOD 1000000000LL
 
+// Default DC sync monitor threshold (ns), for the `dc-in-sync` pin
+#define LCEC_DC_SYNC_THRESHOLD 1000
+
+// Cycles measured before picking a shift for `sync0Shift="auto"`
+#define LCEC_AUTO_SHIFT_CYCLES 200
+
+// Default number of lost frames that drivers bridge, overridden by `extrapolateCycles`
+#define LCEC_EXTRAPOLATE_CYCLES 2
+
+// Cache line size, for keeping data used by different CPUs apart
+#define LCEC_CACHELINE_SIZE 64
+
 // IDN builder
 #define LCEC_IDN_TYPE_P 0x8000
 #define LCEC_IDN_TYPE_S 0x0000
@@ -105,7 +123,12 @@ extern "C" {
 #define LCEC_HAL_ALLOCATE_STRING(len) ((char *)lcec_hal_malloc(len, __FILE__, __func__, __LINE__))
 
 /// Allocate memory for an array of `count` `expr`s.  This zeros out the allocated memory automatically, and exits if malloc fails.
-#define LCEC_HAL_ALLOCATE_ARRAY(expr, count) ((__typeof__(expr) *)lcec_hal_malloc(sizeof(expr) * count, __FILE__, __func__, __LINE__))
+#define LCEC_HAL_ALLOCATE_ARRAY(expr, count) ((__typeof__(expr) *)lcec_hal_malloc(sizeof(expr) * (count), __FILE__, __func__, __LINE__))
+
+/// Allocate memory for a `type` followed by a flexible array of `count` `elemtype`s.  This zeros out the allocated memory automatically,
+/// and exits if malloc fails.
+#define LCEC_HAL_ALLOCATE_FLEX(type, elemtype, count)                                                \
+  ((type *)lcec_hal_malloc(sizeof(type) + sizeof(elemtype) * (count), __FILE__, __func__, __LINE__))
 
 /// Allocate memory for an `expr`.  This zeros out the allocated memory automatically, and exits if malloc fails.
 #define LCEC_ALLOCATE(expr) ((__typeof__(expr) *)lcec_malloc(sizeof(expr), __FILE__, __func__, __LINE__))
@@ -114,9 +137,15 @@ extern "C" {
 #define LCEC_ALLOCATE_STRING(len) ((char *)lcec_malloc(len, __FILE__, __func__, __LINE__))
 
 /// Allocate memory for an array of `count` `expr`s.  This zeros out the allocated memory automatically, and exits if malloc fails.
-#define LCEC_ALLOCATE_ARRAY(expr, count) ((__typeof__(expr) *)lcec_malloc(sizeof(expr) * count, __FILE__, __func__, __LINE__))
+#define LCEC_ALLOCATE_ARRAY(expr, count) ((__typeof__(expr) *)lcec_malloc(sizeof(expr) * (count), __FILE__, __func__, __LINE__))
+
+/// Allocate memory for an `expr`, starting on a cache line.  This does not zero the allocated memory, and exits if allocation fails.
+#define LCEC_ALLOCATE_ALIGNED(expr) \
+  ((__typeof__(expr) *)lcec_malloc_aligned(sizeof(expr), LCEC_CACHELINE_SIZE, __FILE__, __func__, __LINE__))
 
 typedef struct lcec_master lcec_master_t;
+typedef struct lcec_domain lcec_domain_t;
+typedef struct lcec_worker lcec_worker_t;
 typedef struct lcec_slave lcec_slave_t;
 
 typedef int (*lcec_slave_preinit_t)(lcec_slave_t *slave);
@@ -179,10 +208,18 @@ typedef struct lcec_master_data {
   hal_bit_t *state_op;
   hal_bit_t *link_up;
   hal_bit_t *all_op;
+  hal_u32_t *dc_sync_diff;
+  hal_u32_t *dc_sync_diff_max;
+  hal_u32_t *dc_sync_diff_filtered;
+  hal_bit_t *dc_in_sync;
+  hal_u32_t dc_sync_threshold;
+  hal_u32_t dc_send_offset_max;
+  hal_bit_t *shed_divided;
 #ifdef RTAPI_TASK_PLL_SUPPORT
   hal_s32_t *pll_err;
   hal_s32_t *pll_out;
-  hal_u32_t pll_step;
+  hal_bit_t *pll_locked;
+  lcec_pll_params_t pll;
   hal_u32_t pll_max_err;
   hal_u32_t *pll_reset_cnt;
 #endif
@@ -195,8 +232,30 @@ typedef struct lcec_slave_state {
   hal_bit_t *state_preop;   ///< Is the device in state `PREOP`?  Equivalant to the `.slave-state-preop` HAL pin.
   hal_bit_t *state_safeop;  ///< Is the device in state `SAFEOP`?  Equivalant to the `.slave-state-safeop` HAL pin.
   hal_bit_t *state_op;      ///< Is the device in state `OP`?  Equivalant to the `.slave-state-op` HAL pin.
+  hal_bit_t *extrapolated;  ///< Are the inputs made up by the driver because frames were lost?  The `.extrapolated` HAL pin.
 } lcec_slave_state_t;
 
+/// @brief Timing of a master's current cycle, for drivers.
+///
+/// Updated when the master receives its frame, before any driver's
+/// read function runs.  See `lcec_slave_time()`.
+typedef struct {
+  long period;        ///< Nominal period of the master's HAL thread, in ns.
+  long delta;         ///< Time since the previous cycle's frame was received, in ns; `period` in the first cycle.
+  long long receive;  ///< `rtapi_get_time()` when this cycle's frame was received.
+  uint64_t dc_time;   ///< DC application time the received frame was sent with, in ns; 0 in the first cycle.
+  uint64_t cycle;     ///< Number of cycles received so far, including this one.
+} lcec_time_t;
+
+/// @brief Entry in a domain's flat read or write dispatch table.
+typedef struct {
+  lcec_slave_rw_t proc;  ///< Callback to run, never NULL.
+  lcec_slave_t *slave;   ///< Slave to pass to `proc`.
+  void *hal_data;        ///< The slave's `hal_data`, prefetched before the call.
+  int divider;           ///< The slave's `cycle_divider`; only used in divided tables.
+  int countdown;         ///< Domain exchanges until the next call; only used in divided tables.
+} lcec_dispatch_t;
+
 typedef struct lcec_master {
   lcec_master_t *prev;              ///< Next master.
   lcec_master_t *next;              ///< Previous master.
@@ -205,9 +264,12 @@ typedef struct lcec_master {
   ec_master_t *master;              ///< EtherCAT master structure.
   unsigned long mutex;              ///< Mutex for locking operations.
   ec_pdo_entry_reg_t *pdo_entry_regs;
-  ec_domain_t *domain;
-  uint8_t *process_data;
-  int process_data_len;
+  lcec_domain_t *first_domain;  ///< First domain; always the default domain.
+  lcec_domain_t *last_domain;   ///< Last domain.
+  int domain_threads;           ///< Number of domains exchanged from their own HAL functions.
+  uint8_t *domain_memory;       ///< Process data memory shared by all domains, if allocated by us.
+  uint8_t *process_data;        ///< Start of the process data of all domains.
+  int process_data_len;         ///< Length of the process data of all domains.
   lcec_slave_t *first_slave;
   lcec_slave_t *last_slave;
   lcec_master_data_t *hal_data;
@@ -217,25 +279,142 @@ typedef struct lcec_master {
   int sync_ref_cnt;
   int sync_ref_cycles;
   long long state_update_timer;
+  long long state_update_period;    ///< Time between the start of two slave state sweeps, in ns.
+  int state_slaves_per_cycle;       ///< Number of slave states to poll per cycle.
+  lcec_slave_t *state_next_slave;   ///< Next slave to poll in the current sweep, or NULL if the sweep is done.
+  lcec_slave_t *state_first_slave;  ///< First slave polled in the current cycle.
+  lcec_slave_t *state_end_slave;    ///< Slave after the last one polled in the current cycle.
+  int received;                     ///< Set by `lcec.<master>.receive`, so that `.read` doesn't receive again.
+  int sent;                         ///< Set when `.write` sent the frames itself.
+  int send_external;                ///< Set once `lcec.<master>.send` has run; `.write` no longer sends.
+  int sync_monitor_cycles;          ///< Cycles between DC sync monitor reads, or 0 if disabled.
+  int sync_monitor_cnt;             ///< Cycles until the next DC sync monitor read.
+  int sync_monitor_pending;         ///< Set when a DC sync monitor read went out with the last frame.
+  int sync_monitor_valid;           ///< Set when `sync_monitor_diff` was updated this cycle.
+  uint32_t sync_monitor_diff;       ///< Last DC system time difference, in ns.
+  uint32_t cycle_budget;            ///< Initial `timing.budget`, in ns.
+  int shed_divided;                 ///< Skip drivers with a `cycleDivider` this cycle.
+  int auto_shift_cycles;            ///< Cycles left to measure for `sync0Shift="auto"`, or 0 when done.
+  uint32_t auto_shift_send_max;     ///< Latest send time after the start of the cycle seen so far, in ns.
+  int32_t auto_shift_saved;         ///< Send time measured on an earlier start, in ns, or -1 if there is none.
+  lcec_time_t time;                 ///< Timing of the current cycle, for drivers.
+  uint64_t app_time_sent;           ///< DC application time of the last frame sent.
+  int extrapolate_cycles;           ///< Lost frames in a row that drivers bridge by extrapolating their inputs.
+  int recorder_cycles;              ///< Depth of the flight recorder, or 0 if disabled.
+  int recorder_range_count;         ///< Number of `recorder_ranges`, 0 to record all of the process data.
+  lcec_recorder_range_t recorder_ranges[LCEC_RECORDER_RANGES];  ///< Parts of the process data to record.
   ec_master_state_t ms;
+  lcec_timing_t *timing;    ///< Cycle timing statistics.
+  lcec_profile_t *profile;  ///< Slave driver profiler.
+  lcec_log_t *log;          ///< Messages from realtime code, see `lcec_log()`.
+  lcec_image_t *image;      ///< Process image snapshots for userspace tools.
+  lcec_recorder_t *recorder;  ///< Process data flight recorder, or NULL if disabled.
+  int worker_cpu;           ///< CPU for this master's worker thread, or -1 to run in the calling HAL thread.
+  lcec_worker_t *worker;    ///< Worker thread used by `lcec.read-all`/`lcec.write-all`, if any.
 #ifdef RTAPI_TASK_PLL_SUPPORT
   uint64_t dc_ref;
   uint32_t app_time_last;
   int dc_time_valid_last;
+  lcec_pll_t pll;
+#endif
+} __attribute__((aligned(LCEC_CACHELINE_SIZE))) lcec_master_t;
+
+/// @brief Lock a master against the EtherCAT master's own accesses.
+///
+/// Kernel builds register `ecrt_master_callbacks()`, so the lock is
+/// always needed there.  In userspace builds the master is only
+/// shared when a domain is exchanged from its own HAL thread;
+/// otherwise nothing else touches it while the HAL thread is running,
+/// and the lock is skipped.
+static inline void lcec_master_lock(lcec_master_t *master) {
+#ifdef __KERNEL__
+  rtapi_mutex_get(&master->mutex);
+#else
+  if (master->domain_threads) {
+    rtapi_mutex_get(&master->mutex);
+  }
+#endif
+}
+
+/// @brief Unlock a master locked with `lcec_master_lock()`.
+static inline void lcec_master_unlock(lcec_master_t *master) {
+#ifdef __KERNEL__
+  rtapi_mutex_give(&master->mutex);
+#else
+  if (master->domain_threads) {
+    rtapi_mutex_give(&master->mutex);
+  }
 #endif
-} lcec_master_t;
+}
 
 typedef struct lcec_pdo_entry_reg {
   int current;
   int max;
   ec_pdo_entry_reg_t *pdo_entry_regs;
+  lcec_domain_t **domains;  ///< Domain for each entry, or NULL for the slave's domain.
 } lcec_pdo_entry_reg_t;
 
+/// @brief HAL pins for a process data domain.
+typedef struct {
+  hal_u32_t *working_counter;         ///< Working counter of the last exchange.
+  hal_u32_t *expected_wc;             ///< Working counter of a complete exchange, learned from the first one.
+  hal_u32_t *wc_state;                ///< Working counter state of the last exchange: 0 = zero, 1 = incomplete, 2 = complete.
+  hal_bit_t *data_valid;              ///< True if every slave took part in the last exchange.
+  hal_u32_t *missed_frames;           ///< Number of incomplete exchanges since the first complete one.
+  hal_u32_t *consecutive_misses;      ///< Number of incomplete exchanges in a row.
+  hal_u32_t *max_consecutive_misses;  ///< Highest `consecutive_misses` seen.
+} lcec_domain_data_t;
+
+/// @brief What drivers should do with their inputs this cycle.
+typedef enum {
+  LCEC_INPUT_VALID,        ///< The inputs are from this cycle.
+  LCEC_INPUT_EXTRAPOLATE,  ///< A few frames were lost; carry positions on at their last speed.
+  LCEC_INPUT_HOLD,         ///< Frames have been lost for too long, or the domain was never valid; hold everything.
+} lcec_input_state_t;
+
+/// @brief EtherCAT process data domain.
+///
+/// Every master has a `default` domain, which is always the first one
+/// and is exchanged every cycle.  Additional domains are declared
+/// with `<domain>` and are either exchanged every `cycle_divider`
+/// master cycles, or, with a divider of 0, from their own
+/// `lcec.<master>.<domain>.read` and `.write` HAL functions.  Frames
+/// for all domains are sent and received by the master's own
+/// read/write functions.
+struct lcec_domain {
+  lcec_domain_t *prev;              ///< Previous domain.
+  lcec_domain_t *next;              ///< Next domain.
+  lcec_master_t *master;            ///< Master for this domain.
+  char name[LCEC_CONF_STR_MAXLEN];  ///< Domain name.
+  int cycle_divider;                ///< Exchange every Nth master cycle, or 0 for the domain's own HAL functions.
+  int cycle_count;                  ///< Master cycles left until the next exchange.
+  int exchange;                     ///< Set when the domain was queued in the last master cycle.
+  ec_domain_t *domain;              ///< EtherCAT domain.
+  uint8_t *data;                    ///< This domain's process data.
+  int data_len;                     ///< Length of this domain's process data.
+  lcec_pdo_entry_reg_t *regs;       ///< PDO entries registered in this domain.
+  lcec_dispatch_t *read_table;      ///< Slaves with a `proc_read` and no cycle divider, in bus order.
+  int read_count;                   ///< Number of entries in `read_table`.
+  lcec_dispatch_t *write_table;     ///< Slaves with a `proc_write` and no cycle divider, in bus order.
+  int write_count;                  ///< Number of entries in `write_table`.
+  lcec_dispatch_t *read_divided;    ///< Slaves with a `proc_read` and a cycle divider, in bus order.
+  int read_divided_count;           ///< Number of entries in `read_divided`.
+  lcec_dispatch_t *write_divided;   ///< Slaves with a `proc_write` and a cycle divider, in bus order.
+  int write_divided_count;          ///< Number of entries in `write_divided`.
+  lcec_domain_data_t *hal_data;     ///< HAL pins.
+  ec_domain_state_t state;          ///< Domain state from the last exchange.
+  int data_valid;                   ///< True if every slave took part in the last exchange.
+  int stale_cycles;                 ///< Exchanges in a row that weren't valid.
+  lcec_input_state_t input;         ///< What drivers should do with their inputs, see `lcec_slave_input_state()`.
+};
+
 /// @brief Slave Distributed Clock configuration.
 typedef struct {
   uint16_t assignActivate;
   uint32_t sync0Cycle;
   int32_t sync0Shift;
+  int sync0ShiftAuto;        ///< Pick `sync0Shift` from the measured send time.
+  int32_t sync0ShiftMargin;  ///< Time between sending and sync0 for `sync0ShiftAuto`, in ns.
   uint32_t sync1Cycle;
   int32_t sync1Shift;
 } lcec_slave_dc_t;
@@ -275,14 +454,17 @@ typedef struct lcec_slave {
   lcec_slave_t *prev;                        ///< Next slave
   lcec_slave_t *next;                        ///< Previous slave
   lcec_master_t *master;                     ///< Master for this slave
+  lcec_domain_t *domain;                     ///< Domain for this slave's PDOs, unless overridden per entry.
   int index;                                 ///< Index of this slave.
   char name[LCEC_CONF_STR_MAXLEN];           ///< Slave name.
+  const char *type_name;                     ///< Device type name ("EL1008" or "generic").
   uint32_t vid;                              ///< Slave's vendor ID
   uint32_t pid;                              ///< Slave's EtherCAT PID/device ID.
   ec_sync_info_t *sync_info;                 ///< Sync Manager configuration.
   ec_slave_config_t *config;                 ///< Configuration data.
   ec_slave_config_state_t state;             ///< Slave state.
   lcec_slave_dc_t *dc_conf;                  ///< Distributed Clock configuration.
+  hal_s32_t *dc_sync0_shift;                 ///< HAL param with the sync0 shift picked for `sync0Shift="auto"`.
   lcec_slave_watchdog_t *wd_conf;            ///< Watchdog configuration.
   lcec_slave_preinit_t proc_preinit;         ///< Callback for pre-init, if any.
   lcec_slave_init_t proc_init;               ///< Callback for initializing device.
@@ -304,8 +486,71 @@ typedef struct lcec_slave {
   unsigned int *fsoe_master_offset;          ///< FSoE master offset.
   uint64_t flags;                            ///< Flags, as defined by the driver itself.
   lcec_pdo_entry_reg_t *regs;
+  int profile_idx;    ///< Position of this slave in the profiler's shared memory.
+  int cycle_divider;  ///< Run `proc_read`/`proc_write` every Nth time the slave's domain is exchanged.
+  int cycle_phase;    ///< Which of those N exchanges the callbacks run on, `0..cycle_divider-1`.
 } lcec_slave_t;
 
+/// @brief Check whether a slave's inputs are current.
+///
+/// Returns false when the last exchange of the slave's domain was
+/// incomplete, for instance because the frame was lost; the process
+/// data then still holds the inputs of an earlier cycle.  Drivers
+/// can use this to hold their outputs or to avoid acting on stale
+/// data.
+static inline int lcec_slave_data_valid(const lcec_slave_t *slave) { return slave->domain->data_valid; }
+
+/// @brief Find out what a driver should do with a slave's inputs.
+///
+/// When a frame is lost, the process data still holds the inputs of
+/// the last good cycle.  Positions read from it would stand still
+/// for a cycle and then jump, which is enough to trip a following
+/// error.  For up to `extrapolateCycles` lost frames in a row this
+/// returns `LCEC_INPUT_EXTRAPOLATE`, and drivers should carry
+/// positions on at their last speed, see `lcec_extrap_t`; after that,
+/// or before the domain was ever valid, it returns `LCEC_INPUT_HOLD`.
+static inline lcec_input_state_t lcec_slave_input_state(const lcec_slave_t *slave) { return slave->domain->input; }
+
+/// @brief Linear extrapolation of a position across lost frames.
+///
+/// Keep one per position input.  Call `lcec_extrap_update()` with
+/// the change of every real input, and add the result of
+/// `lcec_extrap_stale()` to the position in cycles without one.
+typedef struct {
+  int32_t delta;  ///< Change per cycle, from the last real inputs.
+  int32_t ahead;  ///< Sum of the changes made up since the last real input.
+  int missed;     ///< Cycles without a real input since the last one.
+} lcec_extrap_t;
+
+/// @brief Record the change of a real input.
+///
+/// `change` is relative to the value last shown, including anything
+/// made up by `lcec_extrap_stale()`.
+static inline void lcec_extrap_update(lcec_extrap_t *extrap, int32_t change) {
+  extrap->delta = (change + extrap->ahead) / (extrap->missed + 1);
+  extrap->ahead = 0;
+  extrap->missed = 0;
+}
+
+/// @brief Get the change to make up for a cycle without a real input.
+static inline int32_t lcec_extrap_stale(lcec_extrap_t *extrap, lcec_input_state_t input) {
+  int32_t change = (input == LCEC_INPUT_EXTRAPOLATE) ? extrap->delta : 0;
+
+  extrap->ahead += change;
+  if (extrap->missed < 0x7fffffff) extrap->missed++;
+  return change;
+}
+
+/// @brief Get the timing of the current cycle of a slave's master.
+///
+/// The `period` passed to read and write functions is the nominal
+/// thread period; `delta` is how long the last cycle actually took,
+/// which is better for velocities and other rates when the thread
+/// jitters.  `dc_time` tells when the received inputs were on the
+/// bus, in the same time base as DC latch timestamps.  Drivers that
+/// only run every `cycle_divider` cycles see the last cycle's values.
+static inline const lcec_time_t *lcec_slave_time(const lcec_slave_t *slave) { return &slave->master->time; }
+
 /// @brief HAL pin description.
 typedef struct {
   hal_type_t type;    ///< HAL type of this pin (`HAL_BIT`, `HAL_FLOAT`, `HAL_S32`, or `HAL_U32`).
@@ -403,11 +648,24 @@ lcec_modparam_desc_t *lcec_modparam_desc_concat(lcec_modparam_desc_t const *a, l
 lcec_modparam_desc_t *lcec_modparam_desc_merge_docs(lcec_modparam_desc_t const *a, lcec_modparam_doc_t const *b);
 
 lcec_pdo_entry_reg_t *lcec_allocate_pdo_entry_reg(int size);
+void lcec_free_pdo_entry_reg(lcec_pdo_entry_reg_t *reg);
 int lcec_pdo_init(lcec_slave_t *slave, uint16_t idx, uint16_t sidx, unsigned int *os, unsigned int *bp);
+int lcec_pdo_init_domain(lcec_slave_t *slave, lcec_domain_t *domain, uint16_t idx, uint16_t sidx, unsigned int *os, unsigned int *bp);
 int lcec_pdo_entry_reg_len(lcec_pdo_entry_reg_t *reg);
 int lcec_append_pdo_entry_reg(lcec_pdo_entry_reg_t *dest, lcec_pdo_entry_reg_t *src);
 
+int lcec_worker_start(lcec_master_t *master);
+void lcec_worker_stop(lcec_master_t *master);
+void lcec_run_masters(lcec_master_t *first_master, void (*func)(void *arg, long period), long period);
+
+lcec_domain_t *lcec_get_domain(lcec_master_t *master, const char *name);
+int lcec_domain_register(lcec_master_t *master);
+int lcec_domain_alloc_memory(lcec_master_t *master);
+int lcec_domain_activate(lcec_master_t *master);
+void lcec_update_domain_hal(lcec_domain_t *domain);
+
 void *lcec_hal_malloc(size_t size, const char *file, const char *func, int line);
 void *lcec_malloc(size_t size, const char *file, const char *func, int line);
+void *lcec_malloc_aligned(size_t size, size_t align, const char *file, const char *func, int line);
 
 #endif
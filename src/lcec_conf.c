@@ -22,9 +22,12 @@
 #include "lcec_conf.h"
 
 #include <ctype.h>
+#include <errno.h>
 #include <expat.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
@@ -46,6 +49,24 @@ static int shmem_id;
 
 static int exitEvent;
 
+#define LOG_POLL_MS 100  ///< How often realtime log messages are printed, in ms.
+
+#define SEND_TIME_SUFFIX ".sendtime"  ///< Added to the config file name to get `sendTimeFile`.
+
+/// @brief A master's realtime log, see `lcec_log.h`.
+typedef struct {
+  int index;            ///< Master index.
+  int shmem_id;         ///< RTAPI shared memory ID, or -1 if not open.
+  lcec_log_shm_t *shm;  ///< Shared memory block.
+  int32_t sendTime;     ///< Send time for `sync0Shift="auto"`, in ns, or -1 if it was never measured.
+} LCEC_CONF_LOG_T;
+
+static LCEC_CONF_LOG_T *logs;
+static int log_count;
+
+/// @brief Where send times measured for `sync0Shift="auto"` are kept from one start to the next.
+static char *sendTimeFile;
+
 typedef struct {
   LCEC_CONF_XML_INST_T xml;
 
@@ -63,6 +84,7 @@ typedef struct {
 } LCEC_CONF_XML_STATE_T;
 
 static void parseMasterAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **attr);
+static void parseDomainAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **attr);
 static void parseSlaveAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **attr);
 static void parseDcConfAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **attr);
 static void parseWatchdogAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **attr);
@@ -79,6 +101,7 @@ static void parseModParamAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char
 static const LCEC_CONF_XML_HANLDER_T xml_states[] = {
     {"masters", lcecConfTypeNone, lcecConfTypeMasters, NULL, NULL},
     {"master", lcecConfTypeMasters, lcecConfTypeMaster, parseMasterAttrs, NULL},
+    {"domain", lcecConfTypeMaster, lcecConfTypeDomain, parseDomainAttrs, NULL},
     {"slave", lcecConfTypeMaster, lcecConfTypeSlave, parseSlaveAttrs, NULL},
     {"dcConf", lcecConfTypeSlave, lcecConfTypeDcConf, parseDcConfAttrs, NULL},
     {"watchdog", lcecConfTypeSlave, lcecConfTypeWatchdog, parseWatchdogAttrs, NULL},
@@ -96,6 +119,12 @@ static const LCEC_CONF_XML_HANLDER_T xml_states[] = {
 };
 
 static int parseSyncCycle(LCEC_CONF_XML_STATE_T *state, const char *nptr);
+static int32_t loadSendTime(int index);
+static void saveSendTimes(void);
+static int addLog(int index, int32_t sendTime);
+static void openLogs(void);
+static void drainLogs(void);
+static void closeLogs(void);
 
 static void exitHandler(int sig) {
   uint64_t u = 1;
@@ -115,6 +144,8 @@ int main(int argc, char **argv) {
   LCEC_CONF_HEADER_T *header;
   uint64_t u;
   LCEC_CONF_XML_STATE_T state;
+  struct pollfd pfd;
+  int n;
 
   // initialize component
   hal_comp_id = hal_init(modname);
@@ -157,6 +188,11 @@ int main(int argc, char **argv) {
     goto fail2;
   }
   filename = argv[1];
+  if ((sendTimeFile = malloc(strlen(filename) + sizeof(SEND_TIME_SUFFIX))) == NULL) {
+    fprintf(stderr, "%s: ERROR: Couldn't allocate memory for file name\n", modname);
+    goto fail2;
+  }
+  sprintf(sendTimeFile, "%s" SEND_TIME_SUFFIX, filename);
 
   // open file
   file = fopen(filename, "r");
@@ -223,7 +259,18 @@ int main(int argc, char **argv) {
   ret = 0;
   hal_ready(hal_comp_id);
 
-  // wait for SIGTERM
+  // print realtime log messages until SIGTERM
+  openLogs();
+  pfd.fd = exitEvent;
+  pfd.events = POLLIN;
+  for (;;) {
+    drainLogs();
+    n = poll(&pfd, 1, LOG_POLL_MS);
+    if (n > 0 || (n < 0 && errno != EINTR)) {
+      break;
+    }
+  }
+  drainLogs();
   if (read(exitEvent, &u, sizeof(uint64_t)) < 0) {
     fprintf(stderr, "%s: ERROR: error reading exit event\n", modname);
   }
@@ -231,11 +278,14 @@ int main(int argc, char **argv) {
 fail5:
   rtapi_shmem_delete(shmem_id, hal_comp_id);
 fail4:
+  closeLogs();
   copyFreeOutputBuffer(&state.outputBuf, NULL);
   XML_ParserFree(state.xml.parser);
 fail3:
   fclose(file);
 fail2:
+  free(sendTimeFile);
+  sendTimeFile = NULL;
   close(exitEvent);
 fail1:
   hal_exit(hal_comp_id);
@@ -253,6 +303,8 @@ static void parseMasterAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **
   }
 
   p->confType = lcecConfTypeMaster;
+  p->workerCpu = -1;
+  p->extrapolateCycles = -1;
   while (*attr) {
     const char *name = *(attr++);
     const char *val = *(attr++);
@@ -282,6 +334,124 @@ static void parseMasterAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **
       continue;
     }
 
+    // parse stateUpdatePeriod
+    if (strcmp(name, "stateUpdatePeriod") == 0) {
+      long long period = atoll(val);
+      if (period <= 0) {
+        fprintf(stderr, "%s: ERROR: Invalid master attribute stateUpdatePeriod %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      p->stateUpdatePeriod = period;
+      continue;
+    }
+
+    // parse stateSlavesPerCycle
+    if (strcmp(name, "stateSlavesPerCycle") == 0) {
+      p->stateSlavesPerCycle = atoi(val);
+      if (p->stateSlavesPerCycle < 1) {
+        fprintf(stderr, "%s: ERROR: Invalid master attribute stateSlavesPerCycle %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      continue;
+    }
+
+    // parse workerCpu
+    if (strcmp(name, "workerCpu") == 0) {
+      p->workerCpu = atoi(val);
+      if (p->workerCpu < 0) {
+        fprintf(stderr, "%s: ERROR: Invalid master attribute workerCpu %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      continue;
+    }
+
+    // parse syncMonitorCycles
+    if (strcmp(name, "syncMonitorCycles") == 0) {
+      p->syncMonitorCycles = atoi(val);
+      if (p->syncMonitorCycles < 0) {
+        fprintf(stderr, "%s: ERROR: Invalid master attribute syncMonitorCycles %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      continue;
+    }
+
+    // parse extrapolateCycles
+    if (strcmp(name, "extrapolateCycles") == 0) {
+      p->extrapolateCycles = atoi(val);
+      if (p->extrapolateCycles < 0) {
+        fprintf(stderr, "%s: ERROR: Invalid master attribute extrapolateCycles %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      continue;
+    }
+
+    // parse cycleBudget, in ns or as a percentage of appTimePeriod
+    if (strcmp(name, "cycleBudget") == 0) {
+      char *end;
+      long budget = strtol(val, &end, 10);
+      if (budget <= 0 || (*end != 0 && strcmp(end, "%") != 0)) {
+        fprintf(stderr, "%s: ERROR: Invalid master attribute cycleBudget %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      if (*end == '%') {
+        p->cycleBudgetPct = budget;
+      } else {
+        p->cycleBudget = budget;
+      }
+      continue;
+    }
+
+    // parse recorderCycles
+    if (strcmp(name, "recorderCycles") == 0) {
+      p->recorderCycles = atoi(val);
+      if (p->recorderCycles < 0) {
+        fprintf(stderr, "%s: ERROR: Invalid master attribute recorderCycles %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      continue;
+    }
+
+    // parse recorderRanges, a list of <offset>:<length>
+    if (strcmp(name, "recorderRanges") == 0) {
+      const char *s = val;
+      char *end;
+      p->recorderRangeCount = 0;
+      while (*s != 0) {
+        unsigned long offset, length;
+        while (*s == ',' || isspace((unsigned char)*s)) {
+          s++;
+        }
+        if (*s == 0) {
+          break;
+        }
+        offset = strtoul(s, &end, 0);
+        if (end == s || *end != ':' || p->recorderRangeCount >= LCEC_CONF_RECORDER_RANGES) {
+          fprintf(stderr, "%s: ERROR: Invalid master attribute recorderRanges %s\n", modname, val);
+          XML_StopParser(inst->parser, 0);
+          return;
+        }
+        s = end + 1;
+        length = strtoul(s, &end, 0);
+        if (end == s || length == 0 || (*end != 0 && *end != ',' && !isspace((unsigned char)*end))) {
+          fprintf(stderr, "%s: ERROR: Invalid master attribute recorderRanges %s\n", modname, val);
+          XML_StopParser(inst->parser, 0);
+          return;
+        }
+        p->recorderOffset[p->recorderRangeCount] = offset;
+        p->recorderLength[p->recorderRangeCount] = length;
+        p->recorderRangeCount++;
+        s = end;
+      }
+      continue;
+    }
+
     // handle error
     fprintf(stderr, "%s: ERROR: Invalid master attribute %s\n", modname, name);
     XML_StopParser(inst->parser, 0);
@@ -293,10 +463,71 @@ static void parseMasterAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **
     snprintf(p->name, LCEC_CONF_STR_MAXLEN, "%d", p->index);
   }
 
+  p->autoShiftSendTime = loadSendTime(p->index);
+  if (addLog(p->index, p->autoShiftSendTime)) {
+    fprintf(stderr, "%s: ERROR: Couldn't allocate memory for master log\n", modname);
+    XML_StopParser(inst->parser, 0);
+    return;
+  }
+
   (*(conf_hal_data->master_count))++;
   state->currMaster = p;
 }
 
+static void parseDomainAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **attr) {
+  LCEC_CONF_XML_STATE_T *state = (LCEC_CONF_XML_STATE_T *)inst;
+
+  LCEC_CONF_DOMAIN_T *p = ADD_OUTPUT_BUFFER(&state->outputBuf, LCEC_CONF_DOMAIN_T);
+  if (p == NULL) {
+    XML_StopParser(inst->parser, 0);
+    return;
+  }
+
+  p->confType = lcecConfTypeDomain;
+  p->cycleDivider = 1;
+  while (*attr) {
+    const char *name = *(attr++);
+    const char *val = *(attr++);
+
+    // parse name
+    if (strcmp(name, "name") == 0) {
+      strncpy(p->name, val, LCEC_CONF_STR_MAXLEN);
+      p->name[LCEC_CONF_STR_MAXLEN - 1] = 0;
+      continue;
+    }
+
+    // parse cycleDivider
+    if (strcmp(name, "cycleDivider") == 0) {
+      p->cycleDivider = atoi(val);
+      if (p->cycleDivider < 0) {
+        fprintf(stderr, "%s: ERROR: Invalid domain attribute cycleDivider %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      continue;
+    }
+
+    // handle error
+    fprintf(stderr, "%s: ERROR: Invalid domain attribute %s\n", modname, name);
+    XML_StopParser(inst->parser, 0);
+    return;
+  }
+
+  // name is required
+  if (p->name[0] == 0) {
+    fprintf(stderr, "%s: ERROR: domain has no name attribute\n", modname);
+    XML_StopParser(inst->parser, 0);
+    return;
+  }
+
+  // the default domain always runs every cycle
+  if (strcmp(p->name, LCEC_CONF_DEFAULT_DOMAIN) == 0 && p->cycleDivider != 1) {
+    fprintf(stderr, "%s: ERROR: domain %s must have a cycleDivider of 1\n", modname, p->name);
+    XML_StopParser(inst->parser, 0);
+    return;
+  }
+}
+
 static void parseSlaveAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **attr) {
   const lcec_typelist_t *slaveType;
 
@@ -371,6 +602,24 @@ static void parseSlaveAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **a
       continue;
     }
 
+    // parse domain
+    if (strcmp(name, "domain") == 0) {
+      strncpy(p->domain, val, LCEC_CONF_STR_MAXLEN);
+      p->domain[LCEC_CONF_STR_MAXLEN - 1] = 0;
+      continue;
+    }
+
+    // parse cycleDivider
+    if (strcmp(name, "cycleDivider") == 0) {
+      p->cycleDivider = atoi(val);
+      if (p->cycleDivider < 1) {
+        fprintf(stderr, "%s: ERROR: Invalid slave attribute cycleDivider %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
+      continue;
+    }
+
     // generic only attributes
     if (!strcmp(p->type_name, "generic")) {
       // parse vid (hex value)
@@ -414,6 +663,7 @@ static void parseDcConfAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **
   }
 
   p->confType = lcecConfTypeDcConf;
+  p->sync0ShiftMargin = -1;
   while (*attr) {
     const char *name = *(attr++);
     const char *val = *(attr++);
@@ -432,7 +682,22 @@ static void parseDcConfAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char **
 
     // parse sync0Shift
     if (strcmp(name, "sync0Shift") == 0) {
-      p->sync0Shift = atoi(val);
+      if (strcmp(val, "auto") == 0) {
+        p->sync0ShiftAuto = 1;
+      } else {
+        p->sync0Shift = atoi(val);
+      }
+      continue;
+    }
+
+    // parse sync0ShiftMargin
+    if (strcmp(name, "sync0ShiftMargin") == 0) {
+      p->sync0ShiftMargin = atoi(val);
+      if (p->sync0ShiftMargin < 0) {
+        fprintf(stderr, "%s: ERROR: Invalid dcConfig attribute sync0ShiftMargin %s\n", modname, val);
+        XML_StopParser(inst->parser, 0);
+        return;
+      }
       continue;
     }
 
@@ -998,6 +1263,13 @@ static void parsePdoEntryAttrs(LCEC_CONF_XML_INST_T *inst, int next, const char
       continue;
     }
 
+    // parse domain
+    if (strcmp(name, "domain") == 0) {
+      strncpy(p->domain, val, LCEC_CONF_STR_MAXLEN);
+      p->domain[LCEC_CONF_STR_MAXLEN - 1] = 0;
+      continue;
+    }
+
     // handle error
     fprintf(stderr, "%s: ERROR: Invalid pdoEntry attribute %s\n", modname, name);
     XML_StopParser(inst->parser, 0);
@@ -1312,3 +1584,128 @@ static int parseSyncCycle(LCEC_CONF_XML_STATE_T *state, const char *nptr) {
   // custom value
   return atoi(nptr);
 }
+
+/// @brief Remember a master, so that its realtime log is printed once running.
+static int addLog(int index, int32_t sendTime) {
+  LCEC_CONF_LOG_T *p = realloc(logs, (log_count + 1) * sizeof(LCEC_CONF_LOG_T));
+  if (p == NULL) {
+    return 1;
+  }
+
+  logs = p;
+  logs[log_count].index = index;
+  logs[log_count].shmem_id = -1;
+  logs[log_count].shm = NULL;
+  logs[log_count].sendTime = sendTime;
+  log_count++;
+  return 0;
+}
+
+/// @brief Get the send time saved for a master by an earlier start, or -1 if there is none.
+static int32_t loadSendTime(int index) {
+  int idx;
+  long sendTime;
+  int32_t ret = -1;
+  FILE *f;
+
+  if ((f = fopen(sendTimeFile, "r")) == NULL) {
+    return -1;
+  }
+  while (fscanf(f, "%d %ld\n", &idx, &sendTime) == 2) {
+    if (idx == index && sendTime >= 0 && sendTime <= INT32_MAX) {
+      ret = sendTime;
+    }
+  }
+  fclose(f);
+  return ret;
+}
+
+/// @brief Save the send time of every master that has one, for the next start.
+///
+/// Writes a new file and renames it over the old one, so that a crash
+/// can't leave half a file behind.
+static void saveSendTimes(void) {
+  char *tmp;
+  FILE *f;
+  int i;
+
+  if ((tmp = malloc(strlen(sendTimeFile) + 5)) == NULL) {
+    return;
+  }
+  sprintf(tmp, "%s.new", sendTimeFile);
+  if ((f = fopen(tmp, "w")) == NULL) {
+    fprintf(stderr, "%s: WARNING: unable to save send times to %s\n", modname, tmp);
+    free(tmp);
+    return;
+  }
+  for (i = 0; i < log_count; i++) {
+    if (logs[i].sendTime >= 0) {
+      fprintf(f, "%d %d\n", logs[i].index, logs[i].sendTime);
+    }
+  }
+  if (fclose(f) != 0 || rename(tmp, sendTimeFile) != 0) {
+    fprintf(stderr, "%s: WARNING: unable to save send times to %s\n", modname, sendTimeFile);
+    unlink(tmp);
+  }
+  free(tmp);
+}
+
+/// @brief Map every master's log block.
+///
+/// The blocks usually don't exist yet, as `lcec.so` is loaded later;
+/// then they are created here, and stay empty until `lcec.so`
+/// initializes them.
+static void openLogs(void) {
+  void *ptr;
+  int i;
+
+  for (i = 0; i < log_count; i++) {
+    logs[i].shmem_id = rtapi_shmem_new(LCEC_LOG_SHMEM_KEY + logs[i].index, hal_comp_id, sizeof(lcec_log_shm_t));
+    if (logs[i].shmem_id < 0) {
+      fprintf(stderr, "%s: WARNING: couldn't allocate log shared memory for master %d\n", modname, logs[i].index);
+      continue;
+    }
+    if (lcec_rtapi_shmem_getptr(logs[i].shmem_id, &ptr) < 0) {
+      fprintf(stderr, "%s: WARNING: couldn't map log shared memory for master %d\n", modname, logs[i].index);
+      rtapi_shmem_delete(logs[i].shmem_id, hal_comp_id);
+      logs[i].shmem_id = -1;
+      continue;
+    }
+    logs[i].shm = (lcec_log_shm_t *)ptr;
+  }
+}
+
+/// @brief Print everything queued in the masters' logs.
+static void drainLogs(void) {
+  lcec_log_entry_t entry;
+  char buf[256];
+  int i, level;
+
+  for (i = 0; i < log_count; i++) {
+    if (logs[i].shm == NULL) {
+      continue;
+    }
+    while (lcec_log_read(logs[i].shm, &entry)) {
+      level = lcec_log_format(logs[i].shm, &entry, buf, sizeof(buf));
+      rtapi_print_msg(level, LCEC_MSG_PFX "%s\n", buf);
+      if (entry.id == LCEC_LOG_AUTO_SHIFT_MEASURED) {
+        logs[i].sendTime = entry.args[0];
+        saveSendTimes();
+      }
+    }
+  }
+}
+
+/// @brief Unmap the masters' logs.
+static void closeLogs(void) {
+  int i;
+
+  for (i = 0; i < log_count; i++) {
+    if (logs[i].shmem_id >= 0) {
+      rtapi_shmem_delete(logs[i].shmem_id, hal_comp_id);
+    }
+  }
+  free(logs);
+  logs = NULL;
+  log_count = 0;
+}
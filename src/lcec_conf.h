@@ -30,6 +30,9 @@
 #define LCEC_CONF_SHMEM_MAGIC 0x036ED5A3
 
 #define LCEC_CONF_STR_MAXLEN 48
+#define LCEC_CONF_RECORDER_RANGES 16
+
+#define LCEC_CONF_DEFAULT_DOMAIN "default"
 
 #define LCEC_CONF_SDO_COMPLETE_SUBIDX -1
 #define LCEC_CONF_GENERIC_MAX_SUBPINS 32
@@ -51,7 +54,8 @@ typedef enum {
   lcecConfTypeIdnDataRaw,
   lcecConfTypeInitCmds,
   lcecConfTypeComplexEntry,
-  lcecConfTypeModParam
+  lcecConfTypeModParam,
+  lcecConfTypeDomain
 } LCEC_CONF_TYPE_T;
 
 typedef enum {
@@ -73,9 +77,27 @@ typedef struct {
   int index;
   uint32_t appTimePeriod;
   int refClockSyncCycles;
+  uint64_t stateUpdatePeriod;
+  int stateSlavesPerCycle;
+  int workerCpu;
+  int syncMonitorCycles;
+  uint32_t cycleBudget;
+  int cycleBudgetPct;
+  int extrapolateCycles;
+  int recorderCycles;
+  int32_t autoShiftSendTime;
+  int recorderRangeCount;
+  uint32_t recorderOffset[LCEC_CONF_RECORDER_RANGES];
+  uint32_t recorderLength[LCEC_CONF_RECORDER_RANGES];
   char name[LCEC_CONF_STR_MAXLEN];
 } LCEC_CONF_MASTER_T;
 
+typedef struct {
+  LCEC_CONF_TYPE_T confType;
+  int cycleDivider;
+  char name[LCEC_CONF_STR_MAXLEN];
+} LCEC_CONF_DOMAIN_T;
+
 typedef struct {
   LCEC_CONF_TYPE_T confType;
   int index;
@@ -90,7 +112,9 @@ typedef struct {
   size_t sdoConfigLength;
   size_t idnConfigLength;
   unsigned int modParamCount;
+  int cycleDivider;
   char name[LCEC_CONF_STR_MAXLEN];
+  char domain[LCEC_CONF_STR_MAXLEN];
 } LCEC_CONF_SLAVE_T;
 
 typedef struct {
@@ -98,6 +122,8 @@ typedef struct {
   uint16_t assignActivate;
   uint32_t sync0Cycle;
   int32_t sync0Shift;
+  int sync0ShiftAuto;
+  int32_t sync0ShiftMargin;
   uint32_t sync1Cycle;
   int32_t sync1Shift;
 } LCEC_CONF_DC_T;
@@ -131,6 +157,7 @@ typedef struct {
   hal_float_t floatScale;
   hal_float_t floatOffset;
   char halPin[LCEC_CONF_STR_MAXLEN];
+  char domain[LCEC_CONF_STR_MAXLEN];
 } LCEC_CONF_PDOENTRY_T;
 
 typedef struct {
@@ -0,0 +1,285 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Process data domains
+
+#include "lcec.h"
+
+/// @brief Domain HAL pins
+static const lcec_pindesc_t domain_pins[] = {
+    {HAL_U32, HAL_OUT, offsetof(lcec_domain_data_t, working_counter), "%s.%s.%s.working-counter"},
+    {HAL_U32, HAL_OUT, offsetof(lcec_domain_data_t, expected_wc), "%s.%s.%s.working-counter-expected"},
+    {HAL_U32, HAL_OUT, offsetof(lcec_domain_data_t, wc_state), "%s.%s.%s.wc-state"},
+    {HAL_BIT, HAL_OUT, offsetof(lcec_domain_data_t, data_valid), "%s.%s.%s.data-valid"},
+    {HAL_U32, HAL_OUT, offsetof(lcec_domain_data_t, missed_frames), "%s.%s.%s.missed-frames"},
+    {HAL_U32, HAL_OUT, offsetof(lcec_domain_data_t, consecutive_misses), "%s.%s.%s.consecutive-misses"},
+    {HAL_U32, HAL_OUT, offsetof(lcec_domain_data_t, max_consecutive_misses), "%s.%s.%s.max-consecutive-misses"},
+    {HAL_TYPE_UNSPECIFIED, HAL_DIR_UNSPECIFIED, -1, NULL},
+};
+
+/// @brief Domain of a slave's `i`th registered PDO entry.
+static inline lcec_domain_t *lcec_pdo_entry_domain(lcec_slave_t *slave, int i) {
+  lcec_domain_t *domain = slave->regs->domains[i];
+  return (domain != NULL) ? domain : slave->domain;
+}
+
+/// @brief Find a master's domain by name, creating it if needed.
+///
+/// An empty name is the default domain.  New domains are exchanged
+/// every cycle until their `<domain>` element says otherwise.
+lcec_domain_t *lcec_get_domain(lcec_master_t *master, const char *name) {
+  lcec_domain_t *domain;
+
+  if (name == NULL || name[0] == 0) {
+    name = LCEC_CONF_DEFAULT_DOMAIN;
+  }
+
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    if (strcmp(domain->name, name) == 0) {
+      return domain;
+    }
+  }
+
+  domain = LCEC_ALLOCATE(lcec_domain_t);
+  memset(domain, 0, sizeof(lcec_domain_t));
+  domain->master = master;
+  strncpy(domain->name, name, LCEC_CONF_STR_MAXLEN);
+  domain->name[LCEC_CONF_STR_MAXLEN - 1] = 0;
+  domain->cycle_divider = 1;
+  domain->cycle_count = 1;
+  domain->exchange = 1;
+
+  LCEC_LIST_APPEND(master->first_domain, master->last_domain, domain);
+  return domain;
+}
+
+/// @brief Create a master's EtherCAT domains and register PDO entries.
+///
+/// Sorts every slave's registered PDO entries into their domains.
+/// Must be called after all slaves' `proc_init`, and before the
+/// master is activated.
+int lcec_domain_register(lcec_master_t *master) {
+  lcec_domain_t *domain;
+  lcec_slave_t *slave;
+  int i, count;
+
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    if (!(domain->domain = ecrt_master_create_domain(master->master))) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s domain %s creation failed\n", master->name, domain->name);
+      return -1;
+    }
+
+    count = 0;
+    for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+      for (i = 0; i < slave->regs->current; i++) {
+        if (lcec_pdo_entry_domain(slave, i) == domain) count++;
+      }
+    }
+
+    // one extra, zeroed entry terminates the list
+    if ((domain->regs = lcec_allocate_pdo_entry_reg(count + 1)) == NULL) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure allocating PDO entries for master %s domain %s\n", master->name, domain->name);
+      return -1;
+    }
+    for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+      for (i = 0; i < slave->regs->current; i++) {
+        if (lcec_pdo_entry_domain(slave, i) == domain) {
+          domain->regs->pdo_entry_regs[domain->regs->current] = slave->regs->pdo_entry_regs[i];
+          domain->regs->domains[domain->regs->current] = domain;
+          domain->regs->current++;
+        }
+      }
+    }
+
+    rtapi_print_msg(RTAPI_MSG_DBG, LCEC_MSG_PFX "register %d PDO entries in master %s domain %s\n", count, master->name, domain->name);
+    if (count > 0 && ecrt_domain_reg_pdo_entry_list(domain->domain, domain->regs->pdo_entry_regs)) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s domain %s PDO entry registration failed\n", master->name, domain->name);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/// @brief Place all of a master's domains in one block of memory.
+///
+/// Drivers address all process data relative to
+/// `master->process_data`, so the domains have to be laid out back
+/// to back.  The userspace library already maps them that way; the
+/// kernel master allocates each domain separately unless it is given
+/// external memory.  Must be called after `lcec_domain_register()`
+/// and before the master is activated.
+int lcec_domain_alloc_memory(lcec_master_t *master) {
+#ifdef __KERNEL__
+  lcec_domain_t *domain;
+  size_t size = 0, offset = 0;
+
+  // a single domain is always contiguous
+  if (master->first_domain->next == NULL) {
+    return 0;
+  }
+
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    size += ecrt_domain_size(domain->domain);
+  }
+  if (size == 0) {
+    return 0;
+  }
+
+  if ((master->domain_memory = lcec_zalloc(size)) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure allocating process data for master %s\n", master->name);
+    return -1;
+  }
+
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    size = ecrt_domain_size(domain->domain);
+    if (size == 0) {
+      continue;
+    }
+    ecrt_domain_external_memory(domain->domain, master->domain_memory + offset);
+    offset += size;
+  }
+#endif
+
+  return 0;
+}
+
+/// @brief Set up a master's domains once the master is active.
+///
+/// Sets `master->process_data` to the start of the first domain and
+/// moves the offsets of all PDO entries in later domains so they are
+/// relative to it, then exports the domains' HAL pins.
+int lcec_domain_activate(lcec_master_t *master) {
+  lcec_domain_t *domain;
+  uint8_t *start = NULL, *end = NULL;
+  size_t total = 0;
+  unsigned int delta;
+  int i;
+
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    domain->data = ecrt_domain_data(domain->domain);
+    domain->data_len = ecrt_domain_size(domain->domain);
+    if (domain->data == NULL || domain->data_len <= 0) {
+      continue;
+    }
+
+    if (start == NULL || domain->data < start) start = domain->data;
+    if (end == NULL || domain->data + domain->data_len > end) end = domain->data + domain->data_len;
+    total += domain->data_len;
+  }
+
+  if (start == NULL) {
+    master->process_data = master->first_domain->data;
+    master->process_data_len = 0;
+  } else {
+    if ((size_t)(end - start) != total) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "process data of master %s domains is not contiguous\n", master->name);
+      return -1;
+    }
+    master->process_data = start;
+    master->process_data_len = total;
+  }
+
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    // rebase PDO offsets
+    if (domain->data != NULL && domain->data_len > 0 && domain->data != start) {
+      delta = domain->data - start;
+      for (i = 0; i < domain->regs->current; i++) {
+        *(domain->regs->pdo_entry_regs[i].offset) += delta;
+      }
+    }
+
+    // export pins
+    if ((domain->hal_data = LCEC_HAL_ALLOCATE(lcec_domain_data_t)) == NULL) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "hal_malloc() for master %s domain %s failed\n", master->name, domain->name);
+      return -1;
+    }
+    if (lcec_pin_newf_list(domain->hal_data, domain_pins, LCEC_MODULE_NAME, master->name, domain->name) != 0) {
+      return -1;
+    }
+
+    rtapi_print_msg(RTAPI_MSG_DBG, LCEC_MSG_PFX "master %s domain %s: %d bytes at offset %d, cycle divider %d\n", master->name,
+        domain->name, domain->data_len, (domain->data != NULL && start != NULL) ? (int)(domain->data - start) : 0, domain->cycle_divider);
+  }
+
+  return 0;
+}
+
+/// @brief Tell a domain's drivers what to do with their inputs.
+///
+/// Only called when that changes, so the slaves' `extrapolated` pins
+/// are only touched around lost frames.
+static void lcec_domain_set_input(lcec_domain_t *domain, lcec_input_state_t input) {
+  lcec_slave_t *slave;
+
+  domain->input = input;
+  for (slave = domain->master->first_slave; slave != NULL; slave = slave->next) {
+    if (slave->domain == domain && slave->hal_state_data != NULL) {
+      *(slave->hal_state_data->extrapolated) = (input == LCEC_INPUT_EXTRAPOLATE);
+    }
+  }
+}
+
+/// @brief Check a domain's working counter and update its HAL pins.
+///
+/// Called after every exchange.  Misses are only counted once the
+/// domain has been complete at least once, so that slaves still
+/// coming up at startup don't count as lost frames; the same goes
+/// for extrapolating inputs.  Domains without PDO entries are always
+/// valid.
+void lcec_update_domain_hal(lcec_domain_t *domain) {
+  lcec_domain_data_t *hal_data = domain->hal_data;
+  ec_domain_state_t *state = &domain->state;
+  lcec_input_state_t input;
+
+  *(hal_data->working_counter) = state->working_counter;
+  *(hal_data->wc_state) = state->wc_state;
+
+  if (state->wc_state == EC_WC_COMPLETE || domain->regs->current == 0) {
+    domain->data_valid = 1;
+    domain->stale_cycles = 0;
+    *(hal_data->consecutive_misses) = 0;
+    if (state->working_counter > *(hal_data->expected_wc)) {
+      *(hal_data->expected_wc) = state->working_counter;
+    }
+  } else {
+    domain->data_valid = 0;
+    if (domain->stale_cycles < 0x7fffffff) {
+      domain->stale_cycles++;
+    }
+    if (*(hal_data->expected_wc) > 0) {
+      (*(hal_data->missed_frames))++;
+      (*(hal_data->consecutive_misses))++;
+      if (*(hal_data->consecutive_misses) > *(hal_data->max_consecutive_misses)) {
+        *(hal_data->max_consecutive_misses) = *(hal_data->consecutive_misses);
+      }
+    }
+  }
+
+  *(hal_data->data_valid) = domain->data_valid;
+
+  if (domain->data_valid) {
+    input = LCEC_INPUT_VALID;
+  } else if (*(hal_data->expected_wc) > 0 && domain->stale_cycles <= domain->master->extrapolate_cycles) {
+    input = LCEC_INPUT_EXTRAPOLATE;
+  } else {
+    input = LCEC_INPUT_HOLD;
+  }
+  if (input != domain->input) {
+    lcec_domain_set_input(domain, input);
+  }
+}
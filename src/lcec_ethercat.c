@@ -602,19 +602,38 @@ LCEC_CONF_MODPARAM_VAL_T *lcec_modparam_get(lcec_slave_t *slave, int id) {
 
 /// @brief Allocate a lcec_pdo_entry_reg struct.
 ///
+/// Every slave gets room for `LCEC_MAX_PDO_REG_COUNT` entries, about
+/// 10 kB, so they are kept out of HAL shared memory, which would run
+/// out on big buses.  The realtime code runs in the same address space
+/// and only reads a domain's `current` count, from
+/// `lcec_update_domain_hal()`.  Free them with
+/// `lcec_free_pdo_entry_reg()` once the cycle has stopped.
+///
 /// @param size The maximum number of entries to allocate room for.
 /// @return  A lcec_pdo_entry_reg_t, or NULL if memory allocation failed.
 lcec_pdo_entry_reg_t *lcec_allocate_pdo_entry_reg(int size) {
-  lcec_pdo_entry_reg_t *reg = LCEC_HAL_ALLOCATE(lcec_pdo_entry_reg_t);
+  lcec_pdo_entry_reg_t *reg = LCEC_ALLOCATE(lcec_pdo_entry_reg_t);
   if (reg == NULL) return NULL;
 
   reg->max = size;
   reg->current = 0;
-  reg->pdo_entry_regs = LCEC_HAL_ALLOCATE_ARRAY(ec_pdo_entry_reg_t, size);
+  reg->pdo_entry_regs = LCEC_ALLOCATE_ARRAY(ec_pdo_entry_reg_t, size);
+  reg->domains = LCEC_ALLOCATE_ARRAY(lcec_domain_t *, size);
 
   return reg;
 }
 
+/// @brief Free a lcec_pdo_entry_reg struct from `lcec_allocate_pdo_entry_reg()`.
+///
+/// @param reg The struct to free, or NULL.
+void lcec_free_pdo_entry_reg(lcec_pdo_entry_reg_t *reg) {
+  if (reg == NULL) return;
+
+  lcec_free(reg->pdo_entry_regs);
+  lcec_free(reg->domains);
+  lcec_free(reg);
+}
+
 /// @brief Register a new PDO entry.
 ///
 /// This replaces the old LCEC_PDO_INIT() macro.  It has error
@@ -648,11 +667,24 @@ int lcec_pdo_init(lcec_slave_t *slave, uint16_t idx, uint16_t sidx, unsigned int
   r->subindex = sidx;
   r->offset = os;
   r->bit_position = bp;
+  slave->regs->domains[slave->regs->current] = NULL;
 
   slave->regs->current++;
   return 0;
 }
 
+/// @brief Register a PDO entry like `lcec_pdo_init()`, but in a specific domain.
+///
+/// A `domain` of NULL uses the slave's own domain.
+int lcec_pdo_init_domain(lcec_slave_t *slave, lcec_domain_t *domain, uint16_t idx, uint16_t sidx, unsigned int *os, unsigned int *bp) {
+  if (lcec_pdo_init(slave, idx, sidx, os, bp) < 0) {
+    return -1;
+  }
+
+  slave->regs->domains[slave->regs->current - 1] = domain;
+  return 0;
+}
+
 /// @brief Return the number of entries in a lcec_pdo_entry_reg_t
 int lcec_pdo_entry_reg_len(lcec_pdo_entry_reg_t *reg) { return reg->current; }
 
@@ -668,6 +700,7 @@ int lcec_append_pdo_entry_reg(lcec_pdo_entry_reg_t *dest, lcec_pdo_entry_reg_t *
 
   for (int i = 0; i < src->current; i++) {
     dest->pdo_entry_regs[dest->current] = src->pdo_entry_regs[i];
+    dest->domains[dest->current] = src->domains[i];
     dest->current++;
   }
   return 0;
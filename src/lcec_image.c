@@ -0,0 +1,226 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Process image snapshots for userspace tools
+
+#include "lcec_image.h"
+
+#include "lcec.h"
+
+extern int lcec_comp_id;
+
+/// @brief Clear a process image block and fill in its layout.
+void lcec_image_shm_init(lcec_image_shm_t *shm, uint32_t data_len) {
+  memset(shm, 0, lcec_image_shm_size(data_len));
+  shm->size = lcec_image_shm_size(data_len);
+  shm->data_len = data_len;
+}
+
+/// @brief Set up the process image block for a master.
+///
+/// Must be called after `lcec_domain_activate()`, once the size of
+/// the process data is known.
+int lcec_image_init(lcec_master_t *master) {
+  lcec_image_t *image;
+  void *shmem_ptr;
+  size_t size;
+
+  if ((image = LCEC_HAL_ALLOCATE(lcec_image_t)) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "hal_malloc() for master %s process image failed\n", master->name);
+    return -EIO;
+  }
+
+  size = lcec_image_shm_size(master->process_data_len);
+  image->shmem_id = rtapi_shmem_new(LCEC_IMAGE_SHMEM_KEY + master->index, lcec_comp_id, size);
+  if (image->shmem_id < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to create process image shmem for master %s\n", master->name);
+    return -EIO;
+  }
+  if (lcec_rtapi_shmem_getptr(image->shmem_id, &shmem_ptr) < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to get process image shmem pointer for master %s\n", master->name);
+    rtapi_shmem_delete(image->shmem_id, lcec_comp_id);
+    return -EIO;
+  }
+
+  image->shm = (lcec_image_shm_t *)shmem_ptr;
+  lcec_image_shm_init(image->shm, master->process_data_len);
+  image->shm->master_index = master->index;
+  strncpy(image->shm->master_name, master->name, LCEC_CONF_STR_MAXLEN - 1);
+  image->shm->app_time_period = master->app_time_period;
+  lcec_barrier();
+  image->shm->magic = LCEC_IMAGE_SHMEM_MAGIC;
+
+  master->image = image;
+  return 0;
+}
+
+/// @brief Release the process image shared memory for a master.
+void lcec_image_cleanup(lcec_master_t *master) {
+  lcec_image_t *image = master->image;
+
+  if (image == NULL) {
+    return;
+  }
+
+  image->shm->magic = 0;
+  rtapi_shmem_delete(image->shmem_id, lcec_comp_id);
+  master->image = NULL;
+}
+
+/// @brief Publish a master's process image for this cycle.
+///
+/// Called once per cycle, at the end of `lcec_write_master()`, after
+/// the frame has been sent.  Domains on their own thread may change
+/// their part of the process data during the copy.
+void lcec_image_update(lcec_master_t *master) {
+  lcec_image_frame_t frame;
+  lcec_domain_t *domain;
+
+  if (master->image == NULL) {
+    return;
+  }
+
+  frame.valid = 1;
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    if (!domain->data_valid) {
+      frame.valid = 0;
+    }
+  }
+  frame.cycle = master->time.cycle;
+  frame.time = master->time.receive;
+  frame.dc_time = master->time.dc_time;
+  frame.app_time = master->app_time_sent;
+
+  lcec_image_publish(master->image, &frame, master->process_data);
+}
+
+/// @brief Copy a frame and its process data into the next buffer.
+///
+/// Only the realtime side may call this, and only from one thread at
+/// a time.  `frame->seq` is ignored.
+void lcec_image_publish(lcec_image_t *image, const lcec_image_frame_t *frame, const uint8_t *data) {
+  lcec_image_shm_t *shm = image->shm;
+  uint32_t buf = image->next;
+  lcec_image_frame_t *dst = lcec_image_frame(shm, buf);
+  uint32_t seq = dst->seq;
+
+  dst->seq = seq + 1;
+  lcec_barrier();
+
+  dst->valid = frame->valid;
+  dst->cycle = frame->cycle;
+  dst->time = frame->time;
+  dst->dc_time = frame->dc_time;
+  dst->app_time = frame->app_time;
+  if (shm->data_len > 0) {
+    memcpy(lcec_image_data(shm, buf), data, shm->data_len);
+  }
+
+  lcec_barrier();
+  dst->seq = seq + 2;
+  shm->latest = buf;
+  image->next = buf ^ 1;
+}
+
+/// @brief Open a master's process image from userspace.
+///
+/// `comp_id` is the caller's HAL component.  Returns 0 on success,
+/// or -1 if the master doesn't exist or has no process image.  Close
+/// the reader with `lcec_image_close()`.
+int lcec_image_open(lcec_image_reader_t *reader, int comp_id, int index) {
+  lcec_image_shm_t *shm;
+  void *shmem_ptr;
+  uint32_t size;
+  int shmem_id;
+
+  // open just the header to find the real size, like lcec_perf does for the profile
+  shmem_id = rtapi_shmem_new(LCEC_IMAGE_SHMEM_KEY + index, comp_id, sizeof(lcec_image_shm_t));
+  if (shmem_id < 0) {
+    return -1;
+  }
+  if (lcec_rtapi_shmem_getptr(shmem_id, &shmem_ptr) < 0) {
+    rtapi_shmem_delete(shmem_id, comp_id);
+    return -1;
+  }
+  shm = (lcec_image_shm_t *)shmem_ptr;
+  size = shm->size;
+  if (shm->magic != LCEC_IMAGE_SHMEM_MAGIC) {
+    rtapi_shmem_delete(shmem_id, comp_id);
+    return -1;
+  }
+  rtapi_shmem_delete(shmem_id, comp_id);
+
+  shmem_id = rtapi_shmem_new(LCEC_IMAGE_SHMEM_KEY + index, comp_id, size);
+  if (shmem_id < 0) {
+    return -1;
+  }
+  if (lcec_rtapi_shmem_getptr(shmem_id, &shmem_ptr) < 0) {
+    rtapi_shmem_delete(shmem_id, comp_id);
+    return -1;
+  }
+
+  reader->shm = (const lcec_image_shm_t *)shmem_ptr;
+  reader->shmem_id = shmem_id;
+  reader->comp_id = comp_id;
+  return 0;
+}
+
+/// @brief Close a reader opened with `lcec_image_open()`.
+void lcec_image_close(lcec_image_reader_t *reader) {
+  rtapi_shmem_delete(reader->shmem_id, reader->comp_id);
+  reader->shm = NULL;
+}
+
+/// @brief Take a consistent copy of the latest process image.
+///
+/// For use by userspace readers, at any rate.  Copies the frame
+/// header into `frame` and `shm->data_len` bytes of process data into
+/// `data`, which is `len` bytes long.  Returns 0 on success, or -1 if
+/// the block is not initialized, nothing was published yet, `data` is
+/// too small, or no consistent copy could be made.
+int lcec_image_snapshot(const lcec_image_shm_t *shm, lcec_image_frame_t *frame, uint8_t *data, size_t len) {
+  const lcec_image_frame_t *src;
+  uint32_t buf, seq;
+  int tries;
+
+  if (shm->magic != LCEC_IMAGE_SHMEM_MAGIC || len < shm->data_len) {
+    return -1;
+  }
+
+  for (tries = 0; tries < 1000; tries++) {
+    buf = shm->latest & 1;
+    lcec_barrier();
+    src = lcec_image_frame(shm, buf);
+    seq = src->seq;
+    lcec_barrier();
+    if (seq == 0) {
+      return -1;
+    }
+    if (seq & 1) {
+      lcec_schedule();
+      continue;
+    }
+    memcpy(frame, (const void *)src, sizeof(lcec_image_frame_t));
+    memcpy(data, lcec_image_data(shm, buf), shm->data_len);
+    lcec_barrier();
+    if (src->seq == seq) {
+      return 0;
+    }
+  }
+
+  return -1;
+}
@@ -0,0 +1,114 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Process image snapshots for userspace tools
+///
+/// Once per cycle, right after the frame is sent, each master's
+/// `process_data` is copied into a per-master shared memory block
+/// together with the cycle number and timestamps.  Tools can read
+/// consistent snapshots from it at any rate, without HAL pins and
+/// without ever blocking the realtime thread.
+///
+/// The block holds two buffers, each protected by its own sequence
+/// counter.  The writer fills them in turn and then points `latest`
+/// at the one it just finished, so a reader copying the latest buffer
+/// has a whole cycle before the writer comes back to it.  Use
+/// `lcec_image_open()` and `lcec_image_snapshot()` to read it.
+
+#ifndef _LCEC_IMAGE_H_
+#define _LCEC_IMAGE_H_
+
+#include "hal.h"
+#include "lcec_conf.h"
+#include "lcec_rtapi.h"
+
+#define LCEC_IMAGE_SHMEM_KEY   0xACB57700  ///< Base shared memory key, the master index is added to this.
+#define LCEC_IMAGE_SHMEM_MAGIC 0x1A6E0001  ///< Magic number, changes whenever the shared memory layout changes.
+
+/// @brief Header of a single process image buffer.
+///
+/// The realtime side bumps `seq` to an odd value before updating the
+/// buffer and back to an even value afterwards.  `seq` is 0 until the
+/// buffer is first written.
+typedef struct {
+  volatile uint32_t seq;  ///< Sequence counter, odd while an update is in progress.
+  uint32_t valid;         ///< True if every domain's last exchange was complete.
+  uint64_t cycle;         ///< Cycle number, as in `lcec_time_t`.
+  int64_t time;           ///< `rtapi_get_time()` when this cycle's frame was received.
+  uint64_t dc_time;       ///< DC application time the inputs were sent with.
+  uint64_t app_time;      ///< DC application time the outputs were sent with.
+} lcec_image_frame_t;
+
+/// @brief Header of the per-master process image shared memory block.
+///
+/// The header is followed by two buffers, each a `lcec_image_frame_t`
+/// and `data_len` bytes of process data; use `lcec_image_frame()` and
+/// `lcec_image_data()` to find them.
+typedef struct {
+  uint32_t magic;                          ///< `LCEC_IMAGE_SHMEM_MAGIC` once initialized.
+  uint32_t size;                           ///< Total size of the shared memory block.
+  int master_index;                        ///< Index of the master.
+  char master_name[LCEC_CONF_STR_MAXLEN];  ///< Name of the master.
+  uint32_t data_len;                       ///< Size of the process data, in bytes.
+  uint32_t app_time_period;                ///< Configured `appTimePeriod`, in ns.
+  volatile uint32_t latest;                ///< Buffer written last, 0 or 1.
+} lcec_image_shm_t;
+
+/// @brief Realtime-side process image state for a single master.
+typedef struct {
+  lcec_image_shm_t *shm;  ///< Shared memory block.
+  int shmem_id;           ///< RTAPI shared memory ID.
+  uint32_t next;          ///< Buffer to write next.
+} lcec_image_t;
+
+/// @brief A userspace reader's view of a master's process image.
+typedef struct {
+  const lcec_image_shm_t *shm;  ///< Shared memory block.
+  int shmem_id;                 ///< RTAPI shared memory ID.
+  int comp_id;                  ///< HAL component the block was opened with.
+} lcec_image_reader_t;
+
+/// @brief Size of one buffer, rounded up so that the next one is aligned.
+static inline size_t lcec_image_buf_size(uint32_t data_len) { return (sizeof(lcec_image_frame_t) + data_len + 7) & ~(size_t)7; }
+
+/// @brief Total size of a process image block.
+static inline size_t lcec_image_shm_size(uint32_t data_len) {
+  return ((sizeof(lcec_image_shm_t) + 7) & ~(size_t)7) + 2 * lcec_image_buf_size(data_len);
+}
+
+/// @brief Get the header of buffer `buf`, 0 or 1.
+static inline lcec_image_frame_t *lcec_image_frame(const lcec_image_shm_t *shm, uint32_t buf) {
+  return (lcec_image_frame_t *)((char *)shm + ((sizeof(lcec_image_shm_t) + 7) & ~(size_t)7) + buf * lcec_image_buf_size(shm->data_len));
+}
+
+/// @brief Get the process data of buffer `buf`, 0 or 1.
+static inline uint8_t *lcec_image_data(const lcec_image_shm_t *shm, uint32_t buf) {
+  return (uint8_t *)(lcec_image_frame(shm, buf) + 1);
+}
+
+struct lcec_master;
+
+int lcec_image_init(struct lcec_master *master);
+void lcec_image_cleanup(struct lcec_master *master);
+void lcec_image_shm_init(lcec_image_shm_t *shm, uint32_t data_len);
+void lcec_image_update(struct lcec_master *master);
+void lcec_image_publish(lcec_image_t *image, const lcec_image_frame_t *frame, const uint8_t *data);
+int lcec_image_open(lcec_image_reader_t *reader, int comp_id, int index);
+void lcec_image_close(lcec_image_reader_t *reader);
+int lcec_image_snapshot(const lcec_image_shm_t *shm, lcec_image_frame_t *frame, uint8_t *data, size_t len);
+
+#endif
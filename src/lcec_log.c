@@ -0,0 +1,277 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Deferred logging from realtime code
+
+#include "lcec_log.h"
+
+#include "lcec.h"
+
+extern int lcec_comp_id;
+
+/// @brief Level and format of each message, indexed by `lcec_log_msg_id_t`.
+const lcec_log_msg_t lcec_log_msgs[LCEC_LOG_MSG_COUNT] = {
+    {RTAPI_MSG_ERR, "invalid appTimePeriod of %u ns, the thread period is %u ns"},
+    {RTAPI_MSG_WARN, "%u cycles in a row over budget, last took %u of %u ns"},
+    {RTAPI_MSG_INFO, "sync0Shift=auto measured a send time of %u ns, used from the next start"},
+    {RTAPI_MSG_WARN, "send time %u ns plus margin %d ns exceeds sync0Cycle %u ns"},
+    {RTAPI_MSG_ERR, "not in mode of operation %d, reports %d"},
+};
+
+/// @brief Clear a log block and mark all entries free.
+void lcec_log_shm_init(lcec_log_shm_t *shm) {
+  uint32_t i;
+
+  memset(shm, 0, sizeof(lcec_log_shm_t));
+  for (i = 0; i < LCEC_LOG_ENTRIES; i++) {
+    shm->entries[i].seq = i;
+  }
+}
+
+/// @brief Set up the message log for a master.
+///
+/// Creates the shared memory block and exports
+/// `lcec.<master>.log.dropped` and `lcec.<master>.log.suppressed`.
+int lcec_log_init(lcec_master_t *master) {
+  lcec_log_t *log;
+  void *shmem_ptr;
+
+  if ((log = LCEC_HAL_ALLOCATE(lcec_log_t)) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "hal_malloc() for master %s log failed\n", master->name);
+    return -EIO;
+  }
+  if (lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&log->dropped, "%s.%s.log.dropped", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&log->suppressed, "%s.%s.log.suppressed", LCEC_MODULE_NAME, master->name) != 0) {
+    return -EIO;
+  }
+
+  log->shmem_id = rtapi_shmem_new(LCEC_LOG_SHMEM_KEY + master->index, lcec_comp_id, sizeof(lcec_log_shm_t));
+  if (log->shmem_id < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to create log shmem for master %s\n", master->name);
+    return -EIO;
+  }
+  if (lcec_rtapi_shmem_getptr(log->shmem_id, &shmem_ptr) < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to get log shmem pointer for master %s\n", master->name);
+    rtapi_shmem_delete(log->shmem_id, lcec_comp_id);
+    return -EIO;
+  }
+
+  log->shm = (lcec_log_shm_t *)shmem_ptr;
+  lcec_log_shm_init(log->shm);
+  log->shm->master_index = master->index;
+  strncpy(log->shm->master_name, master->name, LCEC_CONF_STR_MAXLEN - 1);
+  lcec_barrier();
+  log->shm->magic = LCEC_LOG_SHMEM_MAGIC;
+
+  master->log = log;
+  return 0;
+}
+
+/// @brief Release the log shared memory for a master.
+///
+/// Anything still queued is lost, so this should run after the
+/// master's functions have stopped and `lcec_conf` had a chance to
+/// drain the ring.
+void lcec_log_cleanup(lcec_master_t *master) {
+  lcec_log_t *log = master->log;
+
+  if (log == NULL) {
+    return;
+  }
+
+  log->shm->magic = 0;
+  rtapi_shmem_delete(log->shmem_id, lcec_comp_id);
+  master->log = NULL;
+}
+
+/// @brief Put an entry into the ring.
+///
+/// Safe to call from several threads at once.  Never blocks; if the
+/// ring is full the message is counted in `dropped` and -1 is
+/// returned.
+int lcec_log_queue(lcec_log_shm_t *shm, int id, uint32_t count, long long time, const int32_t *args, const char *slave) {
+  lcec_log_entry_t *entry;
+  uint32_t pos, seq;
+  int i;
+
+  pos = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+  for (;;) {
+    entry = &shm->entries[pos & (LCEC_LOG_ENTRIES - 1)];
+    seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+    if (seq == pos) {
+      // free, try to claim it
+      if (__atomic_compare_exchange_n(&shm->head, &pos, pos + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if ((int32_t)(seq - pos) < 0) {
+      // the reader hasn't caught up with the last lap yet
+      __atomic_fetch_add(&shm->dropped, count, __ATOMIC_RELAXED);
+      return -1;
+    } else {
+      // someone else claimed it first
+      pos = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+    }
+  }
+
+  entry->id = id;
+  entry->count = count;
+  entry->time = time;
+  for (i = 0; i < LCEC_LOG_ARGS; i++) {
+    entry->args[i] = args[i];
+  }
+  if (slave != NULL) {
+    strncpy(entry->slave, slave, LCEC_CONF_STR_MAXLEN - 1);
+    entry->slave[LCEC_CONF_STR_MAXLEN - 1] = 0;
+  } else {
+    entry->slave[0] = 0;
+  }
+
+  __atomic_store_n(&entry->seq, pos + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/// @brief Log a message, applying the rate limit.
+///
+/// See `lcec_log()`.  `now` is the current time in ns.  The rate
+/// limit state is shared by all of a master's threads without
+/// locking; if two threads log the same message at the same time, a
+/// repeat count may be off by one.
+void lcec_log_at(lcec_log_t *log, long long now, int id, const char *slave, int32_t a0, int32_t a1, int32_t a2, int32_t a3) {
+  lcec_log_limit_t *limit;
+  int32_t args[LCEC_LOG_ARGS] = {a0, a1, a2, a3};
+  uint32_t count = 1;
+  int i;
+
+  if (log == NULL || id < 0 || id >= LCEC_LOG_MSG_COUNT) {
+    return;
+  }
+  limit = &log->limits[id];
+
+  if (limit->queued > 0 && now - limit->start < LCEC_LOG_RATE_LIMIT) {
+    if (slave == limit->slave) {
+      // a repeat, keep it for later
+      limit->pending++;
+      limit->time = now;
+      for (i = 0; i < LCEC_LOG_ARGS; i++) {
+        limit->args[i] = args[i];
+      }
+      __atomic_fetch_add(&log->shm->suppressed, 1, __ATOMIC_RELAXED);
+      return;
+    }
+    if (limit->queued >= LCEC_LOG_BURST) {
+      __atomic_fetch_add(&log->shm->suppressed, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  } else {
+    limit->start = now;
+    limit->queued = 0;
+  }
+
+  // fold pending repeats into this entry, or queue them on their own
+  if (limit->pending > 0) {
+    if (slave == limit->slave) {
+      count += limit->pending;
+    } else {
+      lcec_log_queue(log->shm, id, limit->pending, limit->time, limit->args, limit->slave);
+    }
+    limit->pending = 0;
+  }
+
+  limit->slave = slave;
+  limit->queued++;
+  lcec_log_queue(log->shm, id, count, now, args, slave);
+}
+
+/// @brief Queue repeats that have been held back for a full rate limit window.
+///
+/// Called once per cycle, at the end of `lcec_write_master()`, so
+/// that the repeat count of a fault that stopped still gets printed.
+/// Also updates the HAL pins.
+void lcec_log_flush(lcec_log_t *log, long long now) {
+  lcec_log_limit_t *limit;
+  int id;
+
+  for (id = 0; id < LCEC_LOG_MSG_COUNT; id++) {
+    limit = &log->limits[id];
+    if (limit->pending == 0 || now - limit->start < LCEC_LOG_RATE_LIMIT) {
+      continue;
+    }
+
+    lcec_log_queue(log->shm, id, limit->pending, limit->time, limit->args, limit->slave);
+    limit->pending = 0;
+    limit->start = now;
+    limit->queued = 1;
+  }
+
+  *(log->dropped) = log->shm->dropped;
+  *(log->suppressed) = log->shm->suppressed;
+}
+
+/// @brief Take the next entry out of the ring.
+///
+/// For use by a single userspace reader.  Returns 1 and fills in
+/// `entry` if there was one, 0 if the ring is empty or not
+/// initialized.
+int lcec_log_read(lcec_log_shm_t *shm, lcec_log_entry_t *entry) {
+  lcec_log_entry_t *next;
+  uint32_t pos;
+
+  if (shm->magic != LCEC_LOG_SHMEM_MAGIC) {
+    return 0;
+  }
+
+  pos = shm->tail;
+  next = &shm->entries[pos & (LCEC_LOG_ENTRIES - 1)];
+  if (__atomic_load_n(&next->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+    return 0;
+  }
+
+  memcpy(entry, next, sizeof(lcec_log_entry_t));
+  __atomic_store_n(&next->seq, pos + LCEC_LOG_ENTRIES, __ATOMIC_RELEASE);
+  shm->tail = pos + 1;
+  return 1;
+}
+
+/// @brief Format an entry for printing.
+///
+/// Writes the text, without the `LCEC_MSG_PFX` prefix or a trailing
+/// newline, into `buf`.  Returns the message's RTAPI level.
+int lcec_log_format(const lcec_log_shm_t *shm, const lcec_log_entry_t *entry, char *buf, size_t len) {
+  const lcec_log_msg_t *msg;
+  size_t n;
+
+  if (entry->slave[0] != 0) {
+    n = snprintf(buf, len, "slave %s.%s: ", shm->master_name, entry->slave);
+  } else {
+    n = snprintf(buf, len, "master %s: ", shm->master_name);
+  }
+  if (n >= len) {
+    return RTAPI_MSG_ERR;
+  }
+
+  if (entry->id >= LCEC_LOG_MSG_COUNT) {
+    snprintf(buf + n, len - n, "unknown message %u", entry->id);
+    return RTAPI_MSG_ERR;
+  }
+
+  msg = &lcec_log_msgs[entry->id];
+  n += snprintf(buf + n, len - n, msg->fmt, entry->args[0], entry->args[1], entry->args[2], entry->args[3]);
+  if (n < len && entry->count > 1) {
+    snprintf(buf + n, len - n, " (%u times)", entry->count);
+  }
+  return msg->level;
+}
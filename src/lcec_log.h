@@ -0,0 +1,135 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Deferred logging from realtime code
+///
+/// `rtapi_print_msg()` can block for a long time on uspace, so the
+/// cyclic code doesn't call it.  Instead, it queues a message ID and a
+/// few integer arguments into a per-master ring in shared memory
+/// (`lcec_log_shm_t`) with `lcec_log()`.  `lcec_conf`, which stays
+/// running for as long as LinuxCNC does, drains the rings and formats
+/// and prints the messages.
+///
+/// Each message ID is rate limited.  Once a message about a slave is
+/// queued, repeats of it for the next `LCEC_LOG_RATE_LIMIT` ns are
+/// only counted, and then queued as a single entry with the number of
+/// times it happened.  At most `LCEC_LOG_BURST` entries per message ID
+/// are queued in that time, so that a fault on every slave at once
+/// can't flood the log either.
+
+#ifndef _LCEC_LOG_H_
+#define _LCEC_LOG_H_
+
+#include "hal.h"
+#include "lcec_conf.h"
+#include "lcec_rtapi.h"
+
+#define LCEC_LOG_SHMEM_KEY   0xACB57600  ///< Base shared memory key, the master index is added to this.
+#define LCEC_LOG_SHMEM_MAGIC 0x10C0E002  ///< Magic number, changes whenever `lcec_log_shm_t` changes.
+#define LCEC_LOG_ENTRIES     256         ///< Number of entries in each ring, must be a power of 2.
+#define LCEC_LOG_ARGS        4           ///< Number of integer arguments per message.
+#define LCEC_LOG_RATE_LIMIT  1000000000  ///< Rate limit window, in ns.
+#define LCEC_LOG_BURST       8           ///< Entries per message ID and rate limit window.
+
+/// @brief Messages that realtime code can log.
+///
+/// Add new messages to the end, together with their format in
+/// `lcec_log_msgs`.
+typedef enum {
+  LCEC_LOG_PERIOD_MISMATCH,      ///< appTimePeriod doesn't match the thread.
+  LCEC_LOG_BUDGET_FAULT,         ///< Too many cycles in a row over budget.
+  LCEC_LOG_AUTO_SHIFT_MEASURED,  ///< `sync0Shift="auto"` measured the send time; `lcec_conf` saves it.
+  LCEC_LOG_AUTO_SHIFT_TOO_LATE,  ///< `sync0Shift="auto"` found no usable shift.
+  LCEC_LOG_OPMODE,               ///< A drive is in the wrong mode of operation.
+  LCEC_LOG_MSG_COUNT,
+} lcec_log_msg_id_t;
+
+/// @brief How to print a message.
+typedef struct {
+  int level;        ///< RTAPI message level.
+  const char *fmt;  ///< printf format, with up to `LCEC_LOG_ARGS` integer arguments.
+} lcec_log_msg_t;
+
+extern const lcec_log_msg_t lcec_log_msgs[LCEC_LOG_MSG_COUNT];
+
+/// @brief A single queued message.
+///
+/// Producers claim an entry by moving `lcec_log_shm_t.head` forward,
+/// fill it in, and then publish it by setting `seq` to one past its
+/// position.  The reader sets `seq` to the entry's position in the
+/// next lap of the ring once it is done with it.
+typedef struct {
+  volatile uint32_t seq;             ///< Entry state, see above.
+  uint16_t id;                       ///< A `lcec_log_msg_id_t`.
+  uint16_t reserved;                 ///< Padding.
+  uint32_t count;                    ///< Number of times the message happened, including rate limited ones.
+  long long time;                    ///< `rtapi_get_time()` of the last occurrence.
+  int32_t args[LCEC_LOG_ARGS];       ///< Message arguments.
+  char slave[LCEC_CONF_STR_MAXLEN];  ///< Name of the slave the message is about, or empty for the master.
+} lcec_log_entry_t;
+
+/// @brief Layout of the per-master log shared memory block.
+typedef struct {
+  uint32_t magic;                              ///< `LCEC_LOG_SHMEM_MAGIC` once initialized.
+  int master_index;                            ///< Index of the master.
+  char master_name[LCEC_CONF_STR_MAXLEN];      ///< Name of the master.
+  uint32_t head;                               ///< Next entry to claim, only ever increases.
+  uint32_t tail;                               ///< Next entry to read, only written by the reader.
+  uint32_t dropped;                            ///< Messages lost because the ring was full.
+  uint32_t suppressed;                         ///< Messages folded into a later entry by the rate limit.
+  lcec_log_entry_t entries[LCEC_LOG_ENTRIES];  ///< The ring.
+} lcec_log_shm_t;
+
+/// @brief Rate limiting state for one message ID.
+typedef struct {
+  long long start;              ///< Start of the current rate limit window.
+  uint32_t queued;              ///< Entries queued in the current window.
+  const char *slave;            ///< Slave of the last queued entry.
+  uint32_t pending;             ///< Repeats of the last queued entry that weren't queued yet.
+  long long time;               ///< Time of the latest pending repeat.
+  int32_t args[LCEC_LOG_ARGS];  ///< Arguments of the latest pending repeat.
+} lcec_log_limit_t;
+
+/// @brief Realtime-side log state for a single master.
+typedef struct lcec_log {
+  lcec_log_shm_t *shm;                          ///< Shared memory block.
+  int shmem_id;                                 ///< RTAPI shared memory ID.
+  hal_u32_t *dropped;                           ///< HAL pin; messages lost because the ring was full.
+  hal_u32_t *suppressed;                        ///< HAL pin; messages folded into a later entry by the rate limit.
+  lcec_log_limit_t limits[LCEC_LOG_MSG_COUNT];  ///< Per-message rate limiting.
+} lcec_log_t;
+
+struct lcec_master;
+
+int lcec_log_init(struct lcec_master *master);
+void lcec_log_cleanup(struct lcec_master *master);
+void lcec_log_shm_init(lcec_log_shm_t *shm);
+int lcec_log_queue(lcec_log_shm_t *shm, int id, uint32_t count, long long time, const int32_t *args, const char *slave);
+void lcec_log_at(lcec_log_t *log, long long now, int id, const char *slave, int32_t a0, int32_t a1, int32_t a2, int32_t a3);
+void lcec_log_flush(lcec_log_t *log, long long now);
+int lcec_log_read(lcec_log_shm_t *shm, lcec_log_entry_t *entry);
+int lcec_log_format(const lcec_log_shm_t *shm, const lcec_log_entry_t *entry, char *buf, size_t len);
+
+/// @brief Log a message from realtime code.
+///
+/// `slave` is the name of the slave the message is about, or NULL
+/// for the master.  Unused arguments should be 0.
+static inline void lcec_log(lcec_log_t *log, int id, const char *slave, int32_t a0, int32_t a1, int32_t a2, int32_t a3) {
+  lcec_log_at(log, rtapi_get_time(), id, slave, a0, a1, a2, a3);
+}
+
+#endif
@@ -48,9 +48,11 @@ static const lcec_pindesc_t master_global_pins[] = {
 
 /// @brief Master HAL pins
 static const lcec_pindesc_t master_pins[] = {
+    {HAL_BIT, HAL_IN, offsetof(lcec_master_data_t, shed_divided), "%s.shed-divided"},
 #ifdef RTAPI_TASK_PLL_SUPPORT
     {HAL_S32, HAL_OUT, offsetof(lcec_master_data_t, pll_err), "%s.pll-err"},
     {HAL_S32, HAL_OUT, offsetof(lcec_master_data_t, pll_out), "%s.pll-out"},
+    {HAL_BIT, HAL_OUT, offsetof(lcec_master_data_t, pll_locked), "%s.pll-locked"},
     {HAL_U32, HAL_OUT, offsetof(lcec_master_data_t, pll_reset_cnt), "%s.pll-reset-count"},
 #endif
     {HAL_TYPE_UNSPECIFIED, HAL_DIR_UNSPECIFIED, -1, NULL},
@@ -58,13 +60,36 @@ static const lcec_pindesc_t master_pins[] = {
 
 /// @brief Master params
 static const lcec_paramdesc_t master_params[] = {
+    {HAL_U32, HAL_RO, offsetof(lcec_master_data_t, dc_send_offset_max), "%s.dc-send-offset-max"},
 #ifdef RTAPI_TASK_PLL_SUPPORT
-    {HAL_U32, HAL_RW, offsetof(lcec_master_data_t, pll_step), "%s.pll-step"},
+    {HAL_U32, HAL_RW, offsetof(lcec_master_data_t, pll.mode), "%s.pll-mode"},
+    {HAL_U32, HAL_RW, offsetof(lcec_master_data_t, pll.step), "%s.pll-step"},
+    {HAL_FLOAT, HAL_RW, offsetof(lcec_master_data_t, pll.p_gain), "%s.pll-p-gain"},
+    {HAL_FLOAT, HAL_RW, offsetof(lcec_master_data_t, pll.i_gain), "%s.pll-i-gain"},
+    {HAL_S32, HAL_RW, offsetof(lcec_master_data_t, pll.ff), "%s.pll-ff"},
+    {HAL_U32, HAL_RW, offsetof(lcec_master_data_t, pll.i_limit), "%s.pll-i-limit"},
+    {HAL_U32, HAL_RW, offsetof(lcec_master_data_t, pll.lock_window), "%s.pll-lock-window"},
+    {HAL_U32, HAL_RW, offsetof(lcec_master_data_t, pll.lock_cycles), "%s.pll-lock-cycles"},
     {HAL_U32, HAL_RW, offsetof(lcec_master_data_t, pll_max_err), "%s.pll-max-err"},
 #endif
     {HAL_TYPE_UNSPECIFIED},
 };
 
+/// @brief DC sync monitor pins, only for masters with `syncMonitorCycles`
+static const lcec_pindesc_t master_sync_monitor_pins[] = {
+    {HAL_U32, HAL_OUT, offsetof(lcec_master_data_t, dc_sync_diff), "%s.dc-sync-diff"},
+    {HAL_U32, HAL_OUT, offsetof(lcec_master_data_t, dc_sync_diff_max), "%s.dc-sync-diff-max"},
+    {HAL_U32, HAL_OUT, offsetof(lcec_master_data_t, dc_sync_diff_filtered), "%s.dc-sync-diff-filtered"},
+    {HAL_BIT, HAL_OUT, offsetof(lcec_master_data_t, dc_in_sync), "%s.dc-in-sync"},
+    {HAL_TYPE_UNSPECIFIED, HAL_DIR_UNSPECIFIED, -1, NULL},
+};
+
+/// @brief DC sync monitor params, only for masters with `syncMonitorCycles`
+static const lcec_paramdesc_t master_sync_monitor_params[] = {
+    {HAL_U32, HAL_RW, offsetof(lcec_master_data_t, dc_sync_threshold), "%s.dc-sync-threshold"},
+    {HAL_TYPE_UNSPECIFIED},
+};
+
 /// @brief Basic Slave pins
 static const lcec_pindesc_t slave_pins[] = {
     {HAL_BIT, HAL_OUT, offsetof(lcec_slave_state_t, online), "%s.%s.%s.slave-online"},
@@ -73,6 +98,7 @@ static const lcec_pindesc_t slave_pins[] = {
     {HAL_BIT, HAL_OUT, offsetof(lcec_slave_state_t, state_preop), "%s.%s.%s.slave-state-preop"},
     {HAL_BIT, HAL_OUT, offsetof(lcec_slave_state_t, state_safeop), "%s.%s.%s.slave-state-safeop"},
     {HAL_BIT, HAL_OUT, offsetof(lcec_slave_state_t, state_op), "%s.%s.%s.slave-state-op"},
+    {HAL_BIT, HAL_OUT, offsetof(lcec_slave_state_t, extrapolated), "%s.%s.%s.extrapolated"},
     {HAL_TYPE_UNSPECIFIED, HAL_DIR_UNSPECIFIED, -1, NULL},
 };
 
@@ -83,6 +109,13 @@ extern int lcec_comp_id;
 static lcec_master_data_t *global_hal_data;
 static ec_master_state_t global_ms;
 
+/// @brief Global master state, accumulated with atomics while masters run in parallel.
+static struct {
+  unsigned int slaves_responding;
+  unsigned int al_states;
+  unsigned int link_down;
+} global_acc;
+
 int lcec_parse_config(void);
 void lcec_clear_config(void);
 
@@ -91,15 +124,26 @@ static void lcec_request_lock(void *data);
 static void lcec_release_lock(void *data);
 #endif
 
-lcec_master_data_t *lcec_init_master_hal(const char *pfx, int global);
+lcec_master_data_t *lcec_init_master_hal(const char *pfx, int global, int sync_monitor);
 lcec_slave_state_t *lcec_init_slave_state_hal(char *master_name, char *slave_name);
 void lcec_update_master_hal(lcec_master_data_t *hal_data, ec_master_state_t *ms);
+static void lcec_update_sync_monitor_hal(lcec_master_t *master);
+static void lcec_auto_shift_sample(lcec_master_t *master, long long now);
 void lcec_update_slave_state_hal(lcec_slave_state_t *hal_data, ec_slave_config_state_t *ss);
 
+static void lcec_build_dispatch(lcec_master_t *master);
+static void lcec_setup_state_polling(lcec_master_t *master);
+
 void lcec_read_all(void *arg, long period);
 void lcec_write_all(void *arg, long period);
 void lcec_read_master(void *arg, long period);
 void lcec_write_master(void *arg, long period);
+void lcec_receive_all(void *arg, long period);
+void lcec_send_all(void *arg, long period);
+void lcec_receive_master(void *arg, long period);
+void lcec_send_master(void *arg, long period);
+void lcec_read_domain(void *arg, long period);
+void lcec_write_domain(void *arg, long period);
 
 static void sigsegv_handler(int sig);
 
@@ -107,12 +151,12 @@ static void sigsegv_handler(int sig);
 int rtapi_app_main(void) {
   int slave_count;
   lcec_master_t *master;
+  lcec_domain_t *domain;
   lcec_slave_t *slave;
   char name[HAL_NAME_LEN + 1];
   lcec_slave_sdoconf_t *sdo_config;
   lcec_slave_idnconf_t *idn_config;
   struct timeval tv;
-  int pdo_entry_count = 0;
 
 #ifndef __KERNEL
   struct sigaction handler;
@@ -138,7 +182,7 @@ int rtapi_app_main(void) {
   }
 
   // init global hal data
-  if ((global_hal_data = lcec_init_master_hal(LCEC_MODULE_NAME, 1)) == NULL) {
+  if ((global_hal_data = lcec_init_master_hal(LCEC_MODULE_NAME, 1, 0)) == NULL) {
     goto fail2;
   }
 
@@ -155,12 +199,6 @@ int rtapi_app_main(void) {
     ecrt_master_callbacks(master->master, lcec_request_lock, lcec_release_lock, master);
 #endif
 
-    // create domain
-    if (!(master->domain = ecrt_master_create_domain(master->master))) {
-      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s domain creation failed\n", master->name);
-      goto fail2;
-    }
-
     // initialize slaves
     for (slave = master->first_slave; slave != NULL; slave = slave->next) {
       // read slave config
@@ -225,6 +263,20 @@ int rtapi_app_main(void) {
             LCEC_MSG_PFX "configuring DC for slave %s.%s: assignActivate=x%x sync0Cycle=%d sync0Shift=%d sync1Cycle=%d sync1Shift=%d\n",
             master->name, slave->name, slave->dc_conf->assignActivate, slave->dc_conf->sync0Cycle, slave->dc_conf->sync0Shift,
             slave->dc_conf->sync1Cycle, slave->dc_conf->sync1Shift);
+
+        // measure the send time over the first cycles, then pick a shift
+        if (slave->dc_conf->sync0ShiftAuto) {
+          if ((slave->dc_sync0_shift = LCEC_HAL_ALLOCATE(hal_s32_t)) == NULL) {
+            rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "hal_malloc() for slave %s.%s dc-sync0-shift failed\n", master->name, slave->name);
+            goto fail2;
+          }
+          if (lcec_param_newf(HAL_S32, HAL_RO, (void *)slave->dc_sync0_shift, "%s.%s.%s.dc-sync0-shift", LCEC_MODULE_NAME, master->name,
+                  slave->name) != 0) {
+            goto fail2;
+          }
+          *(slave->dc_sync0_shift) = slave->dc_conf->sync0Shift;
+          master->auto_shift_cycles = LCEC_AUTO_SHIFT_CYCLES;
+        }
       }
 
       // Configure the slave's watchdog times.
@@ -247,22 +299,14 @@ int rtapi_app_main(void) {
         rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure to export slave pins for slave %s.%s\n", master->name, slave->name);
         goto fail2;
       }
-
-      pdo_entry_count += lcec_pdo_entry_reg_len(slave->regs);
-    }
-
-    lcec_pdo_entry_reg_t *master_regs = lcec_allocate_pdo_entry_reg(pdo_entry_count + 1);
-    for (slave = master->first_slave; slave != NULL; slave = slave->next) {
-      if (lcec_append_pdo_entry_reg(master_regs, slave->regs) < 0) {
-        rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure to append PDO entries for slave %s.%s\n", master->name, slave->name);
-        goto fail2;
-      }
     }
 
-    // register PDO entries
+    // create domains and register PDO entries
     rtapi_print_msg(RTAPI_MSG_DBG, LCEC_MSG_PFX "register PDO entries\n");
-    if (ecrt_domain_reg_pdo_entry_list(master->domain, master_regs->pdo_entry_regs)) {
-      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s PDO entry registration failed\n", master->name);
+    if (lcec_domain_register(master) != 0) {
+      goto fail2;
+    }
+    if (lcec_domain_alloc_memory(master) != 0) {
       goto fail2;
     }
 
@@ -291,24 +335,66 @@ int rtapi_app_main(void) {
       goto fail2;
     }
 
-    // Get internal process data for domain
-    master->process_data = ecrt_domain_data(master->domain);
-    master->process_data_len = ecrt_domain_size(master->domain);
+    // Get internal process data for domains
+    if (lcec_domain_activate(master) != 0) {
+      goto fail2;
+    }
 
     // init hal data
     rtapi_snprintf(name, HAL_NAME_LEN, "%s.%s", LCEC_MODULE_NAME, master->name);
-    if ((master->hal_data = lcec_init_master_hal(name, 0)) == NULL) {
+    if ((master->hal_data = lcec_init_master_hal(name, 0, master->sync_monitor_cycles > 0)) == NULL) {
       rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure to init hal pins for slave %s.%s\n", master->name, slave->name);
       goto fail2;
     }
 
+    master->hal_data->dc_sync_threshold = LCEC_DC_SYNC_THRESHOLD;
+
 #ifdef RTAPI_TASK_PLL_SUPPORT
-    // set default PLL_STEP: use +/-0.1% of period
-    master->hal_data->pll_step = master->app_time_period / 1000;
+    // set default PLL tuning
+    lcec_pll_init_params(&master->hal_data->pll, master->app_time_period);
+    lcec_pll_reset(&master->pll);
     // set default PLL_MAX_ERR: one period
     master->hal_data->pll_max_err = master->app_time_period;
 #endif
 
+    // init realtime message log
+    if (lcec_log_init(master) != 0) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure to init log for master %s\n", master->name);
+      goto fail2;
+    }
+
+    // init cycle timing statistics
+    if (lcec_timing_init(master) != 0) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure to init timing for master %s\n", master->name);
+      goto fail2;
+    }
+
+    // init slave driver profiler
+    if (lcec_profile_init(master) != 0) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure to init profiler for master %s\n", master->name);
+      goto fail2;
+    }
+
+    // init process image snapshots
+    if (lcec_image_init(master) != 0) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure to init process image for master %s\n", master->name);
+      goto fail2;
+    }
+
+    // init flight recorder
+    if (lcec_recorder_init(master) != 0) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failure to init flight recorder for master %s\n", master->name);
+      goto fail2;
+    }
+
+    // build read/write dispatch tables
+    lcec_build_dispatch(master);
+
+    // spread slave state polling over one stateUpdatePeriod unless told otherwise
+    if (master->state_slaves_per_cycle <= 0) {
+      lcec_setup_state_polling(master);
+    }
+
     // export read function
     rtapi_snprintf(name, HAL_NAME_LEN, "%s.%s.read", LCEC_MODULE_NAME, master->name);
     if (hal_export_funct(name, lcec_read_master, master, 0, 0, lcec_comp_id) != 0) {
@@ -321,6 +407,41 @@ int rtapi_app_main(void) {
       rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s write funct export failed\n", master->name);
       goto fail2;
     }
+    // export receive function
+    rtapi_snprintf(name, HAL_NAME_LEN, "%s.%s.receive", LCEC_MODULE_NAME, master->name);
+    if (hal_export_funct(name, lcec_receive_master, master, 0, 0, lcec_comp_id) != 0) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s receive funct export failed\n", master->name);
+      goto fail2;
+    }
+    // export send function
+    rtapi_snprintf(name, HAL_NAME_LEN, "%s.%s.send", LCEC_MODULE_NAME, master->name);
+    if (hal_export_funct(name, lcec_send_master, master, 0, 0, lcec_comp_id) != 0) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s send funct export failed\n", master->name);
+      goto fail2;
+    }
+
+    // export read/write functions for domains that run on their own thread
+    for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+      if (domain->cycle_divider != 0) {
+        continue;
+      }
+      rtapi_snprintf(name, HAL_NAME_LEN, "%s.%s.%s.read", LCEC_MODULE_NAME, master->name, domain->name);
+      if (hal_export_funct(name, lcec_read_domain, domain, 0, 0, lcec_comp_id) != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s domain %s read funct export failed\n", master->name, domain->name);
+        goto fail2;
+      }
+      rtapi_snprintf(name, HAL_NAME_LEN, "%s.%s.%s.write", LCEC_MODULE_NAME, master->name, domain->name);
+      if (hal_export_funct(name, lcec_write_domain, domain, 0, 0, lcec_comp_id) != 0) {
+        rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "master %s domain %s write funct export failed\n", master->name, domain->name);
+        goto fail2;
+      }
+      master->domain_threads++;
+    }
+
+    // start worker thread for read-all/write-all
+    if (lcec_worker_start(master) != 0) {
+      goto fail2;
+    }
   }
 
   // export read-all function
@@ -335,6 +456,18 @@ int rtapi_app_main(void) {
     rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "write-all funct export failed\n");
     goto fail2;
   }
+  // export receive-all function
+  rtapi_snprintf(name, HAL_NAME_LEN, "%s.receive-all", LCEC_MODULE_NAME);
+  if (hal_export_funct(name, lcec_receive_all, NULL, 0, 0, lcec_comp_id) != 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "receive-all funct export failed\n");
+    goto fail2;
+  }
+  // export send-all function
+  rtapi_snprintf(name, HAL_NAME_LEN, "%s.send-all", LCEC_MODULE_NAME);
+  if (hal_export_funct(name, lcec_send_all, NULL, 0, 0, lcec_comp_id) != 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "send-all funct export failed\n");
+    goto fail2;
+  }
 
   rtapi_print_msg(RTAPI_MSG_INFO, LCEC_MSG_PFX "installed driver for %d slaves\n", slave_count);
   hal_ready(lcec_comp_id);
@@ -372,13 +505,16 @@ int lcec_parse_config(void) {
   size_t length;
   char *conf;
   int slave_count;
+  int i;
   const lcec_typelist_t *type;
   lcec_master_t *master;
+  lcec_domain_t *domain;
   lcec_slave_t *slave;
   lcec_slave_dc_t *dc;
   lcec_slave_watchdog_t *wd;
   LCEC_CONF_TYPE_T conf_type;
   LCEC_CONF_MASTER_T *master_conf;
+  LCEC_CONF_DOMAIN_T *domain_conf;
   LCEC_CONF_SLAVE_T *slave_conf;
   LCEC_CONF_DC_T *dc_conf;
   LCEC_CONF_WATCHDOG_T *wd_conf;
@@ -458,7 +594,8 @@ int lcec_parse_config(void) {
         conf += sizeof(LCEC_CONF_MASTER_T);
 
         // alloc master memory
-        master = LCEC_ALLOCATE(lcec_master_t);
+        master = LCEC_ALLOCATE_ALIGNED(lcec_master_t);
+        memset(master, 0, sizeof(lcec_master_t));
 
         // initialize master
         master->index = master_conf->index;
@@ -466,11 +603,77 @@ int lcec_parse_config(void) {
         master->name[LCEC_CONF_STR_MAXLEN - 1] = 0;
         master->app_time_period = master_conf->appTimePeriod;
         master->sync_ref_cycles = master_conf->refClockSyncCycles;
+        master->state_update_timer = 0;
+        master->state_update_period = master_conf->stateUpdatePeriod ? master_conf->stateUpdatePeriod : LCEC_STATE_UPDATE_PERIOD;
+        master->state_slaves_per_cycle = master_conf->stateSlavesPerCycle;
+        master->state_next_slave = NULL;
+        master->state_first_slave = NULL;
+        master->state_end_slave = NULL;
+        master->received = 0;
+        master->sent = 0;
+        master->send_external = 0;
+        master->timing = NULL;
+        master->profile = NULL;
+        master->image = NULL;
+        master->recorder = NULL;
+        master->mutex = 0;
+        master->worker_cpu = master_conf->workerCpu;
+        master->worker = NULL;
+        master->sync_monitor_cycles = master_conf->syncMonitorCycles;
+        master->sync_monitor_cnt = 0;
+        master->sync_monitor_pending = 0;
+        master->sync_monitor_valid = 0;
+        master->sync_monitor_diff = 0;
+        master->auto_shift_cycles = 0;
+        master->shed_divided = 0;
+        memset(&master->time, 0, sizeof(lcec_time_t));
+        master->app_time_sent = 0;
+        if (master_conf->cycleBudgetPct > 0) {
+          master->cycle_budget = (uint32_t)(((uint64_t)master->app_time_period * master_conf->cycleBudgetPct) / 100);
+        } else if (master_conf->cycleBudget > 0) {
+          master->cycle_budget = master_conf->cycleBudget;
+        } else {
+          master->cycle_budget = master->app_time_period;
+        }
+        master->auto_shift_send_max = 0;
+        master->auto_shift_saved = master_conf->autoShiftSendTime;
+        master->extrapolate_cycles = (master_conf->extrapolateCycles >= 0) ? master_conf->extrapolateCycles : LCEC_EXTRAPOLATE_CYCLES;
+        master->recorder_cycles = master_conf->recorderCycles;
+        master->recorder_range_count = master_conf->recorderRangeCount;
+        for (i = 0; i < master_conf->recorderRangeCount; i++) {
+          master->recorder_ranges[i].offset = master_conf->recorderOffset[i];
+          master->recorder_ranges[i].length = master_conf->recorderLength[i];
+        }
+        master->first_domain = NULL;
+        master->last_domain = NULL;
+        master->domain_threads = 0;
+        master->domain_memory = NULL;
+        master->process_data = NULL;
+        master->process_data_len = 0;
+
+        // create default domain
+        lcec_get_domain(master, NULL);
 
         // add master to list
         LCEC_LIST_APPEND(first_master, last_master, master);
         break;
 
+      case lcecConfTypeDomain:
+        // get config token
+        domain_conf = (LCEC_CONF_DOMAIN_T *)conf;
+        conf += sizeof(LCEC_CONF_DOMAIN_T);
+
+        // check for master
+        if (master == NULL) {
+          rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "Master node for domain missing\n");
+          goto fail2;
+        }
+
+        // slaves may already have referenced the domain by name
+        domain = lcec_get_domain(master, domain_conf->name);
+        domain->cycle_divider = domain_conf->cycleDivider;
+        break;
+
       case lcecConfTypeSlave:
         // get config token
         slave_conf = (LCEC_CONF_SLAVE_T *)conf;
@@ -511,6 +714,10 @@ int lcec_parse_config(void) {
         strncpy(slave->name, slave_conf->name, LCEC_CONF_STR_MAXLEN);
         slave->name[LCEC_CONF_STR_MAXLEN - 1] = 0;
         slave->master = master;
+        slave->domain = lcec_get_domain(master, slave_conf->domain);
+        slave->cycle_divider = (slave_conf->cycleDivider > 1) ? slave_conf->cycleDivider : 1;
+        slave->cycle_phase = 0;
+        slave->type_name = (type != NULL) ? type->name : "generic";
 
         // add slave to list
         LCEC_LIST_APPEND(master->first_slave, master->last_slave, slave);
@@ -594,6 +801,7 @@ int lcec_parse_config(void) {
         slave->idn_config = idn_config;
         slave->modparams = modparams;
         slave->dc_conf = NULL;
+        slave->dc_sync0_shift = NULL;
         slave->wd_conf = NULL;
 
         // update slave count
@@ -624,9 +832,27 @@ int lcec_parse_config(void) {
         dc->assignActivate = dc_conf->assignActivate;
         dc->sync0Cycle = dc_conf->sync0Cycle;
         dc->sync0Shift = dc_conf->sync0Shift;
+        dc->sync0ShiftAuto = dc_conf->sync0ShiftAuto;
+        dc->sync0ShiftMargin = (dc_conf->sync0ShiftMargin >= 0) ? dc_conf->sync0ShiftMargin : (int32_t)(master->app_time_period / 10);
         dc->sync1Cycle = dc_conf->sync1Cycle;
         dc->sync1Shift = dc_conf->sync1Shift;
 
+        // use the send time measured on an earlier start; until there is one, half a cycle is a safe guess
+        if (dc->sync0ShiftAuto) {
+          dc->sync0Shift = master->app_time_period / 2;
+          if (master->auto_shift_saved < 0) {
+            rtapi_print_msg(RTAPI_MSG_INFO, LCEC_MSG_PFX "slave %s.%s: sync0Shift=auto uses half a cycle until the send time is measured\n",
+                master->name, slave->name);
+          } else if (dc->sync0Cycle > 0 && master->auto_shift_saved + dc->sync0ShiftMargin >= (int64_t)dc->sync0Cycle) {
+            rtapi_print_msg(RTAPI_MSG_WARN, LCEC_MSG_PFX "slave %s.%s: send time %d ns plus margin %d ns exceeds sync0Cycle %u ns\n",
+                master->name, slave->name, master->auto_shift_saved, dc->sync0ShiftMargin, dc->sync0Cycle);
+          } else {
+            dc->sync0Shift = master->auto_shift_saved + dc->sync0ShiftMargin;
+            rtapi_print_msg(RTAPI_MSG_INFO, LCEC_MSG_PFX "slave %s.%s: sync0Shift=auto picked %d ns (send time %d ns, margin %d ns)\n",
+                master->name, slave->name, dc->sync0Shift, master->auto_shift_saved, dc->sync0ShiftMargin);
+          }
+        }
+
         // add to slave
         slave->dc_conf = dc;
         break;
@@ -766,6 +992,7 @@ int lcec_parse_config(void) {
           generic_hal_data->dir = generic_hal_dir;
           generic_hal_data->pdo_idx = pe_conf->index;
           generic_hal_data->pdo_sidx = pe_conf->subindex;
+          generic_hal_data->domain = (pe_conf->domain[0] != 0) ? lcec_get_domain(master, pe_conf->domain) : NULL;
           generic_hal_data++;
         }
 
@@ -803,6 +1030,7 @@ int lcec_parse_config(void) {
           generic_hal_data->dir = generic_hal_dir;
           generic_hal_data->pdo_idx = pe_conf->index;
           generic_hal_data->pdo_sidx = pe_conf->subindex;
+          generic_hal_data->domain = (pe_conf->domain[0] != 0) ? lcec_get_domain(master, pe_conf->domain) : NULL;
           generic_hal_data++;
         }
         break;
@@ -920,6 +1148,7 @@ fail0:
 void lcec_clear_config(void) {
   lcec_master_t *master, *prev_master;
   lcec_slave_t *slave, *prev_slave;
+  lcec_domain_t *domain;
 
   // iterate all masters
   master = last_master;
@@ -935,14 +1164,35 @@ void lcec_clear_config(void) {
       if (slave->proc_cleanup != NULL) {
         slave->proc_cleanup(slave);
       }
+      lcec_free_pdo_entry_reg(slave->regs);
+      slave->regs = NULL;
 
       slave = prev_slave;
     }
 
+    // stop worker thread
+    lcec_worker_stop(master);
+
+    // release timing, profile, process image, recorder, and log shmem
+    lcec_timing_cleanup(master);
+    lcec_profile_cleanup(master);
+    lcec_image_cleanup(master);
+    lcec_recorder_cleanup(master);
+    lcec_log_cleanup(master);
+
     // release master
     if (master->master) {
       ecrt_release_master(master->master);
     }
+    if (master->domain_memory != NULL) {
+      lcec_free(master->domain_memory);
+    }
+
+    // release PDO entry registrations
+    for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+      lcec_free_pdo_entry_reg(domain->regs);
+      domain->regs = NULL;
+    }
 
     master = prev_master;
   }
@@ -952,18 +1202,194 @@ void lcec_clear_config(void) {
 /// @brief Lock LCEC.
 static void lcec_request_lock(void *data) {
   lcec_master_t *master = (lcec_master_t *)data;
-  rtapi_mutex_get(&master->mutex);
+  lcec_master_lock(master);
 }
 
 /// @brief Unlock LCEC.
 static void lcec_release_lock(void *data) {
   lcec_master_t *master = (lcec_master_t *)data;
-  rtapi_mutex_give(&master->mutex);
+  lcec_master_unlock(master);
 }
 #endif
 
+/// @brief Build one dispatch table for a domain.
+///
+/// Collects the `proc_read` (or, with `write` set, `proc_write`)
+/// callbacks of the domain's slaves, either those that run every
+/// cycle or, with `divided` set, those with a cycle divider.
+static lcec_dispatch_t *lcec_build_dispatch_table(lcec_domain_t *domain, int write, int divided, int *count) {
+  lcec_dispatch_t *table;
+  lcec_slave_t *slave;
+  lcec_slave_rw_t proc;
+  int n = 0;
+
+  for (slave = domain->master->first_slave; slave != NULL; slave = slave->next) {
+    proc = write ? slave->proc_write : slave->proc_read;
+    if (slave->domain == domain && proc != NULL && (slave->cycle_divider > 1) == divided) n++;
+  }
+
+  table = LCEC_ALLOCATE_ARRAY(lcec_dispatch_t, n + 1);
+  *count = 0;
+
+  for (slave = domain->master->first_slave; slave != NULL; slave = slave->next) {
+    proc = write ? slave->proc_write : slave->proc_read;
+    if (slave->domain == domain && proc != NULL && (slave->cycle_divider > 1) == divided) {
+      table[*count].proc = proc;
+      table[*count].slave = slave;
+      table[*count].hal_data = slave->hal_data;
+      table[*count].divider = slave->cycle_divider;
+      table[*count].countdown = slave->cycle_phase + 1;
+      (*count)++;
+    }
+  }
+
+  // terminating entry, so the cyclic code can look one entry ahead
+  memset(&table[*count], 0, sizeof(lcec_dispatch_t));
+  return table;
+}
+
+/// @brief Build the flat read and write dispatch tables for a master's domains.
+///
+/// Slaves are allocated one at a time while parsing the config, so
+/// walking the slave list touches a scattered, fairly large node per
+/// slave.  The cyclic code only needs the callback and its argument,
+/// so pack those into arrays once the slaves' callbacks are final
+/// (after `proc_init`), skipping slaves without a callback.  Each
+/// slave's callbacks run with the domain that holds its PDOs.
+///
+/// Slaves with a `cycleDivider` go into separate tables.  Slaves
+/// in the same domain with the same divider get consecutive phases,
+/// so that their callbacks are spread evenly across cycles instead of
+/// all running on the same one.
+static void lcec_build_dispatch(lcec_master_t *master) {
+  lcec_domain_t *domain;
+  lcec_slave_t *slave, *prev;
+
+  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+    for (prev = slave->prev; prev != NULL; prev = prev->prev) {
+      if (prev->domain == slave->domain && prev->cycle_divider == slave->cycle_divider) {
+        slave->cycle_phase = (prev->cycle_phase + 1) % slave->cycle_divider;
+        break;
+      }
+    }
+  }
+
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    domain->read_table = lcec_build_dispatch_table(domain, 0, 0, &domain->read_count);
+    domain->write_table = lcec_build_dispatch_table(domain, 1, 0, &domain->write_count);
+    domain->read_divided = lcec_build_dispatch_table(domain, 0, 1, &domain->read_divided_count);
+    domain->write_divided = lcec_build_dispatch_table(domain, 1, 1, &domain->write_divided_count);
+
+    rtapi_print_msg(RTAPI_MSG_DBG, LCEC_MSG_PFX "master %s domain %s: %d read and %d write callbacks, %d and %d of them divided\n",
+        master->name, domain->name, domain->read_count + domain->read_divided_count, domain->write_count + domain->write_divided_count,
+        domain->read_divided_count, domain->write_divided_count);
+  }
+}
+
+/// @brief Pick how many slave states to poll per cycle.
+///
+/// Polling every slave's state at once makes one cycle per sweep much
+/// slower than the rest on large buses.  By default, spread the sweep
+/// evenly over `stateUpdatePeriod`, so that each slave's state pins
+/// are refreshed once per period at a constant per-cycle cost.
+static void lcec_setup_state_polling(lcec_master_t *master) {
+  lcec_slave_t *slave;
+  uint64_t cycles = 1;
+  int slave_count = 0;
+
+  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+    slave_count++;
+  }
+
+  if (master->app_time_period > 0) {
+    cycles = lcec_div_u64(master->state_update_period, master->app_time_period);
+  }
+  if (cycles < 1) {
+    cycles = 1;
+  }
+
+  master->state_slaves_per_cycle = (int)lcec_div_u64(slave_count + cycles - 1, cycles);
+  if (master->state_slaves_per_cycle < 1) {
+    master->state_slaves_per_cycle = 1;
+  }
+
+  rtapi_print_msg(
+      RTAPI_MSG_DBG, LCEC_MSG_PFX "master %s: polling %d slave states per cycle\n", master->name, master->state_slaves_per_cycle);
+}
+
+/// @brief Run every callback in a dispatch table.
+///
+/// The profiler check is hoisted out of the loop, so the unprofiled
+/// path is just the calls themselves.  Pass a NULL `profile` for
+/// callbacks that run outside the master's own thread.
+static inline void lcec_run_dispatch(
+    const lcec_dispatch_t *table, int count, lcec_profile_t *profile, lcec_profile_func_t func, long period) {
+  const lcec_dispatch_t *d, *end = table + count;
+  long long start;
+
+  if (profile != NULL && profile->active) {
+    for (d = table; d < end; d++) {
+      start = rtapi_get_clocks();
+      d->proc(d->slave, period);
+      lcec_profile_record(profile, d->slave, func, start);
+    }
+    return;
+  }
+
+  for (d = table; d < end; d++) {
+    // the next driver's HAL data is almost never in cache
+    __builtin_prefetch(d[1].hal_data);
+    d->proc(d->slave, period);
+  }
+}
+
+/// @brief Run the callbacks in a divided dispatch table that are due.
+///
+/// Each entry counts down the domain exchanges until its next call;
+/// the ones that are not due only cost a decrement.
+static inline void lcec_run_divided_dispatch(
+    lcec_dispatch_t *table, int count, lcec_profile_t *profile, lcec_profile_func_t func, long period) {
+  lcec_dispatch_t *d, *end = table + count;
+  long long start;
+  int active = (profile != NULL && profile->active);
+
+  for (d = table; d < end; d++) {
+    if (--d->countdown > 0) {
+      continue;
+    }
+    d->countdown = d->divider;
+
+    if (active) {
+      start = rtapi_get_clocks();
+      d->proc(d->slave, period);
+      lcec_profile_record(profile, d->slave, func, start);
+    } else {
+      d->proc(d->slave, period);
+    }
+  }
+}
+
+/// @brief Run all read callbacks of a domain that are due this cycle.
+///
+/// Drivers with a `cycleDivider` are skipped while the master sheds
+/// them; they pick up where they left off afterwards.
+static inline void lcec_domain_read_dispatch(lcec_domain_t *domain, lcec_profile_t *profile, long period) {
+  lcec_run_dispatch(domain->read_table, domain->read_count, profile, LCEC_PROFILE_READ, period);
+  if (!domain->master->shed_divided) {
+    lcec_run_divided_dispatch(domain->read_divided, domain->read_divided_count, profile, LCEC_PROFILE_READ, period);
+  }
+}
+
+/// @brief Run all write callbacks of a domain that are due this cycle.
+static inline void lcec_domain_write_dispatch(lcec_domain_t *domain, lcec_profile_t *profile, long period) {
+  lcec_run_dispatch(domain->write_table, domain->write_count, profile, LCEC_PROFILE_WRITE, period);
+  if (!domain->master->shed_divided) {
+    lcec_run_divided_dispatch(domain->write_divided, domain->write_divided_count, profile, LCEC_PROFILE_WRITE, period);
+  }
+}
+
 /// @brief Initialize LinuxCNC HAL pins for the master device.
-lcec_master_data_t *lcec_init_master_hal(const char *pfx, int global) {
+lcec_master_data_t *lcec_init_master_hal(const char *pfx, int global, int sync_monitor) {
   lcec_master_data_t *hal_data;
 
   // alloc hal data
@@ -985,6 +1411,14 @@ lcec_master_data_t *lcec_init_master_hal(const char *pfx, int global) {
       return NULL;
     }
   }
+  if (sync_monitor) {
+    if (lcec_pin_newf_list(hal_data, master_sync_monitor_pins, pfx) != 0) {
+      return NULL;
+    }
+    if (lcec_param_newf_list(hal_data, master_sync_monitor_params, pfx) != 0) {
+      return NULL;
+    }
+  }
 
   return hal_data;
 }
@@ -1019,6 +1453,66 @@ void lcec_update_master_hal(lcec_master_data_t *hal_data, ec_master_state_t *ms)
   *(hal_data->all_op) = (ms->al_states == 0x08);
 }
 
+/// @brief Update a master's DC sync monitor pins from the last read.
+static void lcec_update_sync_monitor_hal(lcec_master_t *master) {
+  lcec_master_data_t *hal_data = master->hal_data;
+  uint32_t diff = master->sync_monitor_diff;
+  uint32_t filtered = *(hal_data->dc_sync_diff_filtered);
+
+  lcec_timing_sample(master->timing, LCEC_TIMING_DC_SYNC, diff);
+
+  *(hal_data->dc_sync_diff) = diff;
+  if (diff > *(hal_data->dc_sync_diff_max)) {
+    *(hal_data->dc_sync_diff_max) = diff;
+  }
+
+  // first order low-pass over about 8 reads, starting from the first one
+  if (filtered == 0) {
+    filtered = diff;
+  } else {
+    filtered += ((int32_t)diff - (int32_t)filtered) / 8;
+  }
+  *(hal_data->dc_sync_diff_filtered) = filtered;
+
+  *(hal_data->dc_in_sync) = (diff <= hal_data->dc_sync_threshold);
+}
+
+/// @brief Measure when a master's frames go out, for `sync0Shift="auto"`.
+///
+/// Tracks the latest send time after the start of the cycle over the
+/// first `LCEC_AUTO_SHIFT_CYCLES` cycles, and then logs it.  This runs
+/// in the cycle, so it only measures: DC settings can't be changed
+/// from here, and the EtherCAT master only writes them to a slave
+/// while configuring it anyway.  Instead, `lcec_conf` saves the send
+/// time, and the next start picks every slave's shift from it.
+static void lcec_auto_shift_sample(lcec_master_t *master, long long now) {
+  lcec_slave_dc_t *dc;
+  lcec_slave_t *slave;
+  long long start = master->timing->last_read_start;
+
+  // nothing to measure against before the first read
+  if (start == 0) {
+    return;
+  }
+
+  if (now - start > master->auto_shift_send_max) {
+    master->auto_shift_send_max = (uint32_t)(now - start);
+  }
+  if (--master->auto_shift_cycles > 0) {
+    return;
+  }
+
+  master->hal_data->dc_send_offset_max = master->auto_shift_send_max;
+  lcec_log_at(master->log, now, LCEC_LOG_AUTO_SHIFT_MEASURED, NULL, master->auto_shift_send_max, 0, 0, 0);
+  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+    dc = slave->dc_conf;
+    if (dc != NULL && dc->sync0ShiftAuto && dc->sync0Cycle > 0 && master->auto_shift_send_max + dc->sync0ShiftMargin >= dc->sync0Cycle) {
+      lcec_log_at(master->log, now, LCEC_LOG_AUTO_SHIFT_TOO_LATE, slave->name, master->auto_shift_send_max, dc->sync0ShiftMargin,
+          dc->sync0Cycle, 0);
+    }
+  }
+}
+
 /// @brief Update generic HAL pins for a slave.
 void lcec_update_slave_state_hal(lcec_slave_state_t *hal_data, ec_slave_config_state_t *ss) {
   *(hal_data->online) = ss->online;
@@ -1031,96 +1525,168 @@ void lcec_update_slave_state_hal(lcec_slave_state_t *hal_data, ec_slave_config_s
 
 /// @brief Update all input pins across all masters and slaves.
 void lcec_read_all(void *arg, long period) {
-  lcec_master_t *master;
-
   // initialize global state
-  global_ms.slaves_responding = 0;
-  global_ms.al_states = 0;
-  global_ms.link_up = (first_master != NULL);
+  global_acc.slaves_responding = 0;
+  global_acc.al_states = 0;
+  global_acc.link_down = 0;
 
   // process slaves
-  for (master = first_master; master != NULL; master = master->next) {
-    lcec_read_master(master, period);
-  }
+  lcec_run_masters(first_master, lcec_read_master, period);
 
   // update global state pins
+  global_ms.slaves_responding = global_acc.slaves_responding;
+  global_ms.al_states = global_acc.al_states;
+  global_ms.link_up = (first_master != NULL) && !global_acc.link_down;
   lcec_update_master_hal(global_hal_data, &global_ms);
 }
 
 /// @brief Update all output pins across all masters and slaves.
 void lcec_write_all(void *arg, long period) {
-  lcec_master_t *master;
-
   // process slaves
-  for (master = first_master; master != NULL; master = master->next) {
-    lcec_write_master(master, period);
-  }
+  lcec_run_masters(first_master, lcec_write_master, period);
 }
 
-/// @brief Read all input pins on a master and its slaves.
-void lcec_read_master(void *arg, long period) {
-  lcec_master_t *master = (lcec_master_t *)arg;
+/// @brief Receive frames on all masters, see `lcec_receive_master()`.
+void lcec_receive_all(void *arg, long period) { lcec_run_masters(first_master, lcec_receive_master, period); }
+
+/// @brief Send frames on all masters, see `lcec_send_master()`.
+void lcec_send_all(void *arg, long period) { lcec_run_masters(first_master, lcec_send_master, period); }
+
+/// @brief Receive a master's frames and process its domains.
+///
+/// First half of `lcec_read_master()`, also exported on its own as
+/// `lcec.<master>.receive`.  Slave states polled here are published
+/// to their HAL pins by the next `lcec_read_master()`.
+static void lcec_master_receive(lcec_master_t *master, long period) {
+  lcec_timing_t *timing = master->timing;
+  lcec_domain_t *domain;
   lcec_slave_t *slave;
-  int check_states;
+  long long now;
+  int check_master, i;
 
   // check period
   if (period != master->period_last) {
     master->period_last = period;
     if (master->app_time_period != period) {
-      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "Invalid appTimePeriod of %u for master %s (should be %ld).\n", master->app_time_period,
-          master->name, period);
+      lcec_log(master->log, LCEC_LOG_PERIOD_MISMATCH, NULL, master->app_time_period, period, 0, 0);
     }
   }
 
-  // get state check flag
+  // start a new state sweep once per state update period, but not before the last one is finished
   if (master->state_update_timer > 0) {
-    check_states = 0;
     master->state_update_timer -= period;
-  } else {
-    check_states = 1;
-    master->state_update_timer = LCEC_STATE_UPDATE_PERIOD;
+  }
+  check_master = 0;
+  if (master->state_update_timer <= 0 && master->state_next_slave == NULL) {
+    check_master = 1;
+    master->state_update_timer = master->state_update_period;
+    master->state_next_slave = master->first_slave;
   }
 
-  // receive process data & master state
-  rtapi_mutex_get(&master->mutex);
+  // receive process data, master state, and the next few slaves' states
+  lcec_master_lock(master);
   ecrt_master_receive(master->master);
-  ecrt_domain_process(master->domain);
-  if (check_states) {
+  now = lcec_timing_phase(timing, LCEC_TIMING_RECEIVE);
+  if (master->sync_monitor_pending) {
+    master->sync_monitor_diff = ecrt_master_sync_monitor_process(master->master);
+    master->sync_monitor_pending = 0;
+    master->sync_monitor_valid = 1;
+  }
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    if (domain->cycle_divider > 0 && domain->exchange) {
+      ecrt_domain_process(domain->domain);
+      ecrt_domain_state(domain->domain, &domain->state);
+    }
+  }
+  if (check_master) {
     ecrt_master_state(master->master, &master->ms);
   }
-  rtapi_mutex_give(&master->mutex);
+  master->state_first_slave = master->state_next_slave;
+  for (i = 0, slave = master->state_first_slave; slave != NULL && i < master->state_slaves_per_cycle; i++, slave = slave->next) {
+    ecrt_slave_config_state(slave->config, &slave->state);
+  }
+  master->state_end_slave = slave;
+  lcec_master_unlock(master);
+  master->state_next_slave = master->state_end_slave;
+
+  // update the drivers' view of this cycle
+  master->time.period = period;
+  master->time.delta = (master->time.receive != 0) ? (long)(now - master->time.receive) : period;
+  master->time.receive = now;
+  master->time.dc_time = master->app_time_sent;
+  master->time.cycle++;
+  lcec_timing_phase(timing, LCEC_TIMING_PROCESS);
+}
+
+/// @brief Receive a master's frames without running any drivers.
+///
+/// Lets the frame be picked up as late as possible, with the drivers
+/// run later by `lcec.<master>.read`.
+void lcec_receive_master(void *arg, long period) {
+  lcec_master_t *master = (lcec_master_t *)arg;
+
+  lcec_timing_begin_read(master->timing);
+  lcec_master_receive(master, period);
+  master->received = 1;
+}
+
+/// @brief Read all input pins on a master and its slaves.
+void lcec_read_master(void *arg, long period) {
+  lcec_master_t *master = (lcec_master_t *)arg;
+  lcec_timing_t *timing = master->timing;
+  lcec_profile_t *profile = master->profile;
+  lcec_domain_t *domain;
+  lcec_slave_t *slave;
+
+  // receive, unless lcec.<master>.receive already did this cycle
+  if (master->received) {
+    master->received = 0;
+    lcec_timing_resume(timing, &timing->read_start);
+  } else {
+    lcec_timing_begin_read(timing);
+    lcec_master_receive(master, period);
+  }
+  lcec_profile_begin(profile);
 
   // update state pins
   lcec_update_master_hal(master->hal_data, &master->ms);
+  master->shed_divided = *(master->hal_data->shed_divided);
+  if (master->sync_monitor_valid) {
+    master->sync_monitor_valid = 0;
+    lcec_update_sync_monitor_hal(master);
+  }
 
   // update global state
-  global_ms.slaves_responding += master->ms.slaves_responding;
-  global_ms.al_states |= master->ms.al_states;
-  global_ms.link_up = global_ms.link_up && master->ms.link_up;
+  __atomic_fetch_add(&global_acc.slaves_responding, master->ms.slaves_responding, __ATOMIC_RELAXED);
+  __atomic_fetch_or(&global_acc.al_states, master->ms.al_states, __ATOMIC_RELAXED);
+  if (!master->ms.link_up) {
+    __atomic_store_n(&global_acc.link_down, 1, __ATOMIC_RELAXED);
+  }
 
-  // process slaves
-  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
-    // get slaves state
-    rtapi_mutex_get(&master->mutex);
-    if (check_states) {
-      ecrt_slave_config_state(slave->config, &slave->state);
-    }
-    rtapi_mutex_give(&master->mutex);
-    if (check_states) {
-      lcec_update_slave_state_hal(slave->hal_state_data, &slave->state);
-    }
+  // update slave state pins
+  for (slave = master->state_first_slave; slave != master->state_end_slave; slave = slave->next) {
+    lcec_update_slave_state_hal(slave->hal_state_data, &slave->state);
+  }
 
-    // process read function
-    if (slave->proc_read != NULL) {
-      slave->proc_read(slave, period);
+  // process read functions of the domains exchanged in the last cycle
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    if (domain->cycle_divider > 0 && domain->exchange) {
+      lcec_update_domain_hal(domain);
+      lcec_domain_read_dispatch(domain, profile, period);
     }
   }
+
+  lcec_timing_phase(timing, LCEC_TIMING_READ);
+  lcec_timing_end_read(timing);
 }
 
-/// @brief Write all output pins on a master and its slaves.
-void lcec_write_master(void *arg, long period) {
-  lcec_master_t *master = (lcec_master_t *)arg;
-  lcec_slave_t *slave;
+/// @brief Queue a master's domains and send its frames.
+///
+/// Second half of `lcec_write_master()`, also exported on its own as
+/// `lcec.<master>.send`.
+static void lcec_master_send(lcec_master_t *master, long period) {
+  lcec_timing_t *timing = master->timing;
+  lcec_domain_t *domain;
   uint64_t app_time;
   long long now;
 #ifdef RTAPI_TASK_PLL_SUPPORT
@@ -1130,21 +1696,18 @@ void lcec_write_master(void *arg, long period) {
   lcec_master_data_t *hal_data;
 #endif
 
-  // process slaves
-  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
-    if (slave->proc_write != NULL) {
-      slave->proc_write(slave, period);
-    }
-  }
-
 #ifdef RTAPI_TASK_PLL_SUPPORT
   // get reference time
   ref = rtapi_task_pll_get_reference();
 #endif
 
   // send process data
-  rtapi_mutex_get(&master->mutex);
-  ecrt_domain_queue(master->domain);
+  lcec_master_lock(master);
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    if (domain->cycle_divider > 0 && domain->exchange) {
+      ecrt_domain_queue(domain->domain);
+    }
+  }
 
   // update application time
   now = rtapi_get_time();
@@ -1160,6 +1723,10 @@ void lcec_write_master(void *arg, long period) {
 #endif
 
   ecrt_master_application_time(master->master, app_time);
+  master->app_time_sent = app_time;
+  if (master->auto_shift_cycles > 0) {
+    lcec_auto_shift_sample(master, now);
+  }
 
   // sync ref clock to master
   if (master->sync_ref_cycles > 0) {
@@ -1184,12 +1751,20 @@ void lcec_write_master(void *arg, long period) {
   // sync slaves to ref clock
   ecrt_master_sync_slave_clocks(master->master);
 
+  // read back how well they are synced every few cycles
+  if (master->sync_monitor_cycles > 0 && --master->sync_monitor_cnt <= 0) {
+    master->sync_monitor_cnt = master->sync_monitor_cycles;
+    ecrt_master_sync_monitor_queue(master->master);
+    master->sync_monitor_pending = 1;
+  }
+
   // send domain data
   ecrt_master_send(master->master);
-  rtapi_mutex_give(&master->mutex);
+  lcec_master_unlock(master);
+  timing->send_time = lcec_timing_phase(timing, LCEC_TIMING_SEND);
 
 #ifdef RTAPI_TASK_PLL_SUPPORT
-  // BANG-BANG controller for master thread PLL sync
+  // controller for master thread PLL sync
   // this part is done after ecrt_master_send() to reduce jitter
   hal_data = master->hal_data;
   *(hal_data->pll_err) = 0;
@@ -1205,17 +1780,106 @@ void lcec_write_master(void *arg, long period) {
       dc_time_valid = 0;
       // increment reset counter to document this event
       (*(hal_data->pll_reset_cnt))++;
+      lcec_pll_reset(&master->pll);
     } else {
-      *(hal_data->pll_out) = (*(hal_data->pll_err) < 0) ? -(hal_data->pll_step) : (hal_data->pll_step);
+      *(hal_data->pll_out) = lcec_pll_update(&master->pll, &hal_data->pll, *(hal_data->pll_err));
     }
   }
+  *(hal_data->pll_locked) = master->pll.locked;
 
   rtapi_task_pll_set_correction(*(hal_data->pll_out));
   master->app_time_last = (uint32_t)app_time;
   master->dc_time_valid_last = dc_time_valid;
+  lcec_timing_phase(timing, LCEC_TIMING_PLL);
 #endif
+
+  lcec_timing_end_write(timing);
+  lcec_timing_commit(timing);
+  lcec_log_flush(master->log, master->time.receive);
+  lcec_image_update(master);
+  lcec_recorder_update(master);
 }
 
+/// @brief Write all output pins on a master and its slaves.
+void lcec_write_master(void *arg, long period) {
+  lcec_master_t *master = (lcec_master_t *)arg;
+  lcec_timing_t *timing = master->timing;
+  lcec_profile_t *profile = master->profile;
+  lcec_domain_t *domain;
+
+  lcec_timing_begin_write(timing);
+
+  // process write functions of the domains due this cycle
+  for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+    if (domain->cycle_divider <= 0) {
+      continue;
+    }
+    domain->exchange = (--domain->cycle_count <= 0);
+    if (domain->exchange) {
+      domain->cycle_count = domain->cycle_divider;
+      lcec_domain_write_dispatch(domain, profile, period);
+    }
+  }
+  lcec_timing_phase(timing, LCEC_TIMING_WRITE);
+
+  // send, unless lcec.<master>.send is used
+  if (!master->send_external) {
+    lcec_master_send(master, period);
+    master->sent = 1;
+  }
+}
+
+/// @brief Send a master's frames after `lcec.<master>.write`.
+///
+/// Once this has run, `lcec.<master>.write` only packs the outputs
+/// and leaves sending to this function, so other HAL functions can
+/// run while the frame is on the wire.
+void lcec_send_master(void *arg, long period) {
+  lcec_master_t *master = (lcec_master_t *)arg;
+
+  master->send_external = 1;
+
+  // on the first cycle, lcec.<master>.write didn't know about us yet and has already sent
+  if (master->sent) {
+    master->sent = 0;
+    return;
+  }
+
+  lcec_timing_resume(master->timing, &master->timing->write_start);
+  lcec_master_send(master, period);
+}
+
+/// @brief Read all input pins of a domain that runs on its own thread.
+///
+/// Only processes the frames received by the master's last
+/// `lcec_read_master()`; sending and receiving stays with the master.
+void lcec_read_domain(void *arg, long period) {
+  lcec_domain_t *domain = (lcec_domain_t *)arg;
+  lcec_master_t *master = domain->master;
+
+  lcec_master_lock(master);
+  ecrt_domain_process(domain->domain);
+  ecrt_domain_state(domain->domain, &domain->state);
+  lcec_master_unlock(master);
+
+  lcec_update_domain_hal(domain);
+  lcec_domain_read_dispatch(domain, NULL, period);
+}
+
+/// @brief Write all output pins of a domain that runs on its own thread.
+///
+/// Queues the domain's frames, which go out with the master's next
+/// `lcec_write_master()`.
+void lcec_write_domain(void *arg, long period) {
+  lcec_domain_t *domain = (lcec_domain_t *)arg;
+  lcec_master_t *master = domain->master;
+
+  lcec_domain_write_dispatch(domain, NULL, period);
+
+  lcec_master_lock(master);
+  ecrt_domain_queue(domain->domain);
+  lcec_master_unlock(master);
+}
 
 #ifndef __KERNEL__
 #define BACKTRACE_SIZE 100
@@ -40,5 +40,15 @@ void *lcec_malloc(size_t size, const char *file, const char *func, int line) {
     fprintf(stderr, LCEC_MSG_PFX "MEMORY ALLOCATION FAILURE, hal_malloc() returned NULL in function %s at %s:%d\n", func, file, line);
     exit(1);
   }
+  memset(result, 0, size);
+  return result;
+}
+
+void *lcec_malloc_aligned(size_t size, size_t align, const char *file, const char *func, int line) {
+  void *result = NULL;
+  if (posix_memalign(&result, align, size) != 0) {
+    fprintf(stderr, LCEC_MSG_PFX "MEMORY ALLOCATION FAILURE, posix_memalign() failed in function %s at %s:%d\n", func, file, line);
+    exit(1);
+  }
   return result;
 }
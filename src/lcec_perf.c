@@ -0,0 +1,600 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Code for the `lcec_perf` tool, which reports timing data from a running `lcec` instance.
+///
+/// `lcec_perf` only reads shared memory that the realtime side
+/// publishes, so it can be run against a live machine without
+/// affecting the servo thread.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "lcec.h"
+#include "lcec_rtapi.h"
+#include "rtapi.h"
+
+#define MAX_MASTERS 32  ///< Highest master index + 1 that is probed when `-m` is not given.
+
+static const char *modname = "lcec_perf";
+static int hal_comp_id;
+
+static const char *func_names[LCEC_PROFILE_FUNCS] = {"read", "write"};
+
+/// @brief Command-line options shared by all commands.
+typedef struct {
+  int master_index;    ///< Only report on this master, or -1 for all.
+  int histograms;      ///< Print histograms (`timing`).
+  int interval;        ///< Repeat interval in seconds, or 0 (`timing`, `top`).
+  int top;             ///< Number of rows to print (`top`).
+  int cycles;          ///< Number of cycles to dump (`trace`).
+  const char *output;  ///< Output filename (`trace`, `record`, `decode`).
+} perf_opts_t;
+
+/// @brief One row in the `top` table.
+typedef struct {
+  const char *name;
+  const char *type_name;
+  int func;
+  lcec_timing_stat_t stat;
+} top_row_t;
+
+static void usage(void) {
+  fprintf(stderr,
+      "Usage: %s [options] <command>\n"
+      "\n"
+      "Commands:\n"
+      "  timing         Print per-phase cycle timing for each master.\n"
+      "  top            Print the slowest slave drivers.  Needs lcec.<master>.profile.enable.\n"
+      "  trace          Write a Chrome/Perfetto trace of recent slave driver calls.\n"
+      "  image          Hex dump a snapshot of each master's process data.\n"
+      "  record         Save the flight recorder of a master.  Needs recorderCycles.\n"
+      "  decode <file>  Convert a saved recording to CSV.\n"
+      "\n"
+      "Options:\n"
+      "  -m <index>     Only report on master <index>.\n"
+      "  -H             Include log2 histograms (timing).\n"
+      "  -w <seconds>   Repeat every <seconds> seconds until interrupted (timing, top, image).\n"
+      "  -n <count>     Number of rows to print (top, default 10).\n"
+      "  -c <cycles>    Number of cycles to include (trace, default 100).\n"
+      "  -o <file>      Write to <file> instead of stdout (trace, record, decode).\n",
+      modname);
+}
+
+static void print_histogram(const lcec_timing_stat_t *stat) {
+  int i;
+
+  for (i = 0; i < LCEC_TIMING_HIST_BUCKETS; i++) {
+    if (stat->hist[i] == 0) continue;
+    printf("      %10llu - %10llu ns: %llu\n", (i == 0) ? 0ULL : (1ULL << i), (2ULL << i) - 1, (unsigned long long)stat->hist[i]);
+  }
+}
+
+/// @brief Print timing data for a single master.  Returns 0 on success, -1 if the master has no timing data.
+static int print_timing(int index, const perf_opts_t *opts) {
+  int shmem_id;
+  void *shmem_ptr;
+  lcec_timing_shm_t snap;
+  const lcec_timing_stat_t *stat;
+  int i, ret = -1;
+
+  shmem_id = rtapi_shmem_new(LCEC_TIMING_SHMEM_KEY + index, hal_comp_id, sizeof(lcec_timing_shm_t));
+  if (shmem_id < 0) {
+    return -1;
+  }
+  if (lcec_rtapi_shmem_getptr(shmem_id, &shmem_ptr) < 0) {
+    goto out;
+  }
+  if (lcec_timing_snapshot((const lcec_timing_shm_t *)shmem_ptr, &snap) != 0) {
+    goto out;
+  }
+
+  printf("master %d (%s): %llu cycles, appTimePeriod %u ns\n", snap.master_index, snap.master_name, (unsigned long long)snap.cycles,
+      snap.app_time_period);
+  if (snap.budget != 0) {
+    printf("  %llu cycles over the %u ns budget\n", (unsigned long long)snap.overruns, snap.budget);
+  }
+  printf("  %-12s %10s %10s %10s %10s %10s\n", "phase", "last", "min", "mean", "p99", "max");
+  for (i = 0; i < LCEC_TIMING_COUNT; i++) {
+    stat = &snap.stats[i];
+    if (stat->count == 0) continue;
+    printf("  %-12s %10u %10u %10u %10u %10u\n", lcec_timing_names[i], stat->last, stat->min, (uint32_t)(stat->sum / stat->count),
+        lcec_timing_percentile(stat, 99), stat->max);
+    if (opts->histograms) print_histogram(stat);
+  }
+  ret = 0;
+
+out:
+  rtapi_shmem_delete(shmem_id, hal_comp_id);
+  return ret;
+}
+
+/// @brief Print a snapshot of a single master's process image.  Returns 0 on success, -1 if the master has no process image.
+static int print_image(int index) {
+  lcec_image_reader_t reader;
+  lcec_image_frame_t frame;
+  uint8_t *data;
+  uint32_t i;
+  int ret = -1;
+
+  if (lcec_image_open(&reader, hal_comp_id, index) != 0) {
+    return -1;
+  }
+  if ((data = malloc(reader.shm->data_len + 1)) == NULL) {
+    goto out;
+  }
+  if (lcec_image_snapshot(reader.shm, &frame, data, reader.shm->data_len) != 0) {
+    goto out;
+  }
+
+  printf("master %d (%s): cycle %llu, %u bytes%s, dc time %llu ns\n", reader.shm->master_index, reader.shm->master_name,
+      (unsigned long long)frame.cycle, reader.shm->data_len, frame.valid ? "" : " (stale)", (unsigned long long)frame.dc_time);
+  for (i = 0; i < reader.shm->data_len; i++) {
+    if ((i & 15) == 0) printf("  %04x:", i);
+    printf(" %02x", data[i]);
+    if ((i & 15) == 15 || i == reader.shm->data_len - 1) printf("\n");
+  }
+  ret = 0;
+
+out:
+  free(data);
+  lcec_image_close(&reader);
+  return ret;
+}
+
+/// @brief Copy a master's profile block into newly allocated memory.
+///
+/// Returns NULL if the master doesn't exist or no consistent copy
+/// could be made.  The caller must free() the result.
+static lcec_profile_shm_t *profile_snapshot(int index) {
+  int shmem_id;
+  void *shmem_ptr;
+  lcec_profile_shm_t *shm, *copy = NULL;
+  uint32_t size, seq;
+  int tries;
+
+  // open just the header to find the real size, like lcec_main does for the config
+  shmem_id = rtapi_shmem_new(LCEC_PROFILE_SHMEM_KEY + index, hal_comp_id, sizeof(lcec_profile_shm_t));
+  if (shmem_id < 0) {
+    return NULL;
+  }
+  if (lcec_rtapi_shmem_getptr(shmem_id, &shmem_ptr) < 0) {
+    rtapi_shmem_delete(shmem_id, hal_comp_id);
+    return NULL;
+  }
+  shm = (lcec_profile_shm_t *)shmem_ptr;
+  size = shm->size;
+  if (shm->magic != LCEC_PROFILE_SHMEM_MAGIC) {
+    rtapi_shmem_delete(shmem_id, hal_comp_id);
+    return NULL;
+  }
+  rtapi_shmem_delete(shmem_id, hal_comp_id);
+
+  shmem_id = rtapi_shmem_new(LCEC_PROFILE_SHMEM_KEY + index, hal_comp_id, size);
+  if (shmem_id < 0) {
+    return NULL;
+  }
+  if (lcec_rtapi_shmem_getptr(shmem_id, &shmem_ptr) < 0) {
+    goto out;
+  }
+  shm = (lcec_profile_shm_t *)shmem_ptr;
+
+  if ((copy = malloc(size)) == NULL) {
+    goto out;
+  }
+  for (tries = 0; tries < 1000; tries++) {
+    seq = shm->seq;
+    lcec_barrier();
+    if (seq & 1) {
+      lcec_schedule();
+      continue;
+    }
+    memcpy(copy, shm, size);
+    lcec_barrier();
+    if (shm->seq == seq) {
+      goto out;
+    }
+  }
+  free(copy);
+  copy = NULL;
+
+out:
+  rtapi_shmem_delete(shmem_id, hal_comp_id);
+  return copy;
+}
+
+/// @brief Nanoseconds per `rtapi_get_clocks()` tick, measured by the realtime side.
+static double profile_ns_per_clock(const lcec_profile_shm_t *shm) {
+  int64_t clocks = shm->cal_clocks_last - shm->cal_clocks_start;
+  int64_t ns = shm->cal_time_last - shm->cal_time_start;
+
+  if (clocks <= 0 || ns <= 0) return 1.0;
+  return (double)ns / (double)clocks;
+}
+
+static void merge_stat(lcec_timing_stat_t *dst, const lcec_timing_stat_t *src) {
+  int i;
+
+  if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+  if (src->max > dst->max) dst->max = src->max;
+  for (i = 0; i < LCEC_TIMING_HIST_BUCKETS; i++) {
+    dst->hist[i] += src->hist[i];
+  }
+  dst->sum += src->sum;
+  dst->count += src->count;
+}
+
+static int compare_rows(const void *a, const void *b) {
+  const top_row_t *ra = a, *rb = b;
+
+  if (ra->stat.sum == rb->stat.sum) return 0;
+  return (ra->stat.sum < rb->stat.sum) ? 1 : -1;
+}
+
+static void print_rows(const char *title, top_row_t *rows, int count, const lcec_profile_shm_t *shm, int limit) {
+  double scale = profile_ns_per_clock(shm);
+  uint64_t total = 0;
+  const lcec_timing_stat_t *stat;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    total += rows[i].stat.sum;
+  }
+  qsort(rows, count, sizeof(top_row_t), compare_rows);
+
+  printf("  %-20s %-12s %-5s %10s %9s %9s %9s %9s %6s\n", title, "type", "func", "calls", "min us", "mean us", "p99 us", "max us", "share");
+  for (i = 0; i < count && i < limit; i++) {
+    stat = &rows[i].stat;
+    printf("  %-20s %-12s %-5s %10llu %9.2f %9.2f %9.2f %9.2f %5.1f%%\n", rows[i].name ? rows[i].name : "", rows[i].type_name,
+        func_names[rows[i].func], (unsigned long long)stat->count, stat->min * scale / 1000.0,
+        (double)stat->sum / stat->count * scale / 1000.0, lcec_timing_percentile(stat, 99) * scale / 1000.0, stat->max * scale / 1000.0,
+        total ? 100.0 * stat->sum / total : 0.0);
+  }
+}
+
+/// @brief Print the slowest slaves and driver types for a single master.
+static int print_top(int index, const perf_opts_t *opts) {
+  lcec_profile_shm_t *shm;
+  lcec_profile_slave_t *slaves;
+  top_row_t *rows, *types;
+  int i, j, k, row_count = 0, type_count = 0;
+
+  if ((shm = profile_snapshot(index)) == NULL) {
+    return -1;
+  }
+  slaves = lcec_profile_slaves(shm);
+
+  printf("master %d (%s): %llu profiled cycles%s\n", shm->master_index, shm->master_name, (unsigned long long)shm->cycles,
+      shm->enabled ? "" : " (profiling is off)");
+
+  rows = calloc(shm->slave_count * LCEC_PROFILE_FUNCS + 1, sizeof(top_row_t));
+  types = calloc(shm->slave_count * LCEC_PROFILE_FUNCS + 1, sizeof(top_row_t));
+  if (rows == NULL || types == NULL) {
+    fprintf(stderr, "%s: ERROR: out of memory\n", modname);
+    exit(1);
+  }
+
+  for (i = 0; i < shm->slave_count; i++) {
+    for (j = 0; j < LCEC_PROFILE_FUNCS; j++) {
+      if (slaves[i].stats[j].count == 0) continue;
+
+      rows[row_count].name = slaves[i].name;
+      rows[row_count].type_name = slaves[i].type_name;
+      rows[row_count].func = j;
+      rows[row_count].stat = slaves[i].stats[j];
+      row_count++;
+
+      for (k = 0; k < type_count; k++) {
+        if (types[k].func == j && strcmp(types[k].type_name, slaves[i].type_name) == 0) break;
+      }
+      if (k == type_count) {
+        types[k].type_name = slaves[i].type_name;
+        types[k].func = j;
+        type_count++;
+      }
+      merge_stat(&types[k].stat, &slaves[i].stats[j]);
+    }
+  }
+
+  print_rows("slave", rows, row_count, shm, opts->top);
+  printf("\n");
+  print_rows("(by type)", types, type_count, shm, opts->top);
+
+  free(rows);
+  free(types);
+  free(shm);
+  return 0;
+}
+
+/// @brief Save the flight recorder of a single master.  Returns 0 on success, -1 if the master has no recorder.
+static int save_recording(int index, FILE *out) {
+  lcec_recorder_reader_t reader;
+  lcec_recorder_shm_t *copy = NULL, *tmp = NULL;
+  uint32_t count;
+  int ret = -1;
+
+  if (lcec_recorder_open(&reader, hal_comp_id, index) != 0) {
+    return -1;
+  }
+  if ((copy = malloc(reader.shm->size)) == NULL || (tmp = malloc(reader.shm->size)) == NULL) {
+    goto out;
+  }
+
+  count = lcec_recorder_snapshot(reader.shm, copy, tmp);
+  if (fwrite(copy, copy->size, 1, out) != 1) {
+    fprintf(stderr, "%s: ERROR: unable to write recording\n", modname);
+    goto out;
+  }
+  fprintf(stderr, "master %d (%s): %u cycles, %u bytes each, %s\n", copy->master_index, copy->master_name, count, copy->record_len,
+      copy->frozen ? "frozen" : "still recording");
+  ret = 0;
+
+out:
+  free(tmp);
+  free(copy);
+  lcec_recorder_close(&reader);
+  return ret;
+}
+
+/// @brief Convert a recording saved by `record` to CSV, with one row per cycle and one column per recorded PDO entry.
+static int decode_recording(const char *filename, FILE *out) {
+  lcec_recorder_shm_t *shm = NULL;
+  const lcec_recorder_pdo_t *pdos;
+  const lcec_recorder_record_t *record;
+  char *recorded = NULL;
+  FILE *in;
+  long len;
+  uint64_t value;
+  uint32_t i, p;
+  int ret = -1;
+
+  if ((in = fopen(filename, "rb")) == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, filename);
+    return -1;
+  }
+  if (fseek(in, 0, SEEK_END) != 0 || (len = ftell(in)) < 0 || fseek(in, 0, SEEK_SET) != 0 || (shm = malloc(len + 1)) == NULL ||
+      fread(shm, 1, len, in) != (size_t)len) {
+    fprintf(stderr, "%s: ERROR: unable to read %s\n", modname, filename);
+    goto out;
+  }
+  if (lcec_recorder_check(shm, len) != 0) {
+    fprintf(stderr, "%s: ERROR: %s is not a recording\n", modname, filename);
+    goto out;
+  }
+  pdos = lcec_recorder_pdos(shm);
+  if ((recorded = calloc(shm->pdo_count + 1, 1)) == NULL) {
+    goto out;
+  }
+
+  // only entries inside the recorded ranges get a column
+  fprintf(out, "cycle,time,valid,trigger");
+  for (p = 0; p < shm->pdo_count; p++) {
+    if (shm->depth > 0 && lcec_recorder_value(shm, lcec_recorder_record(shm, 0), &pdos[p], &value) == 0) {
+      recorded[p] = 1;
+      fprintf(out, ",%s.0x%04x:%02x", pdos[p].slave, pdos[p].index, pdos[p].subindex);
+    }
+  }
+  fprintf(out, "\n");
+
+  for (i = 0; i < shm->depth; i++) {
+    record = lcec_recorder_record(shm, i);
+    fprintf(out, "%llu,%lld,%u,%d", (unsigned long long)record->cycle, (long long)record->time, record->valid,
+        shm->trigger_cycle != 0 && record->cycle == shm->trigger_cycle);
+    for (p = 0; p < shm->pdo_count; p++) {
+      if (!recorded[p]) continue;
+      lcec_recorder_value(shm, record, &pdos[p], &value);
+      fprintf(out, ",%llu", (unsigned long long)value);
+    }
+    fprintf(out, "\n");
+  }
+  ret = 0;
+
+out:
+  free(recorded);
+  free(shm);
+  fclose(in);
+  return ret;
+}
+
+/// @brief Write a Chrome/Perfetto JSON trace of the last few cycles for a single master.
+static int write_trace(int index, const perf_opts_t *opts, FILE *out, int *first) {
+  lcec_profile_shm_t *shm;
+  lcec_profile_slave_t *slaves;
+  lcec_profile_event_t *events, *ev;
+  uint64_t head, start, last_cycle = 0, i;
+  int64_t t0 = 0;
+  double scale;
+  int s, have_t0 = 0;
+
+  if ((shm = profile_snapshot(index)) == NULL) {
+    return -1;
+  }
+  slaves = lcec_profile_slaves(shm);
+  events = lcec_profile_events(shm);
+  scale = profile_ns_per_clock(shm);
+
+  // the snapshot was taken under `seq`, which doesn't cover the
+  // ring, so skip the oldest slots in case they were overwritten
+  // during the copy.
+  head = shm->trace_head;
+  start = (head > LCEC_PROFILE_TRACE_EVENTS / 2) ? head - LCEC_PROFILE_TRACE_EVENTS / 2 : 0;
+
+  for (i = start; i < head; i++) {
+    ev = &events[i & (LCEC_PROFILE_TRACE_EVENTS - 1)];
+    if (ev->cycle > last_cycle) last_cycle = ev->cycle;
+  }
+
+  for (s = 0; s < shm->slave_count; s++) {
+    fprintf(out, "%s  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s (%s)\"}}",
+        *first ? "" : ",\n", shm->master_index, s, slaves[s].name, slaves[s].type_name);
+    *first = 0;
+  }
+
+  for (i = start; i < head; i++) {
+    ev = &events[i & (LCEC_PROFILE_TRACE_EVENTS - 1)];
+    if (ev->cycle + opts->cycles <= last_cycle || ev->slave >= shm->slave_count) continue;
+    if (!have_t0) {
+      t0 = ev->start;
+      have_t0 = 1;
+    }
+    fprintf(out,
+        ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d, \"args\": "
+        "{\"cycle\": %llu}}",
+        slaves[ev->slave].type_name, func_names[ev->func], (ev->start - t0) * scale / 1000.0, ev->clocks * scale / 1000.0,
+        shm->master_index, ev->slave, (unsigned long long)ev->cycle);
+  }
+
+  free(shm);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int opt, i, found, first = 1;
+  const char *command;
+  FILE *out = stdout;
+  perf_opts_t opts = {
+      .master_index = -1,
+      .top = 10,
+      .cycles = 100,
+  };
+
+  while ((opt = getopt(argc, argv, "m:Hw:n:c:o:h")) != -1) {
+    switch (opt) {
+      case 'm':
+        opts.master_index = atoi(optarg);
+        break;
+      case 'H':
+        opts.histograms = 1;
+        break;
+      case 'w':
+        opts.interval = atoi(optarg);
+        break;
+      case 'n':
+        opts.top = atoi(optarg);
+        break;
+      case 'c':
+        opts.cycles = atoi(optarg);
+        break;
+      case 'o':
+        opts.output = optarg;
+        break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (optind >= argc) {
+    usage();
+    return 1;
+  }
+  command = argv[optind];
+  if (strcmp(command, "timing") != 0 && strcmp(command, "top") != 0 && strcmp(command, "trace") != 0 && strcmp(command, "image") != 0 &&
+      strcmp(command, "record") != 0 && strcmp(command, "decode") != 0) {
+    usage();
+    return 1;
+  }
+
+  if ((strcmp(command, "record") == 0 || strcmp(command, "decode") == 0) && opts.output != NULL &&
+      (out = fopen(opts.output, strcmp(command, "record") == 0 ? "wb" : "w")) == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, opts.output);
+    return 1;
+  }
+
+  // decoding a saved recording doesn't need a running lcec
+  if (strcmp(command, "decode") == 0) {
+    if (optind + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    found = (decode_recording(argv[optind + 1], out) == 0);
+    if (out != stdout) fclose(out);
+    return found ? 0 : 1;
+  }
+
+  hal_comp_id = hal_init(modname);
+  if (hal_comp_id < 1) {
+    fprintf(stderr, "%s: ERROR: hal_init failed\n", modname);
+    return 1;
+  }
+  hal_ready(hal_comp_id);
+
+  if (strcmp(command, "trace") == 0) {
+    if (opts.output != NULL && (out = fopen(opts.output, "w")) == NULL) {
+      fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, opts.output);
+      hal_exit(hal_comp_id);
+      return 1;
+    }
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    found = 0;
+    for (i = 0; i < MAX_MASTERS; i++) {
+      if (opts.master_index >= 0 && i != opts.master_index) continue;
+      if (write_trace(i, &opts, out, &first) == 0) found++;
+    }
+    fprintf(out, "\n]}\n");
+    if (out != stdout) fclose(out);
+    if (!found) {
+      fprintf(stderr, "%s: no profile data found; is lcec loaded?\n", modname);
+    }
+    hal_exit(hal_comp_id);
+    return found ? 0 : 1;
+  }
+
+  if (strcmp(command, "record") == 0) {
+    // a recording holds a single master, the first one found
+    found = 0;
+    for (i = 0; i < MAX_MASTERS && !found; i++) {
+      if (opts.master_index >= 0 && i != opts.master_index) continue;
+      if (save_recording(i, out) == 0) found++;
+    }
+    if (out != stdout) fclose(out);
+    if (!found) {
+      fprintf(stderr, "%s: no recorder data found; is lcec loaded with recorderCycles set?\n", modname);
+    }
+    hal_exit(hal_comp_id);
+    return found ? 0 : 1;
+  }
+
+  do {
+    found = 0;
+    for (i = 0; i < MAX_MASTERS; i++) {
+      if (opts.master_index >= 0 && i != opts.master_index) continue;
+      if (strcmp(command, "timing") == 0) {
+        if (print_timing(i, &opts) == 0) found++;
+      } else if (strcmp(command, "image") == 0) {
+        if (print_image(i) == 0) found++;
+      } else {
+        if (print_top(i, &opts) == 0) found++;
+      }
+    }
+    if (!found) {
+      fprintf(stderr, "%s: no %s data found; is lcec loaded?\n", modname, strcmp(command, "top") == 0 ? "profile" : command);
+    }
+    if (opts.interval > 0) {
+      printf("\n");
+      fflush(stdout);
+      sleep(opts.interval);
+    }
+  } while (opts.interval > 0);
+
+  hal_exit(hal_comp_id);
+  return found ? 0 : 1;
+}
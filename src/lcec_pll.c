@@ -0,0 +1,79 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Master thread PLL controller
+
+#include "lcec_pll.h"
+
+/// @brief Set the default PLL tuning for a thread period.
+///
+/// The defaults keep the original bang-bang controller, with a step
+/// of 0.1% of the period.  The PI gains place both closed loop poles
+/// at 0.9, which settles in a few dozen cycles.
+void lcec_pll_init_params(lcec_pll_params_t *params, uint32_t period) {
+  params->mode = LCEC_PLL_BANGBANG;
+  params->step = period / 1000;
+  params->p_gain = 0.2;
+  params->i_gain = 0.01;
+  params->ff = 0;
+  params->i_limit = period / 100;
+  params->lock_window = period / 200;
+  params->lock_cycles = 100;
+}
+
+/// @brief Reset the PLL, for instance after the master time was resynced.
+void lcec_pll_reset(lcec_pll_t *pll) {
+  pll->integrator = 0.0;
+  pll->lock_count = 0;
+  pll->locked = 0;
+}
+
+/// @brief Run one PLL cycle.
+///
+/// `err` is the application time minus the reference clock time, in
+/// ns.  Returns the period correction in ns.
+int32_t lcec_pll_update(lcec_pll_t *pll, const lcec_pll_params_t *params, int32_t err) {
+  uint32_t abs_err = (err < 0) ? -(uint32_t)err : (uint32_t)err;
+  double limit, out;
+
+  // lock detection
+  if (abs_err <= params->lock_window) {
+    if (pll->lock_count < params->lock_cycles) {
+      pll->lock_count++;
+    }
+  } else {
+    pll->lock_count = 0;
+  }
+  pll->locked = (abs_err <= params->lock_window && pll->lock_count >= params->lock_cycles);
+
+  if (params->mode != LCEC_PLL_PI) {
+    pll->integrator = 0.0;
+    return (err < 0) ? -(int32_t)params->step : (int32_t)params->step;
+  }
+
+  // integrate, clamping the integrator to avoid windup
+  limit = params->i_limit;
+  pll->integrator += params->i_gain * err;
+  if (pll->integrator > limit) {
+    pll->integrator = limit;
+  } else if (pll->integrator < -limit) {
+    pll->integrator = -limit;
+  }
+
+  out = params->ff + params->p_gain * err + pll->integrator;
+  return (int32_t)((out < 0.0) ? out - 0.5 : out + 0.5);
+}
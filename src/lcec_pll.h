@@ -0,0 +1,62 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Master thread PLL controller
+///
+/// With `refClockSyncCycles` < 0, the master's HAL thread follows the
+/// EtherCAT reference clock instead of the other way around.  Every
+/// cycle, the difference between the application time and the
+/// reference clock is fed into a controller whose output is passed to
+/// `rtapi_task_pll_set_correction()`.  The controller itself doesn't
+/// depend on RTAPI, so it can be tested in simulation.
+
+#ifndef _LCEC_PLL_H_
+#define _LCEC_PLL_H_
+
+#include "hal.h"
+#include "lcec_rtapi.h"
+
+/// @brief PLL controller types.
+typedef enum {
+  LCEC_PLL_BANGBANG = 0,  ///< Always correct by +/- `step`.
+  LCEC_PLL_PI = 1,        ///< Proportional-integral controller with feed-forward.
+} lcec_pll_mode_t;
+
+/// @brief PLL tuning, exported as HAL params.
+typedef struct {
+  hal_u32_t mode;         ///< A `lcec_pll_mode_t`.
+  hal_u32_t step;         ///< Bang-bang correction, in ns.
+  hal_float_t p_gain;     ///< PI proportional gain.
+  hal_float_t i_gain;     ///< PI integral gain.
+  hal_s32_t ff;           ///< PI feed-forward correction, in ns.
+  hal_u32_t i_limit;      ///< PI integrator limit, in ns.
+  hal_u32_t lock_window;  ///< Largest error that counts as locked, in ns.
+  hal_u32_t lock_cycles;  ///< Cycles the error has to stay within `lock_window` before the PLL is locked.
+} lcec_pll_params_t;
+
+/// @brief PLL controller state.
+typedef struct {
+  double integrator;    ///< PI integrator, in ns.
+  uint32_t lock_count;  ///< Consecutive cycles within `lock_window`, up to `lock_cycles`.
+  int locked;           ///< True if the PLL is locked.
+} lcec_pll_t;
+
+void lcec_pll_init_params(lcec_pll_params_t *params, uint32_t period);
+void lcec_pll_reset(lcec_pll_t *pll);
+int32_t lcec_pll_update(lcec_pll_t *pll, const lcec_pll_params_t *params, int32_t err);
+
+#endif
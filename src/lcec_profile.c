@@ -0,0 +1,177 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Per-slave driver execution time profiler
+
+#include "lcec_profile.h"
+
+#include "lcec.h"
+
+extern int lcec_comp_id;
+
+/// @brief Clear all per-slave statistics and the trace ring.
+void lcec_profile_reset_stats(lcec_profile_shm_t *shm) {
+  lcec_profile_slave_t *slaves = lcec_profile_slaves(shm);
+  int i, j;
+
+  shm->cycles = 0;
+  shm->trace_head = 0;
+  for (i = 0; i < shm->slave_count; i++) {
+    memset(slaves[i].stats, 0, sizeof(slaves[i].stats));
+    for (j = 0; j < LCEC_PROFILE_FUNCS; j++) {
+      slaves[i].stats[j].min = 0xffffffff;
+    }
+  }
+}
+
+/// @brief Set up the profiler for a master.
+///
+/// Creates the shared memory block and exports
+/// `lcec.<master>.profile.enable` and `lcec.<master>.profile.reset`.
+int lcec_profile_init(lcec_master_t *master) {
+  lcec_profile_t *profile;
+  lcec_profile_shm_t *shm;
+  lcec_profile_slave_t *slaves;
+  lcec_slave_t *slave;
+  void *shmem_ptr;
+  int slave_count = 0;
+  size_t size;
+
+  if ((profile = LCEC_HAL_ALLOCATE(lcec_profile_t)) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "hal_malloc() for master %s profile failed\n", master->name);
+    return -EIO;
+  }
+  if (lcec_pin_newf(HAL_BIT, HAL_IN, (void **)&profile->enable, "%s.%s.profile.enable", LCEC_MODULE_NAME, master->name) != 0) {
+    return -EIO;
+  }
+  if (lcec_pin_newf(HAL_BIT, HAL_IN, (void **)&profile->reset, "%s.%s.profile.reset", LCEC_MODULE_NAME, master->name) != 0) {
+    return -EIO;
+  }
+
+  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+    slave->profile_idx = slave_count++;
+  }
+
+  size = lcec_profile_shm_size(slave_count);
+  profile->shmem_id = rtapi_shmem_new(LCEC_PROFILE_SHMEM_KEY + master->index, lcec_comp_id, size);
+  if (profile->shmem_id < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to create profile shmem for master %s\n", master->name);
+    return -EIO;
+  }
+  if (lcec_rtapi_shmem_getptr(profile->shmem_id, &shmem_ptr) < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to get profile shmem pointer for master %s\n", master->name);
+    rtapi_shmem_delete(profile->shmem_id, lcec_comp_id);
+    return -EIO;
+  }
+
+  shm = (lcec_profile_shm_t *)shmem_ptr;
+  memset(shm, 0, size);
+  shm->size = size;
+  shm->master_index = master->index;
+  strncpy(shm->master_name, master->name, LCEC_CONF_STR_MAXLEN - 1);
+  shm->slave_count = slave_count;
+
+  slaves = lcec_profile_slaves(shm);
+  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+    slaves[slave->profile_idx].index = slave->index;
+    strncpy(slaves[slave->profile_idx].name, slave->name, LCEC_CONF_STR_MAXLEN - 1);
+    strncpy(slaves[slave->profile_idx].type_name, slave->type_name, LCEC_CONF_STR_MAXLEN - 1);
+  }
+  lcec_profile_reset_stats(shm);
+  lcec_barrier();
+  shm->magic = LCEC_PROFILE_SHMEM_MAGIC;
+
+  profile->shm = shm;
+  master->profile = profile;
+  return 0;
+}
+
+/// @brief Release the profile shared memory for a master.
+void lcec_profile_cleanup(lcec_master_t *master) {
+  lcec_profile_t *profile = master->profile;
+
+  if (profile == NULL) {
+    return;
+  }
+
+  profile->shm->magic = 0;
+  rtapi_shmem_delete(profile->shmem_id, lcec_comp_id);
+  master->profile = NULL;
+}
+
+/// @brief Latch the enable pin for this cycle.
+///
+/// Called once per cycle, at the start of `lcec_read_master()`.  The
+/// result is kept in `profile->active` so that a cycle's read and
+/// write are either both profiled or both skipped.
+void lcec_profile_begin(lcec_profile_t *profile) {
+  lcec_profile_shm_t *shm = profile->shm;
+  long long clocks, now;
+
+  profile->active = *(profile->enable);
+
+  if (*(profile->reset)) {
+    shm->seq++;
+    lcec_barrier();
+    lcec_profile_reset_stats(shm);
+    lcec_barrier();
+    shm->seq++;
+  }
+
+  if (!profile->active) {
+    shm->enabled = 0;
+    return;
+  }
+
+  clocks = rtapi_get_clocks();
+  now = rtapi_get_time();
+  if (!shm->enabled) {
+    shm->cal_clocks_start = clocks;
+    shm->cal_time_start = now;
+    shm->enabled = 1;
+  }
+  shm->cal_clocks_last = clocks;
+  shm->cal_time_last = now;
+  shm->cycles++;
+}
+
+/// @brief Record one profiled slave callback that started at `start` clocks.
+void lcec_profile_record(lcec_profile_t *profile, lcec_slave_t *slave, lcec_profile_func_t func, long long start) {
+  lcec_profile_shm_t *shm = profile->shm;
+  uint32_t clocks = (uint32_t)(rtapi_get_clocks() - start);
+  lcec_timing_stat_t *stat = &lcec_profile_slaves(shm)[slave->profile_idx].stats[func];
+  lcec_profile_event_t *event = &lcec_profile_events(shm)[shm->trace_head & (LCEC_PROFILE_TRACE_EVENTS - 1)];
+
+  shm->seq++;
+  lcec_barrier();
+  stat->last = clocks;
+  if (clocks < stat->min) stat->min = clocks;
+  if (clocks > stat->max) stat->max = clocks;
+  stat->hist[lcec_timing_bucket(clocks)]++;
+  stat->sum += clocks;
+  stat->count++;
+  lcec_barrier();
+  shm->seq++;
+
+  event->cycle = shm->cycles;
+  event->start = start;
+  event->clocks = clocks;
+  event->slave = slave->profile_idx;
+  event->func = func;
+  lcec_barrier();
+  shm->trace_head++;
+}
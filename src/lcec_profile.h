@@ -0,0 +1,119 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Per-slave driver execution time profiler
+///
+/// When `lcec.<master>.profile.enable` is true, every call to a
+/// slave's `proc_read` and `proc_write` is timed with
+/// `rtapi_get_clocks()`.  Results are accumulated per slave and
+/// recorded into a trace ring, both living in a per-master shared
+/// memory block that `lcec_perf top` and `lcec_perf trace` read.
+///
+/// When profiling is disabled the only realtime cost is one
+/// predictable branch per slave callback.
+
+#ifndef _LCEC_PROFILE_H_
+#define _LCEC_PROFILE_H_
+
+#include "hal.h"
+#include "lcec_conf.h"
+#include "lcec_rtapi.h"
+#include "lcec_timing.h"
+
+#define LCEC_PROFILE_SHMEM_KEY    0xACB57500  ///< Base shared memory key, the master index is added to this.
+#define LCEC_PROFILE_SHMEM_MAGIC  0x9F0F1E01  ///< Magic number, changes whenever the shared memory layout changes.
+#define LCEC_PROFILE_TRACE_EVENTS 16384       ///< Number of events in the trace ring.  Must be a power of 2.
+
+/// @brief Which slave callback an event or statistic belongs to.
+typedef enum {
+  LCEC_PROFILE_READ,   ///< `proc_read`.
+  LCEC_PROFILE_WRITE,  ///< `proc_write`.
+  LCEC_PROFILE_FUNCS,
+} lcec_profile_func_t;
+
+/// @brief Per-slave profile data in shared memory.
+typedef struct {
+  int index;                                    ///< Slave index on the bus.
+  char name[LCEC_CONF_STR_MAXLEN];              ///< Slave name.
+  char type_name[LCEC_CONF_STR_MAXLEN];         ///< Device type name.
+  lcec_timing_stat_t stats[LCEC_PROFILE_FUNCS];  ///< Call statistics, in clocks.
+} lcec_profile_slave_t;
+
+/// @brief One call in the trace ring.
+typedef struct {
+  uint64_t cycle;    ///< Cycle number.
+  int64_t start;     ///< `rtapi_get_clocks()` at the start of the call.
+  uint32_t clocks;   ///< Duration, in clocks.
+  uint16_t slave;    ///< Slave position in `lcec_profile_shm_t.slaves`.
+  uint16_t func;     ///< `lcec_profile_func_t`.
+} lcec_profile_event_t;
+
+/// @brief Header of the per-master profile shared memory block.
+///
+/// The header is followed by `slave_count` `lcec_profile_slave_t`s
+/// and `LCEC_PROFILE_TRACE_EVENTS` `lcec_profile_event_t`s; use
+/// `lcec_profile_slaves()` and `lcec_profile_events()` to find them.
+///
+/// Statistics are protected by `seq` in the same way as
+/// `lcec_timing_shm_t`.  Trace events are written to
+/// `events[trace_head % LCEC_PROFILE_TRACE_EVENTS]`, and `trace_head`
+/// is incremented afterwards.
+typedef struct {
+  uint32_t magic;                          ///< `LCEC_PROFILE_SHMEM_MAGIC` once initialized.
+  uint32_t size;                           ///< Total size of the shared memory block.
+  volatile uint32_t seq;                   ///< Sequence counter, odd while statistics are updated.
+  int master_index;                        ///< Index of the master.
+  char master_name[LCEC_CONF_STR_MAXLEN];  ///< Name of the master.
+  int slave_count;                         ///< Number of `lcec_profile_slave_t`s.
+  volatile int enabled;                    ///< True while profiling is on.
+  uint64_t cycles;                         ///< Number of profiled cycles since the last reset.
+  int64_t cal_clocks_start;                ///< `rtapi_get_clocks()` when profiling was enabled.
+  int64_t cal_time_start;                  ///< `rtapi_get_time()` when profiling was enabled.
+  int64_t cal_clocks_last;                 ///< `rtapi_get_clocks()` at the most recent cycle.
+  int64_t cal_time_last;                   ///< `rtapi_get_time()` at the most recent cycle.
+  volatile uint64_t trace_head;            ///< Number of trace events ever written.
+} lcec_profile_shm_t;
+
+/// @brief Realtime-side profiler state for a single master.
+typedef struct {
+  lcec_profile_shm_t *shm;  ///< Shared memory block.
+  int shmem_id;             ///< RTAPI shared memory ID.
+  hal_bit_t *enable;        ///< HAL pin; profile while true.
+  hal_bit_t *reset;         ///< HAL pin; reset statistics when true.
+  int active;               ///< Profiling state for the current cycle.
+} lcec_profile_t;
+
+static inline lcec_profile_slave_t *lcec_profile_slaves(lcec_profile_shm_t *shm) { return (lcec_profile_slave_t *)(shm + 1); }
+
+static inline lcec_profile_event_t *lcec_profile_events(lcec_profile_shm_t *shm) {
+  return (lcec_profile_event_t *)(lcec_profile_slaves(shm) + shm->slave_count);
+}
+
+static inline size_t lcec_profile_shm_size(int slave_count) {
+  return sizeof(lcec_profile_shm_t) + slave_count * sizeof(lcec_profile_slave_t) + LCEC_PROFILE_TRACE_EVENTS * sizeof(lcec_profile_event_t);
+}
+
+struct lcec_master;
+struct lcec_slave;
+
+int lcec_profile_init(struct lcec_master *master);
+void lcec_profile_cleanup(struct lcec_master *master);
+void lcec_profile_begin(lcec_profile_t *profile);
+void lcec_profile_record(lcec_profile_t *profile, struct lcec_slave *slave, lcec_profile_func_t func, long long start);
+void lcec_profile_reset_stats(lcec_profile_shm_t *shm);
+
+#endif
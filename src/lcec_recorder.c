@@ -0,0 +1,460 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Process data flight recorder
+
+#include "lcec_recorder.h"
+
+#include "lcec.h"
+
+extern int lcec_comp_id;
+
+/// @brief Clear a recorder block and fill in its layout.
+///
+/// The block must be `lcec_recorder_shm_size()` bytes long, for a
+/// `record_len` that is the sum of the range lengths.
+void lcec_recorder_shm_init(lcec_recorder_shm_t *shm, uint32_t depth, const lcec_recorder_range_t *ranges, uint32_t range_count,
+    uint32_t pdo_count) {
+  uint32_t record_len = 0;
+  uint32_t i;
+
+  for (i = 0; i < range_count; i++) {
+    record_len += ranges[i].length;
+  }
+
+  memset(shm, 0, lcec_recorder_shm_size(depth, record_len, pdo_count));
+  shm->size = lcec_recorder_shm_size(depth, record_len, pdo_count);
+  shm->depth = depth;
+  shm->record_len = record_len;
+  shm->range_count = range_count;
+  memcpy(shm->ranges, ranges, range_count * sizeof(lcec_recorder_range_t));
+  shm->pdo_count = pdo_count;
+}
+
+/// @brief Find the size of a PDO entry in a slave's sync manager configuration.
+///
+/// Returns 0 if the slave has no configuration or doesn't map the entry.
+static uint8_t lcec_recorder_bit_length(const lcec_slave_t *slave, uint16_t index, uint8_t subindex) {
+  const ec_sync_info_t *sync;
+  unsigned int p, e;
+
+  if (slave->sync_info == NULL) {
+    return 0;
+  }
+
+  for (sync = slave->sync_info; sync->index != 0xff; sync++) {
+    for (p = 0; p < sync->n_pdos; p++) {
+      for (e = 0; e < sync->pdos[p].n_entries; e++) {
+        const ec_pdo_entry_info_t *entry = &sync->pdos[p].entries[e];
+        if (entry->index == index && entry->subindex == subindex) {
+          return entry->bit_length;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+/// @brief Fill in sizes that weren't found in the slaves' PDO mappings.
+///
+/// An entry that doesn't start on a byte boundary, or shares its byte
+/// with entries further along, is taken to be a single bit.  Anything
+/// else is assumed to run up to the next entry, but at most 64 bits.
+void lcec_recorder_guess_lengths(lcec_recorder_pdo_t *pdos, uint32_t pdo_count) {
+  uint32_t i, j, gap;
+
+  for (i = 0; i < pdo_count; i++) {
+    if (pdos[i].bit_length != 0) {
+      continue;
+    }
+    if (pdos[i].bit_position != 0) {
+      pdos[i].bit_length = 1;
+      continue;
+    }
+
+    gap = 8;
+    for (j = 0; j < pdo_count; j++) {
+      if (pdos[j].offset == pdos[i].offset && pdos[j].bit_position > 0) {
+        gap = 0;
+        break;
+      }
+      if (pdos[j].offset > pdos[i].offset && pdos[j].offset - pdos[i].offset < gap) {
+        gap = pdos[j].offset - pdos[i].offset;
+      }
+    }
+    pdos[i].bit_length = (gap == 0) ? 1 : gap * 8;
+  }
+}
+
+/// @brief Set up the flight recorder for a master.
+///
+/// Does nothing unless `recorderCycles` is set.  Must be called after
+/// `lcec_domain_activate()`, once PDO offsets are final.
+int lcec_recorder_init(lcec_master_t *master) {
+  lcec_recorder_t *recorder;
+  lcec_recorder_range_t all;
+  const lcec_recorder_range_t *ranges;
+  lcec_recorder_pdo_t *pdo;
+  lcec_slave_t *slave;
+  void *shmem_ptr;
+  uint32_t range_count, record_len, pdo_count, i;
+  size_t size;
+  int j;
+
+  if (master->recorder_cycles <= 0) {
+    return 0;
+  }
+
+  // no ranges records everything
+  ranges = master->recorder_ranges;
+  range_count = master->recorder_range_count;
+  if (range_count == 0) {
+    all.offset = 0;
+    all.length = master->process_data_len;
+    ranges = &all;
+    range_count = 1;
+  }
+  record_len = 0;
+  for (i = 0; i < range_count; i++) {
+    if (ranges[i].offset > (uint32_t)master->process_data_len || ranges[i].length > master->process_data_len - ranges[i].offset) {
+      rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "recorder range %u:%u is outside the %d bytes of process data of master %s\n",
+          ranges[i].offset, ranges[i].length, master->process_data_len, master->name);
+      return -EINVAL;
+    }
+    record_len += ranges[i].length;
+  }
+
+  pdo_count = 0;
+  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+    if (slave->regs != NULL) {
+      pdo_count += slave->regs->current;
+    }
+  }
+
+  if ((recorder = LCEC_HAL_ALLOCATE(lcec_recorder_t)) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "hal_malloc() for master %s flight recorder failed\n", master->name);
+    return -EIO;
+  }
+  if (lcec_pin_newf(HAL_BIT, HAL_IN, (void **)&recorder->trigger, "%s.%s.recorder.trigger", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_pin_newf(HAL_BIT, HAL_IN, (void **)&recorder->rearm, "%s.%s.recorder.rearm", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_pin_newf(HAL_BIT, HAL_OUT, (void **)&recorder->frozen, "%s.%s.recorder.frozen", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_param_newf(HAL_U32, HAL_RW, (void *)&recorder->post_trigger, "%s.%s.recorder.post-trigger", LCEC_MODULE_NAME, master->name) !=
+          0) {
+    return -EIO;
+  }
+  recorder->post_trigger = master->recorder_cycles / 2;
+
+  size = lcec_recorder_shm_size(master->recorder_cycles, record_len, pdo_count);
+  recorder->shmem_id = rtapi_shmem_new(LCEC_RECORDER_SHMEM_KEY + master->index, lcec_comp_id, size);
+  if (recorder->shmem_id < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to create flight recorder shmem for master %s\n", master->name);
+    return -EIO;
+  }
+  if (lcec_rtapi_shmem_getptr(recorder->shmem_id, &shmem_ptr) < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to get flight recorder shmem pointer for master %s\n", master->name);
+    rtapi_shmem_delete(recorder->shmem_id, lcec_comp_id);
+    return -EIO;
+  }
+
+  recorder->shm = (lcec_recorder_shm_t *)shmem_ptr;
+  lcec_recorder_shm_init(recorder->shm, master->recorder_cycles, ranges, range_count, pdo_count);
+  recorder->shm->master_index = master->index;
+  strncpy(recorder->shm->master_name, master->name, LCEC_CONF_STR_MAXLEN - 1);
+  recorder->shm->app_time_period = master->app_time_period;
+  recorder->shm->data_len = master->process_data_len;
+
+  // describe every registered PDO entry, for decoding
+  pdo = lcec_recorder_pdos(recorder->shm);
+  for (slave = master->first_slave; slave != NULL; slave = slave->next) {
+    if (slave->regs == NULL) {
+      continue;
+    }
+    for (j = 0; j < slave->regs->current; j++, pdo++) {
+      const ec_pdo_entry_reg_t *reg = &slave->regs->pdo_entry_regs[j];
+      strncpy(pdo->slave, slave->name, LCEC_CONF_STR_MAXLEN - 1);
+      pdo->position = slave->index;
+      pdo->index = reg->index;
+      pdo->subindex = reg->subindex;
+      pdo->offset = *(reg->offset);
+      pdo->bit_position = (reg->bit_position != NULL) ? *(reg->bit_position) : 0;
+      pdo->bit_length = lcec_recorder_bit_length(slave, reg->index, reg->subindex);
+    }
+  }
+  lcec_recorder_guess_lengths(lcec_recorder_pdos(recorder->shm), pdo_count);
+
+  lcec_barrier();
+  recorder->shm->magic = LCEC_RECORDER_SHMEM_MAGIC;
+
+  master->recorder = recorder;
+  return 0;
+}
+
+/// @brief Release the flight recorder shared memory for a master.
+void lcec_recorder_cleanup(lcec_master_t *master) {
+  lcec_recorder_t *recorder = master->recorder;
+
+  if (recorder == NULL) {
+    return;
+  }
+
+  recorder->shm->magic = 0;
+  rtapi_shmem_delete(recorder->shmem_id, lcec_comp_id);
+  master->recorder = NULL;
+}
+
+/// @brief Record this cycle's process data, and handle the trigger.
+///
+/// Called once per cycle, right after `lcec_image_update()`.  Once the
+/// ring is frozen, nothing is copied until `recorder.rearm` is set.
+void lcec_recorder_update(lcec_master_t *master) {
+  lcec_recorder_t *recorder = master->recorder;
+  lcec_recorder_shm_t *shm;
+  lcec_domain_t *domain;
+  uint32_t valid;
+
+  if (recorder == NULL) {
+    return;
+  }
+  shm = recorder->shm;
+
+  if (*(recorder->rearm) && shm->frozen) {
+    shm->frozen = 0;
+    recorder->triggered = 0;
+  }
+
+  if (!shm->frozen) {
+    if (*(recorder->trigger) && !recorder->last_trigger && !recorder->triggered) {
+      recorder->triggered = 1;
+      recorder->remaining = recorder->post_trigger;
+      shm->trigger_cycle = master->time.cycle;
+    }
+
+    valid = 1;
+    for (domain = master->first_domain; domain != NULL; domain = domain->next) {
+      if (!domain->data_valid) {
+        valid = 0;
+      }
+    }
+    lcec_recorder_store(shm, master->time.cycle, master->time.receive, valid, master->process_data);
+
+    if (recorder->triggered) {
+      if (recorder->remaining == 0) {
+        shm->frozen = 1;
+        recorder->triggered = 0;
+      } else {
+        recorder->remaining--;
+      }
+    }
+  }
+
+  recorder->last_trigger = *(recorder->trigger);
+  *(recorder->frozen) = shm->frozen;
+}
+
+/// @brief Copy the recorded ranges of `data` into the next slot.
+///
+/// Only the realtime side may call this, and only from one thread at
+/// a time.  `data` is the whole process data.
+void lcec_recorder_store(lcec_recorder_shm_t *shm, uint64_t cycle, int64_t time, uint32_t valid, const uint8_t *data) {
+  lcec_recorder_record_t *record = lcec_recorder_record(shm, shm->next);
+  uint8_t *dst = (uint8_t *)(record + 1);
+  uint32_t i;
+
+  record->cycle = cycle;
+  record->time = time;
+  record->valid = valid;
+  for (i = 0; i < shm->range_count; i++) {
+    memcpy(dst, data + shm->ranges[i].offset, shm->ranges[i].length);
+    dst += shm->ranges[i].length;
+  }
+
+  lcec_barrier();
+  shm->head++;
+  shm->next = (shm->next + 1 < shm->depth) ? shm->next + 1 : 0;
+}
+
+/// @brief Open a master's flight recorder from userspace.
+///
+/// `comp_id` is the caller's HAL component.  Returns 0 on success,
+/// or -1 if the master doesn't exist or has no recorder.  Close the
+/// reader with `lcec_recorder_close()`.
+int lcec_recorder_open(lcec_recorder_reader_t *reader, int comp_id, int index) {
+  lcec_recorder_shm_t *shm;
+  void *shmem_ptr;
+  uint32_t size;
+  int shmem_id;
+
+  // open just the header to find the real size
+  shmem_id = rtapi_shmem_new(LCEC_RECORDER_SHMEM_KEY + index, comp_id, sizeof(lcec_recorder_shm_t));
+  if (shmem_id < 0) {
+    return -1;
+  }
+  if (lcec_rtapi_shmem_getptr(shmem_id, &shmem_ptr) < 0) {
+    rtapi_shmem_delete(shmem_id, comp_id);
+    return -1;
+  }
+  shm = (lcec_recorder_shm_t *)shmem_ptr;
+  size = shm->size;
+  if (shm->magic != LCEC_RECORDER_SHMEM_MAGIC) {
+    rtapi_shmem_delete(shmem_id, comp_id);
+    return -1;
+  }
+  rtapi_shmem_delete(shmem_id, comp_id);
+
+  shmem_id = rtapi_shmem_new(LCEC_RECORDER_SHMEM_KEY + index, comp_id, size);
+  if (shmem_id < 0) {
+    return -1;
+  }
+  if (lcec_rtapi_shmem_getptr(shmem_id, &shmem_ptr) < 0) {
+    rtapi_shmem_delete(shmem_id, comp_id);
+    return -1;
+  }
+
+  reader->shm = (const lcec_recorder_shm_t *)shmem_ptr;
+  reader->shmem_id = shmem_id;
+  reader->comp_id = comp_id;
+  return 0;
+}
+
+/// @brief Close a reader opened with `lcec_recorder_open()`.
+void lcec_recorder_close(lcec_recorder_reader_t *reader) {
+  rtapi_shmem_delete(reader->shmem_id, reader->comp_id);
+  reader->shm = NULL;
+}
+
+/// @brief Copy the records in a recorder block, oldest first.
+///
+/// For use by userspace readers; the realtime side keeps writing
+/// unless the ring is frozen.  `tmp` and `copy` must both be
+/// `shm->size` bytes long.  `copy` gets the header, the PDO table,
+/// and every record that was complete for the whole copy, with
+/// `depth` and `head` set to their number.  Returns the number of
+/// records, or 0 if there are none or the block isn't initialized.
+uint32_t lcec_recorder_snapshot(const lcec_recorder_shm_t *shm, lcec_recorder_shm_t *copy, lcec_recorder_shm_t *tmp) {
+  uint64_t before, after, first;
+  uint32_t count, slot, i;
+  size_t rsize;
+
+  if (shm->magic != LCEC_RECORDER_SHMEM_MAGIC) {
+    return 0;
+  }
+
+  before = shm->head;
+  lcec_barrier();
+  memcpy(tmp, (const void *)shm, shm->size);
+  lcec_barrier();
+  after = shm->head;
+  if (tmp->depth == 0) {
+    return 0;
+  }
+
+  // While recording, the slot after the newest record may be half
+  // written, and records written during the copy may have replaced
+  // the oldest ones.  A ring that stayed frozen can be used whole.
+  if (tmp->frozen && shm->frozen && after == before) {
+    first = (before > tmp->depth) ? before - tmp->depth : 0;
+  } else {
+    first = (after + 1 > tmp->depth) ? after + 1 - tmp->depth : 0;
+  }
+  count = (before > first) ? (uint32_t)(before - first) : 0;
+
+  rsize = lcec_recorder_record_size(tmp->record_len);
+  memcpy(copy, tmp, (char *)lcec_recorder_record(tmp, 0) - (char *)tmp);
+  copy->depth = count;
+  copy->head = count;
+  copy->next = 0;
+  copy->size = lcec_recorder_shm_size(count, tmp->record_len, tmp->pdo_count);
+
+  slot = (uint32_t)lcec_mod_64(first, tmp->depth);
+  for (i = 0; i < count; i++) {
+    memcpy(lcec_recorder_record(copy, i), lcec_recorder_record(tmp, slot), rsize);
+    slot = (slot + 1 < tmp->depth) ? slot + 1 : 0;
+  }
+
+  return count;
+}
+
+/// @brief Check that a recording read into memory is complete.
+///
+/// `len` is the number of bytes read.  Returns 0 if the block is a
+/// recording in the current format and its header matches its size,
+/// or -1 otherwise.
+int lcec_recorder_check(const lcec_recorder_shm_t *shm, size_t len) {
+  uint32_t i, record_len = 0;
+
+  if (len < sizeof(lcec_recorder_shm_t) || shm->magic != LCEC_RECORDER_SHMEM_MAGIC || shm->range_count > LCEC_RECORDER_RANGES) {
+    return -1;
+  }
+  for (i = 0; i < shm->range_count; i++) {
+    record_len += shm->ranges[i].length;
+  }
+  if (record_len != shm->record_len || shm->size != len || lcec_recorder_shm_size(shm->depth, shm->record_len, shm->pdo_count) != len) {
+    return -1;
+  }
+  return 0;
+}
+
+/// @brief Find where a PDO entry is kept in each record.
+///
+/// Sets `*pos` to the byte in a record's data that holds the first
+/// byte of the entry.  Returns 0 on success, or -1 if the entry isn't
+/// entirely inside one of the recorded ranges.
+int lcec_recorder_locate(const lcec_recorder_shm_t *shm, const lcec_recorder_pdo_t *pdo, uint32_t *pos) {
+  uint32_t bytes = (pdo->bit_position + pdo->bit_length + 7) / 8;
+  uint32_t start = 0, i;
+
+  for (i = 0; i < shm->range_count; i++) {
+    const lcec_recorder_range_t *range = &shm->ranges[i];
+    if (pdo->offset >= range->offset && pdo->offset - range->offset + bytes <= range->length) {
+      *pos = start + (pdo->offset - range->offset);
+      return 0;
+    }
+    start += range->length;
+  }
+
+  return -1;
+}
+
+/// @brief Decode a PDO entry from a record.
+///
+/// Values are little endian, as on the bus, and returned unsigned.
+/// Returns 0 on success, or -1 if the entry isn't in the recorded
+/// ranges or is too large to decode.
+int lcec_recorder_value(
+    const lcec_recorder_shm_t *shm, const lcec_recorder_record_t *record, const lcec_recorder_pdo_t *pdo, uint64_t *value) {
+  uint32_t bytes = (pdo->bit_position + pdo->bit_length + 7) / 8;
+  const uint8_t *p;
+  uint32_t pos;
+  uint64_t v;
+
+  if (pdo->bit_length == 0 || bytes > 8 || lcec_recorder_locate(shm, pdo, &pos) != 0) {
+    return -1;
+  }
+
+  p = (const uint8_t *)(record + 1) + pos;
+  v = 0;
+  while (bytes-- > 0) {
+    v = (v << 8) | p[bytes];
+  }
+  v >>= pdo->bit_position;
+  if (pdo->bit_length < 64) {
+    v &= ((uint64_t)1 << pdo->bit_length) - 1;
+  }
+  *value = v;
+  return 0;
+}
@@ -0,0 +1,152 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Process data flight recorder
+///
+/// When a master has `recorderCycles` set, the byte ranges of its
+/// process data given in `recorderRanges` (or all of it) are copied
+/// into a ring in shared memory after every send, together with the
+/// cycle number and time.  A rising edge on the
+/// `lcec.<master>.recorder.trigger` pin freezes the ring after
+/// `recorder.post-trigger` more cycles, so that it holds what was on
+/// the bus around a fault until `recorder.rearm` is set.
+///
+/// The block also holds a table of every PDO entry registered with
+/// `lcec_pdo_init()`, so that `lcec_perf record` can save the ring
+/// into a file and `lcec_perf decode` can turn it into CSV without
+/// the machine.  A saved file has the same layout as the shared
+/// memory block, with the records in order from oldest to newest.
+
+#ifndef _LCEC_RECORDER_H_
+#define _LCEC_RECORDER_H_
+
+#include "hal.h"
+#include "lcec_conf.h"
+#include "lcec_rtapi.h"
+
+#define LCEC_RECORDER_SHMEM_KEY   0xACB57800                ///< Base shared memory key, the master index is added to this.
+#define LCEC_RECORDER_SHMEM_MAGIC 0x5EC0DE02                ///< Magic number, changes whenever the shared memory layout changes.
+#define LCEC_RECORDER_RANGES      LCEC_CONF_RECORDER_RANGES  ///< Maximum number of byte ranges per master.
+
+/// @brief A range of bytes in the process data.
+typedef struct {
+  uint32_t offset;  ///< Offset from the start of `master->process_data`.
+  uint32_t length;  ///< Number of bytes.
+} lcec_recorder_range_t;
+
+/// @brief A registered PDO entry, for decoding records.
+typedef struct {
+  char slave[LCEC_CONF_STR_MAXLEN];  ///< Name of the slave.
+  uint16_t position;                 ///< Position of the slave on the bus, its `idx`.
+  uint16_t index;                    ///< PDO entry index.
+  uint8_t subindex;                  ///< PDO entry subindex.
+  uint8_t bit_length;                ///< Size in bits; guessed from the next entry if the slave's PDO mapping isn't known.
+  uint16_t reserved;                 ///< Padding.
+  uint32_t offset;                   ///< Byte offset in the process data.
+  uint32_t bit_position;             ///< Bit offset within that byte.
+} lcec_recorder_pdo_t;
+
+/// @brief Header of a single record, followed by `record_len` bytes of data.
+typedef struct {
+  uint64_t cycle;     ///< Cycle number, as in `lcec_time_t`.
+  int64_t time;       ///< `rtapi_get_time()` when this cycle's frame was received.
+  uint32_t valid;     ///< True if every domain's last exchange was complete.
+  uint32_t reserved;  ///< Padding.
+} lcec_recorder_record_t;
+
+/// @brief Header of the per-master recorder shared memory block.
+///
+/// The header is followed by `pdo_count` `lcec_recorder_pdo_t`s and
+/// `depth` records; use `lcec_recorder_pdos()` and
+/// `lcec_recorder_record()` to find them.  Record `n` is written to
+/// slot `n % depth`, and `head` is incremented afterwards.
+typedef struct {
+  uint32_t magic;                                      ///< `LCEC_RECORDER_SHMEM_MAGIC` once initialized.
+  uint32_t size;                                       ///< Total size of the block.
+  int master_index;                                    ///< Index of the master.
+  char master_name[LCEC_CONF_STR_MAXLEN];              ///< Name of the master.
+  uint32_t app_time_period;                            ///< Configured `appTimePeriod`, in ns.
+  uint32_t data_len;                                   ///< Size of the whole process data, in bytes.
+  uint32_t depth;                                      ///< Number of records in the ring.
+  uint32_t record_len;                                 ///< Bytes of process data per record, the sum of all range lengths.
+  uint32_t range_count;                                ///< Number of ranges.
+  lcec_recorder_range_t ranges[LCEC_RECORDER_RANGES];  ///< Recorded parts of the process data, in record order.
+  uint32_t pdo_count;                                  ///< Number of `lcec_recorder_pdo_t`s.
+  uint32_t next;                                       ///< Slot written next.
+  volatile uint32_t frozen;                            ///< True once the ring has stopped after a trigger.
+  uint32_t reserved;                                   ///< Padding.
+  volatile uint64_t head;                              ///< Number of records ever written.
+  uint64_t trigger_cycle;                              ///< Cycle of the last trigger, or 0.
+} lcec_recorder_shm_t;
+
+/// @brief Realtime-side recorder state for a single master.
+typedef struct {
+  lcec_recorder_shm_t *shm;  ///< Shared memory block.
+  int shmem_id;              ///< RTAPI shared memory ID.
+  hal_bit_t *trigger;        ///< HAL pin; freeze the ring on a rising edge.
+  hal_bit_t *rearm;          ///< HAL pin; start recording again when true.
+  hal_bit_t *frozen;         ///< HAL pin; true while the ring is frozen.
+  hal_u32_t post_trigger;    ///< HAL param; cycles to record after the trigger.
+  int last_trigger;          ///< `trigger` in the previous cycle.
+  int triggered;             ///< Set from the trigger until the ring is frozen.
+  uint32_t remaining;        ///< Cycles left to record before freezing.
+} lcec_recorder_t;
+
+/// @brief A userspace reader's view of a master's recorder.
+typedef struct {
+  const lcec_recorder_shm_t *shm;  ///< Shared memory block.
+  int shmem_id;                    ///< RTAPI shared memory ID.
+  int comp_id;                     ///< HAL component the block was opened with.
+} lcec_recorder_reader_t;
+
+/// @brief Size of a record, rounded up so that the next one is aligned.
+static inline size_t lcec_recorder_record_size(uint32_t record_len) {
+  return (sizeof(lcec_recorder_record_t) + record_len + 7) & ~(size_t)7;
+}
+
+/// @brief Total size of a recorder block.
+static inline size_t lcec_recorder_shm_size(uint32_t depth, uint32_t record_len, uint32_t pdo_count) {
+  return sizeof(lcec_recorder_shm_t) + ((pdo_count * sizeof(lcec_recorder_pdo_t) + 7) & ~(size_t)7) +
+         depth * lcec_recorder_record_size(record_len);
+}
+
+static inline lcec_recorder_pdo_t *lcec_recorder_pdos(const lcec_recorder_shm_t *shm) { return (lcec_recorder_pdo_t *)(shm + 1); }
+
+/// @brief Get the record in slot `slot`.
+static inline lcec_recorder_record_t *lcec_recorder_record(const lcec_recorder_shm_t *shm, uint32_t slot) {
+  return (lcec_recorder_record_t *)((char *)lcec_recorder_pdos(shm) + ((shm->pdo_count * sizeof(lcec_recorder_pdo_t) + 7) & ~(size_t)7) +
+                                    slot * lcec_recorder_record_size(shm->record_len));
+}
+
+struct lcec_master;
+
+int lcec_recorder_init(struct lcec_master *master);
+void lcec_recorder_cleanup(struct lcec_master *master);
+void lcec_recorder_update(struct lcec_master *master);
+void lcec_recorder_shm_init(lcec_recorder_shm_t *shm, uint32_t depth, const lcec_recorder_range_t *ranges, uint32_t range_count,
+    uint32_t pdo_count);
+void lcec_recorder_guess_lengths(lcec_recorder_pdo_t *pdos, uint32_t pdo_count);
+void lcec_recorder_store(lcec_recorder_shm_t *shm, uint64_t cycle, int64_t time, uint32_t valid, const uint8_t *data);
+int lcec_recorder_open(lcec_recorder_reader_t *reader, int comp_id, int index);
+void lcec_recorder_close(lcec_recorder_reader_t *reader);
+uint32_t lcec_recorder_snapshot(const lcec_recorder_shm_t *shm, lcec_recorder_shm_t *copy, lcec_recorder_shm_t *tmp);
+int lcec_recorder_check(const lcec_recorder_shm_t *shm, size_t len);
+int lcec_recorder_locate(const lcec_recorder_shm_t *shm, const lcec_recorder_pdo_t *pdo, uint32_t *pos);
+int lcec_recorder_value(
+    const lcec_recorder_shm_t *shm, const lcec_recorder_record_t *record, const lcec_recorder_pdo_t *pdo, uint64_t *value);
+
+#endif
@@ -43,4 +43,10 @@ static inline long long lcec_mod_64(long long val, unsigned long div) {
   return rem;
 }
 
+#define lcec_div_u64(val, div) div_u64(val, div)
+
+#define lcec_barrier() smp_mb()
+
+#define lcec_cpu_relax() cpu_relax()
+
 #endif
@@ -46,5 +46,16 @@ static inline long lcec_get_ticks(void) {
 #define lcec_schedule() sched_yield()
 
 static inline long long lcec_mod_64(long long val, unsigned long div) { return val % div; }
+static inline uint64_t lcec_div_u64(uint64_t val, uint32_t div) { return val / div; }
+
+#define lcec_barrier() __sync_synchronize()
+
+#if defined(__x86_64__) || defined(__i386__)
+#define lcec_cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define lcec_cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define lcec_cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
 
 #endif
@@ -0,0 +1,293 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Per-master cycle timing statistics
+
+#include "lcec_timing.h"
+
+#include "lcec.h"
+
+extern int lcec_comp_id;
+
+/// @brief Names of each phase, used for HAL pins and by `lcec_perf`.
+const char *lcec_timing_names[LCEC_TIMING_COUNT] = {
+    "receive",
+    "process",
+    "read",
+    "write",
+    "send",
+    "pll",
+    "read-total",
+    "write-total",
+    "period",
+    "dc-sync",
+};
+
+/// @brief Find the histogram bucket for a sample.
+///
+/// Bucket 0 holds 0 and 1 ns, bucket `n` holds `[2^n, 2^(n+1))` ns.
+int lcec_timing_bucket(uint32_t ns) {
+  int bucket = 0;
+
+  while (ns > 1 && bucket < LCEC_TIMING_HIST_BUCKETS - 1) {
+    ns >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+/// @brief Estimate a percentile from the histogram.
+///
+/// Returns the upper bound of the bucket holding the `pct`th
+/// percentile sample, capped at `stat->max`.
+uint32_t lcec_timing_percentile(const lcec_timing_stat_t *stat, int pct) {
+  uint64_t target, seen = 0;
+  int i;
+
+  if (stat->count == 0) return 0;
+
+  target = lcec_div_u64(stat->count * pct, 100);
+  for (i = 0; i < LCEC_TIMING_HIST_BUCKETS; i++) {
+    seen += stat->hist[i];
+    if (seen > target) {
+      uint64_t upper = (2ULL << i) - 1;
+      return (upper < stat->max) ? (uint32_t)upper : stat->max;
+    }
+  }
+  return stat->max;
+}
+
+/// @brief Find the longest phase in the current cycle.
+///
+/// Only real phases count, not the totals, the period, or other
+/// samples.  Returns a `lcec_timing_stat_id_t`.
+int lcec_timing_worst_phase(const lcec_timing_t *timing) {
+  int i, worst = LCEC_TIMING_RECEIVE;
+
+  for (i = LCEC_TIMING_RECEIVE; i <= LCEC_TIMING_PLL; i++) {
+    if ((timing->valid & (1 << i)) && timing->cur[i] > timing->cur[worst]) {
+      worst = i;
+    }
+  }
+  return worst;
+}
+
+/// @brief Clear all accumulated statistics.
+void lcec_timing_reset_stats(lcec_timing_shm_t *shm) {
+  int i;
+
+  shm->cycles = 0;
+  shm->overruns = 0;
+  memset(shm->stats, 0, sizeof(shm->stats));
+  for (i = 0; i < LCEC_TIMING_COUNT; i++) {
+    shm->stats[i].min = 0xffffffff;
+  }
+}
+
+/// @brief Set up timing statistics for a master.
+///
+/// Creates the shared memory block and exports
+/// `lcec.<master>.timing.<phase>-{last,min,max,mean}`,
+/// `lcec.<master>.timing.reset`, and the cycle budget pins.  The
+/// budget starts out as `master->cycle_budget`.
+int lcec_timing_init(lcec_master_t *master) {
+  lcec_timing_t *timing;
+  void *shmem_ptr;
+  int i;
+
+  if ((timing = LCEC_HAL_ALLOCATE(lcec_timing_t)) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "hal_malloc() for master %s timing failed\n", master->name);
+    return -EIO;
+  }
+  if ((timing->pins = LCEC_HAL_ALLOCATE_ARRAY(lcec_timing_pins_t, LCEC_TIMING_COUNT)) == NULL) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "hal_malloc() for master %s timing pins failed\n", master->name);
+    return -EIO;
+  }
+
+  for (i = 0; i < LCEC_TIMING_COUNT; i++) {
+    if (lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&timing->pins[i].last, "%s.%s.timing.%s-last", LCEC_MODULE_NAME, master->name,
+            lcec_timing_names[i]) != 0 ||
+        lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&timing->pins[i].min, "%s.%s.timing.%s-min", LCEC_MODULE_NAME, master->name,
+            lcec_timing_names[i]) != 0 ||
+        lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&timing->pins[i].max, "%s.%s.timing.%s-max", LCEC_MODULE_NAME, master->name,
+            lcec_timing_names[i]) != 0 ||
+        lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&timing->pins[i].mean, "%s.%s.timing.%s-mean", LCEC_MODULE_NAME, master->name,
+            lcec_timing_names[i]) != 0) {
+      return -EIO;
+    }
+  }
+  if (lcec_pin_newf(HAL_BIT, HAL_IN, (void **)&timing->reset, "%s.%s.timing.reset", LCEC_MODULE_NAME, master->name) != 0) {
+    return -EIO;
+  }
+  if (lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&timing->busy, "%s.%s.timing.busy", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&timing->overruns, "%s.%s.timing.overruns", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&timing->overrun_max, "%s.%s.timing.overrun-max", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_pin_newf(HAL_U32, HAL_OUT, (void **)&timing->overrun_phase, "%s.%s.timing.overrun-phase", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_pin_newf(HAL_BIT, HAL_OUT, (void **)&timing->fault, "%s.%s.timing.overrun-fault", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_pin_newf(HAL_BIT, HAL_IN, (void **)&timing->fault_reset, "%s.%s.timing.overrun-fault-reset", LCEC_MODULE_NAME, master->name) !=
+          0) {
+    return -EIO;
+  }
+  if (lcec_param_newf(HAL_U32, HAL_RW, (void *)&timing->budget, "%s.%s.timing.budget", LCEC_MODULE_NAME, master->name) != 0 ||
+      lcec_param_newf(HAL_U32, HAL_RW, (void *)&timing->fault_overruns, "%s.%s.timing.overrun-fault-count", LCEC_MODULE_NAME,
+          master->name) != 0) {
+    return -EIO;
+  }
+  timing->budget = master->cycle_budget;
+  timing->fault_overruns = 1;
+  timing->log = master->log;
+
+  timing->shmem_id = rtapi_shmem_new(LCEC_TIMING_SHMEM_KEY + master->index, lcec_comp_id, sizeof(lcec_timing_shm_t));
+  if (timing->shmem_id < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to create timing shmem for master %s\n", master->name);
+    return -EIO;
+  }
+  if (lcec_rtapi_shmem_getptr(timing->shmem_id, &shmem_ptr) < 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "unable to get timing shmem pointer for master %s\n", master->name);
+    rtapi_shmem_delete(timing->shmem_id, lcec_comp_id);
+    return -EIO;
+  }
+
+  timing->shm = (lcec_timing_shm_t *)shmem_ptr;
+  memset(timing->shm, 0, sizeof(lcec_timing_shm_t));
+  timing->shm->master_index = master->index;
+  strncpy(timing->shm->master_name, master->name, LCEC_CONF_STR_MAXLEN - 1);
+  timing->shm->app_time_period = master->app_time_period;
+  lcec_timing_reset_stats(timing->shm);
+  lcec_barrier();
+  timing->shm->magic = LCEC_TIMING_SHMEM_MAGIC;
+
+  master->timing = timing;
+  return 0;
+}
+
+/// @brief Release the timing shared memory for a master.
+void lcec_timing_cleanup(lcec_master_t *master) {
+  lcec_timing_t *timing = master->timing;
+
+  if (timing == NULL) {
+    return;
+  }
+
+  timing->shm->magic = 0;
+  rtapi_shmem_delete(timing->shmem_id, lcec_comp_id);
+  master->timing = NULL;
+}
+
+/// @brief Check how long this cycle took from the start of the read to the send.
+static void lcec_timing_check_budget(lcec_timing_t *timing, uint32_t busy) {
+  lcec_timing_shm_t *shm = timing->shm;
+
+  *(timing->busy) = busy;
+  shm->budget = timing->budget;
+  if (*(timing->fault_reset)) {
+    *(timing->fault) = 0;
+  }
+
+  if (timing->budget == 0 || busy <= timing->budget) {
+    timing->consecutive = 0;
+    return;
+  }
+
+  shm->overruns++;
+  timing->consecutive++;
+  *(timing->overruns) = (uint32_t)shm->overruns;
+  if (busy > *(timing->overrun_max)) {
+    *(timing->overrun_max) = busy;
+    *(timing->overrun_phase) = lcec_timing_worst_phase(timing);
+  }
+
+  if (timing->fault_overruns > 0 && timing->consecutive >= timing->fault_overruns && !*(timing->fault)) {
+    *(timing->fault) = 1;
+    lcec_log(timing->log, LCEC_LOG_BUDGET_FAULT, NULL, timing->consecutive, busy, timing->budget, 0);
+  }
+}
+
+/// @brief Fold this cycle's samples into the statistics and update HAL pins.
+///
+/// Called once per cycle, at the end of `lcec_write_master()`.
+void lcec_timing_commit(lcec_timing_t *timing) {
+  lcec_timing_shm_t *shm = timing->shm;
+  lcec_timing_stat_t *stat;
+  uint32_t ns;
+  int i;
+
+  shm->seq++;
+  lcec_barrier();
+
+  if (*(timing->reset)) {
+    lcec_timing_reset_stats(shm);
+    *(timing->overruns) = 0;
+    *(timing->overrun_max) = 0;
+    *(timing->overrun_phase) = 0;
+  }
+
+  if (timing->send_time != 0 && timing->last_read_start != 0) {
+    lcec_timing_check_budget(timing, (uint32_t)(timing->send_time - timing->last_read_start));
+  }
+
+  for (i = 0; i < LCEC_TIMING_COUNT; i++) {
+    if (!(timing->valid & (1 << i))) {
+      continue;
+    }
+
+    ns = timing->cur[i];
+    stat = &shm->stats[i];
+    stat->last = ns;
+    if (ns < stat->min) stat->min = ns;
+    if (ns > stat->max) stat->max = ns;
+    stat->hist[lcec_timing_bucket(ns)]++;
+    stat->sum += ns;
+    stat->count++;
+
+    *(timing->pins[i].last) = stat->last;
+    *(timing->pins[i].min) = stat->min;
+    *(timing->pins[i].max) = stat->max;
+    *(timing->pins[i].mean) = (uint32_t)lcec_div_u64(stat->sum, stat->count);
+  }
+  shm->cycles++;
+
+  lcec_barrier();
+  shm->seq++;
+
+  timing->valid = 0;
+}
+
+/// @brief Take a consistent copy of a master's timing block.
+///
+/// For use by userspace readers.  Returns 0 on success, or -1 if
+/// the block is not initialized or no consistent copy could be made.
+int lcec_timing_snapshot(const lcec_timing_shm_t *shm, lcec_timing_shm_t *copy) {
+  uint32_t seq;
+  int tries;
+
+  for (tries = 0; tries < 1000; tries++) {
+    seq = shm->seq;
+    lcec_barrier();
+    if (seq & 1) {
+      lcec_schedule();
+      continue;
+    }
+    memcpy(copy, (const void *)shm, sizeof(lcec_timing_shm_t));
+    lcec_barrier();
+    if (shm->seq == seq) {
+      return (copy->magic == LCEC_TIMING_SHMEM_MAGIC) ? 0 : -1;
+    }
+  }
+
+  return -1;
+}
@@ -0,0 +1,192 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Per-master cycle timing statistics
+///
+/// Every call to `lcec_read_master()` and `lcec_write_master()` is
+/// split into phases, and the duration of each phase is accumulated
+/// into a `lcec_timing_stat_t`.  Statistics are published once per
+/// cycle into HAL pins and into a shared memory block
+/// (`lcec_timing_shm_t`) that userspace tools like `lcec_perf` can
+/// read without interfering with the realtime thread.
+
+#ifndef _LCEC_TIMING_H_
+#define _LCEC_TIMING_H_
+
+#include "hal.h"
+#include "lcec_conf.h"
+#include "lcec_log.h"
+#include "lcec_rtapi.h"
+
+#define LCEC_TIMING_SHMEM_KEY    0xACB57400  ///< Base shared memory key, the master index is added to this.
+#define LCEC_TIMING_SHMEM_MAGIC  0x5D1A7E03  ///< Magic number, changes whenever `lcec_timing_shm_t` changes.
+#define LCEC_TIMING_HIST_BUCKETS 32          ///< Histogram bucket `n` counts samples between 2^n and 2^(n+1)-1 ns.
+
+/// @brief The phases of a cycle that are measured.
+typedef enum {
+  LCEC_TIMING_RECEIVE,      ///< `ecrt_master_receive()`.
+  LCEC_TIMING_PROCESS,      ///< `ecrt_domain_process()` and master/slave state polling.
+  LCEC_TIMING_READ,         ///< Slave state pins and `proc_read` callbacks.
+  LCEC_TIMING_WRITE,        ///< Slave `proc_write` callbacks.
+  LCEC_TIMING_SEND,         ///< Domain queue, DC clock sync, and `ecrt_master_send()`.
+  LCEC_TIMING_PLL,          ///< Master thread PLL.
+  LCEC_TIMING_READ_TOTAL,   ///< All of `lcec_read_master()`.
+  LCEC_TIMING_WRITE_TOTAL,  ///< All of `lcec_write_master()`.
+  LCEC_TIMING_PERIOD,       ///< Time between the start of two successive reads.
+  LCEC_TIMING_DC_SYNC,      ///< DC system time difference, from the sync monitor; not a phase.
+  LCEC_TIMING_COUNT,
+} lcec_timing_stat_id_t;
+
+/// @brief Accumulated statistics for a single phase, in ns.
+///
+/// The profiler uses the same structure, but in CPU clocks.
+typedef struct {
+  uint32_t last;                           ///< Most recent sample.
+  uint32_t min;                            ///< Smallest sample since the last reset.
+  uint32_t max;                            ///< Largest sample since the last reset.
+  uint32_t hist[LCEC_TIMING_HIST_BUCKETS];  ///< Log2-bucketed histogram.
+  uint64_t sum;                            ///< Sum of all samples, for computing the mean.
+  uint64_t count;                          ///< Number of samples.
+} lcec_timing_stat_t;
+
+/// @brief Layout of the per-master timing shared memory block.
+///
+/// The realtime side bumps `seq` to an odd value before updating
+/// and back to an even value afterwards.  Readers should copy the
+/// block and retry if `seq` was odd or changed during the copy; see
+/// `lcec_timing_snapshot()`.
+typedef struct {
+  uint32_t magic;                               ///< `LCEC_TIMING_SHMEM_MAGIC` once initialized.
+  volatile uint32_t seq;                        ///< Sequence counter, odd while an update is in progress.
+  int master_index;                             ///< Index of the master.
+  char master_name[LCEC_CONF_STR_MAXLEN];       ///< Name of the master.
+  uint32_t app_time_period;                     ///< Configured `appTimePeriod`, in ns.
+  uint64_t cycles;                              ///< Number of completed cycles.
+  uint32_t budget;                              ///< Time allowed from the start of the read to the send, in ns; 0 if unchecked.
+  uint64_t overruns;                            ///< Number of cycles that went over `budget`.
+  lcec_timing_stat_t stats[LCEC_TIMING_COUNT];  ///< Per-phase statistics.
+} lcec_timing_shm_t;
+
+/// @brief HAL pins for a single phase.
+typedef struct {
+  hal_u32_t *last;
+  hal_u32_t *min;
+  hal_u32_t *max;
+  hal_u32_t *mean;
+} lcec_timing_pins_t;
+
+/// @brief Realtime-side timing state for a single master.
+typedef struct {
+  lcec_timing_shm_t *shm;                       ///< Shared memory block.
+  int shmem_id;                                 ///< RTAPI shared memory ID.
+  lcec_timing_pins_t *pins;                     ///< HAL pins, one set per phase.
+  lcec_log_t *log;                              ///< The master's message log.
+  hal_bit_t *reset;                             ///< HAL pin; reset statistics when true.
+  hal_u32_t *busy;                              ///< HAL pin; time from the start of the read to the send, in ns.
+  hal_u32_t *overruns;                          ///< HAL pin; number of cycles where `busy` went over `budget`.
+  hal_u32_t *overrun_max;                       ///< HAL pin; largest `busy` of any overrun.
+  hal_u32_t *overrun_phase;                     ///< HAL pin; longest phase in the cycle that set `overrun_max`.
+  hal_bit_t *fault;                             ///< HAL pin; set after `fault_overruns` overruns in a row.
+  hal_bit_t *fault_reset;                       ///< HAL pin; clear `fault` when true.
+  hal_u32_t budget;                             ///< HAL param; time allowed for `busy`, in ns, or 0 to not check.
+  hal_u32_t fault_overruns;                     ///< HAL param; overruns in a row that set `fault`, or 0 to never set it.
+  uint32_t consecutive;                         ///< Overruns in a row.
+  long long mark;                               ///< Timestamp at the end of the previous phase.
+  long long read_start;                         ///< Timestamp of the start of the current read.
+  long long write_start;                        ///< Timestamp of the start of the current write.
+  long long last_read_start;                    ///< Timestamp of the start of the previous read.
+  long long send_time;                          ///< Timestamp of the last `ecrt_master_send()`.
+  uint32_t cur[LCEC_TIMING_COUNT];              ///< Samples for the current cycle.
+  uint32_t valid;                               ///< Bitmask of samples in `cur` that were set this cycle.
+} lcec_timing_t;
+
+extern const char *lcec_timing_names[LCEC_TIMING_COUNT];
+
+struct lcec_master;
+
+int lcec_timing_init(struct lcec_master *master);
+void lcec_timing_cleanup(struct lcec_master *master);
+void lcec_timing_commit(lcec_timing_t *timing);
+void lcec_timing_reset_stats(lcec_timing_shm_t *shm);
+int lcec_timing_snapshot(const lcec_timing_shm_t *shm, lcec_timing_shm_t *copy);
+int lcec_timing_bucket(uint32_t ns);
+int lcec_timing_worst_phase(const lcec_timing_t *timing);
+uint32_t lcec_timing_percentile(const lcec_timing_stat_t *stat, int pct);
+
+/// @brief Record the time since the previous mark as phase `id`, and move the mark forward.
+static inline long long lcec_timing_phase(lcec_timing_t *timing, lcec_timing_stat_id_t id) {
+  long long now = rtapi_get_time();
+
+  timing->cur[id] = (uint32_t)(now - timing->mark);
+  timing->valid |= 1 << id;
+  timing->mark = now;
+  return now;
+}
+
+/// @brief Record a sample that isn't the duration of a phase.
+static inline void lcec_timing_sample(lcec_timing_t *timing, lcec_timing_stat_id_t id, uint32_t ns) {
+  timing->cur[id] = ns;
+  timing->valid |= 1 << id;
+}
+
+/// @brief Mark the start of `lcec_read_master()`.
+static inline void lcec_timing_begin_read(lcec_timing_t *timing) {
+  long long now = rtapi_get_time();
+
+  if (timing->last_read_start != 0) {
+    timing->cur[LCEC_TIMING_PERIOD] = (uint32_t)(now - timing->last_read_start);
+    timing->valid |= 1 << LCEC_TIMING_PERIOD;
+  }
+  timing->last_read_start = now;
+  timing->read_start = now;
+  timing->mark = now;
+}
+
+/// @brief Continue timing after other HAL functions ran since the last phase.
+///
+/// Used when a master's read or write is split across
+/// `lcec.<master>.receive`/`.read` or `.write`/`.send`.  The time in
+/// between is left out of the next phase and of the total that
+/// started at `*start`.
+static inline void lcec_timing_resume(lcec_timing_t *timing, long long *start) {
+  long long now = rtapi_get_time();
+
+  *start += now - timing->mark;
+  timing->mark = now;
+}
+
+/// @brief Mark the end of `lcec_read_master()`.
+static inline void lcec_timing_end_read(lcec_timing_t *timing) {
+  timing->cur[LCEC_TIMING_READ_TOTAL] = (uint32_t)(timing->mark - timing->read_start);
+  timing->valid |= 1 << LCEC_TIMING_READ_TOTAL;
+}
+
+/// @brief Mark the start of `lcec_write_master()`.
+static inline void lcec_timing_begin_write(lcec_timing_t *timing) {
+  long long now = rtapi_get_time();
+
+  timing->write_start = now;
+  timing->mark = now;
+}
+
+/// @brief Mark the end of `lcec_write_master()`.
+static inline void lcec_timing_end_write(lcec_timing_t *timing) {
+  timing->cur[LCEC_TIMING_WRITE_TOTAL] = (uint32_t)(timing->mark - timing->write_start);
+  timing->valid |= 1 << LCEC_TIMING_WRITE_TOTAL;
+}
+
+#endif
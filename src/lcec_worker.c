@@ -0,0 +1,223 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Per-master worker threads for `lcec.read-all` and `lcec.write-all`
+///
+/// With `workerCpu` set on a master, `lcec.read-all` and
+/// `lcec.write-all` hand that master to a realtime thread pinned to
+/// the given CPU instead of processing it in the HAL thread, so that
+/// several masters are serviced at the same time.  The HAL thread
+/// posts a job by bumping the worker's `go` counter and waking it,
+/// runs any masters without a worker itself, and then spins until
+/// every worker's `done` has caught up.  Workers sleep between jobs,
+/// so an idle worker doesn't use its CPU or run into RT throttling.
+///
+/// This is only available with userspace RTAPI; kernel builds always
+/// run the masters one after another.
+
+#ifndef __KERNEL__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // for CPU_SET() and pthread_attr_setaffinity_np()
+#endif
+#endif
+
+#include "lcec.h"
+
+#ifndef __KERNEL__
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+
+/// @brief Worker thread state.
+///
+/// `go` is written by the HAL thread and `done` by the worker, so
+/// they live on separate cache lines.
+struct lcec_worker {
+  volatile uint32_t go __attribute__((aligned(LCEC_CACHELINE_SIZE)));  ///< Job sequence number, bumped by the HAL thread.
+  sem_t wake;                                                          ///< Posted once per job.
+  void (*func)(void *arg, long period);                                ///< Function to run for the current job.
+  long period;                                                         ///< Period for the current job.
+  int stop;                                                            ///< Exit instead of running a job.
+  volatile uint32_t done __attribute__((aligned(LCEC_CACHELINE_SIZE)));  ///< Sequence number of the last finished job.
+  lcec_master_t *master;                                                 ///< Master served by this worker.
+  pthread_t thread;                                                      ///< The worker thread.
+};
+
+static void *lcec_worker_main(void *arg) {
+  lcec_worker_t *worker = (lcec_worker_t *)arg;
+  uint32_t seq;
+
+  for (;;) {
+    while (sem_wait(&worker->wake) != 0) {
+      // EINTR, try again
+    }
+    seq = __atomic_load_n(&worker->go, __ATOMIC_ACQUIRE);
+
+    if (worker->stop) {
+      break;
+    }
+
+    worker->func(worker->master, worker->period);
+    __atomic_store_n(&worker->done, seq, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+}
+
+/// @brief Start a master's worker thread, if it has a `workerCpu`.
+int lcec_worker_start(lcec_master_t *master) {
+  lcec_master_t *other;
+  lcec_worker_t *worker;
+  pthread_attr_t attr;
+  struct sched_param param;
+  cpu_set_t cpus;
+  int err;
+
+  if (master->worker_cpu < 0) {
+    return 0;
+  }
+
+  // two workers on one CPU would run one after another anyway
+  for (other = master->prev; other != NULL; other = other->prev) {
+    if (other->worker != NULL && other->worker_cpu == master->worker_cpu) {
+      rtapi_print_msg(
+          RTAPI_MSG_ERR, LCEC_MSG_PFX "masters %s and %s both use workerCpu %d\n", other->name, master->name, master->worker_cpu);
+      return -1;
+    }
+  }
+
+#ifdef RTAPI_TASK_PLL_SUPPORT
+  // the task PLL adjusts the calling RTAPI task, so it has to stay on the HAL thread
+  if (master->sync_ref_cycles < 0) {
+    rtapi_print_msg(RTAPI_MSG_WARN, LCEC_MSG_PFX "master %s syncs to the reference clock, ignoring workerCpu\n", master->name);
+    return 0;
+  }
+#endif
+
+  worker = LCEC_ALLOCATE_ALIGNED(lcec_worker_t);
+  memset(worker, 0, sizeof(lcec_worker_t));
+  worker->master = master;
+  if (sem_init(&worker->wake, 0, 0) != 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failed to create worker semaphore for master %s\n", master->name);
+    free(worker);
+    return -1;
+  }
+
+  CPU_ZERO(&cpus);
+  CPU_SET(master->worker_cpu, &cpus);
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+  pthread_attr_setschedparam(&attr, &param);
+  err = pthread_create(&worker->thread, &attr, lcec_worker_main, worker);
+  if (err == EPERM) {
+    rtapi_print_msg(
+        RTAPI_MSG_WARN, LCEC_MSG_PFX "no permission for a realtime worker for master %s, using a normal thread\n", master->name);
+    pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+    err = pthread_create(&worker->thread, &attr, lcec_worker_main, worker);
+  }
+  pthread_attr_destroy(&attr);
+
+  if (err != 0) {
+    rtapi_print_msg(RTAPI_MSG_ERR, LCEC_MSG_PFX "failed to start worker for master %s on CPU %d (error %d)\n", master->name,
+        master->worker_cpu, err);
+    sem_destroy(&worker->wake);
+    free(worker);
+    return -1;
+  }
+
+  rtapi_print_msg(RTAPI_MSG_INFO, LCEC_MSG_PFX "master %s runs on CPU %d\n", master->name, master->worker_cpu);
+  master->worker = worker;
+  return 0;
+}
+
+/// @brief Stop a master's worker thread, if it has one.
+void lcec_worker_stop(lcec_master_t *master) {
+  lcec_worker_t *worker = master->worker;
+
+  if (worker == NULL) {
+    return;
+  }
+
+  worker->stop = 1;
+  __atomic_add_fetch(&worker->go, 1, __ATOMIC_RELEASE);
+  sem_post(&worker->wake);
+  pthread_join(worker->thread, NULL);
+
+  master->worker = NULL;
+  sem_destroy(&worker->wake);
+  free(worker);
+}
+
+/// @brief Run `func` for every master, using worker threads where available.
+///
+/// Returns once `func` has finished for every master.
+void lcec_run_masters(lcec_master_t *first_master, void (*func)(void *arg, long period), long period) {
+  lcec_master_t *master;
+  lcec_worker_t *worker;
+  uint32_t seq;
+
+  // start workers first, so they run while this thread does the rest
+  for (master = first_master; master != NULL; master = master->next) {
+    if ((worker = master->worker) != NULL) {
+      worker->func = func;
+      worker->period = period;
+      __atomic_add_fetch(&worker->go, 1, __ATOMIC_RELEASE);
+      sem_post(&worker->wake);
+    }
+  }
+
+  for (master = first_master; master != NULL; master = master->next) {
+    if (master->worker == NULL) {
+      func(master, period);
+    }
+  }
+
+  for (master = first_master; master != NULL; master = master->next) {
+    if ((worker = master->worker) != NULL) {
+      seq = worker->go;
+      while (__atomic_load_n(&worker->done, __ATOMIC_ACQUIRE) != seq) {
+        lcec_cpu_relax();
+      }
+    }
+  }
+}
+
+#else
+
+int lcec_worker_start(lcec_master_t *master) {
+  if (master->worker_cpu >= 0) {
+    rtapi_print_msg(RTAPI_MSG_WARN, LCEC_MSG_PFX "workerCpu needs userspace RTAPI, ignoring it for master %s\n", master->name);
+  }
+  return 0;
+}
+
+void lcec_worker_stop(lcec_master_t *master) {}
+
+void lcec_run_masters(lcec_master_t *first_master, void (*func)(void *arg, long period), long period) {
+  lcec_master_t *master;
+
+  for (master = first_master; master != NULL; master = master->next) {
+    func(master, period);
+  }
+}
+
+#endif
@@ -0,0 +1,407 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Code for the `lcec_replay` tool, which runs recorded process data through the drivers.
+///
+/// `lcec_replay` loads a config into the simulator, then feeds it the
+/// records of a recording saved by `lcec_perf record`, one per cycle:
+/// each recorded PDO entry is copied into the simulated master's
+/// process data at the place where the simulated master put the same
+/// entry, `lcec.read-all` and `lcec.write-all` are run, and the
+/// resulting pin values are written as CSV.  See
+/// `documentation/simulation.md`.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../lcec.h"
+#include "sim.h"
+
+#define MAX_PREFIXES 64
+
+static const char *modname = "lcec_replay";
+
+/// @brief A recorded PDO entry and where it goes in the simulated process data.
+typedef struct {
+  uint32_t src;      ///< Byte in a record's data.
+  uint32_t src_bit;  ///< Bit within that byte.
+  uint32_t dst;      ///< Byte in the simulated process data.
+  uint32_t dst_bit;  ///< Bit within that byte.
+  uint32_t bits;     ///< Size in bits.
+} copy_t;
+
+/// @brief Call statistics for `read-all` or `write-all`, in ns.
+typedef struct {
+  uint64_t sum;
+  uint64_t count;
+  uint64_t min;
+  uint64_t max;
+} call_stat_t;
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [options] <config.xml> <recording>\n", modname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Runs a recording saved with 'lcec_perf record' through the drivers\n");
+  fprintf(stderr, "configured in <config.xml>, and prints the resulting pins as CSV.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -o <file>         write the CSV to <file> instead of stdout\n");
+  fprintf(stderr, "  -p <prefix>       only include pins starting with <prefix>; may be repeated\n");
+  fprintf(stderr, "  -s <pin>=<value>  set a pin or param before the first cycle; may be repeated\n");
+  fprintf(stderr, "  -n <count>        replay the recording <count> times (default 1)\n");
+  fprintf(stderr, "  -b                time read-all and write-all, and profile each slave\n");
+  fprintf(stderr, "  -v                print more messages; may be repeated\n");
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// @brief Copy `bits` bits, least significant first, as on the bus.
+static void copy_bits(uint8_t *dst, uint32_t dst_bit, const uint8_t *src, uint32_t src_bit, uint32_t bits) {
+  uint32_t i, s, d;
+
+  if (dst_bit == 0 && src_bit == 0 && bits % 8 == 0) {
+    memcpy(dst, src, bits / 8);
+    return;
+  }
+  for (i = 0; i < bits; i++) {
+    s = src_bit + i;
+    d = dst_bit + i;
+    if ((src[s / 8] >> (s % 8)) & 1) {
+      dst[d / 8] |= 1 << (d % 8);
+    } else {
+      dst[d / 8] &= ~(1 << (d % 8));
+    }
+  }
+}
+
+/// @brief Read a whole recording into memory.
+static lcec_recorder_shm_t *load_recording(const char *filename) {
+  lcec_recorder_shm_t *shm = NULL;
+  FILE *in;
+  long len;
+
+  if ((in = fopen(filename, "rb")) == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, filename);
+    return NULL;
+  }
+  if (fseek(in, 0, SEEK_END) != 0 || (len = ftell(in)) < 0 || fseek(in, 0, SEEK_SET) != 0 || (shm = malloc(len + 1)) == NULL ||
+      fread(shm, 1, len, in) != (size_t)len) {
+    fprintf(stderr, "%s: ERROR: unable to read %s\n", modname, filename);
+    free(shm);
+    shm = NULL;
+  } else if (lcec_recorder_check(shm, len) != 0) {
+    fprintf(stderr, "%s: ERROR: %s is not a recording\n", modname, filename);
+    free(shm);
+    shm = NULL;
+  }
+  fclose(in);
+  return shm;
+}
+
+/// @brief Match the recorded PDO entries to the simulated master's.
+///
+/// Returns the number of entries in `copies`, or -1 on error.
+static int map_entries(const lcec_recorder_shm_t *shm, size_t data_len, copy_t **copies) {
+  const lcec_recorder_pdo_t *pdos = lcec_recorder_pdos(shm);
+  const lcec_recorder_pdo_t *pdo;
+  const sim_entry_t *entries, *entry;
+  copy_t *copy;
+  uint32_t p, pos, bits;
+  int count, i, n = 0, missing = 0;
+
+  if ((count = sim_master_entries(shm->master_index, &entries)) < 0) {
+    return -1;
+  }
+  if ((*copies = calloc(shm->pdo_count + 1, sizeof(copy_t))) == NULL) {
+    return -1;
+  }
+
+  for (p = 0; p < shm->pdo_count; p++) {
+    pdo = &pdos[p];
+    if (lcec_recorder_locate(shm, pdo, &pos) != 0) {
+      continue;
+    }
+    for (i = 0, entry = NULL; i < count; i++) {
+      if (entries[i].position == pdo->position && entries[i].index == pdo->index && entries[i].subindex == pdo->subindex) {
+        entry = &entries[i];
+        break;
+      }
+    }
+    if (entry == NULL) {
+      missing++;
+      rtapi_print_msg(RTAPI_MSG_INFO, "%s: %s.0x%04x:%02x isn't in the config\n", modname, pdo->slave, pdo->index, pdo->subindex);
+      continue;
+    }
+
+    // the simulated master knows the size if the config maps the entry
+    bits = (entry->bit_length != 0) ? entry->bit_length : pdo->bit_length;
+    if (bits == 0 || entry->offset + (entry->bit_position + bits + 7) / 8 > data_len ||
+        pos + (pdo->bit_position + bits + 7) / 8 > shm->record_len) {
+      missing++;
+      continue;
+    }
+    copy = &(*copies)[n++];
+    copy->src = pos;
+    copy->src_bit = pdo->bit_position;
+    copy->dst = entry->offset;
+    copy->dst_bit = entry->bit_position;
+    copy->bits = bits;
+  }
+
+  if (missing > 0) {
+    fprintf(stderr, "%s: WARNING: %d recorded PDO entries don't match the config and are skipped\n", modname, missing);
+  }
+  return n;
+}
+
+static int pin_selected(const sim_pin_t *pin, const char **prefixes, int prefix_count) {
+  int i;
+
+  if (pin->is_param) {
+    return 0;
+  }
+  if (prefix_count == 0) {
+    return 1;
+  }
+  for (i = 0; i < prefix_count; i++) {
+    if (strncmp(pin->name, prefixes[i], strlen(prefixes[i])) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void add_sample(call_stat_t *stat, uint64_t ns) {
+  if (stat->count == 0 || ns < stat->min) stat->min = ns;
+  if (ns > stat->max) stat->max = ns;
+  stat->sum += ns;
+  stat->count++;
+}
+
+static void print_stat(FILE *out, const char *name, const call_stat_t *stat) {
+  if (stat->count == 0) {
+    return;
+  }
+  fprintf(out, "%-32s %10llu %10.0f %10llu %10llu\n", name, (unsigned long long)stat->count, (double)stat->sum / stat->count,
+      (unsigned long long)stat->min, (unsigned long long)stat->max);
+}
+
+/// @brief Print the per-slave profile of the replayed master.
+static void print_profile(FILE *out, int index, int comp_id) {
+  lcec_profile_shm_t *shm;
+  lcec_profile_slave_t *slave;
+  call_stat_t stat;
+  char name[LCEC_CONF_STR_MAXLEN * 2 + 8];
+  void *ptr;
+  int shmem_id, i, f;
+
+  if ((shmem_id = rtapi_shmem_new(LCEC_PROFILE_SHMEM_KEY + index, comp_id, sizeof(lcec_profile_shm_t))) < 0) {
+    return;
+  }
+  if (lcec_rtapi_shmem_getptr(shmem_id, &ptr) == 0) {
+    shm = (lcec_profile_shm_t *)ptr;
+    for (i = 0; shm->magic == LCEC_PROFILE_SHMEM_MAGIC && i < shm->slave_count; i++) {
+      slave = &lcec_profile_slaves(shm)[i];
+      for (f = 0; f < LCEC_PROFILE_FUNCS; f++) {
+        // clocks are ns in the simulator
+        stat.sum = slave->stats[f].sum;
+        stat.count = slave->stats[f].count;
+        stat.min = slave->stats[f].min;
+        stat.max = slave->stats[f].max;
+        snprintf(name, sizeof(name), "%s (%s) %s", slave->name, slave->type_name, f == LCEC_PROFILE_READ ? "read" : "write");
+        print_stat(out, name, &stat);
+      }
+    }
+  }
+  rtapi_shmem_delete(shmem_id, comp_id);
+}
+
+int main(int argc, char **argv) {
+  const char *prefixes[MAX_PREFIXES];
+  const char *setps[MAX_PREFIXES];
+  const char *output = NULL;
+  int prefix_count = 0, setp_count = 0, loops = 1, bench = 0, verbose = RTAPI_MSG_ERR;
+  lcec_recorder_shm_t *shm;
+  const lcec_recorder_record_t *record;
+  copy_t *copies = NULL;
+  sim_pin_t **columns = NULL;
+  call_stat_t reads, writes;
+  FILE *out = stdout;
+  char name[LCEC_CONF_STR_MAXLEN * 2 + 32], buf[64];
+  const char *value;
+  uint8_t *data;
+  size_t data_len;
+  long period;
+  int64_t span;
+  uint64_t start;
+  int opt, copy_count, column_count = 0, comp_id, ret = 1, i, l;
+  uint32_t r;
+
+  while ((opt = getopt(argc, argv, "o:p:s:n:bvh")) != -1) {
+    switch (opt) {
+      case 'o':
+        output = optarg;
+        break;
+      case 'p':
+        if (prefix_count < MAX_PREFIXES) prefixes[prefix_count++] = optarg;
+        break;
+      case 's':
+        if (setp_count < MAX_PREFIXES) setps[setp_count++] = optarg;
+        break;
+      case 'n':
+        loops = atoi(optarg);
+        break;
+      case 'b':
+        bench = 1;
+        break;
+      case 'v':
+        verbose++;
+        break;
+      case 'h':
+      default:
+        usage();
+        return (opt == 'h') ? 0 : 1;
+    }
+  }
+  if (argc - optind != 2 || loops < 1) {
+    usage();
+    return 1;
+  }
+
+  if ((shm = load_recording(argv[optind + 1])) == NULL) {
+    return 1;
+  }
+  if (shm->depth == 0) {
+    fprintf(stderr, "%s: ERROR: %s holds no records\n", modname, argv[optind + 1]);
+    goto out0;
+  }
+  period = shm->app_time_period;
+
+  sim_set_msg_level(verbose);
+  sim_set_time(lcec_recorder_record(shm, 0)->time);
+  if (sim_start(argv[optind]) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to load %s\n", modname, argv[optind]);
+    goto out0;
+  }
+  comp_id = hal_init(modname);
+
+  if ((data = sim_master_data(shm->master_index, &data_len)) == NULL) {
+    fprintf(stderr, "%s: ERROR: the config has no master with index %d\n", modname, shm->master_index);
+    goto out1;
+  }
+  if ((copy_count = map_entries(shm, data_len, &copies)) < 0) {
+    goto out1;
+  }
+
+  for (i = 0; i < setp_count; i++) {
+    value = strchr(setps[i], '=');
+    snprintf(name, sizeof(name), "%.*s", value != NULL ? (int)(value - setps[i]) : (int)strlen(setps[i]), setps[i]);
+    if (value == NULL || sim_setp(name, value + 1) != 0) {
+      fprintf(stderr, "%s: ERROR: unable to set %s\n", modname, setps[i]);
+      goto out1;
+    }
+  }
+  if (bench) {
+    snprintf(name, sizeof(name), "%s.%s.profile.enable", LCEC_MODULE_NAME, shm->master_name);
+    sim_setp(name, "1");
+  }
+
+  // pick the columns once; pins don't change while running
+  if ((columns = calloc(sim_pin_count() + 1, sizeof(sim_pin_t *))) == NULL) {
+    goto out1;
+  }
+  for (i = 0; i < sim_pin_count(); i++) {
+    if (pin_selected(sim_pin(i), prefixes, prefix_count)) {
+      columns[column_count++] = sim_pin(i);
+    }
+  }
+
+  if (output != NULL && (out = fopen(output, "w")) == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, output);
+    out = stdout;
+    goto out1;
+  }
+  if (bench && output == NULL) {
+    out = NULL;
+  }
+  if (out != NULL) {
+    fprintf(out, "cycle,time");
+    for (i = 0; i < column_count; i++) {
+      fprintf(out, ",%s", columns[i]->name);
+    }
+    fprintf(out, "\n");
+  }
+
+  memset(&reads, 0, sizeof(reads));
+  memset(&writes, 0, sizeof(writes));
+  span = lcec_recorder_record(shm, shm->depth - 1)->time - lcec_recorder_record(shm, 0)->time + period;
+  for (l = 0; l < loops; l++) {
+    for (r = 0; r < shm->depth; r++) {
+      record = lcec_recorder_record(shm, r);
+      sim_set_time(record->time + l * span);
+      for (i = 0; i < copy_count; i++) {
+        copy_bits(
+            data + copies[i].dst, copies[i].dst_bit, (const uint8_t *)(record + 1) + copies[i].src, copies[i].src_bit, copies[i].bits);
+      }
+      if (!record->valid) {
+        sim_master_lose_frames(shm->master_index, 1);
+      }
+
+      start = now_ns();
+      sim_call(LCEC_MODULE_NAME ".read-all", period);
+      add_sample(&reads, now_ns() - start);
+      start = now_ns();
+      sim_call(LCEC_MODULE_NAME ".write-all", period);
+      add_sample(&writes, now_ns() - start);
+
+      if (out != NULL) {
+        fprintf(out, "%llu,%lld", (unsigned long long)(record->cycle + (uint64_t)l * shm->depth), (long long)sim_time());
+        for (i = 0; i < column_count; i++) {
+          sim_pin_format(columns[i], buf, sizeof(buf));
+          fprintf(out, ",%s", buf);
+        }
+        fprintf(out, "\n");
+      }
+    }
+  }
+
+  if (bench) {
+    printf("%-32s %10s %10s %10s %10s\n", "call", "count", "mean-ns", "min-ns", "max-ns");
+    print_stat(stdout, LCEC_MODULE_NAME ".read-all", &reads);
+    print_stat(stdout, LCEC_MODULE_NAME ".write-all", &writes);
+    print_profile(stdout, shm->master_index, comp_id);
+  }
+  ret = 0;
+
+out1:
+  if (out != NULL && out != stdout) {
+    fclose(out);
+  }
+  sim_stop();
+out0:
+  free(columns);
+  free(copies);
+  free(shm);
+  return ret;
+}
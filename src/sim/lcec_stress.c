@@ -0,0 +1,859 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Code for the `lcec_stress` tool, which runs the cycle under injected faults.
+///
+/// `lcec_stress` loads a config into the simulator and runs
+/// `lcec.read-all` and `lcec.write-all` for a number of cycles at a
+/// fixed period, with random inputs in every PDO entry.  The thread's
+/// wakeup time follows the period and the PLL correction that `lcec`
+/// asks for, plus random jitter.  On top of that it injects late
+/// wakeups, lost frames, slaves that miss a frame (working counter
+/// errors), and slaves that drop to SAFEOP for a while.
+///
+/// The same cycles are first run without faults, with the same
+/// inputs, jitter, and clock drift, and the output PDO entries and
+/// slave pins of each cycle are kept as a hash.  With faults, any
+/// cycle whose outputs differ from that, outside of a fault and the
+/// recovery cycles after it, is counted as wrong.
+///
+/// It reports how long each cycle took to run, the number of wrong
+/// cycles, and how well each master's DC PLL held its lock, and fails
+/// if any of them is outside the bounds given with `-b`.  See
+/// `documentation/simulation.md`.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../lcec.h"
+#include "sim.h"
+
+#define MAX_SETPS          64
+#define MAX_MASTERS        16
+#define WARMUP_CYCLES      100
+#define DEFAULT_CYCLES     100000
+#define DEFAULT_RECOVERY   10
+#define DEFAULT_FLAP       10
+#define DEFAULT_SEED       1
+
+static const char *modname = "lcec_stress";
+
+/// @brief Names of the values that `-b` can bound, in the order of `stress_result_t.values`.
+static const char *bound_names[] = {"p50", "p99", "p99.9", "p99.99", "max", "wrong", "pll-err", "pll-resets"};
+
+#define BOUND_COUNT (sizeof(bound_names) / sizeof(bound_names[0]))
+
+enum { VALUE_P50, VALUE_P99, VALUE_P999, VALUE_P9999, VALUE_MAX, VALUE_WRONG, VALUE_PLL_ERR, VALUE_PLL_RESETS };
+
+/// @brief What to run, from the command line.
+typedef struct {
+  long cycles;         ///< Cycles to measure, after `WARMUP_CYCLES`.
+  long period;         ///< Thread period in ns, or 0 for the first master's `appTimePeriod`.
+  uint64_t seed;       ///< Seed for inputs, jitter, and faults.
+  long jitter;         ///< Most random delay of each wakeup, in ns.
+  double late_rate;    ///< Chance of a cycle waking up late.
+  long late_ns;        ///< How late, in ns, or 0 for half a period.
+  double drop_rate;    ///< Chance of a cycle losing its frame.
+  double wc_rate;      ///< Chance of a slave missing a cycle's frame.
+  double flap_rate;    ///< Chance of a slave dropping to SAFEOP.
+  int flap_cycles;     ///< How long it stays there.
+  double drift;        ///< Reference clock drift, in ppm.
+  int recovery;        ///< Cycles after a fault during which outputs may differ.
+  const char **setps;  ///< `-s` arguments.
+  int setp_count;
+  const char **skips;  ///< `-x` arguments.
+  int skip_count;
+} stress_opts_t;
+
+/// @brief A master being stressed.
+typedef struct {
+  lcec_master_t *master;
+  sim_pin_t *pll_err;        ///< `lcec.<master>.pll-err`.
+  sim_pin_t *pll_locked;     ///< `lcec.<master>.pll-locked`.
+  sim_pin_t *pll_reset_cnt;  ///< `lcec.<master>.pll-reset-count`.
+  long state_cycles;         ///< Cycles for `lcec` to poll every slave's state once.
+  int locked;                ///< True once the PLL has locked.
+  long max_err;              ///< Largest PLL error since it locked, in ns.
+} stress_master_t;
+
+/// @brief A PDO entry that is filled or checked each cycle.
+typedef struct {
+  uint8_t *data;          ///< The master's process data.
+  uint32_t offset;        ///< Byte offset in `data`.
+  uint32_t bit_position;  ///< Bit offset within that byte.
+  uint32_t bits;          ///< Size in bits.
+  int master;             ///< Index in `stress_run_t.masters`.
+  uint16_t position;      ///< Slave position.
+  uint16_t index;         ///< PDO entry index.
+  uint8_t subindex;       ///< PDO entry subindex.
+} stress_entry_t;
+
+/// @brief A slave that faults can be injected into.
+typedef struct {
+  int master;         ///< Index in `stress_run_t.masters`.
+  uint16_t position;  ///< Slave position.
+} stress_slave_t;
+
+/// @brief Everything a run needs once the config is loaded.
+typedef struct {
+  stress_master_t masters[MAX_MASTERS];
+  int master_count;
+  stress_slave_t *slaves;
+  int slave_count;
+  stress_entry_t *inputs;
+  int input_count;
+  stress_entry_t *outputs;
+  int output_count;
+  sim_pin_t **pins;  ///< Slave pins that `lcec` writes.
+  int pin_count;
+} stress_run_t;
+
+/// @brief Everything one cycle produced, by name, to show what differed.
+typedef struct {
+  long cycle;     ///< Cycle it was taken in, or -1 for the first wrong cycle.
+  int count;
+  char **names;
+  char **values;
+} stress_snapshot_t;
+
+/// @brief How a master's PLL did.
+typedef struct {
+  char name[LCEC_CONF_STR_MAXLEN];  ///< Master name.
+  int locked;                       ///< True if the PLL locked.
+  long max_err;                     ///< Largest PLL error since it locked, in ns.
+  long resets;                      ///< PLL resets.
+} stress_pll_t;
+
+/// @brief What a run measured.
+typedef struct {
+  long late;               ///< Late wakeups injected.
+  long dropped;            ///< Lost frames injected.
+  long wc_errors;          ///< Missed frames injected.
+  long flaps;              ///< State flaps injected.
+  long disturbed;          ///< Cycles inside a fault or its recovery.
+  long differed;           ///< Of those, the ones whose outputs differed.
+  long max_wake_late;      ///< Latest wakeup, in ns after the nominal time.
+  double mean;             ///< Mean cycle time, in ns.
+  uint64_t min;            ///< Shortest cycle time, in ns.
+  double values[8];        ///< Values that `-b` can bound, indexed like `bound_names`.
+  stress_pll_t plls[MAX_MASTERS];
+  int master_count;
+} stress_result_t;
+
+static void usage(void) {
+  fprintf(stderr, "usage: %s [options] <config.xml>\n", modname);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Runs the drivers configured in <config.xml> on the simulator at a fixed\n");
+  fprintf(stderr, "period while injecting faults, and checks cycle time, output\n");
+  fprintf(stderr, "correctness, and the DC PLL against bounds.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "options:\n");
+  fprintf(stderr, "  -n <cycles>          cycles to run (default %d)\n", DEFAULT_CYCLES);
+  fprintf(stderr, "  -P <ns>              thread period (default: the first master's appTimePeriod)\n");
+  fprintf(stderr, "  -S <seed>            random seed (default %d)\n", DEFAULT_SEED);
+  fprintf(stderr, "  -j <ns>              random delay of up to <ns> on every wakeup\n");
+  fprintf(stderr, "  -L <rate>[:<ns>]     wake up <ns> late in this fraction of cycles\n");
+  fprintf(stderr, "                       (default: half a period late)\n");
+  fprintf(stderr, "  -d <rate>            lose the frame in this fraction of cycles\n");
+  fprintf(stderr, "  -w <rate>            have one slave miss the frame in this fraction of cycles\n");
+  fprintf(stderr, "  -f <rate>[:<cycles>] drop a slave to SAFEOP for <cycles> in this fraction of\n");
+  fprintf(stderr, "                       cycles (default %d cycles)\n", DEFAULT_FLAP);
+  fprintf(stderr, "  -D <ppm>             run the reference clock <ppm> fast, or slow if negative\n");
+  fprintf(stderr, "  -r <cycles>          cycles after a fault during which outputs may differ\n");
+  fprintf(stderr, "                       (default %d)\n", DEFAULT_RECOVERY);
+  fprintf(stderr, "  -b <name>=<limit>    fail if <name> is above <limit>; may be repeated.  Names\n");
+  fprintf(stderr, "                       are p50, p99, p99.9, p99.99, and max cycle time in ns,\n");
+  fprintf(stderr, "                       wrong cycles, pll-err in ns, and pll-resets\n");
+  fprintf(stderr, "  -x <prefix>          don't compare pins starting with <prefix>; may be repeated\n");
+  fprintf(stderr, "  -s <pin>=<value>     set a pin or param before the first cycle; may be repeated\n");
+  fprintf(stderr, "  -o <file>            write one line of CSV per cycle to <file>\n");
+  fprintf(stderr, "  -v                   print more messages; may be repeated\n");
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// @brief xorshift64*, so each stream of random numbers is the same on every run.
+static uint64_t next_random(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/// @brief True with probability `rate`.
+static int chance(uint64_t *state, double rate) {
+  return rate > 0 && (next_random(state) >> 11) * (1.0 / 9007199254740992.0) < rate;
+}
+
+static uint64_t seed_stream(uint64_t seed, uint64_t stream) {
+  uint64_t state = (seed + 1) * 0x9E3779B97F4A7C15ULL + stream;
+
+  return (state != 0) ? state : 1;
+}
+
+/// @brief Copy `bits` bits, least significant first, as on the bus.
+static void copy_bits(uint8_t *dst, uint32_t dst_bit, const uint8_t *src, uint32_t src_bit, uint32_t bits) {
+  uint32_t i, s, d;
+
+  if (dst_bit == 0 && src_bit == 0 && bits % 8 == 0) {
+    memcpy(dst, src, bits / 8);
+    return;
+  }
+  for (i = 0; i < bits; i++) {
+    s = src_bit + i;
+    d = dst_bit + i;
+    if ((src[s / 8] >> (s % 8)) & 1) {
+      dst[d / 8] |= 1 << (d % 8);
+    } else {
+      dst[d / 8] &= ~(1 << (d % 8));
+    }
+  }
+}
+
+/// @brief FNV-1a.
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+  const uint8_t *p = data;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    hash = (hash ^ p[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/// @brief Parse `<rate>[:<value>]`, leaving `value` alone if it isn't given.
+static void parse_rate(const char *arg, double *rate, long *value) {
+  const char *colon = strchr(arg, ':');
+
+  *rate = atof(arg);
+  if (colon != NULL) {
+    *value = atol(colon + 1);
+  }
+}
+
+static int add_entries(stress_run_t *run, int m, unsigned int index) {
+  const sim_entry_t *entries;
+  stress_entry_t *e;
+  uint8_t *data;
+  size_t size;
+  int count, i;
+
+  if ((count = sim_master_entries(index, &entries)) < 0 || (data = sim_master_data(index, &size)) == NULL) {
+    return 0;
+  }
+  run->inputs = realloc(run->inputs, (run->input_count + count + 1) * sizeof(stress_entry_t));
+  run->outputs = realloc(run->outputs, (run->output_count + count + 1) * sizeof(stress_entry_t));
+  if (run->inputs == NULL || run->outputs == NULL) {
+    return -1;
+  }
+  for (i = 0; i < count; i++) {
+    // entries that aren't in a known mapping have no known size
+    if (entries[i].bit_length == 0 || entries[i].offset + (entries[i].bit_position + entries[i].bit_length + 7) / 8 > size) {
+      continue;
+    }
+    e = entries[i].output ? &run->outputs[run->output_count++] : &run->inputs[run->input_count++];
+    e->data = data;
+    e->offset = entries[i].offset;
+    e->bit_position = entries[i].bit_position;
+    e->bits = entries[i].bit_length;
+    e->master = m;
+    e->position = entries[i].position;
+    e->index = entries[i].index;
+    e->subindex = entries[i].subindex;
+  }
+  return 0;
+}
+
+static int pin_skipped(const sim_pin_t *pin, const stress_opts_t *opts) {
+  int i;
+
+  for (i = 0; i < opts->skip_count; i++) {
+    if (strncmp(pin->name, opts->skips[i], strlen(opts->skips[i])) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/// @brief Find the masters, slaves, PDO entries, and pins of the loaded config.
+static int setup_run(stress_run_t *run, const stress_opts_t *opts) {
+  char name[LCEC_CONF_STR_MAXLEN * 2 + 32], prefix[LCEC_CONF_STR_MAXLEN * 3 + 32];
+  const char *pin_name, *end;
+  stress_master_t *sm;
+  lcec_slave_t *slave;
+  sim_pin_t *pin;
+  size_t len;
+  int i, m, count;
+
+  memset(run, 0, sizeof(*run));
+
+  // every master has a pll-err pin, whether or not it uses the PLL
+  for (i = 0; i < sim_pin_count() && run->master_count < MAX_MASTERS; i++) {
+    pin_name = sim_pin(i)->name;
+    len = strlen(pin_name);
+    if (strncmp(pin_name, LCEC_MODULE_NAME ".", strlen(LCEC_MODULE_NAME) + 1) != 0 || len < 9 ||
+        strcmp(pin_name + len - 8, ".pll-err") != 0) {
+      continue;
+    }
+    pin_name += strlen(LCEC_MODULE_NAME) + 1;
+    end = strrchr(pin_name, '.');
+    snprintf(name, sizeof(name), "%s.%.*s.read", LCEC_MODULE_NAME, (int)(end - pin_name), pin_name);
+    sm = &run->masters[run->master_count];
+    if ((sm->master = sim_funct_arg(name)) == NULL) {
+      continue;
+    }
+    sm->pll_err = sim_pin(i);
+    snprintf(name, sizeof(name), "%s.%s.pll-locked", LCEC_MODULE_NAME, sm->master->name);
+    sm->pll_locked = sim_pin_find(name);
+    snprintf(name, sizeof(name), "%s.%s.pll-reset-count", LCEC_MODULE_NAME, sm->master->name);
+    sm->pll_reset_cnt = sim_pin_find(name);
+    run->master_count++;
+  }
+
+  for (m = 0, count = 0; m < run->master_count; m++) {
+    for (slave = run->masters[m].master->first_slave; slave != NULL; slave = slave->next) {
+      count++;
+    }
+  }
+  if ((run->slaves = calloc(count + 1, sizeof(stress_slave_t))) == NULL ||
+      (run->pins = calloc(sim_pin_count() + 1, sizeof(sim_pin_t *))) == NULL) {
+    return -1;
+  }
+
+  for (m = 0; m < run->master_count; m++) {
+    for (slave = run->masters[m].master->first_slave; slave != NULL; slave = slave->next) {
+      run->slaves[run->slave_count].master = m;
+      run->slaves[run->slave_count].position = slave->index;
+      run->slave_count++;
+    }
+    if (add_entries(run, m, run->masters[m].master->index) != 0) {
+      return -1;
+    }
+  }
+
+  // only slave pins are compared; the master's pins report timing
+  for (i = 0; i < sim_pin_count(); i++) {
+    pin = sim_pin(i);
+    if (pin->is_param || !(pin->dir & HAL_OUT) || pin_skipped(pin, opts)) {
+      continue;
+    }
+    for (m = 0, slave = NULL; m < run->master_count && slave == NULL; m++) {
+      for (slave = run->masters[m].master->first_slave; slave != NULL; slave = slave->next) {
+        snprintf(prefix, sizeof(prefix), "%s.%s.%s.", LCEC_MODULE_NAME, run->masters[m].master->name, slave->name);
+        if (strncmp(pin->name, prefix, strlen(prefix)) == 0) {
+          run->pins[run->pin_count++] = pin;
+          break;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+static void free_run(stress_run_t *run) {
+  free(run->slaves);
+  free(run->inputs);
+  free(run->outputs);
+  free(run->pins);
+}
+
+/// @brief Hash everything the cycle produced.
+static uint64_t hash_outputs(const stress_run_t *run) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  const stress_entry_t *e;
+  uint8_t buf[32];
+  double value;
+  int i;
+
+  for (i = 0; i < run->output_count; i++) {
+    e = &run->outputs[i];
+    memset(buf, 0, sizeof(buf));
+    copy_bits(buf, 0, e->data + e->offset, e->bit_position, e->bits);
+    hash = hash_bytes(hash, buf, (e->bits + 7) / 8);
+  }
+  for (i = 0; i < run->pin_count; i++) {
+    value = sim_pin_get(run->pins[i]);
+    hash = hash_bytes(hash, &value, sizeof(value));
+  }
+  return hash;
+}
+
+/// @brief Format one output PDO entry as hex, most significant byte first.
+static void format_entry(const stress_entry_t *e, char *buf, size_t len) {
+  uint8_t bytes[32];
+  size_t n;
+  int i;
+
+  memset(bytes, 0, sizeof(bytes));
+  copy_bits(bytes, 0, e->data + e->offset, e->bit_position, e->bits);
+  n = snprintf(buf, len, "0x");
+  for (i = (e->bits + 7) / 8 - 1; i >= 0 && n < len; i--) {
+    n += snprintf(buf + n, len - n, "%02x", bytes[i]);
+  }
+}
+
+/// @brief Keep the name and value of everything `hash_outputs()` covers.
+static int take_snapshot(const stress_run_t *run, stress_snapshot_t *snap, long cycle) {
+  const stress_entry_t *e;
+  char name[LCEC_CONF_STR_MAXLEN + 32], value[80];
+  int i;
+
+  snap->cycle = cycle;
+  snap->count = run->output_count + run->pin_count;
+  if ((snap->names = calloc(snap->count + 1, sizeof(char *))) == NULL || (snap->values = calloc(snap->count + 1, sizeof(char *))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < snap->count; i++) {
+    if (i < run->output_count) {
+      e = &run->outputs[i];
+      snprintf(name, sizeof(name), "%s.%s slave %d pdo 0x%04x:%02x", LCEC_MODULE_NAME, run->masters[e->master].master->name, e->position,
+          e->index, e->subindex);
+      format_entry(e, value, sizeof(value));
+    } else {
+      snprintf(name, sizeof(name), "%s", run->pins[i - run->output_count]->name);
+      sim_pin_format(run->pins[i - run->output_count], value, sizeof(value));
+    }
+    if ((snap->names[i] = strdup(name)) == NULL || (snap->values[i] = strdup(value)) == NULL) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static void free_snapshot(stress_snapshot_t *snap) {
+  int i;
+
+  for (i = 0; i < snap->count && snap->names != NULL && snap->values != NULL; i++) {
+    free(snap->names[i]);
+    free(snap->values[i]);
+  }
+  free(snap->names);
+  free(snap->values);
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+/// @brief The `p`th quantile of `count` sorted samples.
+static double quantile(const uint64_t *sorted, long count, double p) {
+  long i = (long)(p * count + 0.999999) - 1;
+
+  if (i < 0) i = 0;
+  if (i >= count) i = count - 1;
+  return (double)sorted[i];
+}
+
+/// @brief Load the config and run it once.
+///
+/// With `faults` false, this stores each cycle's output hash in
+/// `hashes`.  With it true, it injects faults and compares against
+/// them.  If `snap` isn't NULL, it keeps the outputs of cycle
+/// `snap->cycle`, or of the first wrong cycle if that is -1.
+static int run_cycles(const char *config, stress_opts_t *opts, int faults, uint64_t *hashes, stress_result_t *result, FILE *csv,
+    stress_snapshot_t *snap) {
+  uint64_t input_rng = seed_stream(opts->seed, 1), timing_rng = seed_stream(opts->seed, 2), fault_rng = seed_stream(opts->seed, 3);
+  const char *value;
+  char name[LCEC_CONF_STR_MAXLEN * 2 + 32];
+  stress_run_t run;
+  stress_master_t *sm;
+  stress_entry_t *e;
+  stress_slave_t *lost_slave, *flap_slave = NULL;
+  uint64_t *samples = NULL, random[4], start, hash, sum = 0;
+  long long wake, now;
+  long k, total = opts->cycles + WARMUP_CYCLES, correction = 0, disturbed_until = -1, flap_end = 0, err, until;
+  int lost_master, fault, i, m, ret = -1;
+
+  memset(result, 0, sizeof(*result));
+  sim_set_time(0);
+  if (sim_start(config) != 0) {
+    fprintf(stderr, "%s: ERROR: unable to load %s\n", modname, config);
+    return -1;
+  }
+  if (setup_run(&run, opts) != 0 || run.master_count == 0) {
+    fprintf(stderr, "%s: ERROR: no masters in %s\n", modname, config);
+    goto out;
+  }
+  for (i = 0; i < opts->setp_count; i++) {
+    value = strchr(opts->setps[i], '=');
+    snprintf(name, sizeof(name), "%.*s", value != NULL ? (int)(value - opts->setps[i]) : (int)strlen(opts->setps[i]),
+        opts->setps[i]);
+    if (value == NULL || sim_setp(name, value + 1) != 0) {
+      fprintf(stderr, "%s: ERROR: unable to set %s\n", modname, opts->setps[i]);
+      goto out;
+    }
+  }
+  if (opts->period <= 0) {
+    opts->period = run.masters[0].master->app_time_period;
+  }
+  if (opts->late_ns <= 0) {
+    opts->late_ns = opts->period / 2;
+  }
+  for (m = 0; m < run.master_count; m++) {
+    sim_master_set_clock_drift(run.masters[m].master->index, opts->drift);
+    run.masters[m].state_cycles = run.masters[m].master->state_update_period / opts->period + 1;
+  }
+  if (faults && (samples = malloc(opts->cycles * sizeof(uint64_t))) == NULL) {
+    goto out;
+  }
+  if (csv != NULL) {
+    fprintf(csv, "cycle,wake,time,cycle_ns,fault,disturbed,differed,pll_err,pll_correction\n");
+  }
+
+  wake = 0;
+  for (k = 0; k < total; k++) {
+    wake += opts->period + correction;
+    now = wake + ((opts->jitter > 0) ? (long long)(next_random(&timing_rng) % (opts->jitter + 1)) : 0);
+
+    // inject this cycle's faults; the first cycles let the slaves come up
+    fault = 0;
+    lost_master = -1;
+    lost_slave = NULL;
+    if (flap_slave != NULL && k >= flap_end) {
+      sim_slave_set_state(run.masters[flap_slave->master].master->index, flap_slave->position, 0);
+      flap_slave = NULL;
+    }
+    if (faults && k >= WARMUP_CYCLES) {
+      if (chance(&fault_rng, opts->late_rate)) {
+        now += opts->late_ns;
+        result->late++;
+        fault = 1;
+      }
+      if (chance(&fault_rng, opts->drop_rate)) {
+        lost_master = next_random(&fault_rng) % run.master_count;
+        sim_master_lose_frames(run.masters[lost_master].master->index, 1);
+        result->dropped++;
+        fault = 1;
+      }
+      if (chance(&fault_rng, opts->wc_rate) && run.slave_count > 0) {
+        lost_slave = &run.slaves[next_random(&fault_rng) % run.slave_count];
+        sim_slave_lose_frames(run.masters[lost_slave->master].master->index, lost_slave->position, 1);
+        result->wc_errors++;
+        fault = 1;
+      }
+      if (flap_slave == NULL && chance(&fault_rng, opts->flap_rate) && run.slave_count > 0) {
+        flap_slave = &run.slaves[next_random(&fault_rng) % run.slave_count];
+        sim_slave_set_state(run.masters[flap_slave->master].master->index, flap_slave->position, EC_AL_STATE_SAFEOP);
+        flap_end = k + opts->flap_cycles;
+        result->flaps++;
+        fault = 1;
+
+        // the state pins only catch up once lcec has polled the slave again
+        until = flap_end + run.masters[flap_slave->master].state_cycles + opts->recovery;
+        if (until > disturbed_until) {
+          disturbed_until = until;
+        }
+      }
+      if (fault && k + opts->recovery > disturbed_until) {
+        disturbed_until = k + opts->recovery;
+      }
+    }
+    if (k >= WARMUP_CYCLES && now - wake > result->max_wake_late) {
+      result->max_wake_late = now - wake;
+    }
+
+    // new inputs arrive unless the frame, or the slave's part of it, was lost
+    for (i = 0; i < run.input_count; i++) {
+      e = &run.inputs[i];
+      random[0] = next_random(&input_rng);
+      random[1] = next_random(&input_rng);
+      random[2] = next_random(&input_rng);
+      random[3] = next_random(&input_rng);
+      if (e->master == lost_master || (lost_slave != NULL && e->master == lost_slave->master && e->position == lost_slave->position)) {
+        continue;
+      }
+      copy_bits(e->data + e->offset, e->bit_position, (const uint8_t *)random, 0, e->bits);
+    }
+
+    sim_set_pll_reference(wake);
+    sim_set_time(now);
+    start = now_ns();
+    sim_call(LCEC_MODULE_NAME ".read-all", opts->period);
+    sim_call(LCEC_MODULE_NAME ".write-all", opts->period);
+    start = now_ns() - start;
+    correction = sim_pll_correction();
+    hash = hash_outputs(&run);
+
+    for (m = 0; m < run.master_count; m++) {
+      sm = &run.masters[m];
+      err = (long)sim_pin_get(sm->pll_err);
+      if (sm->pll_locked != NULL && sim_pin_get(sm->pll_locked) != 0) {
+        sm->locked = 1;
+      }
+      if (k >= WARMUP_CYCLES && sm->locked && labs(err) > sm->max_err) {
+        sm->max_err = labs(err);
+      }
+    }
+
+    if (snap != NULL && snap->names == NULL &&
+        (k == snap->cycle || (snap->cycle < 0 && faults && k >= WARMUP_CYCLES && k > disturbed_until && hash != hashes[k])) &&
+        take_snapshot(&run, snap, k) != 0) {
+      goto out;
+    }
+    if (!faults) {
+      hashes[k] = hash;
+    } else if (k >= WARMUP_CYCLES) {
+      samples[k - WARMUP_CYCLES] = start;
+      sum += start;
+      if (k <= disturbed_until) {
+        result->disturbed++;
+        result->differed += (hash != hashes[k]);
+      } else if (hash != hashes[k]) {
+        result->values[VALUE_WRONG]++;
+      }
+    }
+    if (csv != NULL) {
+      fprintf(csv, "%ld,%lld,%lld,%llu,%d,%d,%d,%ld,%ld\n", k, wake, now, (unsigned long long)start, fault, k <= disturbed_until,
+          hash != (faults ? hashes[k] : hash), (long)sim_pin_get(run.masters[0].pll_err), correction);
+    }
+  }
+
+  if (faults) {
+    qsort(samples, opts->cycles, sizeof(uint64_t), compare_u64);
+    result->min = samples[0];
+    result->mean = (double)sum / opts->cycles;
+    result->values[VALUE_P50] = quantile(samples, opts->cycles, 0.5);
+    result->values[VALUE_P99] = quantile(samples, opts->cycles, 0.99);
+    result->values[VALUE_P999] = quantile(samples, opts->cycles, 0.999);
+    result->values[VALUE_P9999] = quantile(samples, opts->cycles, 0.9999);
+    result->values[VALUE_MAX] = samples[opts->cycles - 1];
+    result->values[VALUE_PLL_ERR] = -1;
+    for (m = 0; m < run.master_count; m++) {
+      sm = &run.masters[m];
+      snprintf(result->plls[m].name, sizeof(result->plls[m].name), "%s", sm->master->name);
+      result->plls[m].locked = sm->locked;
+      result->plls[m].max_err = sm->max_err;
+      result->plls[m].resets = (sm->pll_reset_cnt != NULL) ? (long)sim_pin_get(sm->pll_reset_cnt) : 0;
+      if (sm->locked && sm->max_err > result->values[VALUE_PLL_ERR]) {
+        result->values[VALUE_PLL_ERR] = sm->max_err;
+      }
+      result->values[VALUE_PLL_RESETS] += result->plls[m].resets;
+    }
+    result->master_count = run.master_count;
+  }
+  ret = 0;
+
+out:
+  free(samples);
+  free_run(&run);
+  sim_stop();
+  return ret;
+}
+
+/// @brief Print what differed in the first wrong cycle.
+static void print_differences(const stress_snapshot_t *expected, const stress_snapshot_t *got) {
+  int i;
+
+  printf("\nfirst wrong cycle %ld:\n", got->cycle);
+  for (i = 0; i < got->count && i < expected->count; i++) {
+    if (strcmp(got->values[i], expected->values[i]) != 0) {
+      printf("  %-48s %16s, expected %s\n", got->names[i], got->values[i], expected->values[i]);
+    }
+  }
+}
+
+static void print_result(const stress_opts_t *opts, const stress_result_t *r) {
+  int m;
+
+  printf("cycles            %ld at %ld ns, after %d to start up\n", opts->cycles, opts->period, WARMUP_CYCLES);
+  printf("faults            %ld late, %ld lost frames, %ld missed by a slave, %ld SAFEOP flaps\n", r->late, r->dropped,
+      r->wc_errors, r->flaps);
+  printf("latest wakeup     %ld ns\n", r->max_wake_late);
+  printf("disturbed cycles  %ld, with different outputs in %ld\n", r->disturbed, r->differed);
+  printf("wrong cycles      %.0f\n", r->values[VALUE_WRONG]);
+  printf("\n");
+  printf("%10s %10s %10s %10s %10s %10s %10s\n", "min-ns", "mean-ns", "p50-ns", "p99-ns", "p99.9-ns", "p99.99-ns", "max-ns");
+  printf("%10llu %10.0f %10.0f %10.0f %10.0f %10.0f %10.0f\n", (unsigned long long)r->min, r->mean, r->values[VALUE_P50],
+      r->values[VALUE_P99], r->values[VALUE_P999], r->values[VALUE_P9999], r->values[VALUE_MAX]);
+  printf("\n");
+  printf("%-24s %10s %10s %10s\n", "master", "pll-locked", "max-err-ns", "resets");
+  for (m = 0; m < r->master_count; m++) {
+    printf("%-24s %10s %10ld %10ld\n", r->plls[m].name, r->plls[m].locked ? "yes" : "no", r->plls[m].max_err, r->plls[m].resets);
+  }
+}
+
+/// @brief Check the results against each `-b`, and return the number that failed.
+static int check_bounds(const stress_result_t *r, const char **bounds, int bound_count) {
+  const char *limit;
+  size_t len;
+  int i, b, failed = 0;
+
+  if (bound_count > 0) {
+    printf("\n");
+  }
+  for (i = 0; i < bound_count; i++) {
+    limit = strchr(bounds[i], '=');
+    len = limit - bounds[i];
+    for (b = 0; b < (int)BOUND_COUNT; b++) {
+      if (strlen(bound_names[b]) == len && strncmp(bounds[i], bound_names[b], len) == 0) {
+        break;
+      }
+    }
+    if (b == VALUE_PLL_ERR && r->values[b] < 0) {
+      printf("%-12s %12s  <= %-12s FAIL\n", bound_names[b], "not locked", limit + 1);
+      failed++;
+    } else if (r->values[b] > atof(limit + 1)) {
+      printf("%-12s %12.0f  <= %-12s FAIL\n", bound_names[b], r->values[b], limit + 1);
+      failed++;
+    } else {
+      printf("%-12s %12.0f  <= %-12s ok\n", bound_names[b], r->values[b], limit + 1);
+    }
+  }
+  return failed;
+}
+
+/// @brief True if `bound` is `<name>=<limit>` with a known name.
+static int valid_bound(const char *bound) {
+  const char *limit = strchr(bound, '=');
+  size_t b;
+
+  for (b = 0; limit != NULL && b < BOUND_COUNT; b++) {
+    if (strlen(bound_names[b]) == (size_t)(limit - bound) && strncmp(bound, bound_names[b], limit - bound) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const char *setps[MAX_SETPS], *bounds[MAX_SETPS], *skips[MAX_SETPS];
+  const char *output = NULL;
+  stress_opts_t opts;
+  stress_result_t result, unused;
+  stress_snapshot_t got, expected;
+  uint64_t *hashes = NULL;
+  FILE *csv = NULL;
+  long flap_cycles = DEFAULT_FLAP;
+  int opt, bound_count = 0, verbose = RTAPI_MSG_ERR, ret = 1;
+
+  memset(&opts, 0, sizeof(opts));
+  opts.cycles = DEFAULT_CYCLES;
+  opts.seed = DEFAULT_SEED;
+  opts.recovery = DEFAULT_RECOVERY;
+  opts.setps = setps;
+  opts.skips = skips;
+  memset(&got, 0, sizeof(got));
+  memset(&expected, 0, sizeof(expected));
+  got.cycle = -1;
+
+  while ((opt = getopt(argc, argv, "n:P:S:j:L:d:w:f:D:r:b:x:s:o:vh")) != -1) {
+    switch (opt) {
+      case 'n':
+        opts.cycles = atol(optarg);
+        break;
+      case 'P':
+        opts.period = atol(optarg);
+        break;
+      case 'S':
+        opts.seed = strtoull(optarg, NULL, 0);
+        break;
+      case 'j':
+        opts.jitter = atol(optarg);
+        break;
+      case 'L':
+        parse_rate(optarg, &opts.late_rate, &opts.late_ns);
+        break;
+      case 'd':
+        opts.drop_rate = atof(optarg);
+        break;
+      case 'w':
+        opts.wc_rate = atof(optarg);
+        break;
+      case 'f':
+        parse_rate(optarg, &opts.flap_rate, &flap_cycles);
+        break;
+      case 'D':
+        opts.drift = atof(optarg);
+        break;
+      case 'r':
+        opts.recovery = atoi(optarg);
+        break;
+      case 'b':
+        if (!valid_bound(optarg)) {
+          fprintf(stderr, "%s: ERROR: unknown bound %s\n", modname, optarg);
+          return 1;
+        }
+        if (bound_count < MAX_SETPS) bounds[bound_count++] = optarg;
+        break;
+      case 'x':
+        if (opts.skip_count < MAX_SETPS) skips[opts.skip_count++] = optarg;
+        break;
+      case 's':
+        if (opts.setp_count < MAX_SETPS) setps[opts.setp_count++] = optarg;
+        break;
+      case 'o':
+        output = optarg;
+        break;
+      case 'v':
+        verbose++;
+        break;
+      case 'h':
+      default:
+        usage();
+        return (opt == 'h') ? 0 : 1;
+    }
+  }
+  opts.flap_cycles = (int)flap_cycles;
+  if (argc - optind != 1 || opts.cycles < 1 || opts.jitter < 0 || opts.recovery < 0 || opts.flap_cycles < 1) {
+    usage();
+    return 1;
+  }
+
+  if ((hashes = calloc(opts.cycles + WARMUP_CYCLES, sizeof(uint64_t))) == NULL) {
+    return 1;
+  }
+  if (output != NULL && (csv = fopen(output, "w")) == NULL) {
+    fprintf(stderr, "%s: ERROR: unable to open %s\n", modname, output);
+    goto out;
+  }
+  sim_set_msg_level(verbose);
+
+  // run once without faults to learn what the outputs should be
+  if (run_cycles(argv[optind], &opts, 0, hashes, &unused, NULL, NULL) != 0 ||
+      run_cycles(argv[optind], &opts, 1, hashes, &result, csv, &got) != 0) {
+    goto out;
+  }
+  print_result(&opts, &result);
+
+  // run the first wrong cycle again without faults to see what it should have been
+  if (got.names != NULL) {
+    expected.cycle = got.cycle;
+    if (run_cycles(argv[optind], &opts, 0, hashes, &unused, NULL, &expected) != 0) {
+      goto out;
+    }
+    print_differences(&expected, &got);
+  }
+  ret = (check_bounds(&result, bounds, bound_count) > 0) ? 1 : 0;
+
+out:
+  if (csv != NULL) {
+    fclose(csv);
+  }
+  free_snapshot(&got);
+  free_snapshot(&expected);
+  free(hashes);
+  return ret;
+}
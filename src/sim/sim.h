@@ -0,0 +1,108 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Run `lcec` in an ordinary process, without HAL or hardware
+///
+/// The simulator links `lcec_main.c`, the common code, every device
+/// driver, and `lcec_conf`'s parser into a single program, and
+/// replaces the HAL, RTAPI, and EtherCAT master libraries with small
+/// in-process stand-ins:
+///
+/// - `sim_hal.c` keeps HAL pins, params, and functs in a table, keeps
+///   RTAPI shared memory in `malloc()`ed blocks, and runs
+///   `rtapi_get_time()` from a clock that only moves when
+///   `sim_set_time()` is called.
+/// - `sim_ecrt.c` is a master with a bus of virtual slaves, each with
+///   an object dictionary.  Unless `sim_slave_add()` says otherwise,
+///   every configured slave is present and goes to OP.  PDO entries
+///   are placed the way the IgH master places them, and domains are
+///   laid out back to back in one block per master, which
+///   `sim_master_data()` returns, so process data can be written and
+///   read directly.
+/// - `sim_stack.c` runs `lcec_conf` on a thread and then loads
+///   `lcec` on top of it, the same way `halcmd` would.
+///
+/// The stand-ins are built into `liblcecsim.a`, which takes the place
+/// of `-llinuxcnchal` and `-lethercat`.  Nothing here is realtime, and
+/// they only implement what `lcec` uses.
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+/// @brief A HAL pin or param.
+typedef struct {
+  char name[HAL_NAME_LEN + 1];  ///< Full name.
+  hal_type_t type;              ///< HAL type.
+  int dir;                      ///< `hal_pin_dir_t` for pins, `hal_param_dir_t` for params.
+  int is_param;                 ///< True for params.
+  volatile void *data;          ///< The value.
+  int comp_id;                  ///< Component that created it.
+} sim_pin_t;
+
+/// @brief A PDO entry registered by a driver, as placed by the simulated master.
+typedef struct {
+  uint16_t position;      ///< Slave position on the bus.
+  uint16_t index;         ///< PDO entry index.
+  uint8_t subindex;       ///< PDO entry subindex.
+  uint8_t bit_length;     ///< Size in bits, from the slave's PDO mapping, or 0 if it isn't known.
+  uint8_t output;         ///< True if it is in an output sync manager.
+  uint32_t offset;        ///< Byte offset from `sim_master_data()`.
+  uint32_t bit_position;  ///< Bit offset within that byte.
+} sim_entry_t;
+
+// sim_hal.c
+int sim_pin_count(void);
+sim_pin_t *sim_pin(int n);
+sim_pin_t *sim_pin_find(const char *name);
+double sim_pin_get(const sim_pin_t *pin);
+void sim_pin_set(sim_pin_t *pin, double value);
+int sim_pin_format(const sim_pin_t *pin, char *buf, size_t len);
+int sim_setp(const char *name, const char *value);
+int sim_call(const char *funct, long period);
+void *sim_funct_arg(const char *funct);
+void sim_set_time(long long time);
+long long sim_time(void);
+void sim_set_pll_reference(long long time);
+long sim_pll_correction(void);
+int sim_ready_count(void);
+size_t sim_hal_malloc_bytes(void);
+void sim_set_msg_level(int level);
+void sim_hal_reset(void);
+
+// sim_ecrt.c
+int sim_slave_add(unsigned int master, uint16_t position, uint32_t vendor_id, uint32_t product_code);
+int sim_slave_sdo_set(unsigned int master, uint16_t position, uint16_t index, uint8_t subindex, const void *data, size_t size);
+int sim_slave_sdo_get(unsigned int master, uint16_t position, uint16_t index, uint8_t subindex, void *data, size_t size);
+void sim_ecrt_reset(void);
+int sim_master_entries(unsigned int index, const sim_entry_t **entries);
+uint8_t *sim_master_data(unsigned int index, size_t *size);
+void sim_master_lose_frames(unsigned int index, int cycles);
+int sim_slave_lose_frames(unsigned int master, uint16_t position, int cycles);
+int sim_slave_set_state(unsigned int master, uint16_t position, uint8_t al_state);
+void sim_master_set_clock_drift(unsigned int index, double ppm);
+
+// sim_stack.c
+int sim_start(const char *config);
+void sim_start_times(long long *conf_ns, long long *load_ns);
+void sim_stop(void);
+
+#endif
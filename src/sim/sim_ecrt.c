@@ -0,0 +1,1320 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief In-process stand-in for the EtherCAT master's application interface
+///
+/// Each master has a bus of virtual slaves.  Normally every slave
+/// that is configured is present, matches its config, and goes to
+/// OP when the master is activated.  Once `sim_slave_add()` has been
+/// called for a master, its bus holds only the slaves added that
+/// way, so tests can leave slaves out or put the wrong one in a
+/// position; configs without a matching slave stay offline, and
+/// their part of the process data isn't counted in the working
+/// counter.  Every frame arrives unless `sim_master_lose_frames()`
+/// says otherwise, and every slave answers it unless
+/// `sim_slave_lose_frames()` or `sim_slave_set_state()` say otherwise.
+/// The reference clock runs from the RTAPI clock, faster or slower by
+/// `sim_master_set_clock_drift()`.
+///
+/// Each slave has an object dictionary, which SDO writes and config
+/// SDOs store objects in and SDO reads return them from.  Objects
+/// that were never written read as zeros of the size asked for,
+/// since the real devices' dictionaries aren't known.  IDN reads
+/// return zeros.
+///
+/// Process data is laid out the way the IgH master does it: each
+/// slave's sync manager gets a region of the domain the first time
+/// one of its entries is registered, sized for the sync manager's
+/// whole PDO mapping.  The mapping comes from the config where it has
+/// one, and otherwise from the PDO assignment (`0x1C1x`) and mapping
+/// (`0x16xx`/`0x1Axx`) objects in the slave's dictionary, which hold
+/// its default layout.  Configured mappings are written back to
+/// those objects on activation, like the IgH master does over CoE.
+/// Entries that aren't mapped anywhere get 8 bytes each, since their
+/// size is unknown.
+///
+/// The return types of several `ecrt_*` functions changed from
+/// `void` to `int` in version 1.6, so the prototypes from `ecrt.h`
+/// are renamed out of the way, and everything is defined to return
+/// `int`, which works for callers built against either version.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ecrt_request_master                  sim_hidden_ecrt_request_master
+#define ecrt_release_master                  sim_hidden_ecrt_release_master
+#define ecrt_master_create_domain            sim_hidden_ecrt_master_create_domain
+#define ecrt_master_slave_config             sim_hidden_ecrt_master_slave_config
+#define ecrt_master_sdo_download             sim_hidden_ecrt_master_sdo_download
+#define ecrt_master_sdo_upload               sim_hidden_ecrt_master_sdo_upload
+#define ecrt_master_read_idn                 sim_hidden_ecrt_master_read_idn
+#define ecrt_master_activate                 sim_hidden_ecrt_master_activate
+#define ecrt_master_deactivate               sim_hidden_ecrt_master_deactivate
+#define ecrt_master_send                     sim_hidden_ecrt_master_send
+#define ecrt_master_receive                  sim_hidden_ecrt_master_receive
+#define ecrt_master_state                    sim_hidden_ecrt_master_state
+#define ecrt_master_application_time         sim_hidden_ecrt_master_application_time
+#define ecrt_master_sync_reference_clock     sim_hidden_ecrt_master_sync_reference_clock
+#define ecrt_master_sync_slave_clocks        sim_hidden_ecrt_master_sync_slave_clocks
+#define ecrt_master_reference_clock_time     sim_hidden_ecrt_master_reference_clock_time
+#define ecrt_master_sync_monitor_queue       sim_hidden_ecrt_master_sync_monitor_queue
+#define ecrt_master_sync_monitor_process     sim_hidden_ecrt_master_sync_monitor_process
+#define ecrt_slave_config_watchdog           sim_hidden_ecrt_slave_config_watchdog
+#define ecrt_slave_config_pdos               sim_hidden_ecrt_slave_config_pdos
+#define ecrt_slave_config_dc                 sim_hidden_ecrt_slave_config_dc
+#define ecrt_slave_config_sdo                sim_hidden_ecrt_slave_config_sdo
+#define ecrt_slave_config_complete_sdo       sim_hidden_ecrt_slave_config_complete_sdo
+#define ecrt_slave_config_idn                sim_hidden_ecrt_slave_config_idn
+#define ecrt_slave_config_state              sim_hidden_ecrt_slave_config_state
+#define ecrt_slave_config_create_sdo_request sim_hidden_ecrt_slave_config_create_sdo_request
+#define ecrt_sdo_request_data                sim_hidden_ecrt_sdo_request_data
+#define ecrt_sdo_request_state               sim_hidden_ecrt_sdo_request_state
+#define ecrt_sdo_request_write               sim_hidden_ecrt_sdo_request_write
+#define ecrt_sdo_request_read                sim_hidden_ecrt_sdo_request_read
+#define ecrt_domain_reg_pdo_entry_list       sim_hidden_ecrt_domain_reg_pdo_entry_list
+#define ecrt_domain_size                     sim_hidden_ecrt_domain_size
+#define ecrt_domain_data                     sim_hidden_ecrt_domain_data
+#define ecrt_domain_process                  sim_hidden_ecrt_domain_process
+#define ecrt_domain_queue                    sim_hidden_ecrt_domain_queue
+#define ecrt_domain_state                    sim_hidden_ecrt_domain_state
+#include "ecrt.h"
+#undef ecrt_request_master
+#undef ecrt_release_master
+#undef ecrt_master_create_domain
+#undef ecrt_master_slave_config
+#undef ecrt_master_sdo_download
+#undef ecrt_master_sdo_upload
+#undef ecrt_master_read_idn
+#undef ecrt_master_activate
+#undef ecrt_master_deactivate
+#undef ecrt_master_send
+#undef ecrt_master_receive
+#undef ecrt_master_state
+#undef ecrt_master_application_time
+#undef ecrt_master_sync_reference_clock
+#undef ecrt_master_sync_slave_clocks
+#undef ecrt_master_reference_clock_time
+#undef ecrt_master_sync_monitor_queue
+#undef ecrt_master_sync_monitor_process
+#undef ecrt_slave_config_watchdog
+#undef ecrt_slave_config_pdos
+#undef ecrt_slave_config_dc
+#undef ecrt_slave_config_sdo
+#undef ecrt_slave_config_complete_sdo
+#undef ecrt_slave_config_idn
+#undef ecrt_slave_config_state
+#undef ecrt_slave_config_create_sdo_request
+#undef ecrt_sdo_request_data
+#undef ecrt_sdo_request_state
+#undef ecrt_sdo_request_write
+#undef ecrt_sdo_request_read
+#undef ecrt_domain_reg_pdo_entry_list
+#undef ecrt_domain_size
+#undef ecrt_domain_data
+#undef ecrt_domain_process
+#undef ecrt_domain_queue
+#undef ecrt_domain_state
+
+
+#include "sim.h"
+
+#define SIM_NO_SYNC    0xff  ///< Sync index of the regions used for entries that aren't in a known mapping.
+#define SIM_MAX_MAPPED 256   ///< Most PDO entries mapped into one sync manager.
+#define SIM_BUCKETS    1024  ///< Size of the tables that find slaves and configs by position.
+
+/// @brief An object in a virtual slave's object dictionary.
+typedef struct sim_object {
+  uint16_t index;                ///< Object index.
+  uint8_t subindex;              ///< Object subindex.
+  size_t size;                   ///< Size of `data`.
+  uint8_t *data;                 ///< Value, as written.
+  struct sim_object *next;
+} sim_object_t;
+
+/// @brief A virtual slave on a simulated bus.
+typedef struct sim_slave {
+  unsigned int master;           ///< Master index.
+  uint16_t position;             ///< Position on the bus.
+  uint32_t vendor_id;            ///< Vendor ID.
+  uint32_t product_code;         ///< Product code.
+  int added;                     ///< True if added with `sim_slave_add()`.
+  int lose_frames;               ///< Number of upcoming frames the slave doesn't answer.
+  int lost;                      ///< True if the slave didn't answer the current frame.
+  uint8_t al_state;              ///< State set with `sim_slave_set_state()`, or 0 to follow the master.
+  sim_object_t *objects;         ///< Object dictionary.
+  struct sim_slave *next;
+  struct sim_slave *bucket_next; ///< Next slave in the same `slave_buckets` entry.
+} sim_slave_t;
+
+/// @brief A PDO entry in a sync manager's effective mapping.
+typedef struct {
+  uint16_t index;
+  uint8_t subindex;
+  uint8_t bit_length;
+} sim_mapped_t;
+
+/// @brief An SDO from the slave config, written to the slave on activation.
+typedef struct sim_sdo_config {
+  uint16_t index;                ///< Object index.
+  uint8_t subindex;              ///< Object subindex, ignored with complete access.
+  int complete;                  ///< True for complete access.
+  size_t size;                   ///< Size of `data`.
+  struct sim_sdo_config *next;
+  uint8_t data[];
+} sim_sdo_config_t;
+
+struct ec_sdo_request {
+  struct ec_slave_config *sc;    ///< Slave config the request belongs to.
+  uint16_t index;                ///< Object index.
+  uint8_t subindex;              ///< Object subindex.
+  uint8_t *data;                 ///< Request data.
+  size_t size;                   ///< Size of `data`.
+  ec_request_state_t state;      ///< Request state.
+  struct ec_sdo_request *next;   ///< Next request of the same slave config.
+};
+
+/// @brief One of a slave's regions, so that it can be found without searching the domain.
+typedef struct {
+  struct ec_domain *domain;      ///< Domain the region is in.
+  int index;                     ///< Index into the domain's `fmmus`.
+} sim_fmmu_ref_t;
+
+struct ec_slave_config {
+  struct ec_master *master;      ///< Master the slave belongs to.
+  uint16_t alias;                ///< Slave alias.
+  uint16_t position;             ///< Slave position.
+  uint32_t vendor_id;            ///< Expected vendor ID.
+  uint32_t product_code;         ///< Expected product code.
+  unsigned int n_syncs;          ///< Number of configured sync managers.
+  ec_sync_info_t *syncs;         ///< Copy of the configured PDO mapping.
+  sim_sdo_config_t *sdos;        ///< Config SDOs, in the order they were added.
+  struct ec_sdo_request *requests;
+  sim_fmmu_ref_t *fmmus;         ///< Regions of this slave in any domain, like IgH's `used_fmmus`.
+  int fmmu_count, fmmu_alloc;
+  struct ec_slave_config *next;
+  struct ec_slave_config *bucket_next;  ///< Next config in the same `config_buckets` entry.
+};
+
+/// @brief A region of a domain holding one slave's sync manager, like an IgH FMMU configuration.
+typedef struct {
+  struct ec_slave_config *sc;    ///< Slave config.
+  uint8_t sync_index;            ///< Sync manager, or `SIM_NO_SYNC`.
+  ec_direction_t dir;            ///< Direction of the sync manager.
+  size_t offset;                 ///< Byte offset in the domain.
+  int counted;                   ///< True for the first region of a slave and direction, which adds to the working counter.
+} sim_fmmu_t;
+
+struct ec_domain {
+  struct ec_master *master;      ///< Master the domain belongs to.
+  size_t size;                   ///< Size of the process data, in bytes.
+  size_t offset;                 ///< Offset from the start of the master's process data.
+  uint8_t *data;                 ///< Process data, once the master is active.
+  sim_fmmu_t *fmmus;             ///< Regions, in order of their offsets.
+  int fmmu_count, fmmu_alloc;
+  unsigned int expected_wc;      ///< Working counter when every configured slave answers.
+  unsigned int wc;               ///< Working counter of the slaves that are there, set on activation.
+  ec_domain_state_t state;       ///< State after the last `ecrt_domain_process()`.
+  struct ec_domain *next;
+};
+
+struct ec_master {
+  unsigned int index;            ///< Master index.
+  int active;                    ///< True once activated.
+  struct ec_slave_config *configs;
+  struct ec_slave_config *config_buckets[SIM_BUCKETS];  ///< `configs` by position.
+  struct ec_domain *domains;
+  sim_entry_t *entries;          ///< Registered PDO entries; offsets are relative to `domains` until activation.
+  struct ec_domain **entry_domains;
+  int entry_count, entry_alloc;
+  uint8_t *data;                 ///< Process data of all domains.
+  size_t size;                   ///< Size of `data`.
+  int lose_frames;               ///< Number of upcoming cycles whose frames are lost.
+  int lost;                      ///< True if the current cycle's frame was lost.
+  uint64_t app_time;             ///< Last application time.
+  uint64_t ref_time;             ///< Reference clock time of the last send.
+  int ref_valid;                 ///< True once a frame has been sent.
+  int64_t ref_offset;            ///< Reference clock time at RTAPI time 0.
+  double clock_drift;            ///< How much faster the reference clock runs than the RTAPI clock, in ppm.
+  struct ec_master *next;
+};
+
+static struct ec_master *masters;
+static sim_slave_t *slaves;
+static sim_slave_t *slave_buckets[SIM_BUCKETS];  ///< `slaves` by master and position, so big buses stay fast.
+static int faulty_slaves;                        ///< Slaves that miss frames or were put in another state.
+
+static unsigned int slave_bucket(unsigned int master, uint16_t position) { return (master * 4099 + position) % SIM_BUCKETS; }
+
+static struct ec_master *find_master(unsigned int index) {
+  struct ec_master *master;
+
+  for (master = masters; master != NULL; master = master->next) {
+    if (master->index == index) {
+      return master;
+    }
+  }
+  return NULL;
+}
+
+static sim_slave_t *find_slave(unsigned int master, uint16_t position) {
+  sim_slave_t *slave;
+
+  for (slave = slave_buckets[slave_bucket(master, position)]; slave != NULL; slave = slave->bucket_next) {
+    if (slave->master == master && slave->position == position) {
+      return slave;
+    }
+  }
+  return NULL;
+}
+
+/// @brief True if a master's bus holds only the slaves added with `sim_slave_add()`.
+static int bus_is_fixed(unsigned int master) {
+  sim_slave_t *slave;
+
+  for (slave = slaves; slave != NULL; slave = slave->next) {
+    if (slave->master == master && slave->added) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static sim_slave_t *new_slave(unsigned int master, uint16_t position, uint32_t vendor_id, uint32_t product_code) {
+  sim_slave_t *slave;
+
+  if ((slave = calloc(1, sizeof(sim_slave_t))) == NULL) {
+    return NULL;
+  }
+  slave->master = master;
+  slave->position = position;
+  slave->vendor_id = vendor_id;
+  slave->product_code = product_code;
+  slave->next = slaves;
+  slaves = slave;
+  slave->bucket_next = slave_buckets[slave_bucket(master, position)];
+  slave_buckets[slave_bucket(master, position)] = slave;
+  return slave;
+}
+
+/// @brief Get the slave a config is attached to, or NULL if there isn't a matching one.
+static sim_slave_t *config_slave(const struct ec_slave_config *sc) {
+  sim_slave_t *slave = find_slave(sc->master->index, sc->position);
+
+  if (slave == NULL || slave->vendor_id != sc->vendor_id || slave->product_code != sc->product_code) {
+    return NULL;
+  }
+  return slave;
+}
+
+/// @brief Get the config attached to a slave, or NULL if there isn't one.
+static struct ec_slave_config *slave_config(const struct ec_master *master, const sim_slave_t *slave) {
+  struct ec_slave_config *sc;
+
+  for (sc = master->config_buckets[slave->position % SIM_BUCKETS]; sc != NULL; sc = sc->bucket_next) {
+    if (sc->position == slave->position && config_slave(sc) == slave) {
+      return sc;
+    }
+  }
+  return NULL;
+}
+
+/// @brief A slave's AL state: OP once the master is active and the slave has a config, unless a test said otherwise.
+static uint8_t slave_state(const struct ec_master *master, const sim_slave_t *slave, int attached) {
+  if (slave->al_state != 0) {
+    return slave->al_state;
+  }
+  return (attached && master->active) ? EC_AL_STATE_OP : EC_AL_STATE_PREOP;
+}
+
+/// @brief True if a slave counts in `faulty_slaves`.
+static int slave_faulty(const sim_slave_t *slave) { return slave->lose_frames > 0 || slave->lost || slave->al_state != 0; }
+
+static sim_object_t *find_object(const sim_slave_t *slave, uint16_t index, uint8_t subindex) {
+  sim_object_t *obj;
+
+  for (obj = slave->objects; obj != NULL; obj = obj->next) {
+    if (obj->index == index && obj->subindex == subindex) {
+      return obj;
+    }
+  }
+  return NULL;
+}
+
+/// @brief Store an object in a slave's dictionary, replacing its old value.
+static int write_object(sim_slave_t *slave, uint16_t index, uint8_t subindex, const uint8_t *data, size_t size) {
+  sim_object_t *obj = find_object(slave, index, subindex);
+  uint8_t *copy;
+
+  if ((copy = malloc(size > 0 ? size : 1)) == NULL) {
+    return -ENOMEM;
+  }
+  memcpy(copy, data, size);
+
+  if (obj == NULL) {
+    if ((obj = calloc(1, sizeof(sim_object_t))) == NULL) {
+      free(copy);
+      return -ENOMEM;
+    }
+    obj->index = index;
+    obj->subindex = subindex;
+    obj->next = slave->objects;
+    slave->objects = obj;
+  }
+  free(obj->data);
+  obj->data = copy;
+  obj->size = size;
+  return 0;
+}
+
+/// @brief Store a whole object written with complete access.
+///
+/// Subindex 0 comes first, padded to 16 bits.  The rest is split
+/// evenly between the subindexes it counts, which is right for
+/// arrays like PDO assignments and mappings.  Records whose entries
+/// differ in size are kept whole as subindex 1.
+static int write_complete(sim_slave_t *slave, uint16_t index, const uint8_t *data, size_t size) {
+  unsigned int i, count;
+  size_t len;
+  int err;
+
+  if (size < 2) {
+    return write_object(slave, index, 0, data, size);
+  }
+  count = data[0];
+  if ((err = write_object(slave, index, 0, data, 1)) != 0) {
+    return err;
+  }
+  if (count == 0 || size == 2) {
+    return 0;
+  }
+  if ((size - 2) % count != 0) {
+    return write_object(slave, index, 1, data + 2, size - 2);
+  }
+
+  len = (size - 2) / count;
+  for (i = 0; i < count; i++) {
+    if ((err = write_object(slave, index, i + 1, data + 2 + i * len, len)) != 0) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+/// @brief Read an object from a slave's dictionary, like an SDO upload.
+///
+/// Objects that were never written read as `target_size` zeros.
+static int read_object(
+    const sim_slave_t *slave, uint16_t index, uint8_t subindex, uint8_t *target, size_t target_size, size_t *result_size) {
+  const sim_object_t *obj = find_object(slave, index, subindex);
+
+  if (obj == NULL) {
+    memset(target, 0, target_size);
+    *result_size = target_size;
+    return 0;
+  }
+  if (obj->size > target_size) {
+    return -EOVERFLOW;
+  }
+  memcpy(target, obj->data, obj->size);
+  *result_size = obj->size;
+  return 0;
+}
+
+/// @brief Read an unsigned object of up to 32 bits, or 0 if the slave doesn't have it.
+static uint32_t object_value(const sim_slave_t *slave, uint16_t index, uint8_t subindex) {
+  const sim_object_t *obj;
+  uint32_t value = 0;
+  size_t i;
+
+  if (slave == NULL || (obj = find_object(slave, index, subindex)) == NULL) {
+    return 0;
+  }
+  for (i = 0; i < obj->size && i < sizeof(value); i++) {
+    value |= (uint32_t)obj->data[i] << (8 * i);
+  }
+  return value;
+}
+
+static void free_objects(sim_slave_t *slave) {
+  sim_object_t *obj;
+
+  while ((obj = slave->objects) != NULL) {
+    slave->objects = obj->next;
+    free(obj->data);
+    free(obj);
+  }
+}
+
+/// @brief Add a slave to a master's simulated bus.
+///
+/// Once a slave has been added, the bus holds only the slaves added
+/// this way; configs at other positions, or whose vendor ID and
+/// product code don't match, stay offline.  Must be called before the
+/// master is requested.  Returns 0 on success, or -1 if the position
+/// is already taken.
+int sim_slave_add(unsigned int master, uint16_t position, uint32_t vendor_id, uint32_t product_code) {
+  sim_slave_t *slave;
+
+  if (find_slave(master, position) != NULL || (slave = new_slave(master, position, vendor_id, product_code)) == NULL) {
+    return -1;
+  }
+  slave->added = 1;
+  return 0;
+}
+
+/// @brief Make a slave miss the next `cycles` frames.
+///
+/// The slave stays in its state, but its share of the working
+/// counter is missing for those cycles, as when a frame is corrupted
+/// on the way through it.  Returns 0 on success, or -1 if there is no
+/// such slave.
+int sim_slave_lose_frames(unsigned int master, uint16_t position, int cycles) {
+  sim_slave_t *slave = find_slave(master, position);
+
+  if (slave == NULL) {
+    return -1;
+  }
+  faulty_slaves -= slave_faulty(slave);
+  slave->lose_frames = cycles;
+  faulty_slaves += slave_faulty(slave);
+  return 0;
+}
+
+/// @brief Put a slave in an AL state, such as `EC_AL_STATE_SAFEOP`, or 0 to let it follow the master again.
+///
+/// Only slaves in OP add to the working counter.  Returns 0 on
+/// success, or -1 if there is no such slave.
+int sim_slave_set_state(unsigned int master, uint16_t position, uint8_t al_state) {
+  sim_slave_t *slave = find_slave(master, position);
+
+  if (slave == NULL) {
+    return -1;
+  }
+  faulty_slaves -= slave_faulty(slave);
+  slave->al_state = al_state;
+  faulty_slaves += slave_faulty(slave);
+  return 0;
+}
+
+/// @brief Set an object in a slave's dictionary, for example to give it a default PDO mapping.
+///
+/// Values are in the slave's byte order, which is little-endian.
+/// Returns 0 on success, or -1 if there is no such slave.
+int sim_slave_sdo_set(unsigned int master, uint16_t position, uint16_t index, uint8_t subindex, const void *data, size_t size) {
+  sim_slave_t *slave = find_slave(master, position);
+
+  if (slave == NULL || write_object(slave, index, subindex, data, size) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/// @brief Get an object from a slave's dictionary, for example to see what a driver wrote.
+///
+/// Copies up to `size` bytes into `data`, and returns the size of the
+/// object, or -1 if the slave or the object doesn't exist.
+int sim_slave_sdo_get(unsigned int master, uint16_t position, uint16_t index, uint8_t subindex, void *data, size_t size) {
+  sim_slave_t *slave = find_slave(master, position);
+  sim_object_t *obj;
+
+  if (slave == NULL || (obj = find_object(slave, index, subindex)) == NULL) {
+    return -1;
+  }
+  memcpy(data, obj->data, obj->size < size ? obj->size : size);
+  return (int)obj->size;
+}
+
+/// @brief Remove all slaves from every simulated bus.
+///
+/// Masters still requested keep their configs, which go offline.
+void sim_ecrt_reset(void) {
+  sim_slave_t *slave;
+
+  while ((slave = slaves) != NULL) {
+    slaves = slave->next;
+    free_objects(slave);
+    free(slave);
+  }
+  memset(slave_buckets, 0, sizeof(slave_buckets));
+  faulty_slaves = 0;
+}
+
+/// @brief Get the PDO entries registered with a master.
+///
+/// Offsets are only valid once the master is active.  Returns the
+/// number of entries, or -1 if the master doesn't exist.
+int sim_master_entries(unsigned int index, const sim_entry_t **entries) {
+  struct ec_master *master = find_master(index);
+
+  if (master == NULL) {
+    return -1;
+  }
+  *entries = master->entries;
+  return master->entry_count;
+}
+
+/// @brief Get a master's process data, which holds all of its domains back to back.
+uint8_t *sim_master_data(unsigned int index, size_t *size) {
+  struct ec_master *master = find_master(index);
+
+  if (master == NULL || !master->active) {
+    return NULL;
+  }
+  if (size != NULL) {
+    *size = master->size;
+  }
+  return master->data;
+}
+
+/// @brief Drop the frames of a master's next `cycles` receives.
+///
+/// Domains report a working counter of 0 for those cycles, and
+/// their process data isn't touched.
+void sim_master_lose_frames(unsigned int index, int cycles) {
+  struct ec_master *master = find_master(index);
+
+  if (master != NULL) {
+    master->lose_frames = cycles;
+  }
+}
+
+/// @brief Make a master's reference clock run `ppm` parts per million faster than the RTAPI clock.
+///
+/// The reference clock starts at the application time of the first
+/// frame, and runs at the same rate as the RTAPI clock by default.
+void sim_master_set_clock_drift(unsigned int index, double ppm) {
+  struct ec_master *master = find_master(index);
+
+  if (master != NULL) {
+    master->clock_drift = ppm;
+  }
+}
+
+static const ec_sync_info_t *config_sync(const struct ec_slave_config *sc, uint8_t sync_index) {
+  unsigned int i;
+
+  for (i = 0; i < sc->n_syncs; i++) {
+    if (sc->syncs[i].index == sync_index) {
+      return &sc->syncs[i];
+    }
+  }
+  return NULL;
+}
+
+/// @brief Append the entries of one PDO to a mapping, from the config or the slave's dictionary.
+static int pdo_entries(const sim_slave_t *slave, const ec_pdo_info_t *pdo, uint16_t pdo_index, sim_mapped_t *mapped, int count) {
+  unsigned int k, n;
+  uint32_t value;
+
+  if (pdo != NULL && pdo->n_entries > 0) {
+    for (k = 0; k < pdo->n_entries && count < SIM_MAX_MAPPED; k++, count++) {
+      mapped[count].index = pdo->entries[k].index;
+      mapped[count].subindex = pdo->entries[k].subindex;
+      mapped[count].bit_length = pdo->entries[k].bit_length;
+    }
+    return count;
+  }
+
+  n = object_value(slave, pdo_index, 0);
+  for (k = 1; k <= n && count < SIM_MAX_MAPPED; k++, count++) {
+    value = object_value(slave, pdo_index, k);
+    mapped[count].index = value >> 16;
+    mapped[count].subindex = (value >> 8) & 0xff;
+    mapped[count].bit_length = value & 0xff;
+  }
+  return count;
+}
+
+/// @brief Get the PDO entries a slave maps into one of its sync managers.
+///
+/// Like the IgH master, the config's PDO assignment replaces the
+/// slave's default one, and PDOs that the config lists without
+/// entries keep the slave's default mapping.  Returns the number of
+/// entries, and sets `*dir` to the sync manager's direction.
+static int sync_mapping(const struct ec_slave_config *sc, uint8_t sync_index, sim_mapped_t *mapped, ec_direction_t *dir) {
+  const ec_sync_info_t *sync = config_sync(sc, sync_index);
+  const sim_slave_t *slave = config_slave(sc);
+  unsigned int j, n;
+  uint16_t pdo_index = 0;
+  int count = 0;
+
+  if (sync != NULL && sync->n_pdos > 0) {
+    for (j = 0; j < sync->n_pdos; j++) {
+      count = pdo_entries(slave, &sync->pdos[j], sync->pdos[j].index, mapped, count);
+    }
+    pdo_index = sync->pdos[0].index;
+  } else {
+    n = object_value(slave, 0x1c10 + sync_index, 0);
+    for (j = 1; j <= n; j++) {
+      pdo_index = object_value(slave, 0x1c10 + sync_index, j);
+      count = pdo_entries(slave, NULL, pdo_index, mapped, count);
+    }
+  }
+
+  if (sync != NULL && sync->dir != EC_DIR_INVALID) {
+    *dir = sync->dir;
+  } else {
+    // RxPDOs, which the master writes, are numbered 0x1600 to 0x17ff
+    *dir = (pdo_index >= 0x1600 && pdo_index < 0x1800) ? EC_DIR_OUTPUT : EC_DIR_INPUT;
+  }
+  return count;
+}
+
+/// @brief Find a PDO entry in a slave's mapping.
+///
+/// Returns the sync manager holding it and sets `*bit_pos` to its bit
+/// offset in the sync manager's data and `*size` to the size of that
+/// data, or returns -1 if the entry isn't mapped.
+static int find_entry(const struct ec_slave_config *sc, uint16_t index, uint8_t subindex, unsigned int *bit_pos, uint8_t *bit_length,
+    ec_direction_t *dir, size_t *size) {
+  sim_mapped_t mapped[SIM_MAX_MAPPED];
+  unsigned int total;
+  int i, count, found, sync_index;
+
+  for (sync_index = 0; sync_index < EC_MAX_SYNC_MANAGERS; sync_index++) {
+    count = sync_mapping(sc, sync_index, mapped, dir);
+    found = 0;
+    total = 0;
+    for (i = 0; i < count; i++) {
+      if (!found && mapped[i].index == index && mapped[i].subindex == subindex) {
+        found = 1;
+        *bit_pos = total;
+        *bit_length = mapped[i].bit_length;
+      }
+      total += mapped[i].bit_length;
+    }
+    if (found) {
+      *size = (total + 7) / 8;
+      return sync_index;
+    }
+  }
+  return -1;
+}
+
+/// @brief Find or add the region of a domain for a slave's sync manager.
+static sim_fmmu_t *prepare_fmmu(struct ec_domain *domain, struct ec_slave_config *sc, uint8_t sync_index, ec_direction_t dir, size_t size) {
+  sim_fmmu_t *fmmu;
+  void *p;
+  int i, counted = 1;
+
+  for (i = 0; i < sc->fmmu_count; i++) {
+    if (sc->fmmus[i].domain != domain) {
+      continue;
+    }
+    fmmu = &domain->fmmus[sc->fmmus[i].index];
+    if (sync_index != SIM_NO_SYNC && fmmu->sync_index == sync_index) {
+      return fmmu;
+    }
+    // inputs count once, outputs twice, per slave and direction
+    if (fmmu->dir == dir) {
+      counted = 0;
+    }
+  }
+
+  if (domain->fmmu_count == domain->fmmu_alloc) {
+    domain->fmmu_alloc = domain->fmmu_alloc > 0 ? domain->fmmu_alloc * 2 : 64;
+    if ((p = realloc(domain->fmmus, domain->fmmu_alloc * sizeof(sim_fmmu_t))) == NULL) {
+      return NULL;
+    }
+    domain->fmmus = p;
+  }
+  if (sc->fmmu_count == sc->fmmu_alloc) {
+    sc->fmmu_alloc = sc->fmmu_alloc > 0 ? sc->fmmu_alloc * 2 : 4;
+    if ((p = realloc(sc->fmmus, sc->fmmu_alloc * sizeof(sim_fmmu_ref_t))) == NULL) {
+      return NULL;
+    }
+    sc->fmmus = p;
+  }
+  sc->fmmus[sc->fmmu_count].domain = domain;
+  sc->fmmus[sc->fmmu_count++].index = domain->fmmu_count;
+
+  fmmu = &domain->fmmus[domain->fmmu_count++];
+  fmmu->sc = sc;
+  fmmu->sync_index = sync_index;
+  fmmu->dir = dir;
+  fmmu->offset = domain->size;
+  fmmu->counted = counted;
+  domain->size += size;
+  if (counted) {
+    domain->expected_wc += (dir == EC_DIR_OUTPUT) ? 2 : 1;
+  }
+  return fmmu;
+}
+
+static void free_syncs(struct ec_slave_config *sc) {
+  unsigned int i, j;
+
+  for (i = 0; i < sc->n_syncs; i++) {
+    for (j = 0; j < sc->syncs[i].n_pdos; j++) {
+      free(sc->syncs[i].pdos[j].entries);
+    }
+    free(sc->syncs[i].pdos);
+  }
+  free(sc->syncs);
+  sc->syncs = NULL;
+  sc->n_syncs = 0;
+}
+
+/// @brief Write a slave config's SDOs and PDO mapping to its slave, in the order the IgH master does.
+static int configure_slave(struct ec_slave_config *sc) {
+  sim_slave_t *slave = config_slave(sc);
+  const sim_sdo_config_t *sdo;
+  const ec_sync_info_t *sync;
+  const ec_pdo_info_t *pdo;
+  const ec_pdo_entry_info_t *entry;
+  uint8_t buf[4];
+  unsigned int i, j, k;
+  int err;
+
+  if (slave == NULL) {
+    return 0;
+  }
+
+  for (sdo = sc->sdos; sdo != NULL; sdo = sdo->next) {
+    err = sdo->complete ? write_complete(slave, sdo->index, sdo->data, sdo->size)
+                        : write_object(slave, sdo->index, sdo->subindex, sdo->data, sdo->size);
+    if (err != 0) {
+      return err;
+    }
+  }
+
+  for (i = 0; i < sc->n_syncs; i++) {
+    sync = &sc->syncs[i];
+    if (sync->n_pdos == 0) {
+      continue;
+    }
+    for (j = 0; j < sync->n_pdos; j++) {
+      pdo = &sync->pdos[j];
+      buf[0] = pdo->index & 0xff;
+      buf[1] = pdo->index >> 8;
+      write_object(slave, 0x1c10 + sync->index, j + 1, buf, 2);
+      if (pdo->n_entries == 0) {
+        continue;
+      }
+      for (k = 0; k < pdo->n_entries; k++) {
+        entry = &pdo->entries[k];
+        buf[0] = entry->bit_length;
+        buf[1] = entry->subindex;
+        buf[2] = entry->index & 0xff;
+        buf[3] = entry->index >> 8;
+        write_object(slave, pdo->index, k + 1, buf, 4);
+      }
+      buf[0] = pdo->n_entries;
+      write_object(slave, pdo->index, 0, buf, 1);
+    }
+    buf[0] = sync->n_pdos;
+    if ((err = write_object(slave, 0x1c10 + sync->index, 0, buf, 1)) != 0) {
+      return err;
+    }
+  }
+  return 0;
+}
+
+ec_master_t *ecrt_request_master(unsigned int master_index) {
+  struct ec_master *master;
+
+  if (find_master(master_index) != NULL) {
+    fprintf(stderr, "sim: master %u is already in use\n", master_index);
+    return NULL;
+  }
+  if ((master = calloc(1, sizeof(struct ec_master))) == NULL) {
+    return NULL;
+  }
+  master->index = master_index;
+  master->next = masters;
+  masters = master;
+  return master;
+}
+
+int ecrt_release_master(ec_master_t *master) {
+  struct ec_master **p;
+  struct ec_slave_config *sc;
+  struct ec_domain *domain;
+  struct ec_sdo_request *req;
+  sim_sdo_config_t *sdo;
+
+  for (p = &masters; *p != NULL; p = &(*p)->next) {
+    if (*p == master) {
+      *p = master->next;
+      break;
+    }
+  }
+
+  while ((sc = master->configs) != NULL) {
+    master->configs = sc->next;
+    while ((req = sc->requests) != NULL) {
+      sc->requests = req->next;
+      free(req->data);
+      free(req);
+    }
+    while ((sdo = sc->sdos) != NULL) {
+      sc->sdos = sdo->next;
+      free(sdo);
+    }
+    free_syncs(sc);
+    free(sc->fmmus);
+    free(sc);
+  }
+  while ((domain = master->domains) != NULL) {
+    master->domains = domain->next;
+    free(domain->fmmus);
+    free(domain);
+  }
+  free(master->entries);
+  free(master->entry_domains);
+  free(master->data);
+  free(master);
+  return 0;
+}
+
+ec_domain_t *ecrt_master_create_domain(ec_master_t *master) {
+  struct ec_domain *domain, **p;
+
+  if (master->active || (domain = calloc(1, sizeof(struct ec_domain))) == NULL) {
+    return NULL;
+  }
+  domain->master = master;
+  for (p = &master->domains; *p != NULL; p = &(*p)->next) {
+  }
+  *p = domain;
+  return domain;
+}
+
+/// @brief Configure a slave.  Unless the bus is fixed, this also puts a matching slave at the position.
+ec_slave_config_t *ecrt_master_slave_config(
+    ec_master_t *master, uint16_t alias, uint16_t position, uint32_t vendor_id, uint32_t product_code) {
+  struct ec_slave_config *sc, **p;
+
+  for (sc = master->config_buckets[position % SIM_BUCKETS]; sc != NULL; sc = sc->bucket_next) {
+    if (sc->alias == alias && sc->position == position) {
+      if (sc->vendor_id != vendor_id || sc->product_code != product_code) {
+        fprintf(stderr, "sim: slave %u:%u is already configured as 0x%08x/0x%08x\n", alias, position, sc->vendor_id, sc->product_code);
+        return NULL;
+      }
+      return sc;
+    }
+  }
+
+  if (!bus_is_fixed(master->index) && find_slave(master->index, position) == NULL &&
+      new_slave(master->index, position, vendor_id, product_code) == NULL) {
+    return NULL;
+  }
+  if ((sc = calloc(1, sizeof(struct ec_slave_config))) == NULL) {
+    return NULL;
+  }
+  sc->master = master;
+  sc->alias = alias;
+  sc->position = position;
+  sc->vendor_id = vendor_id;
+  sc->product_code = product_code;
+  sc->bucket_next = master->config_buckets[position % SIM_BUCKETS];
+  master->config_buckets[position % SIM_BUCKETS] = sc;
+  for (p = &master->configs; *p != NULL; p = &(*p)->next) {
+  }
+  *p = sc;
+  return sc;
+}
+
+int ecrt_master_sdo_download(ec_master_t *master, uint16_t slave_position, uint16_t index, uint8_t subindex, const uint8_t *data,
+    size_t data_size, uint32_t *abort_code) {
+  sim_slave_t *slave = find_slave(master->index, slave_position);
+
+  *abort_code = 0;
+  if (slave == NULL) {
+    return -EINVAL;
+  }
+  return write_object(slave, index, subindex, data, data_size);
+}
+
+int ecrt_master_sdo_upload(ec_master_t *master, uint16_t slave_position, uint16_t index, uint8_t subindex, uint8_t *target,
+    size_t target_size, size_t *result_size, uint32_t *abort_code) {
+  sim_slave_t *slave = find_slave(master->index, slave_position);
+
+  *abort_code = 0;
+  if (slave == NULL) {
+    return -EINVAL;
+  }
+  return read_object(slave, index, subindex, target, target_size, result_size);
+}
+
+int ecrt_master_read_idn(ec_master_t *master, uint16_t slave_position, uint8_t drive_no, uint16_t idn, uint8_t *target, size_t target_size,
+    size_t *result_size, uint16_t *error_code) {
+  *error_code = 0;
+  if (find_slave(master->index, slave_position) == NULL) {
+    return -EINVAL;
+  }
+  memset(target, 0, target_size);
+  *result_size = target_size;
+  return 0;
+}
+
+/// @brief Configure the slaves, lay the domains out back to back, and resolve the entry offsets.
+int ecrt_master_activate(ec_master_t *master) {
+  struct ec_slave_config *sc;
+  struct ec_domain *domain;
+  size_t size = 0;
+  int i, err;
+
+  for (sc = master->configs; sc != NULL; sc = sc->next) {
+    if ((err = configure_slave(sc)) != 0) {
+      return err;
+    }
+  }
+
+  for (domain = master->domains; domain != NULL; domain = domain->next) {
+    domain->offset = size;
+    size += domain->size;
+
+    // only slaves that are there add to the working counter
+    domain->wc = 0;
+    for (i = 0; i < domain->fmmu_count; i++) {
+      if (domain->fmmus[i].counted && config_slave(domain->fmmus[i].sc) != NULL) {
+        domain->wc += (domain->fmmus[i].dir == EC_DIR_OUTPUT) ? 2 : 1;
+      }
+    }
+  }
+  if ((master->data = calloc(1, size > 0 ? size : 1)) == NULL) {
+    return -ENOMEM;
+  }
+  master->size = size;
+  for (domain = master->domains; domain != NULL; domain = domain->next) {
+    domain->data = master->data + domain->offset;
+  }
+  for (i = 0; i < master->entry_count; i++) {
+    master->entries[i].offset += master->entry_domains[i]->offset;
+  }
+
+  master->active = 1;
+  return 0;
+}
+
+int ecrt_master_deactivate(ec_master_t *master) {
+  master->active = 0;
+  return 0;
+}
+
+/// @brief The reference clock is read as the frame passes it, which is at the RTAPI time it is sent.
+int ecrt_master_send(ec_master_t *master) {
+  int64_t now = sim_time();
+
+  now += (int64_t)(now * master->clock_drift / 1000000);
+  if (!master->ref_valid) {
+    master->ref_offset = (int64_t)master->app_time - now;
+    master->ref_valid = 1;
+  }
+  master->ref_time = master->ref_offset + now;
+  return 0;
+}
+
+int ecrt_master_receive(ec_master_t *master) {
+  sim_slave_t *slave;
+
+  master->lost = (master->lose_frames > 0);
+  if (master->lose_frames > 0) {
+    master->lose_frames--;
+  }
+  if (faulty_slaves > 0) {
+    for (slave = slaves; slave != NULL; slave = slave->next) {
+      if (slave->master == master->index && (slave->lose_frames > 0 || slave->lost)) {
+        faulty_slaves -= slave_faulty(slave);
+        slave->lost = (slave->lose_frames > 0);
+        if (slave->lose_frames > 0) {
+          slave->lose_frames--;
+        }
+        faulty_slaves += slave_faulty(slave);
+      }
+    }
+  }
+  return 0;
+}
+
+/// @brief Slaves with a matching config are in OP once the master is active, and the rest stay in PREOP.
+int ecrt_master_state(const ec_master_t *master, ec_master_state_t *state) {
+  const sim_slave_t *slave;
+
+  memset(state, 0, sizeof(ec_master_state_t));
+  for (slave = slaves; slave != NULL; slave = slave->next) {
+    if (slave->master == master->index) {
+      state->slaves_responding++;
+      state->al_states |= slave_state(master, slave, slave_config(master, slave) != NULL);
+    }
+  }
+  state->link_up = 1;
+  return 0;
+}
+
+int ecrt_master_application_time(ec_master_t *master, uint64_t app_time) {
+  master->app_time = app_time;
+  return 0;
+}
+
+int ecrt_master_sync_reference_clock(ec_master_t *master) { return 0; }
+
+int ecrt_master_sync_slave_clocks(ec_master_t *master) { return 0; }
+
+/// @brief The reference clock time read by the last frame, which is lost with the frame.
+int ecrt_master_reference_clock_time(ec_master_t *master, uint32_t *time) {
+  if (!master->ref_valid) {
+    return -ENXIO;
+  }
+  if (master->lost) {
+    return -EIO;
+  }
+  *time = (uint32_t)master->ref_time;
+  return 0;
+}
+
+int ecrt_master_sync_monitor_queue(ec_master_t *master) { return 0; }
+
+uint32_t ecrt_master_sync_monitor_process(ec_master_t *master) { return 0; }
+
+int ecrt_slave_config_watchdog(ec_slave_config_t *sc, uint16_t watchdog_divider, uint16_t watchdog_intervals) { return 0; }
+
+/// @brief Keep a copy of the PDO mapping, for placing entries and configuring the slave.
+int ecrt_slave_config_pdos(ec_slave_config_t *sc, unsigned int n_syncs, const ec_sync_info_t syncs[]) {
+  ec_sync_info_t *copy;
+  unsigned int i, j, n;
+
+  for (n = 0; n < n_syncs && syncs[n].index != 0xff; n++) {
+  }
+  free_syncs(sc);
+  if (n == 0) {
+    return 0;
+  }
+
+  if ((copy = calloc(n, sizeof(ec_sync_info_t))) == NULL) {
+    return -ENOMEM;
+  }
+  sc->syncs = copy;
+  sc->n_syncs = n;
+  for (i = 0; i < n; i++) {
+    copy[i] = syncs[i];
+    copy[i].pdos = NULL;
+    if (syncs[i].pdos == NULL || syncs[i].n_pdos == 0) {
+      copy[i].n_pdos = 0;
+      continue;
+    }
+    if ((copy[i].pdos = calloc(syncs[i].n_pdos, sizeof(ec_pdo_info_t))) == NULL) {
+      return -ENOMEM;
+    }
+    for (j = 0; j < syncs[i].n_pdos; j++) {
+      copy[i].pdos[j] = syncs[i].pdos[j];
+      copy[i].pdos[j].entries = NULL;
+      if (syncs[i].pdos[j].entries == NULL || syncs[i].pdos[j].n_entries == 0) {
+        copy[i].pdos[j].n_entries = 0;
+        continue;
+      }
+      if ((copy[i].pdos[j].entries = calloc(syncs[i].pdos[j].n_entries, sizeof(ec_pdo_entry_info_t))) == NULL) {
+        return -ENOMEM;
+      }
+      memcpy(copy[i].pdos[j].entries, syncs[i].pdos[j].entries, syncs[i].pdos[j].n_entries * sizeof(ec_pdo_entry_info_t));
+    }
+  }
+  return 0;
+}
+
+int ecrt_slave_config_dc(ec_slave_config_t *sc, uint16_t assign_activate, uint32_t sync0_cycle, int32_t sync0_shift, uint32_t sync1_cycle,
+    int32_t sync1_shift) {
+  return 0;
+}
+
+/// @brief Queue an SDO for the slave, which gets it when the master is activated.
+static int add_sdo_config(ec_slave_config_t *sc, uint16_t index, uint8_t subindex, int complete, const uint8_t *data, size_t size) {
+  sim_sdo_config_t *sdo, **p;
+
+  if ((sdo = calloc(1, sizeof(sim_sdo_config_t) + size)) == NULL) {
+    return -ENOMEM;
+  }
+  sdo->index = index;
+  sdo->subindex = subindex;
+  sdo->complete = complete;
+  sdo->size = size;
+  memcpy(sdo->data, data, size);
+  for (p = &sc->sdos; *p != NULL; p = &(*p)->next) {
+  }
+  *p = sdo;
+  return 0;
+}
+
+int ecrt_slave_config_sdo(ec_slave_config_t *sc, uint16_t index, uint8_t subindex, const uint8_t *data, size_t size) {
+  return add_sdo_config(sc, index, subindex, 0, data, size);
+}
+
+int ecrt_slave_config_complete_sdo(ec_slave_config_t *sc, uint16_t index, const uint8_t *data, size_t size) {
+  return add_sdo_config(sc, index, 0, 1, data, size);
+}
+
+int ecrt_slave_config_idn(ec_slave_config_t *sc, uint8_t drive_no, uint16_t idn, ec_al_state_t state, const uint8_t *data, size_t size) {
+  return 0;
+}
+
+int ecrt_slave_config_state(const ec_slave_config_t *sc, ec_slave_config_state_t *state) {
+  const sim_slave_t *slave = config_slave(sc);
+
+  memset(state, 0, sizeof(ec_slave_config_state_t));
+  state->online = (slave != NULL);
+  state->al_state = (slave != NULL) ? slave_state(sc->master, slave, 1) : 0;
+  state->operational = (state->al_state == EC_AL_STATE_OP);
+  return 0;
+}
+
+ec_sdo_request_t *ecrt_slave_config_create_sdo_request(ec_slave_config_t *sc, uint16_t index, uint8_t subindex, size_t size) {
+  struct ec_sdo_request *req;
+
+  if ((req = calloc(1, sizeof(struct ec_sdo_request))) == NULL) {
+    return NULL;
+  }
+  if ((req->data = calloc(1, size > 0 ? size : 1)) == NULL) {
+    free(req);
+    return NULL;
+  }
+  req->sc = sc;
+  req->index = index;
+  req->subindex = subindex;
+  req->size = size;
+  req->state = EC_REQUEST_UNUSED;
+  req->next = sc->requests;
+  sc->requests = req;
+  return req;
+}
+
+uint8_t *ecrt_sdo_request_data(ec_sdo_request_t *req) { return req->data; }
+
+ec_request_state_t ecrt_sdo_request_state(ec_sdo_request_t *req) { return req->state; }
+
+/// @brief Requests complete at once, and fail if the config's slave isn't there.
+int ecrt_sdo_request_write(ec_sdo_request_t *req) {
+  sim_slave_t *slave = config_slave(req->sc);
+
+  if (slave == NULL || write_object(slave, req->index, req->subindex, req->data, req->size) != 0) {
+    req->state = EC_REQUEST_ERROR;
+  } else {
+    req->state = EC_REQUEST_SUCCESS;
+  }
+  return 0;
+}
+
+int ecrt_sdo_request_read(ec_sdo_request_t *req) {
+  sim_slave_t *slave = config_slave(req->sc);
+  size_t result_size;
+
+  if (slave == NULL || read_object(slave, req->index, req->subindex, req->data, req->size, &result_size) != 0) {
+    req->state = EC_REQUEST_ERROR;
+  } else {
+    req->state = EC_REQUEST_SUCCESS;
+  }
+  return 0;
+}
+
+int ecrt_domain_reg_pdo_entry_list(ec_domain_t *domain, const ec_pdo_entry_reg_t *regs) {
+  struct ec_master *master = domain->master;
+  const ec_pdo_entry_reg_t *reg;
+  struct ec_slave_config *sc;
+  sim_fmmu_t *fmmu;
+  sim_entry_t *entry;
+  ec_direction_t dir;
+  unsigned int bit_pos;
+  uint8_t bit_length;
+  size_t offset, size;
+  int sync_index;
+  void *p;
+
+  for (reg = regs; reg->index != 0; reg++) {
+    if ((sc = ecrt_master_slave_config(master, reg->alias, reg->position, reg->vendor_id, reg->product_code)) == NULL) {
+      return -ENOENT;
+    }
+
+    if ((sync_index = find_entry(sc, reg->index, reg->subindex, &bit_pos, &bit_length, &dir, &size)) >= 0) {
+      fmmu = prepare_fmmu(domain, sc, sync_index, dir, size);
+    } else {
+      bit_pos = 0;
+      bit_length = 0;
+      fmmu = prepare_fmmu(domain, sc, SIM_NO_SYNC, EC_DIR_INPUT, sizeof(uint64_t));
+    }
+    if (fmmu == NULL) {
+      return -ENOMEM;
+    }
+
+    offset = fmmu->offset + bit_pos / 8;
+    if (reg->bit_position != NULL) {
+      *reg->bit_position = bit_pos % 8;
+    } else if (bit_pos % 8 != 0) {
+      fprintf(stderr, "sim: PDO entry 0x%04x:%02x of slave %u is not byte-aligned\n", reg->index, reg->subindex, reg->position);
+      return -EFAULT;
+    }
+    *reg->offset = offset;
+
+    if (master->entry_count == master->entry_alloc) {
+      master->entry_alloc = master->entry_alloc > 0 ? master->entry_alloc * 2 : 64;
+      if ((p = realloc(master->entries, master->entry_alloc * sizeof(sim_entry_t))) == NULL) {
+        return -ENOMEM;
+      }
+      master->entries = p;
+      if ((p = realloc(master->entry_domains, master->entry_alloc * sizeof(struct ec_domain *))) == NULL) {
+        return -ENOMEM;
+      }
+      master->entry_domains = p;
+    }
+    master->entry_domains[master->entry_count] = domain;
+    entry = &master->entries[master->entry_count++];
+    entry->position = reg->position;
+    entry->index = reg->index;
+    entry->subindex = reg->subindex;
+    entry->bit_length = bit_length;
+    entry->output = (sync_index >= 0 && dir == EC_DIR_OUTPUT);
+    entry->offset = offset;
+    entry->bit_position = bit_pos % 8;
+  }
+  return 0;
+}
+
+size_t ecrt_domain_size(const ec_domain_t *domain) { return domain->size; }
+
+uint8_t *ecrt_domain_data(ec_domain_t *domain) { return domain->data; }
+
+int ecrt_domain_process(ec_domain_t *domain) {
+  unsigned int wc = domain->master->lost ? 0 : domain->wc;
+  const sim_slave_t *slave;
+  int i;
+
+  // take out the slaves that didn't answer
+  for (i = 0; i < domain->fmmu_count && wc > 0 && faulty_slaves > 0; i++) {
+    if (domain->fmmus[i].counted && (slave = config_slave(domain->fmmus[i].sc)) != NULL &&
+        (slave->lost || slave_state(domain->master, slave, 1) != EC_AL_STATE_OP)) {
+      wc -= (domain->fmmus[i].dir == EC_DIR_OUTPUT) ? 2 : 1;
+    }
+  }
+
+  domain->state.working_counter = wc;
+  if (wc == 0) {
+    domain->state.wc_state = EC_WC_ZERO;
+  } else if (wc < domain->expected_wc) {
+    domain->state.wc_state = EC_WC_INCOMPLETE;
+  } else {
+    domain->state.wc_state = EC_WC_COMPLETE;
+  }
+  return 0;
+}
+
+int ecrt_domain_queue(ec_domain_t *domain) { return 0; }
+
+int ecrt_domain_state(const ec_domain_t *domain, ec_domain_state_t *state) {
+  *state = domain->state;
+  return 0;
+}
@@ -0,0 +1,617 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief In-process stand-ins for the HAL and RTAPI functions that `lcec` uses
+///
+/// The exact prototypes in `hal.h` and `rtapi.h` differ between
+/// LinuxCNC versions, so they are renamed out of the way while the
+/// headers are included, and the definitions below only have to be
+/// call-compatible with all of them.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define hal_init                      sim_hidden_hal_init
+#define hal_exit                      sim_hidden_hal_exit
+#define hal_ready                     sim_hidden_hal_ready
+#define hal_malloc                    sim_hidden_hal_malloc
+#define hal_pin_new                   sim_hidden_hal_pin_new
+#define hal_pin_u32_newf              sim_hidden_hal_pin_u32_newf
+#define hal_param_new                 sim_hidden_hal_param_new
+#define hal_export_funct              sim_hidden_hal_export_funct
+#define rtapi_print                   sim_hidden_rtapi_print
+#define rtapi_print_msg               sim_hidden_rtapi_print_msg
+#define rtapi_snprintf                sim_hidden_rtapi_snprintf
+#define rtapi_vsnprintf               sim_hidden_rtapi_vsnprintf
+#define rtapi_get_time                sim_hidden_rtapi_get_time
+#define rtapi_get_clocks              sim_hidden_rtapi_get_clocks
+#define rtapi_shmem_new               sim_hidden_rtapi_shmem_new
+#define rtapi_shmem_delete            sim_hidden_rtapi_shmem_delete
+#define rtapi_shmem_getptr            sim_hidden_rtapi_shmem_getptr
+#define rtapi_task_pll_get_reference  sim_hidden_rtapi_task_pll_get_reference
+#define rtapi_task_pll_set_correction sim_hidden_rtapi_task_pll_set_correction
+#include "sim.h"
+#undef hal_init
+#undef hal_exit
+#undef hal_ready
+#undef hal_malloc
+#undef hal_pin_new
+#undef hal_pin_u32_newf
+#undef hal_param_new
+#undef hal_export_funct
+#undef rtapi_print
+#undef rtapi_print_msg
+#undef rtapi_snprintf
+#undef rtapi_vsnprintf
+#undef rtapi_get_time
+#undef rtapi_get_clocks
+#undef rtapi_shmem_new
+#undef rtapi_shmem_delete
+#undef rtapi_shmem_getptr
+#undef rtapi_task_pll_get_reference
+#undef rtapi_task_pll_set_correction
+
+/// @brief An exported HAL function.
+typedef struct {
+  char name[HAL_NAME_LEN + 1];
+  void (*funct)(void *, long);
+  void *arg;
+} sim_funct_t;
+
+/// @brief An RTAPI shared memory block.
+typedef struct {
+  int key;
+  int id;
+  int refs;
+  unsigned long size;
+  void *ptr;
+} sim_shmem_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static sim_pin_t *pins;
+static int pin_count, pin_alloc;
+static int *pin_hash;  ///< Open-addressed table of pin numbers + 1, by name; 0 is empty.
+static int pin_hash_size;
+static sim_funct_t *functs;
+static int funct_count, funct_alloc;
+static sim_shmem_t *shmems;
+static int shmem_count, shmem_alloc, shmem_next_id = 1;
+static void **allocs;
+static int alloc_count, alloc_alloc;
+static size_t malloc_bytes;
+static int comp_next_id = 1;
+static volatile int ready_count;
+static volatile long long now;
+static long long pll_reference;
+static int pll_reference_set;
+static long pll_correction;
+static int msg_level = RTAPI_MSG_ERR;
+
+/// @brief Make room for one more element in a table.
+static int grow(void **table, int count, int *alloc, size_t size) {
+  void *p;
+  int n;
+
+  if (count < *alloc) {
+    return 0;
+  }
+  n = (*alloc > 0) ? *alloc * 2 : 64;
+  p = realloc(*table, n * size);
+  if (p == NULL) {
+    return -1;
+  }
+  *table = p;
+  *alloc = n;
+  return 0;
+}
+
+/// @brief Number of pins and params.
+int sim_pin_count(void) { return pin_count; }
+
+/// @brief Get a pin or param by position, in the order they were created.
+sim_pin_t *sim_pin(int n) { return (n >= 0 && n < pin_count) ? &pins[n] : NULL; }
+
+static unsigned int name_hash(const char *name) {
+  unsigned int h = 2166136261u;
+
+  while (*name) {
+    h = (h ^ (unsigned char)*name++) * 16777619u;
+  }
+  return h;
+}
+
+/// @brief Add pin `n` to `pin_hash`.
+static void hash_pin(int n) {
+  unsigned int h;
+
+  for (h = name_hash(pins[n].name) & (pin_hash_size - 1); pin_hash[h] != 0; h = (h + 1) & (pin_hash_size - 1)) {
+  }
+  pin_hash[h] = n + 1;
+}
+
+/// @brief Make room in `pin_hash` for one more pin.  Big configs have thousands of pins.
+static int grow_pin_hash(void) {
+  int *table, n;
+
+  if ((pin_count + 1) * 2 <= pin_hash_size) {
+    return 0;
+  }
+  n = (pin_hash_size > 0) ? pin_hash_size * 2 : 256;
+  if ((table = calloc(n, sizeof(int))) == NULL) {
+    return -1;
+  }
+  free(pin_hash);
+  pin_hash = table;
+  pin_hash_size = n;
+  for (n = 0; n < pin_count; n++) {
+    hash_pin(n);
+  }
+  return 0;
+}
+
+/// @brief Find a pin or param by name.
+sim_pin_t *sim_pin_find(const char *name) {
+  unsigned int h;
+
+  if (pin_hash_size == 0) {
+    return NULL;
+  }
+  for (h = name_hash(name) & (pin_hash_size - 1); pin_hash[h] != 0; h = (h + 1) & (pin_hash_size - 1)) {
+    if (strcmp(pins[pin_hash[h] - 1].name, name) == 0) {
+      return &pins[pin_hash[h] - 1];
+    }
+  }
+  return NULL;
+}
+
+/// @brief Get a pin's value.
+double sim_pin_get(const sim_pin_t *pin) {
+  switch (pin->type) {
+    case HAL_BIT:
+      return *(hal_bit_t *)pin->data ? 1 : 0;
+    case HAL_FLOAT:
+      return *(hal_float_t *)pin->data;
+    case HAL_S32:
+      return *(hal_s32_t *)pin->data;
+    case HAL_U32:
+      return *(hal_u32_t *)pin->data;
+    default:
+      return 0;
+  }
+}
+
+/// @brief Set a pin's value, whatever its direction.
+void sim_pin_set(sim_pin_t *pin, double value) {
+  switch (pin->type) {
+    case HAL_BIT:
+      *(hal_bit_t *)pin->data = (value != 0);
+      break;
+    case HAL_FLOAT:
+      *(hal_float_t *)pin->data = value;
+      break;
+    case HAL_S32:
+      *(hal_s32_t *)pin->data = (int32_t)value;
+      break;
+    case HAL_U32:
+      *(hal_u32_t *)pin->data = (uint32_t)value;
+      break;
+    default:
+      break;
+  }
+}
+
+/// @brief Format a pin's value the way `halcmd` would.
+int sim_pin_format(const sim_pin_t *pin, char *buf, size_t len) {
+  switch (pin->type) {
+    case HAL_BIT:
+      return snprintf(buf, len, "%d", *(hal_bit_t *)pin->data ? 1 : 0);
+    case HAL_FLOAT:
+      return snprintf(buf, len, "%.15g", (double)*(hal_float_t *)pin->data);
+    case HAL_S32:
+      return snprintf(buf, len, "%d", (int)*(hal_s32_t *)pin->data);
+    case HAL_U32:
+      return snprintf(buf, len, "%u", (unsigned int)*(hal_u32_t *)pin->data);
+    default:
+      return snprintf(buf, len, "?");
+  }
+}
+
+/// @brief Set a pin or param from a string, like `halcmd setp`.
+///
+/// Returns 0 on success, or -1 if there is no such pin or the value
+/// can't be parsed.
+int sim_setp(const char *name, const char *value) {
+  sim_pin_t *pin = sim_pin_find(name);
+  char *end;
+  double v;
+
+  if (pin == NULL) {
+    return -1;
+  }
+
+  switch (pin->type) {
+    case HAL_BIT:
+      if (strcmp(value, "1") == 0 || strcasecmp(value, "true") == 0) {
+        v = 1;
+      } else if (strcmp(value, "0") == 0 || strcasecmp(value, "false") == 0) {
+        v = 0;
+      } else {
+        return -1;
+      }
+      break;
+    case HAL_FLOAT:
+      v = strtod(value, &end);
+      break;
+    case HAL_S32:
+      v = strtol(value, &end, 0);
+      break;
+    case HAL_U32:
+      v = strtoul(value, &end, 0);
+      break;
+    default:
+      return -1;
+  }
+  if (pin->type != HAL_BIT && (end == value || *end != 0)) {
+    return -1;
+  }
+
+  sim_pin_set(pin, v);
+  return 0;
+}
+
+/// @brief Call an exported HAL function by name.
+///
+/// Returns 0 on success, or -1 if there is no such function.
+int sim_call(const char *funct, long period) {
+  int i;
+
+  for (i = 0; i < funct_count; i++) {
+    if (strcmp(functs[i].name, funct) == 0) {
+      functs[i].funct(functs[i].arg, period);
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/// @brief Get the argument an exported HAL function is called with, or NULL if there is no such function.
+///
+/// For `lcec.<master>.read`, this is the master's `lcec_master_t`,
+/// which lets a program reach the slaves and their drivers.
+void *sim_funct_arg(const char *funct) {
+  int i;
+
+  for (i = 0; i < funct_count; i++) {
+    if (strcmp(functs[i].name, funct) == 0) {
+      return functs[i].arg;
+    }
+  }
+  return NULL;
+}
+
+/// @brief Set the time returned by `rtapi_get_time()`, in ns.
+void sim_set_time(long long time) { now = time; }
+
+long long sim_time(void) { return now; }
+
+/// @brief Set the time `rtapi_task_pll_get_reference()` returns, which is the thread's wakeup time.
+///
+/// Until this is called it returns the simulated clock, as if the
+/// thread woke exactly on time.
+void sim_set_pll_reference(long long time) {
+  pll_reference = time;
+  pll_reference_set = 1;
+}
+
+/// @brief The last correction passed to `rtapi_task_pll_set_correction()`, in ns per period.
+long sim_pll_correction(void) { return pll_correction; }
+
+/// @brief Number of times any component has called `hal_ready()`.
+int sim_ready_count(void) { return ready_count; }
+
+/// @brief Bytes requested with `hal_malloc()` since the last reset.
+///
+/// Pins and params take HAL memory of their own in a real HAL, which
+/// isn't counted here.
+size_t sim_hal_malloc_bytes(void) { return malloc_bytes; }
+
+/// @brief Set the most verbose `msg_level_t` that is printed.
+void sim_set_msg_level(int level) { msg_level = level; }
+
+/// @brief Forget every pin, funct, and shared memory block, and free all HAL memory.
+void sim_hal_reset(void) {
+  int i;
+
+  pthread_mutex_lock(&lock);
+  for (i = 0; i < alloc_count; i++) {
+    free(allocs[i]);
+  }
+  for (i = 0; i < shmem_count; i++) {
+    free(shmems[i].ptr);
+  }
+  free(allocs);
+  free(shmems);
+  free(functs);
+  free(pins);
+  free(pin_hash);
+  allocs = NULL;
+  shmems = NULL;
+  functs = NULL;
+  pins = NULL;
+  pin_hash = NULL;
+  alloc_count = alloc_alloc = 0;
+  malloc_bytes = 0;
+  shmem_count = shmem_alloc = 0;
+  funct_count = funct_alloc = 0;
+  pin_count = pin_alloc = pin_hash_size = 0;
+  shmem_next_id = 1;
+  comp_next_id = 1;
+  ready_count = 0;
+  now = 0;
+  pll_reference = pll_correction = 0;
+  pll_reference_set = 0;
+  pthread_mutex_unlock(&lock);
+}
+
+/// @brief Track a block that is freed by `sim_hal_reset()`.
+static void *sim_alloc(size_t size) {
+  void *p;
+
+  pthread_mutex_lock(&lock);
+  if (grow((void **)&allocs, alloc_count, &alloc_alloc, sizeof(void *)) != 0 || (p = calloc(1, size)) == NULL) {
+    pthread_mutex_unlock(&lock);
+    return NULL;
+  }
+  allocs[alloc_count++] = p;
+  pthread_mutex_unlock(&lock);
+  return p;
+}
+
+static int sim_add_pin(const char *name, hal_type_t type, int dir, int is_param, volatile void *data, int comp_id) {
+  sim_pin_t *pin;
+
+  if (strlen(name) > HAL_NAME_LEN) {
+    fprintf(stderr, "HAL: ERROR: name '%s' is too long\n", name);
+    return -EINVAL;
+  }
+  if (sim_pin_find(name) != NULL) {
+    fprintf(stderr, "HAL: ERROR: duplicate name '%s'\n", name);
+    return -EINVAL;
+  }
+
+  pthread_mutex_lock(&lock);
+  if (grow((void **)&pins, pin_count, &pin_alloc, sizeof(sim_pin_t)) != 0 || grow_pin_hash() != 0) {
+    pthread_mutex_unlock(&lock);
+    return -ENOMEM;
+  }
+  pin = &pins[pin_count++];
+  memset(pin, 0, sizeof(sim_pin_t));
+  strcpy(pin->name, name);
+  pin->type = type;
+  pin->dir = dir;
+  pin->is_param = is_param;
+  pin->data = data;
+  pin->comp_id = comp_id;
+  hash_pin(pin_count - 1);
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+int hal_init(const char *name) {
+  int id;
+
+  pthread_mutex_lock(&lock);
+  id = comp_next_id++;
+  pthread_mutex_unlock(&lock);
+  return id;
+}
+
+int hal_exit(int comp_id) { return 0; }
+
+int hal_ready(int comp_id) {
+  __sync_fetch_and_add(&ready_count, 1);
+  return 0;
+}
+
+void *hal_malloc(long int size) {
+  __sync_fetch_and_add(&malloc_bytes, size);
+  return sim_alloc(size);
+}
+
+int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir, void **data_ptr_addr, int comp_id) {
+  void *data;
+  int err;
+
+  // like an unconnected pin, each pin gets its own zeroed storage
+  if ((data = sim_alloc(sizeof(uint64_t))) == NULL) {
+    return -ENOMEM;
+  }
+  if ((err = sim_add_pin(name, type, dir, 0, data, comp_id)) != 0) {
+    return err;
+  }
+  *data_ptr_addr = data;
+  return 0;
+}
+
+int hal_pin_u32_newf(hal_pin_dir_t dir, hal_u32_t **data_ptr_addr, int comp_id, const char *fmt, ...) {
+  char name[HAL_NAME_LEN + 1];
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(name, sizeof(name), fmt, ap);
+  va_end(ap);
+  if (len > HAL_NAME_LEN) {
+    return -ENOMEM;
+  }
+  return hal_pin_new(name, HAL_U32, dir, (void **)data_ptr_addr, comp_id);
+}
+
+int hal_param_new(const char *name, hal_type_t type, hal_param_dir_t dir, volatile void *data_addr, int comp_id) {
+  return sim_add_pin(name, type, dir, 1, data_addr, comp_id);
+}
+
+int hal_export_funct(const char *name, void (*funct)(void *, long), void *arg, int uses_fp, int reentrant, int comp_id) {
+  sim_funct_t *f;
+
+  pthread_mutex_lock(&lock);
+  if (grow((void **)&functs, funct_count, &funct_alloc, sizeof(sim_funct_t)) != 0) {
+    pthread_mutex_unlock(&lock);
+    return -ENOMEM;
+  }
+  f = &functs[funct_count++];
+  snprintf(f->name, sizeof(f->name), "%s", name);
+  f->funct = funct;
+  f->arg = arg;
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+void rtapi_print(const char *fmt, ...) {
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+}
+
+void rtapi_print_msg(msg_level_t level, const char *fmt, ...) {
+  va_list ap;
+
+  if ((int)level > msg_level) {
+    return;
+  }
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+}
+
+int rtapi_vsnprintf(char *buf, unsigned long size, const char *fmt, va_list ap) { return vsnprintf(buf, size, fmt, ap); }
+
+int rtapi_snprintf(char *buf, unsigned long size, const char *fmt, ...) {
+  va_list ap;
+  int len;
+
+  va_start(ap, fmt);
+  len = vsnprintf(buf, size, fmt, ap);
+  va_end(ap);
+  return len;
+}
+
+long long rtapi_get_time(void) { return now; }
+
+/// @brief Real elapsed time, so profiling still measures the drivers; clocks are ns here.
+long long rtapi_get_clocks(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int rtapi_shmem_new(int key, int module_id, unsigned long int size) {
+  sim_shmem_t *shmem;
+  int i, id;
+
+  pthread_mutex_lock(&lock);
+  for (i = 0; i < shmem_count; i++) {
+    if (shmems[i].key == key && shmems[i].refs > 0) {
+      if (size > shmems[i].size) {
+        pthread_mutex_unlock(&lock);
+        return -EINVAL;
+      }
+      shmems[i].refs++;
+      id = shmems[i].id;
+      pthread_mutex_unlock(&lock);
+      return id;
+    }
+  }
+
+  if (grow((void **)&shmems, shmem_count, &shmem_alloc, sizeof(sim_shmem_t)) != 0) {
+    pthread_mutex_unlock(&lock);
+    return -ENOMEM;
+  }
+  shmem = &shmems[shmem_count];
+  if ((shmem->ptr = calloc(1, size)) == NULL) {
+    pthread_mutex_unlock(&lock);
+    return -ENOMEM;
+  }
+  shmem->key = key;
+  shmem->id = shmem_next_id++;
+  shmem->refs = 1;
+  shmem->size = size;
+  shmem_count++;
+  id = shmem->id;
+  pthread_mutex_unlock(&lock);
+  return id;
+}
+
+int rtapi_shmem_delete(int shmem_id, int module_id) {
+  int i;
+
+  pthread_mutex_lock(&lock);
+  for (i = 0; i < shmem_count; i++) {
+    if (shmems[i].id == shmem_id && shmems[i].refs > 0) {
+      if (--shmems[i].refs == 0) {
+        free(shmems[i].ptr);
+        shmems[i].ptr = NULL;
+      }
+      pthread_mutex_unlock(&lock);
+      return 0;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return -EINVAL;
+}
+
+#if defined RTAPI_SERIAL && RTAPI_SERIAL >= 2
+int rtapi_shmem_getptr(int shmem_id, void **ptr, unsigned long int *size) {
+#else
+int rtapi_shmem_getptr(int shmem_id, void **ptr) {
+  unsigned long int *size = NULL;
+#endif
+  int i;
+
+  pthread_mutex_lock(&lock);
+  for (i = 0; i < shmem_count; i++) {
+    if (shmems[i].id == shmem_id && shmems[i].refs > 0) {
+      *ptr = shmems[i].ptr;
+      if (size != NULL) {
+        *size = shmems[i].size;
+      }
+      pthread_mutex_unlock(&lock);
+      return 0;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return -EINVAL;
+}
+
+#ifdef RTAPI_TASK_PLL_SUPPORT
+/// @brief The thread's wakeup time, from `sim_set_pll_reference()`, or else the simulated clock.
+long long rtapi_task_pll_get_reference(void) { return pll_reference_set ? pll_reference : now; }
+
+int rtapi_task_pll_set_correction(long value) {
+  pll_correction = value;
+  return 0;
+}
+#endif
@@ -0,0 +1,127 @@
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+//
+
+/// @file
+/// @brief Load `lcec_conf` and `lcec` into the simulator
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+int lcec_conf_main(int argc, char **argv);
+int rtapi_app_main(void);
+void rtapi_app_exit(void);
+
+static pthread_t conf_thread;
+static char *conf_argv[3];
+static volatile int conf_done;
+static int conf_running;
+static int lcec_loaded;
+static long long conf_time, load_time;
+
+static long long now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *conf_main(void *arg) {
+  lcec_conf_main(2, conf_argv);
+  conf_done = 1;
+  return NULL;
+}
+
+/// @brief Stop `lcec_conf` and wait for it to exit.
+static void stop_conf(void) {
+  if (!conf_running) {
+    return;
+  }
+  // lcec_conf stops printing logs and exits on SIGTERM
+  if (!conf_done) {
+    raise(SIGTERM);
+  }
+  pthread_join(conf_thread, NULL);
+  signal(SIGTERM, SIG_DFL);
+  conf_running = 0;
+}
+
+/// @brief Parse `config` and load `lcec`, like `loadusr -W lcec_conf` followed by `loadrt lcec`.
+///
+/// Returns 0 on success, or -1 if either step failed; errors have
+/// already been printed.
+int sim_start(const char *config) {
+  int ready = sim_ready_count();
+  long long start = now_ns();
+
+  conf_argv[0] = "lcec_conf";
+  conf_argv[1] = (char *)config;
+  conf_argv[2] = NULL;
+  conf_done = 0;
+  if (pthread_create(&conf_thread, NULL, conf_main, NULL) != 0) {
+    fprintf(stderr, "sim: unable to start lcec_conf\n");
+    return -1;
+  }
+  conf_running = 1;
+
+  // lcec_conf calls hal_ready() once the config is in shared memory
+  while (sim_ready_count() == ready && !conf_done) {
+    usleep(100);
+  }
+  if (conf_done) {
+    stop_conf();
+    sim_hal_reset();
+    sim_ecrt_reset();
+    return -1;
+  }
+  signal(SIGINT, SIG_DFL);
+  conf_time = now_ns() - start;
+
+  start = now_ns();
+  if (rtapi_app_main() != 0) {
+    stop_conf();
+    sim_hal_reset();
+    sim_ecrt_reset();
+    return -1;
+  }
+  load_time = now_ns() - start;
+  lcec_loaded = 1;
+  return 0;
+}
+
+/// @brief How long the last successful `sim_start()` spent in each step, in ns.
+///
+/// `conf_ns` runs from starting `lcec_conf` until the config is in
+/// shared memory, so it includes starting a thread and waiting up to
+/// 0.1 ms for it.  `load_ns` is all of `rtapi_app_main()`.
+void sim_start_times(long long *conf_ns, long long *load_ns) {
+  *conf_ns = conf_time;
+  *load_ns = load_time;
+}
+
+/// @brief Unload `lcec` and `lcec_conf`, and free everything, including the simulated slaves.
+void sim_stop(void) {
+  if (lcec_loaded) {
+    rtapi_app_exit();
+    lcec_loaded = 0;
+  }
+  stop_conf();
+  sim_hal_reset();
+  sim_ecrt_reset();
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+
+#include "../../src/lcec.h"
+#include "tests.h"
+
+TESTGLOBALSETUP;
+
+TESTFUNC(test_get_domain) {
+  static lcec_master_t master;
+  lcec_domain_t *def, *slow;
+  TESTSETUP;
+
+  // An empty name is the default domain, which is created first.
+  def = lcec_get_domain(&master, NULL);
+  TESTINT(def == master.first_domain, 1);
+  TESTINT(strcmp(def->name, LCEC_CONF_DEFAULT_DOMAIN), 0);
+  TESTINT(def->cycle_divider, 1);
+  TESTINT(lcec_get_domain(&master, "") == def, 1);
+  TESTINT(lcec_get_domain(&master, LCEC_CONF_DEFAULT_DOMAIN) == def, 1);
+
+  // Named domains are created once and appended.
+  slow = lcec_get_domain(&master, "slow");
+  TESTINT(slow != def, 1);
+  TESTINT(slow->master == &master, 1);
+  TESTINT(lcec_get_domain(&master, "slow") == slow, 1);
+  TESTINT(master.first_domain == def, 1);
+  TESTINT(master.last_domain == slow, 1);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_update_domain_hal) {
+  static lcec_master_t master;
+  static lcec_slave_t slave;
+  static lcec_slave_state_t slave_state;
+  static lcec_domain_t domain;
+  static lcec_domain_data_t hal_data;
+  static lcec_pdo_entry_reg_t regs;
+  static hal_u32_t wc, expected, wc_state, missed, consecutive, max_consecutive;
+  static hal_bit_t valid, extrapolated;
+  static const int states[][2] = {
+      // working counter, state
+      {0, EC_WC_ZERO},        // slaves not up yet, not a miss
+      {3, EC_WC_INCOMPLETE},  // not a miss either
+      {6, EC_WC_COMPLETE},    //
+      {0, EC_WC_ZERO},        // lost frame
+      {3, EC_WC_INCOMPLETE},  // partially processed frame
+      {6, EC_WC_COMPLETE},    //
+      {0, EC_WC_ZERO},        //
+      {6, EC_WC_COMPLETE},    //
+  };
+  static const int expect[][6] = {
+      // expected, valid, missed, consecutive, max consecutive, input
+      {0, 0, 0, 0, 0, LCEC_INPUT_HOLD},
+      {0, 0, 0, 0, 0, LCEC_INPUT_HOLD},
+      {6, 1, 0, 0, 0, LCEC_INPUT_VALID},
+      {6, 0, 1, 1, 1, LCEC_INPUT_EXTRAPOLATE},
+      {6, 0, 2, 2, 2, LCEC_INPUT_HOLD},
+      {6, 1, 2, 0, 2, LCEC_INPUT_VALID},
+      {6, 0, 3, 1, 2, LCEC_INPUT_EXTRAPOLATE},
+      {6, 1, 3, 0, 2, LCEC_INPUT_VALID},
+  };
+  int i;
+  TESTSETUP;
+
+  hal_data.working_counter = &wc;
+  hal_data.expected_wc = &expected;
+  hal_data.wc_state = &wc_state;
+  hal_data.data_valid = &valid;
+  hal_data.missed_frames = &missed;
+  hal_data.consecutive_misses = &consecutive;
+  hal_data.max_consecutive_misses = &max_consecutive;
+  regs.current = 1;
+  master.extrapolate_cycles = 1;
+  master.first_slave = &slave;
+  slave.domain = &domain;
+  slave.hal_state_data = &slave_state;
+  slave_state.extrapolated = &extrapolated;
+  domain.master = &master;
+  domain.hal_data = &hal_data;
+  domain.regs = &regs;
+
+  for (i = 0; i < sizeof(states) / sizeof(states[0]); i++) {
+    domain.state.working_counter = states[i][0];
+    domain.state.wc_state = states[i][1];
+    lcec_update_domain_hal(&domain);
+    TESTINT(wc, states[i][0]);
+    TESTINT(wc_state, states[i][1]);
+    TESTINT(expected, expect[i][0]);
+    TESTINT(valid, expect[i][1]);
+    TESTINT(domain.data_valid, expect[i][1]);
+    TESTINT(missed, expect[i][2]);
+    TESTINT(consecutive, expect[i][3]);
+    TESTINT(max_consecutive, expect[i][4]);
+    TESTINT(domain.input, expect[i][5]);
+    TESTINT(lcec_slave_input_state(&slave), expect[i][5]);
+    TESTINT(extrapolated, (expect[i][5] == LCEC_INPUT_EXTRAPOLATE));
+  }
+
+  // A domain without PDO entries never exchanges any data and is always valid.
+  regs.current = 0;
+  domain.state.working_counter = 0;
+  domain.state.wc_state = EC_WC_ZERO;
+  lcec_update_domain_hal(&domain);
+  TESTINT(domain.data_valid, 1);
+  TESTINT(missed, 3);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_extrap) {
+  lcec_extrap_t extrap;
+  TESTSETUP;
+
+  memset(&extrap, 0, sizeof(extrap));
+
+  // Moves on at the last speed, then holds.
+  lcec_extrap_update(&extrap, 10);
+  TESTINT(lcec_extrap_stale(&extrap, LCEC_INPUT_EXTRAPOLATE), 10);
+  TESTINT(lcec_extrap_stale(&extrap, LCEC_INPUT_EXTRAPOLATE), 10);
+  TESTINT(lcec_extrap_stale(&extrap, LCEC_INPUT_HOLD), 0);
+
+  // The speed after a gap is averaged over the whole gap.  The real
+  // position moved 40 in 4 cycles, 20 of which were already
+  // extrapolated.
+  lcec_extrap_update(&extrap, 20);
+  TESTINT(extrap.delta, 10);
+  TESTINT(extrap.ahead, 0);
+  TESTINT(extrap.missed, 0);
+
+  // Stopping during the gap takes the extrapolated distance back.
+  TESTINT(lcec_extrap_stale(&extrap, LCEC_INPUT_EXTRAPOLATE), 10);
+  lcec_extrap_update(&extrap, -10);
+  TESTINT(extrap.delta, 0);
+
+  TESTRESULTS;
+}
+
+TESTMAIN
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/lcec.h"
+#include "tests.h"
+
+TESTGLOBALSETUP;
+
+#define DATA_LEN 13
+
+static lcec_image_shm_t *shm;
+static lcec_image_t image;
+
+/// @brief Start each test with an empty, initialized image.
+static void setup_image(void) {
+  free(shm);
+  shm = malloc(lcec_image_shm_size(DATA_LEN));
+  lcec_image_shm_init(shm, DATA_LEN);
+  shm->magic = LCEC_IMAGE_SHMEM_MAGIC;
+  memset(&image, 0, sizeof(image));
+  image.shm = shm;
+}
+
+static void publish(uint64_t cycle) {
+  lcec_image_frame_t frame;
+  uint8_t data[DATA_LEN];
+
+  memset(&frame, 0, sizeof(frame));
+  frame.cycle = cycle;
+  frame.valid = 1;
+  memset(data, (int)cycle, sizeof(data));
+  lcec_image_publish(&image, &frame, data);
+}
+
+TESTFUNC(test_image_layout) {
+  TESTSETUP;
+
+  setup_image();
+
+  // Both buffers fit, don't overlap, and are aligned.
+  TESTINT(shm->size, (int)lcec_image_shm_size(DATA_LEN));
+  TESTINT((char *)lcec_image_frame(shm, 0) >= (char *)(shm + 1), 1);
+  TESTINT((char *)lcec_image_frame(shm, 1) >= (char *)(lcec_image_data(shm, 0) + DATA_LEN), 1);
+  TESTINT((char *)(lcec_image_data(shm, 1) + DATA_LEN) <= (char *)shm + shm->size, 1);
+  TESTINT((int)((uintptr_t)lcec_image_frame(shm, 1) % 8), 0);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_image_snapshot) {
+  lcec_image_frame_t frame;
+  uint8_t data[DATA_LEN];
+  TESTSETUP;
+
+  setup_image();
+
+  // Nothing to read until the first publish.
+  TESTINT(lcec_image_snapshot(shm, &frame, data, sizeof(data)), -1);
+
+  // The latest buffer is read, and the writer alternates between them.
+  publish(1);
+  TESTINT(shm->latest, 0);
+  TESTINT(lcec_image_snapshot(shm, &frame, data, sizeof(data)), 0);
+  TESTINT((int)frame.cycle, 1);
+  TESTINT(frame.valid, 1);
+  TESTINT(data[0], 1);
+  TESTINT(data[DATA_LEN - 1], 1);
+  publish(2);
+  TESTINT(shm->latest, 1);
+  TESTINT(lcec_image_snapshot(shm, &frame, data, sizeof(data)), 0);
+  TESTINT((int)frame.cycle, 2);
+  TESTINT(data[DATA_LEN - 1], 2);
+  TESTINT(frame.seq, 2);
+
+  // A buffer that is being written is never read.
+  lcec_image_frame(shm, 1)->seq++;
+  TESTINT(lcec_image_snapshot(shm, &frame, data, sizeof(data)), -1);
+  lcec_image_frame(shm, 1)->seq++;
+
+  // The next publish goes into the other buffer, so a reader still
+  // copying the latest one isn't disturbed.
+  publish(3);
+  TESTINT(shm->latest, 0);
+  TESTINT(lcec_image_frame(shm, 1)->seq, 4);
+  TESTINT(lcec_image_snapshot(shm, &frame, data, sizeof(data)), 0);
+  TESTINT((int)frame.cycle, 3);
+
+  // Too small a buffer or an uninitialized block is an error.
+  TESTINT(lcec_image_snapshot(shm, &frame, data, DATA_LEN - 1), -1);
+  shm->magic = 0;
+  TESTINT(lcec_image_snapshot(shm, &frame, data, sizeof(data)), -1);
+
+  TESTRESULTS;
+}
+
+TESTMAIN
@@ -0,0 +1,176 @@
+#include <stdio.h>
+
+#include "../../src/lcec.h"
+#include "tests.h"
+
+TESTGLOBALSETUP;
+
+#define SEC 1000000000LL
+
+static lcec_log_shm_t shm;
+static lcec_log_t mlog;
+static hal_u32_t dropped, suppressed;
+
+/// @brief Start each test with an empty, initialized mlog.
+static void setup_log(void) {
+  lcec_log_shm_init(&shm);
+  strcpy(shm.master_name, "m0");
+  shm.magic = LCEC_LOG_SHMEM_MAGIC;
+  memset(&mlog, 0, sizeof(mlog));
+  mlog.shm = &shm;
+  mlog.dropped = &dropped;
+  mlog.suppressed = &suppressed;
+}
+
+TESTFUNC(test_log_ring) {
+  static const int32_t args[LCEC_LOG_ARGS] = {1, 2, 3, 4};
+  lcec_log_entry_t entry;
+  int i;
+  TESTSETUP;
+
+  setup_log();
+  TESTINT(lcec_log_read(&shm, &entry), 0);
+
+  // Entries come out in order, and the ring can be reused forever.
+  for (i = 0; i < 3 * LCEC_LOG_ENTRIES; i++) {
+    TESTINT(lcec_log_queue(&shm, LCEC_LOG_OPMODE, 1, i, args, "s1"), 0);
+    TESTINT(lcec_log_read(&shm, &entry), 1);
+    TESTINT((int)entry.time, i);
+  }
+  TESTINT(entry.id, LCEC_LOG_OPMODE);
+  TESTINT(entry.args[3], 4);
+  TESTSTRING(entry.slave, "s1");
+  TESTINT(lcec_log_read(&shm, &entry), 0);
+
+  // A full ring drops new messages and counts them.
+  for (i = 0; i < LCEC_LOG_ENTRIES; i++) {
+    lcec_log_queue(&shm, LCEC_LOG_OPMODE, 1, i, args, NULL);
+  }
+  TESTINT(lcec_log_queue(&shm, LCEC_LOG_OPMODE, 5, 0, args, NULL), -1);
+  TESTINT(shm.dropped, 5);
+  TESTINT(lcec_log_read(&shm, &entry), 1);
+  TESTINT((int)entry.time, 0);
+  TESTINT(entry.slave[0], 0);
+  TESTINT(lcec_log_queue(&shm, LCEC_LOG_OPMODE, 1, 0, args, NULL), 0);
+
+  // Nothing is read from an uninitialized block.
+  shm.magic = 0;
+  TESTINT(lcec_log_read(&shm, &entry), 0);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_log_rate_limit) {
+  lcec_log_entry_t entry;
+  int i;
+  TESTSETUP;
+
+  setup_log();
+
+  // The first message goes out right away, repeats are held back.
+  for (i = 0; i < 1000; i++) {
+    lcec_log_at(&mlog, i * 1000000LL, LCEC_LOG_OPMODE, "s1", 2, i, 0, 0);
+  }
+  TESTINT(lcec_log_read(&shm, &entry), 1);
+  TESTINT(entry.count, 1);
+  TESTINT(entry.args[1], 0);
+  TESTINT(lcec_log_read(&shm, &entry), 0);
+  TESTINT(shm.suppressed, 999);
+
+  // After a full window, the flush queues them as one entry.
+  lcec_log_flush(&mlog, SEC - 1);
+  TESTINT(lcec_log_read(&shm, &entry), 0);
+  lcec_log_flush(&mlog, SEC);
+  TESTINT(lcec_log_read(&shm, &entry), 1);
+  TESTINT(entry.count, 999);
+  TESTINT(entry.args[1], 999);
+  TESTINT(suppressed, 999);
+  TESTINT(dropped, 0);
+
+  // A repeat in the next window is held back again, and folded into
+  // the next message after that.
+  lcec_log_at(&mlog, SEC + 1, LCEC_LOG_OPMODE, "s1", 2, 5, 0, 0);
+  TESTINT(lcec_log_read(&shm, &entry), 0);
+  lcec_log_at(&mlog, 3 * SEC, LCEC_LOG_OPMODE, "s1", 2, 6, 0, 0);
+  TESTINT(lcec_log_read(&shm, &entry), 1);
+  TESTINT(entry.count, 2);
+  TESTINT(entry.args[1], 6);
+
+  // Other messages have their own limit.
+  lcec_log_at(&mlog, 3 * SEC, LCEC_LOG_BUDGET_FAULT, NULL, 1, 2, 3, 0);
+  TESTINT(lcec_log_read(&shm, &entry), 1);
+  TESTINT(entry.id, LCEC_LOG_BUDGET_FAULT);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_log_burst) {
+  static char names[2 * LCEC_LOG_BURST][8];
+  lcec_log_entry_t entry;
+  int i, n;
+  TESTSETUP;
+
+  setup_log();
+
+  // Different slaves aren't coalesced, up to a burst per window.
+  for (i = 0; i < 2 * LCEC_LOG_BURST; i++) {
+    snprintf(names[i], sizeof(names[i]), "s%d", i);
+    lcec_log_at(&mlog, i, LCEC_LOG_OPMODE, names[i], 2, 0, 0, 0);
+  }
+  for (n = 0; lcec_log_read(&shm, &entry); n++) {
+  }
+  TESTINT(n, LCEC_LOG_BURST);
+  TESTINT(shm.suppressed, LCEC_LOG_BURST);
+
+  // Pending repeats for one slave are queued before another slave's message.
+  setup_log();
+  lcec_log_at(&mlog, 0, LCEC_LOG_OPMODE, names[0], 2, 0, 0, 0);
+  lcec_log_at(&mlog, 1, LCEC_LOG_OPMODE, names[0], 2, 1, 0, 0);
+  lcec_log_at(&mlog, 2, LCEC_LOG_OPMODE, names[1], 2, 2, 0, 0);
+  TESTINT(lcec_log_read(&shm, &entry), 1);
+  TESTINT(lcec_log_read(&shm, &entry), 1);
+  TESTSTRING(entry.slave, "s0");
+  TESTINT(entry.count, 1);
+  TESTINT(entry.args[1], 1);
+  TESTINT(lcec_log_read(&shm, &entry), 1);
+  TESTSTRING(entry.slave, "s1");
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_log_format) {
+  lcec_log_entry_t entry;
+  char buf[256];
+  TESTSETUP;
+
+  setup_log();
+  memset(&entry, 0, sizeof(entry));
+  entry.id = LCEC_LOG_OPMODE;
+  entry.count = 1;
+  entry.args[0] = 2;
+  entry.args[1] = 8;
+  strcpy(entry.slave, "drive");
+  TESTINT(lcec_log_format(&shm, &entry, buf, sizeof(buf)), RTAPI_MSG_ERR);
+  TESTSTRING(buf, "slave m0.drive: not in mode of operation 2, reports 8");
+
+  entry.id = LCEC_LOG_PERIOD_MISMATCH;
+  entry.count = 3;
+  entry.args[0] = 1000000;
+  entry.args[1] = 500000;
+  entry.slave[0] = 0;
+  lcec_log_format(&shm, &entry, buf, sizeof(buf));
+  TESTSTRING(buf, "master m0: invalid appTimePeriod of 1000000 ns, the thread period is 500000 ns (3 times)");
+
+  entry.id = LCEC_LOG_MSG_COUNT;
+  lcec_log_format(&shm, &entry, buf, sizeof(buf));
+  TESTSTRING(buf, "master m0: unknown message 5");
+
+  // Long messages are cut off.
+  entry.id = LCEC_LOG_PERIOD_MISMATCH;
+  lcec_log_format(&shm, &entry, buf, 20);
+  TESTSTRING(buf, "master m0: invalid ");
+
+  TESTRESULTS;
+}
+
+TESTMAIN
@@ -0,0 +1,191 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/lcec_pll.h"
+#include "tests.h"
+
+TESTGLOBALSETUP;
+
+#define SIM_PERIOD 1000000  // 1 ms thread
+#define SIM_CYCLES 4000
+#define SIM_DRIFT  50     // thread clock is 50 ppm off the reference clock
+#define SIM_NOISE  50     // +/- 50 ns measurement noise
+#define SIM_ERR0   20000  // initial error
+
+/// @brief Result of a PLL simulation.
+typedef struct {
+  int lock_cycle;     ///< First cycle the PLL reported lock, or -1.
+  double out_mean;    ///< Mean correction over the second half, in ns.
+  double out_jitter;  ///< Standard deviation of the correction over the second half, in ns.
+  int err_max;        ///< Largest error over the second half, in ns.
+  int unlocked;       ///< Number of cycles in the second half without lock.
+} sim_result_t;
+
+/// @brief Simulate a HAL thread locked to a drifting reference clock.
+///
+/// Each cycle, the error grows by the drift and shrinks by the
+/// correction.  The controller sees the error of the previous cycle,
+/// as in `lcec_write_master()`, plus some noise.
+static void simulate(const lcec_pll_params_t *params, sim_result_t *res) {
+  lcec_pll_t pll;
+  unsigned int seed = 1;
+  int32_t err = SIM_ERR0, meas = 0, out;
+  double sum = 0.0, sumsq = 0.0;
+  int i, n = 0, have_meas = 0;
+
+  lcec_pll_reset(&pll);
+  res->lock_cycle = -1;
+  res->err_max = 0;
+  res->unlocked = 0;
+
+  for (i = 0; i < SIM_CYCLES; i++) {
+    out = have_meas ? lcec_pll_update(&pll, params, meas) : 0;
+
+    seed = seed * 1103515245 + 12345;
+    meas = err + (int32_t)((seed >> 16) % (2 * SIM_NOISE + 1)) - SIM_NOISE;
+    have_meas = 1;
+
+    if (pll.locked && res->lock_cycle < 0) res->lock_cycle = i;
+    if (i >= SIM_CYCLES / 2) {
+      sum += out;
+      sumsq += (double)out * out;
+      n++;
+      if (abs(err) > res->err_max) res->err_max = abs(err);
+      if (!pll.locked) res->unlocked++;
+    }
+
+    err += SIM_DRIFT - out;
+  }
+
+  res->out_mean = sum / n;
+  res->out_jitter = sqrt(sumsq / n - res->out_mean * res->out_mean);
+}
+
+TESTFUNC(test_pll_bangbang) {
+  lcec_pll_params_t params;
+  lcec_pll_t pll;
+  TESTSETUP;
+
+  lcec_pll_init_params(&params, SIM_PERIOD);
+  lcec_pll_reset(&pll);
+  TESTINT(params.mode, LCEC_PLL_BANGBANG);
+  TESTINT(params.step, 1000);
+
+  // Always a full step, in the direction of the error.
+  TESTINT(lcec_pll_update(&pll, &params, 1), 1000);
+  TESTINT(lcec_pll_update(&pll, &params, 0), 1000);
+  TESTINT(lcec_pll_update(&pll, &params, -1), -1000);
+  TESTINT(lcec_pll_update(&pll, &params, 100000), 1000);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_pll_pi) {
+  lcec_pll_params_t params;
+  lcec_pll_t pll;
+  int i;
+  TESTSETUP;
+
+  lcec_pll_init_params(&params, SIM_PERIOD);
+  params.mode = LCEC_PLL_PI;
+  params.p_gain = 0.5;
+  params.i_gain = 0.25;
+  params.i_limit = 1000;
+  lcec_pll_reset(&pll);
+
+  // P + I, rounded.
+  TESTINT(lcec_pll_update(&pll, &params, 100), 75);
+  TESTINT(lcec_pll_update(&pll, &params, 100), 100);
+  TESTINT(lcec_pll_update(&pll, &params, -100), -25);
+
+  // Feed-forward is added as is.
+  params.ff = 10;
+  TESTINT(lcec_pll_update(&pll, &params, 0), 35);
+  params.ff = 0;
+
+  // The integrator is clamped, so it recovers as soon as the error changes sign.
+  for (i = 0; i < 1000; i++) {
+    lcec_pll_update(&pll, &params, 100000);
+  }
+  TESTINT((int)pll.integrator, 1000);
+  TESTINT(lcec_pll_update(&pll, &params, -4000), -2000);
+  TESTINT((int)pll.integrator, 0);
+
+  lcec_pll_reset(&pll);
+  TESTINT((int)pll.integrator, 0);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_pll_lock) {
+  lcec_pll_params_t params;
+  lcec_pll_t pll;
+  int i;
+  TESTSETUP;
+
+  lcec_pll_init_params(&params, SIM_PERIOD);
+  params.lock_window = 100;
+  params.lock_cycles = 3;
+  lcec_pll_reset(&pll);
+
+  // Locks after lock_cycles within the window.
+  for (i = 0; i < 2; i++) {
+    lcec_pll_update(&pll, &params, 50);
+    TESTINT(pll.locked, 0);
+  }
+  lcec_pll_update(&pll, &params, -100);
+  TESTINT(pll.locked, 1);
+  lcec_pll_update(&pll, &params, 0);
+  TESTINT(pll.locked, 1);
+
+  // A single error outside the window drops lock, and the count restarts.
+  lcec_pll_update(&pll, &params, 101);
+  TESTINT(pll.locked, 0);
+  lcec_pll_update(&pll, &params, 0);
+  TESTINT(pll.locked, 0);
+
+  // Zero lock cycles locks as soon as the error is within the window.
+  params.lock_cycles = 0;
+  lcec_pll_reset(&pll);
+  lcec_pll_update(&pll, &params, 0);
+  TESTINT(pll.locked, 1);
+  lcec_pll_update(&pll, &params, -1000);
+  TESTINT(pll.locked, 0);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_pll_simulation) {
+  lcec_pll_params_t params;
+  sim_result_t bb, pi;
+  TESTSETUP;
+
+  lcec_pll_init_params(&params, SIM_PERIOD);
+  simulate(&params, &bb);
+  params.mode = LCEC_PLL_PI;
+  simulate(&params, &pi);
+
+  fprintf(stderr, "  bang-bang: locked after %d cycles, correction %.1f +/- %.1f ns, max error %d ns\n", bb.lock_cycle, bb.out_mean,
+      bb.out_jitter, bb.err_max);
+  fprintf(stderr, "  PI:        locked after %d cycles, correction %.1f +/- %.1f ns, max error %d ns\n", pi.lock_cycle, pi.out_mean,
+      pi.out_jitter, pi.err_max);
+
+  // Both lock and stay locked, and both correct the drift on average.
+  TESTINT(bb.lock_cycle >= 0, 1);
+  TESTINT(pi.lock_cycle >= 0, 1);
+  TESTINT(bb.unlocked, 0);
+  TESTINT(pi.unlocked, 0);
+  TESTINT(fabs(bb.out_mean - SIM_DRIFT) < 5, 1);
+  TESTINT(fabs(pi.out_mean - SIM_DRIFT) < 5, 1);
+
+  // Bang-bang dithers by a full step forever; PI only follows the noise.
+  TESTINT(bb.out_jitter > 0.9 * params.step, 1);
+  TESTINT(pi.out_jitter < 0.05 * params.step, 1);
+  TESTINT(pi.err_max < 2 * SIM_NOISE, 1);
+  TESTINT(pi.err_max < bb.err_max / 10, 1);
+
+  TESTRESULTS;
+}
+
+TESTMAIN
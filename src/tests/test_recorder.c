@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/lcec.h"
+#include "tests.h"
+
+TESTGLOBALSETUP;
+
+#define DATA_LEN 16
+#define DEPTH    4
+#define PDOS     4
+
+static const lcec_recorder_range_t ranges[] = {{2, 4}, {10, 2}};
+static lcec_recorder_shm_t *shm, *copy, *tmp;
+
+/// @brief Start each test with an empty, initialized recorder.
+static void setup_recorder(void) {
+  size_t size = lcec_recorder_shm_size(DEPTH, 6, PDOS);
+
+  free(shm);
+  free(copy);
+  free(tmp);
+  shm = malloc(size);
+  copy = malloc(size);
+  tmp = malloc(size);
+  lcec_recorder_shm_init(shm, DEPTH, ranges, 2, PDOS);
+  shm->magic = LCEC_RECORDER_SHMEM_MAGIC;
+}
+
+static void store(uint64_t cycle) {
+  uint8_t data[DATA_LEN];
+  int i;
+
+  for (i = 0; i < DATA_LEN; i++) {
+    data[i] = (uint8_t)(cycle * 16 + i);
+  }
+  lcec_recorder_store(shm, cycle, cycle * 1000, 1, data);
+}
+
+TESTFUNC(test_recorder_layout) {
+  TESTSETUP;
+
+  setup_recorder();
+
+  // Records hold just the ranges, and are aligned.
+  TESTINT(shm->record_len, 6);
+  TESTINT(shm->size, (int)lcec_recorder_shm_size(DEPTH, 6, PDOS));
+  TESTINT((char *)lcec_recorder_record(shm, 0) >= (char *)(lcec_recorder_pdos(shm) + PDOS), 1);
+  TESTINT((int)((uintptr_t)lcec_recorder_record(shm, 1) % 8), 0);
+  TESTINT((char *)lcec_recorder_record(shm, DEPTH) == (char *)shm + shm->size, 1);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_recorder_ring) {
+  const uint8_t *data;
+  int i;
+  TESTSETUP;
+
+  setup_recorder();
+  TESTINT(lcec_recorder_snapshot(shm, copy, tmp), 0);
+
+  // Ranges are packed back to back.
+  store(1);
+  data = (const uint8_t *)(lcec_recorder_record(shm, 0) + 1);
+  TESTINT(data[0], 0x12);
+  TESTINT(data[3], 0x15);
+  TESTINT(data[4], 0x1a);
+  TESTINT(data[5], 0x1b);
+
+  // While recording, the oldest slot is left out of a snapshot in
+  // case it is being overwritten.
+  for (i = 2; i <= 10; i++) {
+    store(i);
+  }
+  TESTINT((int)shm->head, 10);
+  TESTINT(shm->next, 2);
+  TESTINT(lcec_recorder_snapshot(shm, copy, tmp), DEPTH - 1);
+  TESTINT(copy->depth, DEPTH - 1);
+  TESTINT((int)lcec_recorder_record(copy, 0)->cycle, 8);
+  TESTINT((int)lcec_recorder_record(copy, 2)->cycle, 10);
+  TESTINT((int)lcec_recorder_record(copy, 2)->time, 10000);
+  TESTINT(copy->size, (int)lcec_recorder_shm_size(DEPTH - 1, 6, PDOS));
+
+  // A frozen ring is copied whole, oldest first.
+  shm->frozen = 1;
+  TESTINT(lcec_recorder_snapshot(shm, copy, tmp), DEPTH);
+  TESTINT((int)lcec_recorder_record(copy, 0)->cycle, 7);
+  TESTINT((int)lcec_recorder_record(copy, 3)->cycle, 10);
+
+  // A snapshot is a valid recording, but not once it's cut short.
+  TESTINT(lcec_recorder_check(copy, copy->size), 0);
+  TESTINT(lcec_recorder_check(copy, copy->size - 1), -1);
+  copy->record_len++;
+  TESTINT(lcec_recorder_check(copy, copy->size), -1);
+
+  // Nothing is read from an uninitialized block.
+  shm->magic = 0;
+  TESTINT(lcec_recorder_snapshot(shm, copy, tmp), 0);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_recorder_value) {
+  lcec_recorder_pdo_t pdos[PDOS];
+  uint64_t value;
+  uint32_t pos;
+  TESTSETUP;
+
+  setup_recorder();
+  memset(pdos, 0, sizeof(pdos));
+  pdos[0].offset = 2;
+  pdos[1].offset = 4;
+  pdos[2].offset = 10;
+  pdos[2].bit_position = 3;
+  pdos[3].offset = 12;
+  pdos[3].bit_length = 16;
+
+  // Sizes come from the next entry, single bits from the bit position.
+  lcec_recorder_guess_lengths(pdos, PDOS);
+  TESTINT(pdos[0].bit_length, 16);
+  TESTINT(pdos[1].bit_length, 48);
+  TESTINT(pdos[2].bit_length, 1);
+  TESTINT(pdos[3].bit_length, 16);
+
+  // Values are little endian and found through the ranges.
+  store(1);
+  TESTINT(lcec_recorder_value(shm, lcec_recorder_record(shm, 0), &pdos[0], &value), 0);
+  TESTINT((int)value, 0x1312);
+  TESTINT(lcec_recorder_value(shm, lcec_recorder_record(shm, 0), &pdos[2], &value), 0);
+  TESTINT((int)value, 1);
+
+  // Entries running past or outside a range aren't decoded.
+  TESTINT(lcec_recorder_value(shm, lcec_recorder_record(shm, 0), &pdos[1], &value), -1);
+  TESTINT(lcec_recorder_value(shm, lcec_recorder_record(shm, 0), &pdos[3], &value), -1);
+  pdos[1].bit_length = 16;
+  TESTINT(lcec_recorder_value(shm, lcec_recorder_record(shm, 0), &pdos[1], &value), 0);
+  TESTINT((int)value, 0x1514);
+
+  // Entries in later ranges come after all of the earlier ones.
+  TESTINT(lcec_recorder_locate(shm, &pdos[1], &pos), 0);
+  TESTINT((int)pos, 2);
+  TESTINT(lcec_recorder_locate(shm, &pdos[2], &pos), 0);
+  TESTINT((int)pos, 4);
+  TESTINT(lcec_recorder_locate(shm, &pdos[3], &pos), -1);
+
+  TESTRESULTS;
+}
+
+TESTMAIN
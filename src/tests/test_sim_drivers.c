@@ -0,0 +1,424 @@
+/// @file
+/// @brief Bit-exact golden vectors for every driver's `proc_read` and `proc_write`.
+///
+/// Each type is loaded on its own, with its default modParams, on the
+/// simulator in `sim/`, the same way `bench/bench_drivers.c` does it,
+/// and run until the slave is operational.  `generic` gets one PDO
+/// entry of each `halType` in each direction instead.  Then, from a
+/// fixed seed:
+///
+/// - `proc_read` is called on `VECTORS` different process images, and
+///   the slave's output pins are kept after each call.
+/// - `proc_write` is called with `VECTORS` different sets of values on
+///   the slave's input pins, over a process image of random bytes, and
+///   every PDO entry registered with `lcec_pdo_init()` is kept, at the
+///   offset the master assigned it.
+///
+/// Everything kept is hashed, and the hash for each type and direction
+/// has to match the one in `test_sim_drivers.golden`, so changes to
+/// how drivers pack and unpack process data can't change a single bit
+/// without this test noticing.  Float pins are the one exception: they
+/// are rounded to `FLOAT_DIGITS` significant digits before hashing, so
+/// that the same golden file holds on every compiler and architecture.
+///
+/// After an intended change, rerun with `LCEC_GOLDEN_UPDATE=1` in the
+/// environment to rewrite the golden file, and commit it with the
+/// change.  To see what differs, run with `LCEC_GOLDEN_DUMP=<type>`
+/// before and after the change and compare the output, which lists
+/// every vector's inputs and results.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../lcec.h"
+#include "../sim/sim.h"
+#include "tests.h"
+
+TESTGLOBALSETUP;
+
+#define PERIOD        1000000
+#define WARMUP_CYCLES 100
+#define VECTORS       32
+#define MAX_GOLDEN    4096
+#define FLOAT_DIGITS  9
+
+/// @brief Kept next to this file, and found from `src/`, where `make test` runs.
+#define GOLDEN_FILE "tests/test_sim_drivers.golden"
+
+extern lcec_typelinkedlist_t *typeslist;
+
+/// @brief One line of the golden file.
+typedef struct {
+  char type[LCEC_CONF_STR_MAXLEN];
+  char op[8];
+  uint64_t hash;
+  int seen;  ///< True once the type has been run.
+} golden_t;
+
+static uint64_t rng_state;
+static const char *dump_type;
+
+static uint32_t rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return (uint32_t)rng_state;
+}
+
+/// @brief FNV-1a.
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len) {
+  const uint8_t *p = data;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    hash = (hash ^ p[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/// @brief Hash a pin's value, and print it when dumping.
+///
+/// Integer and bit pins are hashed exactly.  Float pins are rounded to
+/// `FLOAT_DIGITS` significant digits first, since the last bit of a
+/// scaled value depends on the compiler and architecture (x86-64 and
+/// aarch64 differ on whether `a * b + c` is fused, for one), and the
+/// golden file has to hold everywhere.
+static uint64_t hash_pin(uint64_t hash, const sim_pin_t *pin, int dump) {
+  double value = sim_pin_get(pin);
+  char buf[64];
+
+  if (pin->type != HAL_FLOAT) {
+    if (dump) {
+      sim_pin_format(pin, buf, sizeof(buf));
+      printf("  %s=%s\n", pin->name, buf);
+    }
+    return hash_bytes(hash, &value, sizeof(value));
+  }
+
+  if (isnan(value)) {
+    snprintf(buf, sizeof(buf), "nan");
+  } else {
+    // Adding 0.0 turns -0 into 0.
+    snprintf(buf, sizeof(buf), "%.*g", FLOAT_DIGITS, value + 0.0);
+  }
+  if (dump) {
+    printf("  %s=%s\n", pin->name, buf);
+  }
+  return hash_bytes(hash, buf, strlen(buf) + 1);
+}
+
+/// @brief Hash the bits of one PDO entry, least significant first, and print them when dumping.
+static uint64_t hash_entry(uint64_t hash, const uint8_t *data, const sim_entry_t *entry, int dump) {
+  uint8_t bytes[32];
+  uint32_t i, bit, bits = entry->bit_length ? entry->bit_length : 64;
+
+  memset(bytes, 0, sizeof(bytes));
+  for (i = 0; i < bits; i++) {
+    bit = entry->bit_position + i;
+    if ((data[entry->offset + bit / 8] >> (bit % 8)) & 1) {
+      bytes[i / 8] |= 1 << (i % 8);
+    }
+  }
+  if (dump) {
+    printf("  0x%04x:%02x=0x", entry->index, entry->subindex);
+    for (i = (bits + 7) / 8; i > 0; i--) {
+      printf("%02x", bytes[i - 1]);
+    }
+    printf("\n");
+  }
+  hash = hash_bytes(hash, &entry->index, sizeof(entry->index));
+  hash = hash_bytes(hash, &entry->subindex, sizeof(entry->subindex));
+  return hash_bytes(hash, bytes, (bits + 7) / 8);
+}
+
+/// @brief PDO entries for `generic`, which has none of its own.
+///
+/// One of each `halType`, at odd bit offsets and lengths.  The last
+/// one is split into `complexEntries`.
+static const struct {
+  int bits;
+  const char *pin;
+  const char *type;
+  const char *extra;
+} generic_entries[] = {
+    {1, "bit", "bit", ""},
+    {3, "u3", "u32", ""},
+    {12, "s12", "s32", ""},
+    {16, "float", "float", " scale=\"0.5\" offset=\"3\""},
+    {16, "float-unsigned", "float-unsigned", ""},
+    {32, "float-ieee", "float-ieee", ""},
+    {64, "float-double", "float-double-ieee", ""},
+}, generic_complex_entries[] = {
+    {1, "c-bit", "bit", ""},
+    {7, "c-s7", "s32", ""},
+    {8, "c-u8", "u32", ""},
+    {16, "c-float", "float", " scale=\"0.25\""},
+};
+
+/// @brief Write a sync manager with `generic_entries` for `generic`.
+static void write_generic_sm(FILE *f, int sm, const char *dir, int pdo, int index) {
+  size_t i;
+
+  fprintf(f, "      <syncManager idx=\"%d\" dir=\"%s\">\n        <pdo idx=\"%04x\">\n", sm, dir, pdo);
+  for (i = 0; i < sizeof(generic_entries) / sizeof(generic_entries[0]); i++) {
+    fprintf(f, "          <pdoEntry idx=\"%04x\" subIdx=\"%02zx\" bitLen=\"%d\" halPin=\"%s-%s\" halType=\"%s\"%s/>\n", index, i + 1,
+        generic_entries[i].bits, dir, generic_entries[i].pin, generic_entries[i].type, generic_entries[i].extra);
+  }
+  fprintf(f, "          <pdoEntry idx=\"%04x\" subIdx=\"%02zx\" bitLen=\"32\" halType=\"complex\">\n", index, i + 1);
+  for (i = 0; i < sizeof(generic_complex_entries) / sizeof(generic_complex_entries[0]); i++) {
+    fprintf(f, "            <complexEntry bitLen=\"%d\" halPin=\"%s-%s\" halType=\"%s\"%s/>\n", generic_complex_entries[i].bits, dir,
+        generic_complex_entries[i].pin, generic_complex_entries[i].type, generic_complex_entries[i].extra);
+  }
+  fprintf(f, "          </pdoEntry>\n        </pdo>\n      </syncManager>\n");
+}
+
+/// @brief Write a config with one slave of a type, with its default modParams.
+static int write_config(const char *path, const lcec_typelist_t *type) {
+  const lcec_modparam_desc_t *m;
+  FILE *f;
+
+  if ((f = fopen(path, "w")) == NULL) {
+    return -1;
+  }
+  fprintf(f, "<masters>\n  <master idx=\"0\" appTimePeriod=\"%d\" refClockSyncCycles=\"1000\">\n", PERIOD);
+  if (strcmp(type->name, "generic") == 0) {
+    fprintf(f, "    <slave idx=\"0\" type=\"generic\" vid=\"00000002\" pid=\"00000001\" configPdos=\"true\" name=\"d\">\n");
+    write_generic_sm(f, 2, "out", 0x1600, 0x7000);
+    write_generic_sm(f, 3, "in", 0x1a00, 0x6000);
+  } else {
+    fprintf(f, "    <slave idx=\"0\" type=\"%s\" name=\"d\">\n", type->name);
+    for (m = type->modparams; m != NULL && m->name != NULL; m++) {
+      if (m->config_value != NULL) {
+        fprintf(f, "      <modParam name=\"%s\" value=\"%s\"/>\n", m->name, m->config_value);
+      }
+    }
+  }
+  fprintf(f, "    </slave>\n  </master>\n</masters>\n");
+  return fclose(f);
+}
+
+/// @brief Load one type, and hash what its `proc_read` and `proc_write` make of the vectors.
+///
+/// Returns 0, or -1 if the type doesn't load on its own.  Directions
+/// the driver doesn't have hash to 0.
+static int run_type(const char *config, const lcec_typelist_t *type, uint64_t *read_hash, uint64_t *write_hash) {
+  char prefix[LCEC_CONF_STR_MAXLEN * 2 + 16];
+  const sim_entry_t *entries;
+  lcec_master_t *master;
+  lcec_slave_t *slave;
+  sim_pin_t *pin;
+  uint8_t *data;
+  size_t size, i;
+  int v, p, e, entry_count, dump = (dump_type != NULL && strcmp(dump_type, type->name) == 0);
+
+  *read_hash = *write_hash = 0;
+  if (write_config(config, type) != 0 || sim_start(config) != 0) {
+    return -1;
+  }
+  if ((master = sim_funct_arg(LCEC_MODULE_NAME ".0.read")) == NULL || (slave = master->first_slave) == NULL ||
+      (data = sim_master_data(0, &size)) == NULL || (entry_count = sim_master_entries(0, &entries)) < 0) {
+    sim_stop();
+    return -1;
+  }
+  snprintf(prefix, sizeof(prefix), "%s.%s.%s.", LCEC_MODULE_NAME, master->name, slave->name);
+
+  // let the slave come up
+  for (v = 0; v < WARMUP_CYCLES; v++) {
+    sim_set_time((long long)v * PERIOD);
+    sim_call(LCEC_MODULE_NAME ".read-all", PERIOD);
+    sim_call(LCEC_MODULE_NAME ".write-all", PERIOD);
+  }
+
+  rng_state = 0x9e3779b97f4a7c15ULL;
+  if (slave->proc_read != NULL) {
+    *read_hash = 0xcbf29ce484222325ULL;
+    for (v = 0; v < VECTORS; v++) {
+      for (i = 0; i < size; i++) {
+        data[i] = (uint8_t)rng_next();
+      }
+      if (dump) {
+        printf("%s read %d:\n", type->name, v);
+        for (e = 0; e < entry_count; e++) {
+          hash_entry(0, data, &entries[e], 1);
+        }
+        printf(" ->\n");
+      }
+      slave->proc_read(slave, PERIOD);
+      for (p = 0; p < sim_pin_count(); p++) {
+        pin = sim_pin(p);
+        if (!pin->is_param && pin->dir != HAL_IN && strncmp(pin->name, prefix, strlen(prefix)) == 0) {
+          *read_hash = hash_pin(*read_hash, pin, dump);
+        }
+      }
+    }
+  }
+
+  if (slave->proc_write != NULL) {
+    *write_hash = 0xcbf29ce484222325ULL;
+    for (v = 0; v < VECTORS; v++) {
+      for (i = 0; i < size; i++) {
+        data[i] = (uint8_t)rng_next();
+      }
+      if (dump) {
+        printf("%s write %d:\n", type->name, v);
+      }
+      for (p = 0; p < sim_pin_count(); p++) {
+        pin = sim_pin(p);
+        if (pin->is_param || pin->dir == HAL_OUT || strncmp(pin->name, prefix, strlen(prefix)) != 0) {
+          continue;
+        }
+        switch (pin->type) {
+          case HAL_BIT:
+            sim_pin_set(pin, rng_next() & 1);
+            break;
+          case HAL_U32:
+            sim_pin_set(pin, rng_next() % 2001);
+            break;
+          case HAL_S32:
+            sim_pin_set(pin, (double)(rng_next() % 2001) - 1000);
+            break;
+          default:
+            // hundredths, so rounding and scaling are covered too
+            sim_pin_set(pin, ((double)(rng_next() % 200001) - 100000) / 100);
+            break;
+        }
+        hash_pin(0, pin, dump);
+      }
+      if (dump) {
+        printf(" ->\n");
+      }
+      slave->proc_write(slave, PERIOD);
+      for (e = 0; e < entry_count; e++) {
+        *write_hash = hash_entry(*write_hash, data, &entries[e], dump);
+      }
+    }
+  }
+
+  sim_stop();
+  return 0;
+}
+
+/// @brief Read the golden file.  Returns the number of lines, or -1 if it can't be read.
+static int read_golden(const char *path, golden_t *golden) {
+  char line[256], *type, *op, *hash, *save;
+  int count = 0;
+  FILE *f;
+
+  if ((f = fopen(path, "r")) == NULL) {
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL && count < MAX_GOLDEN) {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0] == '#' || (type = strtok_r(line, ",", &save)) == NULL || (op = strtok_r(NULL, ",", &save)) == NULL ||
+        (hash = strtok_r(NULL, ",", &save)) == NULL) {
+      continue;
+    }
+    snprintf(golden[count].type, sizeof(golden[count].type), "%s", type);
+    snprintf(golden[count].op, sizeof(golden[count].op), "%s", op);
+    golden[count].hash = strtoull(hash, NULL, 16);
+    golden[count].seen = 0;
+    count++;
+  }
+  fclose(f);
+  return count;
+}
+
+/// @brief Find the first line for a type and direction that hasn't been seen yet.
+///
+/// A few names are added by more than one driver, and so are in
+/// `typeslist` and the golden file more than once.
+static golden_t *find_golden(golden_t *golden, int count, const char *type, const char *op) {
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (!golden[i].seen && strcmp(golden[i].type, type) == 0 && strcmp(golden[i].op, op) == 0) {
+      return &golden[i];
+    }
+  }
+  return NULL;
+}
+
+static void check_hash(golden_t *golden, int count, const char *type, const char *op, uint64_t got, int *pass, int *fail) {
+  golden_t *want = find_golden(golden, count, type, op);
+
+  if (want == NULL) {
+    fprintf(stderr, "fail: %s %s has no golden vectors; rerun with LCEC_GOLDEN_UPDATE=1\n", type, op);
+    (*fail)++;
+    return;
+  }
+  want->seen = 1;
+  if (want->hash != got) {
+    fprintf(stderr, "fail: %s %s, got %016llx, want %016llx\n", type, op, (unsigned long long)got, (unsigned long long)want->hash);
+    (*fail)++;
+  } else {
+    (*pass)++;
+  }
+}
+
+/// @brief Not a constructor like other tests, since drivers add their types in constructors too.
+int test_sim_drivers(void) {
+  static golden_t golden[MAX_GOLDEN];
+  const lcec_typelinkedlist_t *t;
+  char config[] = "/tmp/lcec-test-XXXXXX";
+  uint64_t read_hash, write_hash;
+  int i, fd, golden_count, update = (getenv("LCEC_GOLDEN_UPDATE") != NULL);
+  FILE *out = NULL;
+  TESTSETUP;
+
+  dump_type = getenv("LCEC_GOLDEN_DUMP");
+  if (update) {
+    golden_count = 0;
+    if ((out = fopen(GOLDEN_FILE, "w")) == NULL) {
+      fprintf(stderr, "fail: unable to write %s\n", GOLDEN_FILE);
+      fail++;
+      TESTRESULTS;
+    }
+    fprintf(out, "# Golden vectors for test_sim_drivers.c: type, direction, and a hash of\n");
+    fprintf(out, "# what every vector produced.  Regenerate with LCEC_GOLDEN_UPDATE=1.\n");
+  } else if ((golden_count = read_golden(GOLDEN_FILE, golden)) < 0) {
+    fprintf(stderr, "fail: unable to read %s\n", GOLDEN_FILE);
+    fail++;
+    TESTRESULTS;
+  }
+  if ((fd = mkstemp(config)) < 0) {
+    fprintf(stderr, "fail: unable to create a config file\n");
+    fail++;
+    TESTRESULTS;
+  }
+  close(fd);
+  sim_set_msg_level(RTAPI_MSG_NONE);
+
+  for (t = typeslist; t != NULL; t = t->next) {
+    // some types need more configuration than modParams
+    if (run_type(config, t->type, &read_hash, &write_hash) != 0) {
+      continue;
+    }
+    if (update) {
+      fprintf(out, "%s,read,%016llx\n", t->type->name, (unsigned long long)read_hash);
+      fprintf(out, "%s,write,%016llx\n", t->type->name, (unsigned long long)write_hash);
+      pass += 2;
+    } else {
+      check_hash(golden, golden_count, t->type->name, "read", read_hash, &pass, &fail);
+      check_hash(golden, golden_count, t->type->name, "write", write_hash, &pass, &fail);
+    }
+  }
+  unlink(config);
+  for (i = 0; i < golden_count; i++) {
+    if (!golden[i].seen) {
+      fprintf(stderr, "fail: %s %s has golden vectors, but didn't load\n", golden[i].type, golden[i].op);
+      fail++;
+    }
+  }
+  if (out != NULL) {
+    fclose(out);
+  }
+  TESTRESULTS;
+}
+
+int main(int argc, char **argv) {
+  test_sim_drivers();
+  TESTMAINRESULTS;
+}
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ecrt.h"
+#include "../sim/sim.h"
+#include "tests.h"
+
+TESTGLOBALSETUP;
+
+#define VID 0x00000002
+#define PID 0x03f03052
+
+static ec_pdo_entry_info_t out_entries[] = {{0x7000, 0x01, 1}, {0x7010, 0x01, 1}, {0x0000, 0x00, 6}};
+static ec_pdo_entry_info_t in_entries[] = {{0x6000, 0x01, 16}, {0x6000, 0x02, 16}};
+static ec_pdo_info_t pdos[] = {{0x1600, 3, out_entries}, {0x1a00, 2, in_entries}};
+static ec_sync_info_t syncs[] = {
+    {2, EC_DIR_OUTPUT, 1, &pdos[0], EC_WD_DEFAULT},
+    {3, EC_DIR_INPUT, 1, &pdos[1], EC_WD_DEFAULT},
+    {0xff},
+};
+
+/// @brief Give a slave a default mapping of two 16-bit inputs in PDO 0x1a00.
+static void set_default_mapping(unsigned int master, uint16_t position) {
+  const uint8_t count = 2, assign[] = {0x00, 0x1a}, entry1[] = {0x10, 0x01, 0x00, 0x60}, entry2[] = {0x10, 0x02, 0x00, 0x60};
+
+  sim_slave_sdo_set(master, position, 0x1c13, 0, &count, 1);
+  sim_slave_sdo_set(master, position, 0x1c13, 1, assign, 2);
+  sim_slave_sdo_set(master, position, 0x1a00, 0, &count, 1);
+  sim_slave_sdo_set(master, position, 0x1a00, 1, entry1, 4);
+  sim_slave_sdo_set(master, position, 0x1a00, 2, entry2, 4);
+}
+
+TESTFUNC(test_sim_layout) {
+  ec_master_t *master;
+  ec_domain_t *domain;
+  ec_slave_config_t *sc;
+  ec_domain_state_t state;
+  unsigned int in_off, in_bit, out_off, out_bit, def_off, unk_off;
+  const sim_entry_t *entries;
+  uint8_t *data;
+  size_t size;
+  TESTSETUP;
+
+  master = ecrt_request_master(0);
+  domain = ecrt_master_create_domain(master);
+  sc = ecrt_master_slave_config(master, 0, 0, VID, PID);
+  TESTINT(ecrt_slave_config_pdos(sc, 3, syncs), 0);
+
+  // Slave 1 has no mapping in its config, so its default one is used.
+  ecrt_master_slave_config(master, 0, 1, VID, PID);
+  set_default_mapping(0, 1);
+
+  {
+    ec_pdo_entry_reg_t regs[] = {
+        {0, 0, VID, PID, 0x6000, 0x02, &in_off, &in_bit},
+        {0, 0, VID, PID, 0x7010, 0x01, &out_off, &out_bit},
+        {0, 1, VID, PID, 0x6000, 0x02, &def_off, NULL},
+        {0, 1, VID, PID, 0x5000, 0x01, &unk_off, NULL},
+        {0},
+    };
+    TESTINT(ecrt_domain_reg_pdo_entry_list(domain, regs), 0);
+  }
+
+  // Each sync manager gets a region for its whole mapping the first
+  // time one of its entries is registered, in order.
+  TESTINT((int)in_off, 2);
+  TESTINT((int)in_bit, 0);
+  TESTINT((int)out_off, 4);
+  TESTINT((int)out_bit, 1);
+  TESTINT((int)def_off, 7);
+  TESTINT((int)unk_off, 9);
+  TESTINT((int)ecrt_domain_size(domain), 17);
+  TESTINT(sim_master_entries(0, &entries), 4);
+  TESTINT(entries[2].bit_length, 16);
+  TESTINT(entries[3].bit_length, 0);
+
+  TESTINT(ecrt_master_activate(master), 0);
+  TESTINT((data = sim_master_data(0, &size)) == ecrt_domain_data(domain), 1);
+  TESTINT((int)size, 17);
+
+  // Every slave answers: 2 for slave 0's outputs, 1 for its inputs,
+  // 1 each for slave 1's inputs.
+  ecrt_master_receive(master);
+  ecrt_domain_process(domain);
+  ecrt_domain_state(domain, &state);
+  TESTINT((int)state.working_counter, 4);
+  TESTINT(state.wc_state, EC_WC_COMPLETE);
+
+  sim_master_lose_frames(0, 1);
+  ecrt_master_receive(master);
+  ecrt_domain_process(domain);
+  ecrt_domain_state(domain, &state);
+  TESTINT((int)state.working_counter, 0);
+  TESTINT(state.wc_state, EC_WC_ZERO);
+  ecrt_master_receive(master);
+  ecrt_domain_process(domain);
+  ecrt_domain_state(domain, &state);
+  TESTINT(state.wc_state, EC_WC_COMPLETE);
+
+  ecrt_release_master(master);
+  sim_ecrt_reset();
+  TESTRESULTS;
+}
+
+TESTFUNC(test_sim_sdo) {
+  ec_master_t *master;
+  ec_slave_config_t *sc;
+  ec_sdo_request_t *req;
+  const uint8_t mode = 3, complete[] = {2, 0, 0x10, 0x16, 0x11, 0x16};
+  uint8_t buf[8];
+  uint32_t abort_code;
+  size_t result_size;
+  TESTSETUP;
+
+  master = ecrt_request_master(0);
+  sc = ecrt_master_slave_config(master, 0, 0, VID, PID);
+  ecrt_slave_config_pdos(sc, 3, syncs);
+  ecrt_slave_config_sdo(sc, 0x8000, 0x01, &mode, 1);
+  ecrt_slave_config_complete_sdo(sc, 0x1c12, complete, sizeof(complete));
+
+  // Objects that were never written read as zeros.
+  memset(buf, 0xff, sizeof(buf));
+  TESTINT(ecrt_master_sdo_upload(master, 0, 0x8000, 0x01, buf, 2, &result_size, &abort_code), 0);
+  TESTINT((int)result_size, 2);
+  TESTINT(buf[0] | buf[1], 0);
+
+  // Written objects read back, but not into a smaller buffer.
+  buf[0] = 0x34;
+  buf[1] = 0x12;
+  TESTINT(ecrt_master_sdo_download(master, 0, 0x8010, 0x02, buf, 2, &abort_code), 0);
+  TESTINT(ecrt_master_sdo_upload(master, 0, 0x8010, 0x02, buf, 4, &result_size, &abort_code), 0);
+  TESTINT((int)result_size, 2);
+  TESTINT(buf[0] | buf[1] << 8, 0x1234);
+  TESTINT(ecrt_master_sdo_upload(master, 0, 0x8010, 0x02, buf, 1, &result_size, &abort_code) < 0, 1);
+  TESTINT(ecrt_master_sdo_upload(master, 5, 0x8010, 0x02, buf, 2, &result_size, &abort_code) < 0, 1);
+
+  // Config SDOs, then the PDO mapping, reach the slave on activation.
+  TESTINT(sim_slave_sdo_get(0, 0, 0x8000, 0x01, buf, 1), -1);
+  TESTINT(ecrt_master_activate(master), 0);
+  TESTINT(sim_slave_sdo_get(0, 0, 0x8000, 0x01, buf, 1), 1);
+  TESTINT(buf[0], 3);
+  TESTINT(sim_slave_sdo_get(0, 0, 0x1c12, 0, buf, 1), 1);
+  TESTINT(buf[0], 1);
+  TESTINT(sim_slave_sdo_get(0, 0, 0x1c12, 1, buf, 2), 2);
+  TESTINT(buf[0] | buf[1] << 8, 0x1600);
+  TESTINT(sim_slave_sdo_get(0, 0, 0x1c12, 2, buf, 2), 2);
+  TESTINT(buf[0] | buf[1] << 8, 0x1611);
+  TESTINT(sim_slave_sdo_get(0, 0, 0x1600, 0, buf, 1), 1);
+  TESTINT(buf[0], 3);
+  TESTINT(sim_slave_sdo_get(0, 0, 0x1600, 2, buf, 4), 4);
+  TESTINT(buf[0] | buf[1] << 8 | buf[2] << 16 | buf[3] << 24, 0x70100101);
+
+  // Requests go to the same dictionary.
+  req = ecrt_slave_config_create_sdo_request(sc, 0x8010, 0x02, 2);
+  ecrt_sdo_request_read(req);
+  TESTINT(ecrt_sdo_request_state(req), EC_REQUEST_SUCCESS);
+  TESTINT(ecrt_sdo_request_data(req)[0], 0x34);
+  ecrt_sdo_request_data(req)[0] = 0x56;
+  ecrt_sdo_request_write(req);
+  TESTINT(ecrt_sdo_request_state(req), EC_REQUEST_SUCCESS);
+  TESTINT(sim_slave_sdo_get(0, 0, 0x8010, 0x02, buf, 2), 2);
+  TESTINT(buf[0], 0x56);
+
+  ecrt_release_master(master);
+  sim_ecrt_reset();
+  TESTRESULTS;
+}
+
+TESTFUNC(test_sim_fixed_bus) {
+  ec_master_t *master;
+  ec_domain_t *domain;
+  ec_slave_config_t *sc0, *sc1, *sc2;
+  ec_slave_config_state_t sc_state;
+  ec_master_state_t state;
+  ec_domain_state_t domain_state;
+  unsigned int off0, off1;
+  uint8_t buf[2];
+  uint32_t abort_code;
+  size_t result_size;
+  TESTSETUP;
+
+  // Slave 0 matches its config, slave 1 is something else, and
+  // there is no slave 2.
+  TESTINT(sim_slave_add(1, 0, VID, PID), 0);
+  TESTINT(sim_slave_add(1, 1, VID, PID + 1), 0);
+  TESTINT(sim_slave_add(1, 1, VID, PID), -1);
+  set_default_mapping(1, 0);
+  set_default_mapping(1, 1);
+
+  master = ecrt_request_master(1);
+  domain = ecrt_master_create_domain(master);
+  sc0 = ecrt_master_slave_config(master, 0, 0, VID, PID);
+  sc1 = ecrt_master_slave_config(master, 0, 1, VID, PID);
+  sc2 = ecrt_master_slave_config(master, 0, 2, VID, PID);
+  {
+    ec_pdo_entry_reg_t regs[] = {
+        {0, 0, VID, PID, 0x6000, 0x01, &off0, NULL},
+        {0, 1, VID, PID, 0x6000, 0x01, &off1, NULL},
+        {0},
+    };
+    TESTINT(ecrt_domain_reg_pdo_entry_list(domain, regs), 0);
+  }
+  TESTINT((int)off0, 0);
+  TESTINT((int)off1, 4);
+  TESTINT(ecrt_master_activate(master), 0);
+
+  ecrt_master_state(master, &state);
+  TESTINT((int)state.slaves_responding, 2);
+  TESTINT((int)state.al_states, (EC_AL_STATE_OP | EC_AL_STATE_PREOP));
+  ecrt_slave_config_state(sc0, &sc_state);
+  TESTINT((int)sc_state.operational, 1);
+  ecrt_slave_config_state(sc1, &sc_state);
+  TESTINT((int)sc_state.online, 0);
+  ecrt_slave_config_state(sc2, &sc_state);
+  TESTINT((int)sc_state.online, 0);
+
+  // Only slave 0 adds to the working counter.
+  ecrt_master_receive(master);
+  ecrt_domain_process(domain);
+  ecrt_domain_state(domain, &domain_state);
+  TESTINT((int)domain_state.working_counter, 1);
+  TESTINT(domain_state.wc_state, EC_WC_INCOMPLETE);
+
+  TESTINT(ecrt_master_sdo_upload(master, 2, 0x1000, 0, buf, 2, &result_size, &abort_code) < 0, 1);
+
+  ecrt_release_master(master);
+  sim_ecrt_reset();
+  TESTRESULTS;
+}
+
+TESTFUNC(test_sim_faults) {
+  ec_master_t *master;
+  ec_domain_t *domain;
+  ec_slave_config_t *sc0, *sc1;
+  ec_slave_config_state_t sc_state;
+  ec_master_state_t state;
+  ec_domain_state_t domain_state;
+  unsigned int off0, off1;
+  uint32_t dc_time;
+  TESTSETUP;
+
+  TESTINT(sim_slave_add(2, 0, VID, PID), 0);
+  TESTINT(sim_slave_add(2, 1, VID, PID), 0);
+  set_default_mapping(2, 0);
+  set_default_mapping(2, 1);
+  TESTINT(sim_slave_set_state(2, 2, EC_AL_STATE_SAFEOP), -1);
+  TESTINT(sim_slave_lose_frames(2, 2, 1), -1);
+
+  master = ecrt_request_master(2);
+  domain = ecrt_master_create_domain(master);
+  sc0 = ecrt_master_slave_config(master, 0, 0, VID, PID);
+  sc1 = ecrt_master_slave_config(master, 0, 1, VID, PID);
+  {
+    ec_pdo_entry_reg_t regs[] = {
+        {0, 0, VID, PID, 0x6000, 0x01, &off0, NULL},
+        {0, 1, VID, PID, 0x6000, 0x01, &off1, NULL},
+        {0},
+    };
+    TESTINT(ecrt_domain_reg_pdo_entry_list(domain, regs), 0);
+  }
+  TESTINT(ecrt_master_activate(master), 0);
+
+  // Slave 1 drops to SAFEOP, and stops adding to the working counter.
+  TESTINT(sim_slave_set_state(2, 1, EC_AL_STATE_SAFEOP), 0);
+  ecrt_master_state(master, &state);
+  TESTINT((int)state.al_states, (EC_AL_STATE_OP | EC_AL_STATE_SAFEOP));
+  ecrt_slave_config_state(sc1, &sc_state);
+  TESTINT((int)sc_state.online, 1);
+  TESTINT((int)sc_state.operational, 0);
+  TESTINT((int)sc_state.al_state, EC_AL_STATE_SAFEOP);
+  ecrt_master_receive(master);
+  ecrt_domain_process(domain);
+  ecrt_domain_state(domain, &domain_state);
+  TESTINT((int)domain_state.working_counter, 1);
+  TESTINT(domain_state.wc_state, EC_WC_INCOMPLETE);
+
+  // Slave 0 misses one frame, while slave 1 comes back.
+  TESTINT(sim_slave_set_state(2, 1, 0), 0);
+  TESTINT(sim_slave_lose_frames(2, 0, 1), 0);
+  ecrt_master_receive(master);
+  ecrt_domain_process(domain);
+  ecrt_domain_state(domain, &domain_state);
+  TESTINT((int)domain_state.working_counter, 1);
+  ecrt_slave_config_state(sc0, &sc_state);
+  TESTINT((int)sc_state.operational, 1);
+  ecrt_master_receive(master);
+  ecrt_domain_process(domain);
+  ecrt_domain_state(domain, &domain_state);
+  TESTINT((int)domain_state.working_counter, 2);
+  TESTINT(domain_state.wc_state, EC_WC_COMPLETE);
+
+  // The reference clock starts at the first application time, and
+  // runs 100 ppm fast.
+  sim_master_set_clock_drift(2, 100);
+  sim_set_time(1000000);
+  ecrt_master_application_time(master, 5000000);
+  ecrt_master_send(master);
+  sim_set_time(2000000);
+  ecrt_master_send(master);
+  TESTINT(ecrt_master_reference_clock_time(master, &dc_time), 0);
+  TESTINT((int)dc_time, 6000100);
+
+  ecrt_release_master(master);
+  sim_ecrt_reset();
+  sim_set_time(0);
+  TESTRESULTS;
+}
+
+TESTMAIN
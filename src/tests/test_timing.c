@@ -0,0 +1,143 @@
+#include <stdio.h>
+
+#include "../../src/lcec.h"
+#include "tests.h"
+
+TESTGLOBALSETUP;
+
+TESTFUNC(test_timing_bucket) {
+  TESTSETUP;
+
+  TESTINT(lcec_timing_bucket(0), 0);
+  TESTINT(lcec_timing_bucket(1), 0);
+  TESTINT(lcec_timing_bucket(2), 1);
+  TESTINT(lcec_timing_bucket(3), 1);
+  TESTINT(lcec_timing_bucket(1000), 9);
+  TESTINT(lcec_timing_bucket(1024), 10);
+  TESTINT(lcec_timing_bucket(1000000), 19);
+  TESTINT(lcec_timing_bucket(0xffffffff), LCEC_TIMING_HIST_BUCKETS - 1);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_timing_snapshot) {
+  static lcec_timing_shm_t shm, copy;
+  TESTSETUP;
+
+  // Uninitialized blocks are rejected.
+  TESTINT(lcec_timing_snapshot(&shm, &copy), -1);
+
+  shm.magic = LCEC_TIMING_SHMEM_MAGIC;
+  shm.cycles = 42;
+  lcec_timing_reset_stats(&shm);
+  TESTINT(shm.cycles, 0);
+  TESTINT(shm.stats[LCEC_TIMING_RECEIVE].min, 0xffffffff);
+
+  shm.stats[LCEC_TIMING_SEND].max = 1234;
+  TESTINT(lcec_timing_snapshot(&shm, &copy), 0);
+  TESTINT(copy.stats[LCEC_TIMING_SEND].max, 1234);
+
+  // A writer that never finishes (odd sequence) never yields a snapshot.
+  shm.seq = 1;
+  TESTINT(lcec_timing_snapshot(&shm, &copy), -1);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_timing_worst_phase) {
+  static lcec_timing_t timing;
+  TESTSETUP;
+
+  // Only phases set this cycle count.
+  timing.cur[LCEC_TIMING_SEND] = 5000;
+  TESTINT(lcec_timing_worst_phase(&timing), LCEC_TIMING_RECEIVE);
+
+  timing.cur[LCEC_TIMING_RECEIVE] = 1000;
+  timing.cur[LCEC_TIMING_WRITE] = 3000;
+  timing.valid = (1 << LCEC_TIMING_RECEIVE) | (1 << LCEC_TIMING_WRITE) | (1 << LCEC_TIMING_SEND);
+  TESTINT(lcec_timing_worst_phase(&timing), LCEC_TIMING_SEND);
+
+  // Totals and the period are not phases.
+  timing.cur[LCEC_TIMING_WRITE_TOTAL] = 9000;
+  timing.cur[LCEC_TIMING_PERIOD] = 1000000;
+  timing.valid |= (1 << LCEC_TIMING_WRITE_TOTAL) | (1 << LCEC_TIMING_PERIOD);
+  TESTINT(lcec_timing_worst_phase(&timing), LCEC_TIMING_SEND);
+
+  TESTRESULTS;
+}
+
+TESTFUNC(test_timing_budget) {
+  static lcec_timing_t timing;
+  static lcec_timing_shm_t shm;
+  static lcec_timing_pins_t pins[LCEC_TIMING_COUNT];
+  static hal_u32_t stat_pins[LCEC_TIMING_COUNT][4];
+  static hal_u32_t busy, overruns, overrun_max, overrun_phase;
+  static hal_bit_t reset, fault, fault_reset;
+  static const int cycles[][5] = {
+      // busy, send phase, overruns, overrun max, fault
+      {400, 100, 0, 0, 0},  //
+      {600, 500, 1, 600, 0},  // first overrun
+      {400, 100, 1, 600, 0},  //
+      {700, 100, 2, 700, 0},  // longest phase is the read
+      {800, 600, 3, 800, 1},  // second in a row
+      {500, 100, 3, 800, 1},  // the fault latches
+  };
+  int i;
+  TESTSETUP;
+
+  for (i = 0; i < LCEC_TIMING_COUNT; i++) {
+    pins[i].last = &stat_pins[i][0];
+    pins[i].min = &stat_pins[i][1];
+    pins[i].max = &stat_pins[i][2];
+    pins[i].mean = &stat_pins[i][3];
+  }
+  timing.shm = &shm;
+  timing.pins = pins;
+  timing.reset = &reset;
+  timing.busy = &busy;
+  timing.overruns = &overruns;
+  timing.overrun_max = &overrun_max;
+  timing.overrun_phase = &overrun_phase;
+  timing.fault = &fault;
+  timing.fault_reset = &fault_reset;
+  timing.budget = 500;
+  timing.fault_overruns = 2;
+  lcec_timing_reset_stats(&shm);
+
+  for (i = 0; i < sizeof(cycles) / sizeof(cycles[0]); i++) {
+    timing.last_read_start = 1000000 * (i + 1);
+    timing.send_time = timing.last_read_start + cycles[i][0];
+    timing.cur[LCEC_TIMING_READ] = 200;
+    timing.cur[LCEC_TIMING_SEND] = cycles[i][1];
+    timing.valid = (1 << LCEC_TIMING_READ) | (1 << LCEC_TIMING_SEND);
+    lcec_timing_commit(&timing);
+
+    TESTINT(busy, cycles[i][0]);
+    TESTINT(overruns, cycles[i][2]);
+    TESTINT(shm.overruns, cycles[i][2]);
+    TESTINT(overrun_max, cycles[i][3]);
+    TESTINT(fault, cycles[i][4]);
+  }
+  TESTINT(shm.budget, 500);
+  TESTINT(overrun_phase, LCEC_TIMING_SEND);
+
+  // Resetting the fault and the statistics.
+  fault_reset = 1;
+  reset = 1;
+  lcec_timing_commit(&timing);
+  TESTINT(fault, 0);
+  TESTINT(overruns, 0);
+  TESTINT(overrun_max, 0);
+
+  // A budget of 0 disables the check.
+  fault_reset = 0;
+  reset = 0;
+  timing.budget = 0;
+  timing.send_time = timing.last_read_start + 100000;
+  lcec_timing_commit(&timing);
+  TESTINT(overruns, 0);
+
+  TESTRESULTS;
+}
+
+TESTMAIN